@@ -0,0 +1,184 @@
+#include <boost/program_options.hpp>
+#include <sam/CompressedSparse.hpp>
+#include <sam/EdgeRing.hpp>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/VastNetflowGenerators.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <vector>
+
+/**
+ * Microbenchmark of the candidate filtering in CompressedSparse::findEdges.
+ * One vertex gets numEdges edges one second apart, and each lookup asks
+ * for the edges in a time window covering a fraction of them, optionally
+ * to one target.  Compares:
+ * - records: the loop findEdges used before, over an array of
+ *   (start, end, other) records with a branch per test;
+ * - scalar: the scalar kernel over the columns;
+ * - avx2: the AVX2 kernel (if the processor has it);
+ * - findEdges: the whole lookup, which only scans the edges that start
+ *   in the window (see EdgeRing), including copying the matches.
+ */
+
+namespace po = boost::program_options;
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+typedef EdgeRing<EdgeType, TimeSeconds, DurationSeconds> RingType;
+typedef CompressedSparse<EdgeType, SourceIp, DestIp, TimeSeconds,
+  DurationSeconds, StringHashFunction, StringEqualityFunction> GraphType;
+
+/**
+ * Times f over the iterations and prints the nanoseconds per lookup and
+ * per edge scanned.  numScanned is how many edges one lookup scans, which
+ * for findEdges is only the edges starting in the window.  Returns the 
+ * number of matches of the last iteration.
+ */
+template <typename F>
+size_t timeIt(std::string const& name, size_t iterations, size_t numScanned,
+              F&& f)
+{
+  size_t matches = 0;
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    matches = f();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  double seconds = std::chrono::duration_cast<
+    std::chrono::duration<double>>(end - begin).count();
+  printf("%-10s %10.1f ns/lookup %8.3f ns/scanned edge  %zu scanned  "
+    "%zu matches\n", name.c_str(), seconds * 1e9 / iterations,
+    seconds * 1e9 / (iterations * std::max<size_t>(numScanned, 1)),
+    numScanned, matches);
+  return matches;
+}
+
+int main(int argc, char** argv) {
+
+  size_t numEdges; ///> Edges of the vertex
+  size_t numTargets; ///> How many distinct targets the edges go to
+  size_t iterations; ///> How many lookups to time
+  double fraction; ///> Fraction of the edges inside the lookup window
+  bool anyTarget = false; ///> If true, the lookups don't bind the target
+
+  po::options_description desc("Benchmark of the candidate filtering in "
+    "CompressedSparse::findEdges");
+  desc.add_options()
+    ("help", "help message")
+    ("numEdges", po::value<size_t>(&numEdges)->default_value(10000),
+      "The number of edges of the vertex (default: 10000).")
+    ("numTargets", po::value<size_t>(&numTargets)->default_value(100),
+      "The number of distinct targets (default: 100).")
+    ("iterations", po::value<size_t>(&iterations)->default_value(10000),
+      "The number of lookups (default: 10000).")
+    ("fraction", po::value<double>(&fraction)->default_value(0.5),
+      "The fraction of the edges in the lookup time window (default: 0.5).")
+    ("anyTarget", po::bool_switch(&anyTarget),
+      "If specified, the lookups match any target.")
+  ;
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  // One source, numTargets targets, one edge per second.
+  double window = numEdges + 1;
+  GraphType graph(1000, window);
+  RingType ring;
+  std::vector<RingType::Record> records;
+  StringHashFunction hash;
+  Tuplizer tuplizer;
+  for (size_t i = 0; i < numEdges; i++) {
+    std::string target = "target" + std::to_string(i % numTargets);
+    std::string str = std::to_string(i) +
+      ",parseDate,dateTimeStr,ipLayerProtocol,ipLayerProtocolCode,"
+      "source," + target + ",51482,40020,1,1,1,1,1,1,1,1,1,1";
+    EdgeType edge = tuplizer(i, str);
+    graph.addEdge(edge);
+    ring.push_back(edge, hash(target));
+    records.push_back(ring.record(i));
+  }
+
+  std::vector<double> startTimes(numEdges), endTimes(numEdges);
+  std::vector<uint64_t> others(numEdges);
+  for (size_t i = 0; i < numEdges; i++) {
+    startTimes[i] = records[i].startTime;
+    endTimes[i] = records[i].endTime;
+    others[i] = records[i].other;
+  }
+
+  std::string target = anyTarget ? nullValue<std::string>() : "target0";
+  EdgeFilter filter;
+  filter.startTimeFirst = numEdges * (1 - fraction) / 2;
+  filter.startTimeSecond = numEdges * (1 + fraction) / 2;
+  filter.endTimeFirst = filter.startTimeFirst;
+  filter.endTimeSecond = filter.startTimeSecond + 1;
+  filter.now = numEdges;
+  filter.window = window;
+  filter.checkOther = !anyTarget;
+  filter.other = anyTarget ? 0 : hash(target);
+
+  std::vector<uint32_t> survivors(numEdges);
+
+  timeIt("records", iterations, numEdges, [&]() {
+    size_t count = 0;
+    for (RingType::Record const& record : records) {
+      if (filter.now - record.startTime >= filter.window) continue;
+      if (record.startTime < filter.startTimeFirst ||
+          record.startTime > filter.startTimeSecond ||
+          record.endTime < filter.endTimeFirst ||
+          record.endTime > filter.endTimeSecond)
+      {
+        continue;
+      }
+      if (filter.checkOther && record.other != filter.other) continue;
+      survivors[count++] = &record - records.data();
+    }
+    return count;
+  });
+
+  timeIt("scalar", iterations, numEdges, [&]() {
+    return ring_detail::filterScalar(filter, startTimes.data(),
+      endTimes.data(), others.data(), numEdges, survivors.data());
+  });
+
+#if SAM_HAS_AVX2_KERNELS
+  if (cpuHasAvx2()) {
+    timeIt("avx2", iterations, numEdges, [&]() {
+      return ring_detail::filterAvx2(filter, startTimes.data(),
+        endTimes.data(), others.data(), numEdges, survivors.data());
+    });
+  }
+#endif
+
+  // findEdges binary searches the ring for the edges that start in
+  // [startTimeFirst, min(startTimeSecond, endTimeSecond)] and scans those.
+  double lastStart = std::min(filter.startTimeSecond, filter.endTimeSecond);
+  size_t windowEdges = 0;
+  for (double startTime : startTimes) {
+    if (startTime >= filter.startTimeFirst && startTime <= lastStart) {
+      windowEdges++;
+    }
+  }
+
+  timeIt("findEdges", iterations, windowEdges, [&]() {
+    std::list<EdgeType> foundEdges;
+    graph.findEdges("source", target,
+      filter.startTimeFirst, filter.startTimeSecond,
+      filter.endTimeFirst, filter.endTimeSecond, foundEdges);
+    return foundEdges.size();
+  });
+
+  return 0;
+}
@@ -3,17 +3,168 @@
 
 #include <boost/program_options.hpp>
 #include <sam/ZeroMQUtil.hpp>
+#include <algorithm>
+#include <cmath>
 
 /**
  * Benchmarking the PullPull class.
+ *
+ * Each message carries the time it was sent in its first eight bytes so
+ * that the receiver can compute latency.  Latency across machines is only
+ * as good as the clock synchronization between them; with --local all the
+ * nodes run in this process.
  */
 
 namespace po = boost::program_options;
 using namespace sam;
 
-int main(int argc, char** argv) {
+/**
+ * What one run of the benchmark measured.
+ */
+struct BenchmarkResult
+{
+  double totalTime = 0; ///> Seconds from first send until terminated
+  size_t totalMessages = 0; ///> Messages sent
+  size_t totalReceived = 0; ///> Messages received
+  double p99Latency = 0; ///> 99th percentile latency in microseconds
+};
+
+/**
+ * Microseconds since the epoch.
+ */
+uint64_t microsNow()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Runs the benchmark once.
+ * \param nodeIds The nodes to run in this process.  One unless --local.
+ */
+BenchmarkResult runBenchmark(std::string const& body,
+                             size_t numNodes,
+                             std::vector<size_t> const& nodeIds,
+                             std::vector<std::string> const& hostnames,
+                             uint32_t hwm,
+                             size_t numMessages,
+                             size_t startingPort,
+                             size_t numSendThreads,
+                             size_t numPullThreads,
+                             size_t numPushSockets,
+                             int timeout,
+                             bool local,
+                             BatchPolicy batchPolicy)
+{
+  // The callback pulls the send time off the front of the message.
+  std::mutex latencyLock;
+  std::vector<uint64_t> latencies;
+  auto latencyFunction = [&latencies, &latencyLock](char const* data,
+                                                    size_t size)
+  {
+    if (size < sizeof(uint64_t)) return;
+    uint64_t sent;
+    std::memcpy(&sent, data, sizeof(sent));
+    uint64_t now = microsNow();
+    std::lock_guard<std::mutex> lock(latencyLock);
+    latencies.push_back(now > sent ? now - sent : 0);
+  };
+  typedef PushPull::RawFunctionType FunctionType;
+  std::vector<FunctionType> functions;
+  functions.push_back(latencyFunction);
+
+  std::vector<PushPull*> pushPulls;
+  for (size_t nodeId : nodeIds) {
+    pushPulls.push_back(new PushPull(numNodes, nodeId, numPushSockets,
+                                     numPullThreads, hostnames, hwm,
+                                     functions, startingPort, timeout, local,
+                                     batchPolicy));
+  }
+
+  auto begin = std::chrono::high_resolution_clock::now();
+
+  // Thread to create data and send it out.
+  auto function = [&body, numNodes, numMessages](PushPull* pushPull,
+                                                 size_t nodeId)
+  {
+    std::random_device rd;
+    auto myRand = std::mt19937(rd());
+    auto dist = std::uniform_int_distribution<size_t>(0, numNodes-1);
+
+    std::string message(sizeof(uint64_t), '\0');
+    message += body;
+
+    for( size_t i = 0; i < numMessages; i++)
+    {
+      bool found = false;
+      size_t node;
 
-  auto totalTimingBegin = std::chrono::high_resolution_clock::now();
+      // iterate until we find a destination node that is not the current node
+      while (!found) {
+        node = dist(myRand);
+
+        // Don't want to send data to ourselves.
+        if (node != nodeId) {
+          found = true;
+        }
+      }
+      uint64_t now = microsNow();
+      std::memcpy(&message[0], &now, sizeof(now));
+      pushPull->send(message, node);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < nodeIds.size(); i++) {
+    for (size_t j = 0; j < numSendThreads; j++) {
+      threads.push_back(std::thread(function, pushPulls[i], nodeIds[i]));
+    }
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Terminate all of the local nodes at once since each waits on the
+  // others' terminate messages.
+  threads.clear();
+  for (auto pushPull : pushPulls) {
+    threads.push_back(std::thread([pushPull]() { pushPull->terminate(); }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+
+  BenchmarkResult result;
+  result.totalTime = std::chrono::duration_cast<
+    std::chrono::duration<double>>(end - begin).count();
+  result.totalMessages = numMessages * numSendThreads * nodeIds.size();
+  for (auto pushPull : pushPulls) {
+    result.totalReceived += pushPull->getTotalMessagesReceived();
+    delete pushPull;
+  }
+  if (latencies.size() > 0) {
+    std::sort(latencies.begin(), latencies.end());
+    size_t index = static_cast<size_t>(
+      std::ceil(0.99 * latencies.size())) - 1;
+    result.p99Latency = latencies[index];
+  }
+  return result;
+}
+
+void printResult(std::string const& name, BenchmarkResult const& result)
+{
+  printf("%s total time: %f \n", name.c_str(), result.totalTime);
+  printf("%s messages/second: %f\n", name.c_str(),
+    result.totalMessages / result.totalTime);
+  printf("%s total messages received: %lu \n", name.c_str(),
+    result.totalReceived);
+  printf("%s p99 latency (microseconds): %f\n", name.c_str(),
+    result.p99Latency);
+}
+
+int main(int argc, char** argv) {
 
   /// Parameters
   size_t numNodes; ///> The number of nodes in the cluster
@@ -28,8 +179,12 @@ int main(int argc, char** argv) {
   size_t numPushSockets; ///> Number of push sockets per node
   bool useNetflowString = false;
   int timeout; ///> Timeout in milliseconds for zmq::send() calls
+  bool local = false; ///> Run all the nodes in this process
+  size_t batchRecords; ///> Max records in a batch
+  size_t batchBytes; ///> Max bytes in a batch
+  size_t batchMicros; ///> Max time in microseconds a record waits in a batch
 
-  /// An example netflow string.  This is used as the message 
+  /// An example netflow string.  This is used as the message
   /// when --netflowString is selected.
   std::string netflowString = "1,1,1365582756.384094,2013-04-10 08:32:36,"
                          "20130410083236.384094,17,UDP,172.20.2.18,"
@@ -39,18 +194,18 @@ int main(int argc, char** argv) {
     "for ZeroMQ");
   desc.add_options()
     ("help", "help message")
-    ("numNodes", po::value<size_t>(&numNodes)->default_value(1), 
+    ("numNodes", po::value<size_t>(&numNodes)->default_value(1),
       "The number of nodes involved in the computation (default: 1).")
-    ("nodeId", po::value<size_t>(&nodeId)->default_value(0), 
+    ("nodeId", po::value<size_t>(&nodeId)->default_value(0),
       "The node id of this node (default: 0).")
-    ("hwm", po::value<uint32_t>(&hwm)->default_value(10000), 
+    ("hwm", po::value<uint32_t>(&hwm)->default_value(10000),
       "The high water mark (how many items can queue up before we start "
       "dropping)")
     ("messageSize", po::value<size_t>(&messageSize)->default_value(1),
       "The size of the message body")
     ("startingPort", po::value<size_t>(&startingPort)->default_value(
       10000), "The starting port for the zeromq communications")
-    ("prefix", po::value<std::string>(&prefix)->default_value("node"), 
+    ("prefix", po::value<std::string>(&prefix)->default_value("node"),
       "The prefix common to all nodes (default is node, but localhost is"
       "used when there is only one node).")
     ("numMessages", po::value<size_t>(&numMessages)->default_value(
@@ -66,6 +221,17 @@ int main(int argc, char** argv) {
     ("timeout", po::value<int>(&timeout)->default_value(-1),
       "Send Timeout in milliseconds.  If -1, then block until complete."
       "  (Default -1)")
+    ("local", po::bool_switch(&local),
+      "If specified, runs all numNodes nodes in this process.")
+    ("batchRecords", po::value<size_t>(&batchRecords)->default_value(1),
+      "Send a batch when it has this many messages.  If this and batchBytes"
+      " are left at the defaults, only the unbatched run happens."
+      " (Default 1)")
+    ("batchBytes", po::value<size_t>(&batchBytes)->default_value(0),
+      "Send a batch when it reaches this many bytes.  (Default 0, no limit)")
+    ("batchMicros", po::value<size_t>(&batchMicros)->default_value(0),
+      "Send a batch when its oldest message has waited this many "
+      "microseconds. (Default 0, no deadline)")
   ;
 
   // Parse the command line variables
@@ -80,6 +246,11 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if (numNodes < 2) {
+    std::cout << "Need at least two nodes to send messages" << std::endl;
+    return 1;
+  }
+
   // Make a message of the specified size
   std::string message;
 
@@ -94,9 +265,13 @@ int main(int argc, char** argv) {
 
   std::vector<std::string> hostnames;
   hostnames.resize(numNodes);
+  std::vector<size_t> nodeIds;
 
-  if (numNodes == 1) { // Case when we are operating on one node
-    hostnames[0] = "127.0.0.1";
+  if (local) { // Case when we are operating on one node
+    for (size_t i = 0; i < numNodes; i++) {
+      hostnames[i] = "127.0.0.1";
+      nodeIds.push_back(i);
+    }
   } else {
     for (size_t i = 0; i < numNodes; i++) {
       //printf("i %lu\n", i);
@@ -104,76 +279,26 @@ int main(int argc, char** argv) {
       // [0,numNodes).
       hostnames[i] = prefix + boost::lexical_cast<std::string>(i);
     }
+    nodeIds.push_back(nodeId);
   }
 
-  // PushPull needs a list of callback functions.  Here we create a list
-  // and add a function that doesn't do anything.
-  auto noopFunction = [](std::string const& str) {
-  };
-  typedef PushPull::FunctionType FunctionType;
-  std::vector<FunctionType> functions;
-  functions.push_back(noopFunction);
-
-  PushPull* pushPull = new PushPull(numNodes, nodeId, numPushSockets, 
-                                    numPullThreads, hostnames, hwm,
-                                    functions, startingPort, timeout);
-
-  
-
-
-  // Thread to create data and send it out.  
-  auto function = [message, numNodes, nodeId, numPushSockets, numPullThreads,
-    hostnames, hwm, pushPull, numMessages]()
-  {
-    std::random_device rd;
-    auto myRand = std::mt19937(rd());
-    auto dist = std::uniform_int_distribution<size_t>(0, numNodes-1);
-
-    for( size_t i = 0; i < numMessages; i++)
-    {
-      bool found = false;
-      size_t node;
-
-      // iterate until we find a destination node that is not the current node
-      while (!found) {
-        node = dist(myRand);
-
-        // Don't want to send data to ourselves.
-        if (node != nodeId) {
-          found = true;
-        }
-      }
-      //printf("Node %lu sending message %s\n", nodeId, message.c_str());
-      pushPull->send(message, node);
-    }
-  };
-
-  std::vector<std::thread> threads;
-  threads.resize(numSendThreads);
-
-  for (size_t i = 0; i < numSendThreads; i++)
-  {
-    threads[i] = std::thread(function);
-  }
-
-
-  for (size_t i = 0; i < numSendThreads; i++)
-  {
-    threads[i].join();
+  std::string name = local ? "Local" :
+    "Node " + boost::lexical_cast<std::string>(nodeId);
+
+  BenchmarkResult unbatched = runBenchmark(message, numNodes, nodeIds,
+    hostnames, hwm, numMessages, startingPort, numSendThreads,
+    numPullThreads, numPushSockets, timeout, local, BatchPolicy());
+  printResult(name + " unbatched", unbatched);
+
+  BatchPolicy batchPolicy(batchRecords, batchBytes, batchMicros);
+  if (batchPolicy.enabled()) {
+    // Use a fresh port range so the second run doesn't collide with
+    // sockets that are still closing.
+    size_t batchedStartingPort = startingPort + numNodes * numNodes *
+                                 numPushSockets;
+    BenchmarkResult batched = runBenchmark(message, numNodes, nodeIds,
+      hostnames, hwm, numMessages, batchedStartingPort, numSendThreads,
+      numPullThreads, numPushSockets, timeout, local, batchPolicy);
+    printResult(name + " batched", batched);
   }
-
-  pushPull->terminate();
-
-  auto totalTimingEnd = std::chrono::high_resolution_clock::now();
-  auto totalTimingDiff = std::chrono::duration_cast<
-    std::chrono::duration<double>>(totalTimingEnd - totalTimingBegin);
-  double totalTime = totalTimingDiff.count();
-  size_t totalMessages = numMessages * numSendThreads;
-  size_t totalReceived = pushPull->getTotalMessagesReceived();
-  printf("Node %lu total time: %f \n", nodeId, totalTime);
-  printf("Node %lu messages/second: %f\n", nodeId, totalMessages / totalTime);
-  printf("Node %lu total messages received: %lu \n", nodeId, totalReceived);
-
-
 }
-
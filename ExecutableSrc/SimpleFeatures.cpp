@@ -76,6 +76,9 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
   //}
 
 
+  // Each operator only writes its own feature, so they are registered as
+  // concurrent and work on a batch at the same time.
+
   /** Dest Ip as key **/
   identifier = "averageSrcTotalBytes";
   auto averageSrcTotalBytes = std::make_shared<
@@ -84,7 +87,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
 
-  producer->registerConsumer(averageSrcTotalBytes);
+  producer->registerConsumer(averageSrcTotalBytes, true);
   if (subscriber != NULL) {
     averageSrcTotalBytes->registerSubscriber(subscriber, identifier);
   }
@@ -95,7 +98,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcTotalBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varSrcTotalBytes);
+  producer->registerConsumer(varSrcTotalBytes, true);
   if (subscriber != NULL) {
     varSrcTotalBytes->registerSubscriber(subscriber, identifier);
   }
@@ -106,7 +109,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestTotalBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestTotalBytes);
+  producer->registerConsumer(averageDestTotalBytes, true);
   if (subscriber != NULL) {
     averageDestTotalBytes->registerSubscriber(subscriber, identifier);
   }
@@ -117,7 +120,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestTotalBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestTotalBytes);
+  producer->registerConsumer(varDestTotalBytes, true);
   if (subscriber != NULL) {
     varDestTotalBytes->registerSubscriber(subscriber, identifier);
   }
@@ -128,7 +131,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DurationSeconds,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDuration);
+  producer->registerConsumer(averageDuration, true);
   if (subscriber != NULL) {
     averageDuration->registerSubscriber(subscriber, identifier);
   }
@@ -139,7 +142,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DurationSeconds,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDuration);
+  producer->registerConsumer(varDuration, true);
   if (subscriber != NULL) {
     varDuration->registerSubscriber(subscriber, identifier);
   }
@@ -150,7 +153,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcPayloadBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageSrcPayloadBytes);
+  producer->registerConsumer(averageSrcPayloadBytes, true);
   if (subscriber != NULL) {
     averageSrcPayloadBytes->registerSubscriber(subscriber, identifier);
   }
@@ -161,7 +164,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcPayloadBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varSrcPayloadBytes);
+  producer->registerConsumer(varSrcPayloadBytes, true);
   if (subscriber != NULL) {
     varSrcPayloadBytes->registerSubscriber(subscriber, identifier);
   }
@@ -172,7 +175,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestPayloadBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestPayloadBytes);
+  producer->registerConsumer(averageDestPayloadBytes, true);
   if (subscriber != NULL) {
     averageDestPayloadBytes->registerSubscriber(subscriber, identifier);
   }
@@ -183,7 +186,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestPayloadBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestPayloadBytes);
+  producer->registerConsumer(varDestPayloadBytes, true);
   if (subscriber != NULL) {
     varDestPayloadBytes->registerSubscriber(subscriber, identifier);
   }
@@ -194,7 +197,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenSrcPacketCount,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageSrcPacketCount);
+  producer->registerConsumer(averageSrcPacketCount, true);
   if (subscriber != NULL) {
     averageSrcPacketCount->registerSubscriber(subscriber, identifier);
   }
@@ -205,7 +208,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenSrcPacketCount,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varSrcPacketCount);
+  producer->registerConsumer(varSrcPacketCount, true);
   if (subscriber != NULL) {
     varSrcPacketCount->registerSubscriber(subscriber, identifier);
   }
@@ -216,7 +219,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenDestPacketCount,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestPacketCount);
+  producer->registerConsumer(averageDestPacketCount, true);
   if (subscriber != NULL) {
     averageDestPacketCount->registerSubscriber(subscriber, identifier);
   }
@@ -227,7 +230,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenDestPacketCount,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestPacketCount);
+  producer->registerConsumer(varDestPacketCount, true);
   if (subscriber != NULL) {
     varDestPacketCount->registerSubscriber(subscriber, identifier);
   }
@@ -239,7 +242,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcTotalBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageSrcTotalBytesSourceIp);
+  producer->registerConsumer(averageSrcTotalBytesSourceIp, true);
   if (subscriber != NULL) {
     averageSrcTotalBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -250,7 +253,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcTotalBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varSrcTotalBytesSourceIp);
+  producer->registerConsumer(varSrcTotalBytesSourceIp, true);
   if (subscriber != NULL) {
     varSrcTotalBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -261,7 +264,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestTotalBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestTotalBytesSourceIp);
+  producer->registerConsumer(averageDestTotalBytesSourceIp, true);
   if (subscriber != NULL) {
     averageDestTotalBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -272,7 +275,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestTotalBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestTotalBytesSourceIp);
+  producer->registerConsumer(varDestTotalBytesSourceIp, true);
   if (subscriber != NULL) {
     varDestTotalBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -283,7 +286,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DurationSeconds,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDurationSourceIp);
+  producer->registerConsumer(averageDurationSourceIp, true);
   if (subscriber != NULL) {
     averageDurationSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -294,7 +297,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DurationSeconds,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDurationSourceIp);
+  producer->registerConsumer(varDurationSourceIp, true);
   if (subscriber != NULL) {
     varDurationSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -305,7 +308,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcPayloadBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageSrcPayloadBytesSourceIp);
+  producer->registerConsumer(averageSrcPayloadBytesSourceIp, true);
   if (subscriber != NULL) {
     averageSrcPayloadBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -316,7 +319,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcPayloadBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varSrcPayloadBytesSourceIp);
+  producer->registerConsumer(varSrcPayloadBytesSourceIp, true);
   if (subscriber != NULL) {
     varSrcPayloadBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -327,7 +330,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestPayloadBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestPayloadBytesSourceIp);
+  producer->registerConsumer(averageDestPayloadBytesSourceIp, true);
   if (subscriber != NULL) {
     averageDestPayloadBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -338,7 +341,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestPayloadBytes,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestPayloadBytesSourceIp);
+  producer->registerConsumer(varDestPayloadBytesSourceIp, true);
   if (subscriber != NULL) {
     varDestPayloadBytesSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -349,7 +352,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenSrcPacketCount,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageSrcPacketCountSourceIp);
+  producer->registerConsumer(averageSrcPacketCountSourceIp, true);
   if (subscriber != NULL) {
     averageSrcPacketCountSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -360,7 +363,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenSrcPacketCount,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varSrcPacketCountSourceIp);
+  producer->registerConsumer(varSrcPacketCountSourceIp, true);
   if (subscriber != NULL) {
     varSrcPacketCountSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -371,7 +374,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenDestPacketCount,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestPacketCountSourceIp);
+  producer->registerConsumer(averageDestPacketCountSourceIp, true);
   if (subscriber != NULL) {
     averageDestPacketCountSourceIp->registerSubscriber(subscriber, identifier);
   }
@@ -382,7 +385,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenDestPacketCount,
                                                  SourceIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestPacketCountSourceIp);
+  producer->registerConsumer(varDestPacketCountSourceIp, true);
   if (subscriber != NULL) {
     varDestPacketCountSourceIp->registerSubscriber(subscriber, identifier);
   }
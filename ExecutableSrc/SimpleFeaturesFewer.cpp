@@ -68,6 +68,8 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
     label->registerSubscriber(subscriber, identifier); 
   }*/
 
+  // Each operator only writes its own feature, so they are registered as
+  // concurrent and work on a batch at the same time.
   
   // Original Feature from SimpleFeatures.cpp: 1 
   identifier = "varSrcTotalBytes";
@@ -76,7 +78,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcTotalBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varSrcTotalBytes);
+  producer->registerConsumer(varSrcTotalBytes, true);
   if (subscriber != NULL) {
     varSrcTotalBytes->registerSubscriber(subscriber, identifier);
   }
@@ -88,7 +90,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestTotalBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestTotalBytes);
+  producer->registerConsumer(averageDestTotalBytes, true);
   if (subscriber != NULL) {
     averageDestTotalBytes->registerSubscriber(subscriber, identifier);
   }
@@ -100,7 +102,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  SrcPayloadBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageSrcPayloadBytes);
+  producer->registerConsumer(averageSrcPayloadBytes, true);
   if (subscriber != NULL) {
     averageSrcPayloadBytes->registerSubscriber(subscriber, identifier);
   }
@@ -112,7 +114,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestPayloadBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestPayloadBytes);
+  producer->registerConsumer(averageDestPayloadBytes, true);
   if (subscriber != NULL) {
     averageDestPayloadBytes->registerSubscriber(subscriber, identifier);
   }
@@ -124,7 +126,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  DestPayloadBytes,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestPayloadBytes);
+  producer->registerConsumer(varDestPayloadBytes, true);
   if (subscriber != NULL) {
     varDestPayloadBytes->registerSubscriber(subscriber, identifier);
   }
@@ -137,7 +139,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenSrcPacketCount,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageSrcPacketCount);
+  producer->registerConsumer(averageSrcPacketCount, true);
   if (subscriber != NULL) {
     averageSrcPacketCount->registerSubscriber(subscriber, identifier);
   }
@@ -149,7 +151,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenDestPacketCount,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(averageDestPacketCount);
+  producer->registerConsumer(averageDestPacketCount, true);
   if (subscriber != NULL) {
     averageDestPacketCount->registerSubscriber(subscriber, identifier);
   }
@@ -161,7 +163,7 @@ void createPipeline(std::shared_ptr<ProducerType> producer,
                                                  FirstSeenDestPacketCount,
                                                  DestIp>>
                           (N, 2, nodeId, featureMap, identifier);
-  producer->registerConsumer(varDestPacketCount);
+  producer->registerConsumer(varDestPacketCount, true);
   if (subscriber != NULL) {
     varDestPacketCount->registerSubscriber(subscriber, identifier);
   }
@@ -21,6 +21,20 @@ trait BaseParsing extends RegexParsers {
   def int           = posInt | negInt | "0".r ^^ {_.toInt}
   
   def float         = """[+-]?([0-9]*)?[.][0-9]+""".r ^^ {_.toFloat}
+
+  // A length of time, e.g. 500ms, 30s, 5m, 1h, 1d.  Converted to seconds.
+  def duration      = """([0-9]*[.])?[0-9]+(ms|s|m|h|d)""".r ^^
+    { str =>
+      val unit = str.dropWhile(c => c.isDigit || c == '.')
+      val amount = str.dropRight(unit.length).toDouble
+      unit match {
+        case "ms" => amount / 1000
+        case "s"  => amount
+        case "m"  => amount * 60
+        case "h"  => amount * 60 * 60
+        case "d"  => amount * 60 * 60 * 24
+      }
+    }
   def identifier    = """[_\p{L}][_\p{L}\p{Nd}]*""".r ^^ {_.toString}
   def identifiers   = repsep(identifier , ",")
   
@@ -62,6 +76,9 @@ trait BaseParsing extends RegexParsers {
   def ehVarKeyWord = "(?i)ehvar".r
   def varKeyWord = "(?i)var".r
   def simpleSumKeyWord = "(?i)simplesum".r
+  def medianKeyWord = "(?i)median".r
+  def quantileKeyWord = "(?i)quantile".r
+  def countDistinctKeyWord = "(?i)countdistinct".r
   
   // Arithmetic Operators
   def arithmeticOperator = plus | minus
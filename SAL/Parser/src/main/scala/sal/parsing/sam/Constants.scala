@@ -28,12 +28,26 @@ object Constants {
   val WindowSize            = "WindowSizeVarKey"
   val DefaultWindowSize     = "10000"
 
+  // The time field used by time based windows when the stream doesn't
+  // record one.
+  val DefaultTimeField      = "TimeSeconds"
+
   val TopKK                 = "TopKKVarKey"
+
+  // The accuracy of the quantile sketches.  The rank error is about 1.7/k.
+  val QuantileK             = "QuantileKVarKey"
+  val DefaultQuantileK      = "200"
+
+  // log2 of the number of HyperLogLog registers used by countdistinct.
+  val HllPrecision          = "HllPrecisionVarKey"
+  val DefaultHllPrecision   = "10"
   
   val TopKKey               = "TopKKey"
   val EHSumKey              = "EHSumKey"
   val EHVarKey              = "EHVarKey"
   val SimpleSumKey          = "SimpleSumKey"
+  val QuantileKey           = "QuantileKey"
+  val CountDistinctKey      = "CountDistinctKey"
   val FilterKey             = "FilterKey"
 
   /************* end memory keys ********************/
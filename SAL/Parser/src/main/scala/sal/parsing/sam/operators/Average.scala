@@ -41,6 +41,20 @@ trait Average extends BaseParsing
     {case ehave ~ lpar ~ id ~ c1 ~ n ~ c2 ~ k ~ rpar =>
       EHAveExp(id, n, k, memory)}
 
+  // Time based windows, e.g. ehave(SrcTotalBytes, 60s, 2), where the
+  // window holds the items of the last 60 seconds instead of the last N.
+  def timeAveOperator : Parser[TimeEHAveExp] =
+    // When k is not specified
+    (ehAveKeyWord | aveKeyWord) ~ "(" ~ identifier ~ "," ~ duration ~ ")" ^^
+    {case kw ~ lpar ~ id ~ c1 ~ d ~ rpar =>
+      val ehk = memory.getOrElse(Constants.EHK,
+        Constants.DefaultEHK).toInt;
+      TimeEHAveExp(id, d, ehk, memory)} |
+    // When k is specified
+    (ehAveKeyWord | aveKeyWord) ~ "(" ~ identifier ~ "," ~ duration ~ "," ~
+      posInt ~ ")" ^^
+    {case kw ~ lpar ~ id ~ c1 ~ d ~ c2 ~ k ~ rpar =>
+      TimeEHAveExp(id, d, k, memory)}
 }
 
 /**
@@ -91,4 +105,47 @@ case class EHAveExp(field: String, N: Int, k: Int,
   
 }
 
+/**
+ * An expression of the form EHAve(field, duration, k) with a time based
+ * window.
+ * @param field This is a keyword of the high-level language
+ *   indicating what field is being averaged.
+ * @param duration The length of the window in seconds.
+ * @param k Determines the size of the bins in the exponential histogram.
+ */
+case class TimeEHAveExp(field: String, duration: Double, k: Int,
+                       memory: HashMap[String, String])
+  extends OperatorExp(field, memory) with Util
+{
+
+  override def createOpString() =
+  {
+    val lstream = memory.get(Constants.CurrentLStream).get
+    val rstream = memory.get(Constants.CurrentRStream).get
+
+    // Creating an entry for the operator type of lstream so we can
+    // look it up later.
+    memory += lstream + Constants.OperatorType -> Constants.EHSumKey
+
+    // Getting fields that are arguments of the template
+    val timeField = memory.getOrElse(lstream + Constants.TimeField,
+      Constants.DefaultTimeField)
+    val numKeys = memory.get(lstream + Constants.NumKeys).get
+    var keysString = ""
+    for (i <- 0 until numKeys.toInt ) {
+      keysString = keysString +
+        memory.get(lstream + Constants.KeyStr + i).get + ", "
+    }
+    keysString = keysString.dropRight(2)
+
+    var rString = "  identifier = \"" + lstream + "\";\n"
+    rString += "  auto " + lstream +
+      " = std::make_shared<TimeExponentialHistogramAve<\n" +
+      "    double, EdgeType, " + field + ", " + timeField + ", " +
+      keysString + ">>(" + duration.toString + ", " + k.toString +
+      ", nodeId, featureMap, identifier);\n"
+    rString += addRegisterStatements(lstream, rstream, memory)
+    rString
+  }
 
+}
@@ -0,0 +1,68 @@
+package sal.parsing.sam.operators
+
+import scala.collection.mutable.HashMap
+import sal.parsing.sam.BaseParsing
+import sal.parsing.sam.Constants
+import sal.parsing.sam.Util
+
+trait CountDistinct extends BaseParsing
+{
+
+  def countDistinctOperator : Parser[CountDistinctExp] =
+    // When the parameters are not specified
+    countDistinctKeyWord ~ "(" ~ identifier ~ ")" ^^
+    {case cd ~ lpar ~ id ~ rpar =>
+      val windowSize = memory.getOrElse(Constants.WindowSize,
+        Constants.DefaultWindowSize).toInt
+      val basicWindowSize = memory.getOrElse(Constants.BasicWindowSize,
+        Constants.DefaultBasicWindowSize).toInt
+      CountDistinctExp(id, windowSize, basicWindowSize, memory)} |
+    // When the parameters are specified.
+    countDistinctKeyWord ~ "(" ~ identifier ~ "," ~ posInt ~ "," ~
+      posInt ~ ")" ^^
+    {case cd ~ lpar ~ id ~ c1 ~ n ~ c2 ~ b ~ rpar =>
+      CountDistinctExp(id, n, b, memory)}
+}
+
+/**
+ * An expression of the form countdistinct(field, N, b).
+ * @param field This is a keyword of the high-level language
+ *   indicating what field the distinct values are counted of.
+ * @param N The number of items in the window.
+ * @param b The number of items in a basic window.
+ */
+case class CountDistinctExp(field: String, N: Int, b: Int,
+                            memory: HashMap[String, String])
+  extends OperatorExp(field, memory) with Util
+{
+
+  override def createOpString() =
+  {
+    val lstream = memory.get(Constants.CurrentLStream).get
+    val rstream = memory.get(Constants.CurrentRStream).get
+
+    // Creating an entry for the operator type of lstream so we can
+    // look it up later.
+    memory += lstream + Constants.OperatorType -> Constants.CountDistinctKey
+
+    // Getting fields that are arguments of the template
+    val precision = memory.getOrElse(Constants.HllPrecision,
+      Constants.DefaultHllPrecision)
+    val numKeys = memory.get(lstream + Constants.NumKeys).get
+    var keysString = ""
+    for (i <- 0 until numKeys.toInt ) {
+      keysString = keysString +
+        memory.get(lstream + Constants.KeyStr + i).get + ", "
+    }
+    keysString = keysString.dropRight(2)
+
+    var rString = "  identifier = \"" + lstream + "\";\n"
+    rString += "  auto " + lstream + " = std::make_shared<CountDistinct<\n" +
+      "    EdgeType, " + field + ", " + keysString + ">>(" +
+      N.toString + ", " + b.toString + ", " + precision +
+      ", nodeId, featureMap, identifier);\n"
+    rString += addRegisterStatements(lstream, rstream, memory)
+    rString
+  }
+
+}
@@ -5,12 +5,15 @@ package sal.parsing.sam.operators
  * be added to the disjunction below.
  */
 trait Operator extends TopK with Sum with Average
-  with Variance 
+  with Variance with Quantile with CountDistinct
 {
 
   def operator = topKOperator |
+                 timeSumOperator | timeVarOperator | timeAveOperator |
                  ehSumOperator | sumOperator |
                  ehVarOperator | varOperator |
                  ehAveOperator | aveOperator |
-                 simpleSumOperator
+                 simpleSumOperator |
+                 medianOperator | quantileOperator |
+                 countDistinctOperator
 }
@@ -0,0 +1,85 @@
+package sal.parsing.sam.operators
+
+import scala.collection.mutable.HashMap
+import sal.parsing.sam.BaseParsing
+import sal.parsing.sam.Constants
+import sal.parsing.sam.Util
+
+trait Quantile extends BaseParsing
+{
+
+  def medianOperator : Parser[QuantileExp] =
+    // When the parameters are not specified
+    medianKeyWord ~ "(" ~ identifier ~ ")" ^^
+    {case median ~ lpar ~ id ~ rpar =>
+      QuantileExp(id, 0.5, windowSize, basicWindowSize, memory)} |
+    // When the parameters are specified.
+    medianKeyWord ~ "(" ~ identifier ~ "," ~ posInt ~ "," ~ posInt ~ ")" ^^
+    {case median ~ lpar ~ id ~ c1 ~ n ~ c2 ~ b ~ rpar =>
+      QuantileExp(id, 0.5, n, b, memory)}
+
+  def quantileOperator : Parser[QuantileExp] =
+    // When the parameters are not specified
+    quantileKeyWord ~ "(" ~ identifier ~ "," ~ probability ~ ")" ^^
+    {case quantile ~ lpar ~ id ~ c1 ~ q ~ rpar =>
+      QuantileExp(id, q, windowSize, basicWindowSize, memory)} |
+    // When the parameters are specified.
+    quantileKeyWord ~ "(" ~ identifier ~ "," ~ probability ~ "," ~
+      posInt ~ "," ~ posInt ~ ")" ^^
+    {case quantile ~ lpar ~ id ~ c1 ~ q ~ c2 ~ n ~ c3 ~ b ~ rpar =>
+      QuantileExp(id, q, n, b, memory)}
+
+  // A number in [0, 1], e.g. 0.9
+  def probability = """0?[.][0-9]+|1[.]0*|[01]""".r ^^ {_.toDouble}
+
+  private def windowSize = memory.getOrElse(Constants.WindowSize,
+    Constants.DefaultWindowSize).toInt
+
+  private def basicWindowSize = memory.getOrElse(Constants.BasicWindowSize,
+    Constants.DefaultBasicWindowSize).toInt
+}
+
+/**
+ * An expression of the form median(field, N, b) or
+ * quantile(field, q, N, b).
+ * @param field This is a keyword of the high-level language
+ *   indicating what field the quantile is of.
+ * @param q The quantile, e.g. 0.5 for the median.
+ * @param N The number of items in the window.
+ * @param b The number of items in a basic window.  The feature is updated
+ *   each time a basic window fills up.
+ */
+case class QuantileExp(field: String, q: Double, N: Int, b: Int,
+                       memory: HashMap[String, String])
+  extends OperatorExp(field, memory) with Util
+{
+
+  override def createOpString() =
+  {
+    val lstream = memory.get(Constants.CurrentLStream).get
+    val rstream = memory.get(Constants.CurrentRStream).get
+
+    // Creating an entry for the operator type of lstream so we can
+    // look it up later.
+    memory += lstream + Constants.OperatorType -> Constants.QuantileKey
+
+    // Getting fields that are arguments of the template
+    val k = memory.getOrElse(Constants.QuantileK, Constants.DefaultQuantileK)
+    val numKeys = memory.get(lstream + Constants.NumKeys).get
+    var keysString = ""
+    for (i <- 0 until numKeys.toInt ) {
+      keysString = keysString +
+        memory.get(lstream + Constants.KeyStr + i).get + ", "
+    }
+    keysString = keysString.dropRight(2)
+
+    var rString = "  identifier = \"" + lstream + "\";\n"
+    rString += "  auto " + lstream + " = std::make_shared<Quantile<\n" +
+      "    double, EdgeType, " + field + ", " + keysString + ">>(" +
+      N.toString + ", " + b.toString + ", " + k + ", " + q.toString +
+      ", nodeId, featureMap, identifier);\n"
+    rString += addRegisterStatements(lstream, rstream, memory)
+    rString
+  }
+
+}
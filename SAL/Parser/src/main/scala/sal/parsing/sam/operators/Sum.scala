@@ -36,6 +36,20 @@ trait Sum extends BaseParsing
     {case ehsum ~ lpar ~ id ~ c1 ~ n ~ c2 ~ k ~ rpar =>
       EHSumExp(id, n, k, memory)}
 
+  // Time based windows, e.g. ehsum(SrcTotalBytes, 60s, 2), where the
+  // window holds the items of the last 60 seconds instead of the last N.
+  def timeSumOperator : Parser[TimeEHSumExp] =
+    // When k is not specified
+    (ehSumKeyWord | sumKeyWord) ~ "(" ~ identifier ~ "," ~ duration ~ ")" ^^
+    {case kw ~ lpar ~ id ~ c1 ~ d ~ rpar =>
+      val ehk = memory.getOrElse(Constants.EHK,
+        Constants.DefaultEHK).toInt;
+      TimeEHSumExp(id, d, ehk, memory)} |
+    // When k is specified
+    (ehSumKeyWord | sumKeyWord) ~ "(" ~ identifier ~ "," ~ duration ~ "," ~
+      posInt ~ ")" ^^
+    {case kw ~ lpar ~ id ~ c1 ~ d ~ c2 ~ k ~ rpar =>
+      TimeEHSumExp(id, d, k, memory)}
 
   def simpleSumOperator : Parser[SimpleSumExp] =
     simpleSumKeyWord ~ "(" ~ identifier ~ ","  ~ posInt ~ ")" ^^
@@ -130,4 +144,47 @@ case class SimpleSumExp(field: String, N: Int,
   
 }
 
+/**
+ * An expression of the form EHSum(field, duration, k) with a time based
+ * window.
+ * @param field This is a keyword of the high-level language
+ *   indicating what field is being summed.
+ * @param duration The length of the window in seconds.
+ * @param k Determines the size of the bins in the exponential histogram.
+ */
+case class TimeEHSumExp(field: String, duration: Double, k: Int,
+                       memory: HashMap[String, String])
+  extends OperatorExp(field, memory) with Util
+{
 
+  override def createOpString() =
+  {
+    val lstream = memory.get(Constants.CurrentLStream).get
+    val rstream = memory.get(Constants.CurrentRStream).get
+
+    // Creating an entry for the operator type of lstream so we can
+    // look it up later.
+    memory += lstream + Constants.OperatorType -> Constants.EHSumKey
+
+    // Getting fields that are arguments of the template
+    val timeField = memory.getOrElse(lstream + Constants.TimeField,
+      Constants.DefaultTimeField)
+    val numKeys = memory.get(lstream + Constants.NumKeys).get
+    var keysString = ""
+    for (i <- 0 until numKeys.toInt ) {
+      keysString = keysString +
+        memory.get(lstream + Constants.KeyStr + i).get + ", "
+    }
+    keysString = keysString.dropRight(2)
+
+    var rString = "  identifier = \"" + lstream + "\";\n"
+    rString += "  auto " + lstream +
+      " = std::make_shared<TimeExponentialHistogramSum<\n" +
+      "    double, EdgeType, " + field + ", " + timeField + ", " +
+      keysString + ">>(" + duration.toString + ", " + k.toString +
+      ", nodeId, featureMap, identifier);\n"
+    rString += addRegisterStatements(lstream, rstream, memory)
+    rString
+  }
+
+}
@@ -37,6 +37,20 @@ trait Variance extends BaseParsing
     {case ehave ~ lpar ~ id ~ c1 ~ n ~ c2 ~ k ~ rpar =>
       EHVarExp(id, n, k, memory)}
 
+  // Time based windows, e.g. ehvar(SrcTotalBytes, 60s, 2), where the
+  // window holds the items of the last 60 seconds instead of the last N.
+  def timeVarOperator : Parser[TimeEHVarExp] =
+    // When k is not specified
+    (ehVarKeyWord | varKeyWord) ~ "(" ~ identifier ~ "," ~ duration ~ ")" ^^
+    {case kw ~ lpar ~ id ~ c1 ~ d ~ rpar =>
+      val ehk = memory.getOrElse(Constants.EHK,
+        Constants.DefaultEHK).toInt;
+      TimeEHVarExp(id, d, ehk, memory)} |
+    // When k is specified
+    (ehVarKeyWord | varKeyWord) ~ "(" ~ identifier ~ "," ~ duration ~ "," ~
+      posInt ~ ")" ^^
+    {case kw ~ lpar ~ id ~ c1 ~ d ~ c2 ~ k ~ rpar =>
+      TimeEHVarExp(id, d, k, memory)}
 }
 
 /**
@@ -85,4 +99,47 @@ case class EHVarExp(field: String, N: Int, k: Int,
   
 }
 
+/**
+ * An expression of the form EHVar(field, duration, k) with a time based
+ * window.
+ * @param field This is a keyword of the high-level language
+ *   indicating what field is being used.
+ * @param duration The length of the window in seconds.
+ * @param k Determines the size of the bins in the exponential histogram.
+ */
+case class TimeEHVarExp(field: String, duration: Double, k: Int,
+                       memory: HashMap[String, String])
+  extends OperatorExp(field, memory) with Util
+{
+
+  override def createOpString() =
+  {
+    val lstream = memory.get(Constants.CurrentLStream).get
+    val rstream = memory.get(Constants.CurrentRStream).get
+
+    // Creating an entry for the operator type of lstream so we can
+    // look it up later.
+    memory += lstream + Constants.OperatorType -> Constants.EHVarKey
+
+    // Getting fields that are arguments of the template
+    val timeField = memory.getOrElse(lstream + Constants.TimeField,
+      Constants.DefaultTimeField)
+    val numKeys = memory.get(lstream + Constants.NumKeys).get
+    var keysString = ""
+    for (i <- 0 until numKeys.toInt ) {
+      keysString = keysString +
+        memory.get(lstream + Constants.KeyStr + i).get + ", "
+    }
+    keysString = keysString.dropRight(2)
+
+    var rString = "  identifier = \"" + lstream + "\";\n"
+    rString += "  auto " + lstream +
+      " = std::make_shared<TimeExponentialHistogramVariance<\n" +
+      "    double, EdgeType, " + field + ", " + timeField + ", " +
+      keysString + ">>(" + duration.toString + ", " + k.toString +
+      ", nodeId, featureMap, identifier);\n"
+    rString += addRegisterStatements(lstream, rstream, memory)
+    rString
+  }
 
+}
@@ -30,6 +30,11 @@ abstract class Statement {
     // This grabs the tuple type from the rstream and assigns it to the lstream.
     val tupleType = memory.get(rstream + Constants.TupleType).get
     memory += lstream + Constants.TupleType -> tupleType
+
+    // The time field, used by time based windows.
+    memory.get(rstream + Constants.TimeField).foreach { timeField =>
+      memory += lstream + Constants.TimeField -> timeField
+    }
   }
 
 }
@@ -51,6 +51,11 @@ case class StreamByStatement(lstream: String,
                                      
     // Adding the tuple type for lstream to memory
     memory += lstream + Constants.TupleType -> tupleType
+
+    // Adding the time field of rstream, used by time based windows
+    memory.get(rstream + Constants.TimeField).foreach { timeField =>
+      memory += lstream + Constants.TimeField -> timeField
+    }
     
     // Adding the number of keys for lstream to memory
     memory += lstream + Constants.NumKeys -> features.length.toString()
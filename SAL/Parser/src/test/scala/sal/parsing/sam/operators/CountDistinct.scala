@@ -0,0 +1,48 @@
+import org.scalatest.FlatSpec
+import sal.parsing.sam.operators.CountDistinct
+import sal.parsing.sam.Constants
+import sal.parsing.sam.TupleTypes
+
+class CountDistinctSpec extends FlatSpec with CountDistinct {
+
+  "A countdistinct operator" must "use default values in Constants when no" +
+  " global defaults have been specified" in {
+    memory.clear
+    memory += Constants.CurrentLStream -> "features1"
+    memory += Constants.CurrentRStream -> "VerticesBySource"
+    memory += "features1" + Constants.TupleType -> "VastNetflow"
+    memory += "features1" + Constants.NumKeys -> 1.toString
+    memory += "features1" + Constants.KeyStr + 0 -> "SourceIp"
+    parseAll(countDistinctOperator, "countdistinct(DestPort)")
+      match
+    {
+      case Success(matched,_) =>
+         assert(matched.toString.contains("std::make_shared<CountDistinct<"))
+         assert(matched.toString.contains("EdgeType, DestPort, SourceIp>"))
+         assert(matched.toString.contains(Constants.DefaultWindowSize +
+           ", " + Constants.DefaultBasicWindowSize + ", " +
+           Constants.DefaultHllPrecision))
+      case Failure(msg,_) => assert(false)
+      case Error(msg,_) => assert(false)
+    }
+  }
+
+  "A countdistinct operator" must "use the specified window" in {
+    memory.clear
+    memory += Constants.CurrentLStream -> "features1"
+    memory += Constants.CurrentRStream -> "VerticesBySource"
+    memory += "features1" + Constants.TupleType -> "VastNetflow"
+    memory += "features1" + Constants.NumKeys -> 1.toString
+    memory += "features1" + Constants.KeyStr + 0 -> "SourceIp"
+    memory += Constants.HllPrecision -> "12"
+    parseAll(countDistinctOperator, "countdistinct(DestIp, 5000, 500)")
+      match
+    {
+      case Success(matched,_) =>
+         assert(matched.toString.contains("EdgeType, DestIp, SourceIp>"))
+         assert(matched.toString.contains("5000, 500, 12"))
+      case Failure(msg,_) => assert(false)
+      case Error(msg,_) => assert(false)
+    }
+  }
+}
@@ -0,0 +1,51 @@
+import org.scalatest.FlatSpec
+import sal.parsing.sam.operators.Quantile
+import sal.parsing.sam.Constants
+import sal.parsing.sam.TupleTypes
+
+class QuantileSpec extends FlatSpec with Quantile {
+
+  "A median operator" must "use default values in Constants when no" +
+  " global defaults have been specified" in {
+    memory.clear
+    memory += Constants.CurrentLStream -> "features1"
+    memory += Constants.CurrentRStream -> "VerticesBySource"
+    memory += "features1" + Constants.TupleType -> "VastNetflow"
+    memory += "features1" + Constants.NumKeys -> 1.toString
+    memory += "features1" + Constants.KeyStr + 0 -> "SourceIp"
+    parseAll(medianOperator, "median(TimeDiff)")
+      match
+    {
+      case Success(matched,_) =>
+         assert(matched.toString.contains("std::make_shared<Quantile<"))
+         assert(matched.toString.contains(
+           "double, EdgeType, TimeDiff, SourceIp>"))
+         assert(matched.toString.contains(Constants.DefaultWindowSize +
+           ", " + Constants.DefaultBasicWindowSize + ", " +
+           Constants.DefaultQuantileK + ", 0.5"))
+      case Failure(msg,_) => assert(false)
+      case Error(msg,_) => assert(false)
+    }
+  }
+
+  "A quantile operator" must "use the specified quantile and window" in {
+    memory.clear
+    memory += Constants.CurrentLStream -> "features1"
+    memory += Constants.CurrentRStream -> "VerticesBySource"
+    memory += "features1" + Constants.TupleType -> "VastNetflow"
+    memory += "features1" + Constants.NumKeys -> 1.toString
+    memory += "features1" + Constants.KeyStr + 0 -> "SourceIp"
+    parseAll(quantileOperator, "quantile(SrcTotalBytes, 0.9, 1000, 100)")
+      match
+    {
+      case Success(matched,_) =>
+         assert(matched.toString.contains("std::make_shared<Quantile<"))
+         assert(matched.toString.contains(
+           "double, EdgeType, SrcTotalBytes, SourceIp>"))
+         assert(matched.toString.contains("1000, 100, " +
+           Constants.DefaultQuantileK + ", 0.9"))
+      case Failure(msg,_) => assert(false)
+      case Error(msg,_) => assert(false)
+    }
+  }
+}
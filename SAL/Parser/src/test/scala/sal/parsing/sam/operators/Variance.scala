@@ -102,4 +102,50 @@ class VarianceSpec extends FlatSpec with Variance {
       case Error(msg,_) => assert(false)
     }
   }
+
+  "A time based ehvar operator" must "use the duration instead of N and " +
+    "the time field of the stream" in
+  {
+    memory.clear
+    memory += Constants.CurrentLStream -> "features1"
+    memory += Constants.CurrentRStream -> "VerticesBySource"
+    memory += "features1" + Constants.TupleType -> "VastNetflow"
+    memory += "features1" + Constants.TimeField -> "TimeSeconds"
+    memory += "features1" + Constants.NumKeys -> 1.toString
+    memory += "features1" + Constants.KeyStr + 0 -> "SourceIp"
+    parseAll(timeVarOperator, "ehvar(SrcTotalBytes, 1m, 2)")
+      match
+    {
+      case Success(matched,_) =>
+         assert(matched.toString.contains(
+           "std::make_shared<TimeExponentialHistogramVariance<"))
+         assert(matched.toString.contains(
+           "double, EdgeType, SrcTotalBytes, TimeSeconds, SourceIp>"))
+         assert(matched.toString.contains("60.0, 2"))
+      case Failure(msg,_) => assert(false)
+      case Error(msg,_) => assert(false)
+    }
+  }
+
+  "A time based var operator" must "use the global k when it isn't " +
+    "specified" in
+  {
+    memory.clear
+    memory += Constants.CurrentLStream -> "features1"
+    memory += Constants.CurrentRStream -> "VerticesBySource"
+    memory += "features1" + Constants.TupleType -> "VastNetflow"
+    memory += "features1" + Constants.NumKeys -> 1.toString
+    memory += "features1" + Constants.KeyStr + 0 -> "SourceIp"
+    memory += Constants.EHK -> "5"
+    parseAll(timeVarOperator, "var(SrcTotalBytes, 500ms)")
+      match
+    {
+      case Success(matched,_) =>
+         assert(matched.toString.contains(
+           "std::make_shared<TimeExponentialHistogramVariance<"))
+         assert(matched.toString.contains("0.5, 5"))
+      case Failure(msg,_) => assert(false)
+      case Error(msg,_) => assert(false)
+    }
+  }
 }
@@ -24,6 +24,20 @@ public:
 
 	virtual bool consume(EdgeType const& edge) = 0;
 
+  /**
+   * Consumes count edges, in order.  The default calls consume() on each;
+   * operators override it to share work (locks, lookups, feature map
+   * writes) across the batch.
+   * \return Returns false if consuming any of the edges returned false.
+   */
+  virtual bool consumeBatch(EdgeType const* edges, size_t count) {
+    bool consumed = true;
+    for (size_t i = 0; i < count; i++) {
+      consumed = consume(edges[i]) && consumed;
+    }
+    return consumed;
+  }
+
   virtual void terminate() = 0;
 
 };
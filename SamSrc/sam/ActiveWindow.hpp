@@ -4,7 +4,8 @@
 #include <map>
 #include <algorithm>
 #include <iostream>
-#include <numeric>
+#include <unordered_map>
+#include <vector>
 
 using std::map;
 
@@ -14,7 +15,7 @@ template <typename K>
 class ActiveWindow
 {
 private:
-  map<K, size_t> keyCounter; ///> Keeps track of counts for each key.
+  std::unordered_map<K, size_t> keyCounter; ///> Counts for each key.
   size_t count = 0; ///> Total number of elements in this window.
   size_t limit; ///> Max number of elements in the window.
 
@@ -31,12 +32,7 @@ public:
    */
   inline bool update(K key) {
     if (count < limit) {
-      if (keyCounter.count(key) > 0) {
-        size_t value = keyCounter.at(key);
-        keyCounter[key] = value + 1;
-      } else {
-        keyCounter[key] = 1;
-      }
+      keyCounter[key]++;
       count++;
       return true;
     }
@@ -44,43 +40,28 @@ public:
   }
 
   /**
-   * Returns the topk elements
+   * Returns the topk elements in descending order of count.  Ties are
+   * broken by key.  Only the top n are sorted.
    */
   inline std::vector<std::pair<K, size_t>> topk(size_t n) const
-  
   {
-
-    // Make a vector of pairs and put all the key-value pairs into it.
-    std::vector<std::pair<K, size_t>> pairs;
-    for (auto itr = keyCounter.begin(); itr != keyCounter.end(); ++itr)
-    pairs.push_back(*itr);
-        
-    // Sort the vector of pairs 
-    std::sort(pairs.begin(), pairs.end(), 
-          [=](std::pair<K, size_t> const & a, std::pair<K, size_t> const & b)
-         {
-               return a.second > b.second;
-         }
+    std::vector<std::pair<K, size_t>> pairs(keyCounter.begin(),
+                                            keyCounter.end());
+    size_t actualN = std::min(n, pairs.size());
+    std::partial_sort(pairs.begin(), pairs.begin() + actualN, pairs.end(),
+      [](std::pair<K, size_t> const & a, std::pair<K, size_t> const & b)
+      {
+        return a.second > b.second ||
+               (a.second == b.second && a.first < b.first);
+      }
     );
-
-    std::vector<std::pair<K, size_t>> rVector;
-    for (int i = 0; (i < n) && (i < pairs.size()); i++) {
-      rVector.push_back(pairs[i]);
-    }
-
-    return rVector;
+    pairs.resize(actualN);
+    return pairs;
   }
 
 
   inline size_t getNumElements() {
-    return std::accumulate(std::begin(keyCounter),
-              std::end(keyCounter),
-              0,
-              [](const size_t previous, const std::pair<K, size_t>& p)
-              {
-                return previous + p.second; 
-              }
-           );
+    return count;
   }
 
 
@@ -0,0 +1,54 @@
+#ifndef SAM_BACKOFF_HPP
+#define SAM_BACKOFF_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+namespace sam {
+
+/**
+ * How a thread polling a queue waits while the queue is empty.  The first
+ * spins waits only yield, so a busy queue is picked up right away.  After
+ * that each wait sleeps, starting at a microsecond and doubling up to 
+ * maxSleepMicros, so an idle poller doesn't use a whole core.  Call 
+ * reset() whenever the queue had something.
+ */
+class Backoff
+{
+private:
+  size_t spins;
+  std::chrono::microseconds maxSleep;
+
+  size_t numWaits = 0; ///> Waits since the last reset
+  std::chrono::microseconds sleep{1}; ///> How long the next sleep is
+
+public:
+  /**
+   * \param spins How many waits only yield.
+   * \param maxSleepMicros The longest sleep.  Bounds how late an idle 
+   *   poller notices new items.
+   */
+  Backoff(size_t spins = 64, size_t maxSleepMicros = 500) :
+    spins(spins), maxSleep(maxSleepMicros) {}
+
+  void wait() {
+    if (numWaits < spins) {
+      numWaits++;
+      std::this_thread::yield();
+      return;
+    }
+    std::this_thread::sleep_for(sleep);
+    sleep = std::min(sleep * 2, maxSleep);
+  }
+
+  void reset() {
+    numWaits = 0;
+    sleep = std::chrono::microseconds(1);
+  }
+};
+
+} // end namespace sam
+
+#endif
@@ -13,6 +13,10 @@
 #include <thread>
 #include <functional>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <exception>
 
 #include <sam/IdGenerator.hpp>
 #include <sam/AbstractConsumer.hpp>
@@ -28,13 +32,15 @@ public:
   typedef typename EdgeType::LocalTupleType TupleType;
 
 private:
-  // These are the threads we use for parallelizing the parallelFeed
-  // function.  
-  std::vector<std::thread> threads;
+  // One worker per consumer.  Each runs workerLoop for as long as the 
+  // producer lives.
+  std::vector<std::thread> workers;
 
-
-  // The function that each of the threads run in the parallelFeed function.
-  std::function<void(size_t)> parallelFeedFunction;
+  /// The consumers are run in stages, one stage after the other.  The 
+  /// consumers of a stage work on a batch at the same time.  Each entry is
+  /// the stage of the consumer with the same index.
+  std::vector<size_t> consumerStages;
+  std::vector<size_t> stageSizes; ///> How many consumers are in each stage
 
   // Multiple threads access the parallelFeed method.  This mutex prevents
   // problems
@@ -42,6 +48,57 @@ private:
 
   size_t nodeId; ///> Used for debugging purposes
 
+  /// The full buffer the workers are working through.  The producer fills
+  /// inputQueue in the meantime.
+  EdgeType* drainQueue;
+
+  // Guards the hand off between the producer and the workers (drainQueue,
+  // batchNumber, the stages, busy, failure, stopWorkers and the 
+  // backpressure counts).
+  mutable std::mutex poolLock;
+  std::condition_variable batchReady; ///> Signals workers that a stage began
+  std::condition_variable batchDone; ///> Signals that busy became false
+
+  size_t batchNumber = 0; ///> How many batches have been handed off
+  std::vector<size_t> batchStageSizes; ///> stageSizes for the current batch
+  size_t stage = 0; ///> The stage working on the current batch
+  size_t pending = 0; ///> Workers of the stage still on the current batch
+  bool busy = false; ///> True until every stage is done with the batch
+  bool stopWorkers = false;
+
+  /// The first exception thrown by a consumer since it was last rethrown
+  /// (see waitForConsumers()).
+  std::exception_ptr failure;
+
+  /// How many times a full buffer had to wait on the workers to finish the
+  /// previous one, and the total time spent waiting.
+  size_t numBackpressureWaits = 0;
+  double backpressureSeconds = 0;
+
+  /**
+   * Run by the worker of one consumer.  Waits for its stage of each batch
+   * and gives the batch to the consumer until the producer is destroyed.
+   * \param consumer The consumer of this worker.
+   * \param myStage The stage of the consumer.
+   * \param seen The number of batches handed off before the worker started.
+   */
+  void workerLoop(std::shared_ptr<AbstractConsumer<EdgeType>> consumer,
+                  size_t myStage, size_t seen);
+
+  /**
+   * Swaps the full inputQueue with the drain buffer and wakes the workers
+   * of the first stage.  Waits first if the workers are still on the
+   * previous batch.  Rethrows an exception a consumer threw on an earlier
+   * batch.
+   */
+  void handOff();
+
+  /**
+   * If a consumer has thrown, clears and rethrows the exception.  Called
+   * with poolLock held.
+   */
+  void rethrowFailure();
+
 protected:
   /// The list of consumers that consume from output from this producer
   std::vector<std::shared_ptr<AbstractConsumer<EdgeType>>> consumers;
@@ -58,16 +115,53 @@ protected:
   /// The number of items passed to parallelFeed
   size_t numReadItems = 0;
 
+  /**
+   * Waits until the workers are done with the batch that was last handed
+   * off.  Subclasses call this before terminating their consumers and at
+   * the end of the input, so that the consumers have seen everything that
+   * was handed off.  Items in a buffer that isn't full yet are not handed
+   * off.  If a consumer threw while working on a batch, the exception is 
+   * rethrown here (or by the next parallelFeed that hands off a batch).
+   */
+  void waitForConsumers();
+
+  /**
+   * Waits for the consumers and then terminates them.  If a consumer threw,
+   * the exception is rethrown after all of them are terminated.
+   */
+  void terminateConsumers();
+
+  /**
+   * Adds the item to the queue and hands the queue to the consumers when it
+   * is full.  The caller holds feedLock.
+   */
+  void feedLocked(EdgeType const& item);
+
+  /**
+   * Locks out other threads calling parallelFeed, so that a subclass can
+   * feed several items with feedLocked under one lock.
+   */
+  std::unique_lock<std::mutex> feedLock() {
+    return std::unique_lock<std::mutex>(lock);
+  }
+
 public:
   BaseProducer(size_t nodeId, size_t queueLength);
   virtual ~BaseProducer();
 
   /**
    * Registers a consumer that will consume the output of this producer.
+   * Consumers get each batch in the order they were registered, so a
+   * consumer can read the features written by the ones before it (e.g. a
+   * Filter on a TopK's feature).
    * \param consumer The object that consumes the output of this producer.
+   * \param concurrent If true, the consumer doesn't read anything written
+   *   by the consumers registered before it, and works on a batch at the 
+   *   same time as the previous consumer.
    */
   void registerConsumer(
-    std::shared_ptr<AbstractConsumer<EdgeType>> consumer);
+    std::shared_ptr<AbstractConsumer<EdgeType>> consumer,
+    bool concurrent = false);
 
   /**
    * Removes the consumer from list of consumers. (Note: not implemented)
@@ -87,12 +181,41 @@ public:
     getConsumer(size_t i);
 
   /**
-   * Feeds the provided item to each of the consumers in parallel.
+   * Feeds the provided item to each of the consumers in parallel.  Items
+   * are queued and each full queue is handed to the consumers as one batch 
+   * (AbstractConsumer::consumeBatch).  Each consumer has its own worker 
+   * thread, so the consumers work on a batch while the caller fills the
+   * other buffer.  Consumers registered as concurrent work on the batch at
+   * the same time as the one before them; the others wait for it (see
+   * registerConsumer()).  If the workers haven't finished the previous
+   * batch when the next one is full, the caller waits (see
+   * getNumBackpressureWaits()).
    */
   void parallelFeed(EdgeType const& s);
 
+  /**
+   * Feeds count items, taking the lock once.
+   */
+  void parallelFeed(EdgeType const* items, size_t count);
+
   size_t getNumReadItems() const { return numReadItems; }
 
+  /**
+   * How many times a full buffer had to wait for the consumers.
+   */
+  size_t getNumBackpressureWaits() const {
+    std::lock_guard<std::mutex> guard(poolLock);
+    return numBackpressureWaits;
+  }
+
+  /**
+   * Total seconds spent waiting for the consumers.
+   */
+  double getBackpressureSeconds() const {
+    std::lock_guard<std::mutex> guard(poolLock);
+    return backpressureSeconds;
+  }
+
 };
 
 template <typename EdgeType>
@@ -101,26 +224,46 @@ BaseProducer<EdgeType>::BaseProducer(size_t nodeId, size_t queueLength)
   this->nodeId = nodeId;
   this->queueLength = queueLength;
   inputQueue = new EdgeType[queueLength];
+  drainQueue = new EdgeType[queueLength];
   numItems = 0;
-
-  parallelFeedFunction = [this](size_t threadId) {
-    for (size_t i = 0; i < this->queueLength; i++) {
-      this->consumers[threadId]->consume(this->inputQueue[i]);
-    }
-  };
 }
 
 template <typename EdgeType>
 BaseProducer<EdgeType>::~BaseProducer() {
+  {
+    std::unique_lock<std::mutex> guard(poolLock);
+    batchDone.wait(guard, [this]() { return !busy; });
+    if (failure) {
+      printf("Node %lu BaseProducer destroyed with an unreported consumer "
+        "exception\n", nodeId);
+    }
+    stopWorkers = true;
+  }
+  batchReady.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  if (numBackpressureWaits > 0) {
+    printf("Node %lu BaseProducer waited on consumers %lu times for %f "
+      "seconds\n", nodeId, numBackpressureWaits, backpressureSeconds);
+  }
+
   delete[] inputQueue;
+  delete[] drainQueue;
 }
 
 template <typename EdgeType>
 void BaseProducer<EdgeType>::registerConsumer(
-  std::shared_ptr<AbstractConsumer<EdgeType>> consumer)
+  std::shared_ptr<AbstractConsumer<EdgeType>> consumer, bool concurrent)
 {
+  std::lock_guard<std::mutex> guard(poolLock);
+  if (!concurrent || stageSizes.empty()) {
+    stageSizes.push_back(0);
+  }
+  stageSizes.back()++;
+  consumerStages.push_back(stageSizes.size() - 1);
   consumers.push_back(consumer);
-  threads.resize(consumers.size());
 }
 
 template <typename EdgeType>
@@ -136,47 +279,150 @@ size_t BaseProducer<EdgeType>::getNumConsumers() const { return consumers.size()
 
 template <typename EdgeType>
 void BaseProducer<EdgeType>::parallelFeed(EdgeType const& item) {
-  lock.lock();
+  std::lock_guard<std::mutex> guard(lock);
+  feedLocked(item);
+}
+
+template <typename EdgeType>
+void BaseProducer<EdgeType>::parallelFeed(EdgeType const* items, 
+                                          size_t count) 
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (size_t i = 0; i < count; i++) {
+    feedLocked(items[i]);
+  }
+}
+
+template <typename EdgeType>
+void BaseProducer<EdgeType>::feedLocked(EdgeType const& item) {
   DEBUG_PRINT("Node %lu BaseProducer::parallelFeed %s numItems %lu"
     " queueLength %lu \n", 
     nodeId, item.toString().c_str(), numItems, queueLength); 
   
-  // Generate an unique id for this item
-
   numReadItems++;
   inputQueue[numItems] = item; // T(item);
   numItems++;
 
-  //  this->queueLength));
   if (numItems >= queueLength) {
     DEBUG_PRINT("Node %lu BaseProducer::parallelFeed %s numItems %lu >= "
       "queueLength %lu consumes.size() %lu \n", nodeId, 
       item.toString().c_str(), numItems, queueLength, consumers.size()); 
-    //for(size_t i = 0; i < consumers.size(); i++) {
-    //  threads[i] = std::thread(parallelFeedFunction, i);
-    //}
-
-    //for(size_t i = 0; i < consumers.size(); i++) {
-    //  threads[i].join();
-    //}
-    // Serial for debugging
     
-    for(size_t j = 0; j < this->queueLength; j++) {
-      
-      DEBUG_PRINT("Node %lu BaseProducer::parallelFeed j %lu queueLength "
-        "%lu tuple %s\n", nodeId, j, this->queueLength, 
-        inputQueue[j].toString().c_str());
-      
-      for(size_t i = 0; i < consumers.size(); i++) {
-        consumers[i]->consume(inputQueue[j]);
-      }
-    }
+    // Reset first; handOff can rethrow a consumer's exception.
     numItems = 0;
+    handOff();
   } 
+}
+
+template <typename EdgeType>
+void BaseProducer<EdgeType>::handOff() {
+  std::unique_lock<std::mutex> guard(poolLock);
+  if (busy) {
+    numBackpressureWaits++;
+    auto begin = std::chrono::high_resolution_clock::now();
+    batchDone.wait(guard, [this]() { return !busy; });
+    std::chrono::duration<double> waited = 
+      std::chrono::high_resolution_clock::now() - begin;
+    backpressureSeconds += waited.count();
+  }
+
+  // Consumers registered since the last batch get a worker.
+  while (workers.size() < consumers.size()) {
+    size_t i = workers.size();
+    workers.push_back(std::thread(&BaseProducer<EdgeType>::workerLoop, this,
+                                  consumers[i], consumerStages[i], 
+                                  batchNumber));
+  }
+
+  std::swap(inputQueue, drainQueue);
+  batchStageSizes = stageSizes;
+  stage = 0;
+  pending = batchStageSizes.empty() ? 0 : batchStageSizes[0];
+  busy = pending > 0;
+  batchNumber++;
+  batchReady.notify_all();
+
+  rethrowFailure();
+}
 
-  lock.unlock();
+template <typename EdgeType>
+void BaseProducer<EdgeType>::rethrowFailure() {
+  if (failure) {
+    std::exception_ptr e = failure;
+    failure = nullptr;
+    std::rethrow_exception(e);
+  }
+}
 
+template <typename EdgeType>
+void BaseProducer<EdgeType>::workerLoop(
+  std::shared_ptr<AbstractConsumer<EdgeType>> consumer, size_t myStage,
+  size_t seen)
+{
+  while (true) {
+    EdgeType const* batch;
+    {
+      std::unique_lock<std::mutex> guard(poolLock);
+      auto myTurn = [this, myStage, &seen]() {
+        return busy && batchNumber > seen && stage == myStage;
+      };
+      batchReady.wait(guard, [this, &myTurn]() { 
+        return stopWorkers || myTurn();
+      });
+      if (!myTurn()) {
+        return; // Stopped with nothing left to do
+      }
+      seen = batchNumber;
+      batch = drainQueue;
+    }
+
+    std::exception_ptr thrown;
+    try {
+      consumer->consumeBatch(batch, queueLength);
+    } catch (...) {
+      thrown = std::current_exception();
+    }
 
+    std::lock_guard<std::mutex> guard(poolLock);
+    if (thrown && !failure) {
+      failure = thrown;
+    }
+    pending--;
+    if (pending == 0) {
+      // The stage is done; start the next one or finish the batch.
+      stage++;
+      if (stage < batchStageSizes.size()) {
+        pending = batchStageSizes[stage];
+        batchReady.notify_all();
+      } else {
+        busy = false;
+        batchDone.notify_all();
+      }
+    }
+  }
+}
+
+template <typename EdgeType>
+void BaseProducer<EdgeType>::waitForConsumers() {
+  std::unique_lock<std::mutex> guard(poolLock);
+  batchDone.wait(guard, [this]() { return !busy; });
+  rethrowFailure();
+}
+
+template <typename EdgeType>
+void BaseProducer<EdgeType>::terminateConsumers() {
+  std::exception_ptr thrown;
+  try {
+    waitForConsumers();
+  } catch (...) {
+    thrown = std::current_exception();
+  }
+  for (auto consumer : consumers) {
+    consumer->terminate();
+  }
+  if (thrown) {
+    std::rethrow_exception(thrown);
+  }
 }
 
 
@@ -50,10 +50,11 @@ public:
   {
     std::string key = generateKey<keyFields...>(edge.tuple);
 
-    if (featureMap->exists(key, targetId))
+    auto targetFeature = featureMap->find(key, targetId);
+    if (targetFeature)
     {
       auto mapFeature = std::static_pointer_cast<const MapFeature>(
-                          this->featureMap->at(key, targetId));
+                          targetFeature);
       double result = mapFeature->evaluate(func);
        
       SingleFeature feature(result);
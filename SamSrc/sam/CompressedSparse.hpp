@@ -1,10 +1,13 @@
 #ifndef COMPRESSED_SPARSE_HPP
 #define COMPRESSED_SPARSE_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <mutex>
 #include <sam/Util.hpp>
 #include <sam/EdgeRequest.hpp>
+#include <sam/EdgeRing.hpp>
 #include <thread>
 
 namespace sam {
@@ -33,17 +36,36 @@ public:
   typedef SourceType NodeType; // SourceType and TargetType should be the same.
   typedef EdgeRequest<TupleType, source, target> EdgeRequestType;
   typedef EdgeRequest<TupleType, target, source> ReversedEdgeRequestType;
+  typedef EdgeRing<EdgeType, time, duration> RingType;
 
 private:
 
+  /**
+   * An entry in the open-addressed vertex index of a bin.  An entry is 
+   * empty when ring is null.
+   */
+  struct VertexSlot {
+    uint64_t hash = 0; ///> The hash of the vertex
+    NodeType vertex; ///> The vertex (source for csr, target for csc)
+    RingType* ring = nullptr; ///> The time-ordered edges of the vertex
+  };
+
+  /**
+   * The vertex index of a bin.  Linear probing over a power-of-two
+   * array of slots that doubles when it is half full.
+   */
+  struct VertexTable {
+    VertexSlot* slots = nullptr;
+    size_t numSlots = 0;
+    size_t numVertices = 0;
+  };
+
   // Time window in seconds.  
   double window = 1;
 
   /**
-   * The current time.  We update current time in method addEdge in a
-   * non-perfect way.  Current time should generally increase, but because
-   * of threading issues it might jump around a bit.  This should be good
-   * enough.
+   * The current time: the largest tuple time seen by addEdge.  Edges that
+   * started before currentTime - window (the low-water mark) have expired.
    */
   std::atomic<double> currentTime;
 
@@ -51,9 +73,9 @@ private:
   EF equal;
 
   /**
-   * How many slots there are in alle (the array of lists of lists of edges).
-   * Each slot has a mutex associated with it so that only one thread can
-   * access the slot at one time.
+   * How many bins there are in alle (the array of vertex tables).
+   * Each bin has a mutex associated with it so that only one thread can
+   * access the bin at one time.
    */
   size_t capacity; 
  
@@ -62,15 +84,62 @@ private:
    */ 
   std::mutex* mutexes;
 
-  // array of lists of lists of edges
-  std::list<std::list<EdgeType>>* alle;
+  // array of vertex tables 
+  VertexTable* alle;
+
+  /// How many edges are in the graph.  Kept up to date as edges are added
+  /// and expired, so it never takes a scan.
+  std::atomic<size_t> numLiveEdges;
+
+  /// How many vertices have edges (and so a ring).
+  std::atomic<size_t> numLiveVertices;
+
+  /// Bytes allocated for the bins, vertex tables and rings (see 
+  /// EdgeRing::bytes).  Kept up to date like numLiveEdges.
+  std::atomic<size_t> numBytes;
+
+  /// The next bin for expireSlice to sweep.
+  std::atomic<size_t> sweepCursor;
+
+  /**
+   * Moves currentTime up to tupleTime if it is larger.
+   */
+  void observeTime(double tupleTime);
+
+  /**
+   * Updates numBytes for an allocation that went from before bytes to 
+   * after bytes.
+   */
+  void adjustBytes(size_t before, size_t after);
+
+  /**
+   * Expires the edges of each vertex in the bin and removes the vertices
+   * left with none.
+   * \return Returns the number of edges removed.
+   */
+  size_t sweepBin(size_t index, double now);
 
   /**
-   * For the given slot in the hash table (alle), we clear out edges that 
-   * have expired (i.e. older than currentTime - window).
-   * \return Returns the number edges deleted.
+   * Finds the slot for the vertex in the table.  If the vertex isn't 
+   * present, returns the empty slot where it would be inserted, or null
+   * if the table has no slots.  Should be called with the bin locked.
+   * \param probes Incremented by the number of slots looked at.
    */
-  size_t cleanupEdges(size_t index);
+  VertexSlot* findSlot(VertexTable const& table, NodeType const& vertex,
+                       uint64_t vertexHash, size_t& probes) const;
+
+  /**
+   * Doubles the number of slots in the table (or creates the initial 
+   * slots).  Should be called with the bin locked.
+   */
+  void growTable(VertexTable& table);
+
+  /**
+   * Moves the vertices of the table into newNumSlots slots, which may be
+   * zero if the table has no vertices.  Should be called with the bin 
+   * locked.
+   */
+  void rehashTable(VertexTable& table, size_t newNumSlots);
 
   #ifdef METRICS
   mutable size_t totalEdgesAdded = 0;
@@ -135,9 +204,61 @@ public:
 
 
   /** 
-   * Counts the number of edges in the graph.  Linear operation.
+   * The number of edges in the graph.  Constant time; the count is kept
+   * up to date as edges are added and expired.
+   */
+  size_t countEdges() const { return numLiveEdges.load(); }
+
+  /**
+   * The number of vertices with edges (sources for a csr, targets for a
+   * csc).
+   */
+  size_t getNumVertices() const { return numLiveVertices.load(); }
+
+  /**
+   * The bytes allocated by the graph for its bins, vertex tables, and 
+   * rings.  Doesn't count memory owned by the tuples (e.g. strings).
+   */
+  size_t getNumBytes() const { return numBytes.load(); }
+
+  /// The largest tuple time seen.
+  double getCurrentTime() const { return currentTime.load(); }
+
+  /// Edges that started before the low-water mark have expired.
+  double getLowWaterMark() const { return currentTime.load() - window; }
+
+  /// The number of bins, i.e. how many expireSlice sweeps in all.
+  size_t getCapacity() const { return capacity; }
+
+  /**
+   * Sweeps the next maxBins bins (wrapping around), removing the edges 
+   * that started before the low-water mark and freeing the vertices left 
+   * with no edges.  addEdge only expires the edges of the vertex it adds
+   * to, so without sweeps a vertex that stops getting edges keeps its
+   * edges forever.  Only one bin is locked at a time, so this can run in
+   * the background (see ExpiryService) while edges are added and looked 
+   * up, and from several threads at once.
+   * \param maxBins How many bins to sweep.
+   * \return Returns the number of edges removed.
    */
-  size_t countEdges() const;
+  size_t expireSlice(size_t maxBins);
+
+  /**
+   * Summarizes the degrees of the vertices that have edges (out-degree for
+   * a csr, in-degree for a csc).  Linear operation.
+   * \param numVertices Set to the number of vertices with edges.
+   * \param meanDegree Set to the mean degree of those vertices.
+   * \param secondMoment Set to the mean of the squared degrees.
+   */
+  void degreeStatistics(size_t& numVertices, double& meanDegree,
+                        double& secondMoment) const;
+
+  /**
+   * Calls f on every edge in the graph, one bin at a time with the bin 
+   * locked, so f must not call back into this graph.
+   */
+  template <typename F>
+  void forEachEdge(F&& f) const;
 
   #ifdef METRICS
   size_t getTotalEdgesAdded() const { return totalEdgesAdded; }
@@ -151,14 +272,16 @@ template <typename EdgeType, size_t source, size_t target,
           typename HF, typename EF>
 CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
 CompressedSparse( size_t capacity, double window ) :
-  currentTime(0)
+  currentTime(0), numLiveEdges(0), numLiveVertices(0), numBytes(0),
+  sweepCursor(0)
 {
   this->capacity = capacity;
   this->window = window;
 
   mutexes = new std::mutex[capacity];
 
-  alle = new std::list<std::list<EdgeType>>[capacity];
+  alle = new VertexTable[capacity];
+  numBytes = capacity * (sizeof(std::mutex) + sizeof(VertexTable));
 }
 
 template <typename EdgeType, size_t source, size_t target, 
@@ -167,10 +290,109 @@ template <typename EdgeType, size_t source, size_t target,
 CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
 ~CompressedSparse()
 {
+  for (size_t i = 0; i < capacity; i++) {
+    for (size_t j = 0; j < alle[i].numSlots; j++) {
+      delete alle[i].slots[j].ring;
+    }
+    delete[] alle[i].slots;
+  }
   delete[] mutexes;
   delete[] alle;
 }
 
+template <typename EdgeType, size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename HF, typename EF>
+typename CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+  VertexSlot*
+CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+findSlot(VertexTable const& table, NodeType const& vertex, 
+         uint64_t vertexHash, size_t& probes) const
+{
+  if (table.numSlots == 0) {
+    return nullptr;
+  }
+
+  size_t mask = table.numSlots - 1;
+  // The low bits were used to pick the bin, so mix in the high bits.
+  size_t i = (vertexHash ^ (vertexHash >> 32)) & mask;
+  while (true) {
+    probes++;
+    VertexSlot* slot = &table.slots[i];
+    if (!slot->ring) {
+      return slot;
+    }
+    if (slot->hash == vertexHash && equal(vertex, slot->vertex)) {
+      return slot;
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+template <typename EdgeType, size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename HF, typename EF>
+void
+CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+growTable(VertexTable& table)
+{
+  rehashTable(table, table.numSlots == 0 ? 4 : table.numSlots * 2);
+}
+
+template <typename EdgeType, size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename HF, typename EF>
+void
+CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+rehashTable(VertexTable& table, size_t newNumSlots)
+{
+  VertexSlot* oldSlots = table.slots;
+  size_t oldNumSlots = table.numSlots;
+
+  table.slots = newNumSlots > 0 ? new VertexSlot[newNumSlots] : nullptr;
+  table.numSlots = newNumSlots;
+
+  size_t probes = 0;
+  for (size_t j = 0; j < oldNumSlots; j++) {
+    VertexSlot& old = oldSlots[j];
+    if (old.ring) {
+      VertexSlot* slot = findSlot(table, old.vertex, old.hash, probes);
+      slot->hash = old.hash;
+      slot->vertex = std::move(old.vertex);
+      slot->ring = old.ring;
+    }
+  }
+  delete[] oldSlots;
+  adjustBytes(oldNumSlots * sizeof(VertexSlot), 
+              newNumSlots * sizeof(VertexSlot));
+}
+
+template <typename EdgeType, size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename HF, typename EF>
+void
+CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+observeTime(double tupleTime)
+{
+  double current = currentTime.load();
+  while (tupleTime > current && 
+         !currentTime.compare_exchange_weak(current, tupleTime)) {}
+}
+
+template <typename EdgeType, size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename HF, typename EF>
+void
+CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+adjustBytes(size_t before, size_t after)
+{
+  if (after > before) {
+    numBytes.fetch_add(after - before);
+  } else if (before > after) {
+    numBytes.fetch_sub(before - after);
+  }
+}
+
 template <typename EdgeType, size_t source, size_t target,
           size_t time, size_t duration,
           typename HF, typename EF>
@@ -236,112 +458,50 @@ const
     src.c_str(), trg.c_str(),
     startTimeFirst, startTimeSecond, endTimeFirst, endTimeSecond);
   
-  size_t index = hash(src) % capacity;
+  uint64_t srcHash = hash(src);
+  size_t index = srcHash % capacity;
+
+  bool checkTarget = !isNull(trg);
+  uint64_t trgHash = checkTarget ? hash(trg) : 0;
 
   std::lock_guard<std::mutex> lock(mutexes[index]);
 
-  DEBUG_PRINT("CompressedSparse::findEdges src %s trg %s  number of lists"
-    " to consider: %lu\n", src.c_str(), trg.c_str(), alle[index].size());
-  for (auto & l : alle[index]) {
-    // l should be a list of lists
-
-    DEBUG_PRINT("CompressedSparse::findEdges number of edges to consider: "
-      "%lu\n", l.size());
-
-    if(l.size() > 0) {
-
-      try {
-        // All the tuples in each list should have the same source, so
-        // look at the first one and see if it matches what we are looking
-        // for.  
-        SourceType s0 = std::get<source>(l.front().tuple);  
-        if (equal(src, s0)) 
-        {
-          // If the first one matched on the source, look through
-          // all other tuples in the list.
-          for(auto it = l.begin(); it != l.end(); )
-          {
-            size_t id = it->id;
-            TupleType tuple = it->tuple;
-            DEBUG_PRINT("CompressedSparse::findEdges considering graph "                      "edge %s\n", sam::toString(tuple).c_str());
-
-            // Check that the edge hasn't expired.
-            DEBUG_PRINT("CompressedSparse::findEdges currentTime %f tupletype"
-              " %f window %f \n", currentTime.load(), 
-              std::get<time>(tuple), 
-              window);
-
-            if ( currentTime.load() - std::get<time>(tuple) < window) 
-            {
-              DEBUG_PRINT_SIMPLE("CompressedSparse::findEdges edge hasn't"
-                " expired\n");
-              
-              bool passed = true;
-
-              // Check to see if the source matches. It always should, so
-              // throw an exception if it doesn't
-              SourceType candSrc = std::get<source>(tuple);
-              if (!equal(src, candSrc))
-              {
-                std::string message = "CompressedSpare::findEdges: Found an "
-                  "edge where the source doesn't match the source of the "
-                  "first edge.  This is a logical error.";
-                throw CompressedSparseException(message);
-              }
-
-              // Check to see if the target matches if the target is defined
-              // in the edge request.
-              if (!isNull(trg)) {
-                TargetType candTrg = std::get<target>(tuple);
-                if (!equal(trg, candTrg))
-                {
-                  passed = false;
-                }
-              }
-              DEBUG_PRINT("CompressedSparse::findEdges pass after checking "
-                "source/target: %d\n", passed);
-
-              if (passed) {
-                double candTime = std::get<time>(tuple);
-                double candDuration = std::get<duration>(tuple);
-                // Check that the time is after starttime and 
-                // before stoptime
-                DEBUG_PRINT("CompressedSparse::findEdges candTime %f "
-                  "candDuration %f "
-                  "startTimeFirst %f startTimeSecond %f "
-                  "endTimeFirst %f endTimeSecond %f\n",
-                  candTime, candDuration, startTimeFirst, startTimeSecond,
-                  endTimeFirst, endTimeSecond);
-                if (candTime < startTimeFirst ||
-                    candTime > startTimeSecond ||
-                    candTime + candDuration < endTimeFirst ||
-                    candTime + candDuration > endTimeSecond)
-                {
-                  passed = false;
-                }
-              }
-              if (passed) {
-                foundEdges.push_back(*it);
-              }
-              ++it;
-            } else {
-              // The edge has expired, so we get rid of it.
-
-              DEBUG_PRINT("CompressedSparse::findEdges the edge has expired"
-                " %s\n", toString(tuple).c_str());
-              
-              it = l.erase(it);
-              METRICS_INCREMENT(this->totalEdgesDeleted)
-            }
-          }
-        }
-      } catch (std::exception e) {
-        std::string message = std::string("addEdge: Error accessing first "
-          "element of list") + e.what();  
-        throw CompressedSparseException(message);
-      }
-    }
+  size_t probes = 0;
+  VertexSlot const* slot = findSlot(alle[index], src, srcHash, probes);
+  if (!slot || !slot->ring) {
+    DEBUG_PRINT("CompressedSparse::findEdges src %s not in graph\n", 
+      src.c_str());
+    return;
   }
+
+  RingType const& ring = *slot->ring;
+
+  DEBUG_PRINT("CompressedSparse::findEdges number of edges to consider: "
+    "%lu\n", ring.size());
+
+  // The ring only scans the edges that start within the time bounds, and
+  // filters them on the remaining bounds and the target hash without 
+  // touching the tuples.  Expired edges are left for addEdge to remove; 
+  // the filter just skips them.
+  EdgeFilter filter;
+  filter.startTimeFirst = startTimeFirst;
+  filter.startTimeSecond = startTimeSecond;
+  filter.endTimeFirst = endTimeFirst;
+  filter.endTimeSecond = endTimeSecond;
+  filter.now = currentTime.load();
+  filter.window = window;
+  filter.checkOther = checkTarget;
+  filter.other = trgHash;
+
+  ring.findMatches(filter, [&](EdgeType const& edge) {
+    // The hashes matched, so now check the target itself.
+    if (checkTarget && !equal(trg, std::get<target>(edge.tuple))) {
+      return;
+    }
+    DEBUG_PRINT("CompressedSparse::findEdges found edge %s\n", 
+      sam::toString(edge.tuple).c_str());
+    foundEdges.push_back(edge);
+  });
 }
 
 
@@ -356,144 +516,175 @@ CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::addEdge(
               edge.toString().c_str());
   METRICS_INCREMENT(totalEdgesAdded)
 
-  TupleType tuple = edge.tuple;
-
-  // Updating time in a somewhat unsafe manner that should generally work.
-  //uint64_t tupleTime = convert(std::get<time>(tuple));
-  double tupleTime = std::get<time>(tuple);
-  DEBUG_PRINT("CompressedSparse::addEdge tupleTime %f currentTime %f\n",
-    tupleTime, currentTime.load());
-  if (tupleTime > currentTime.load()) {
-    currentTime.store(tupleTime);
-  }
+  double tupleTime = std::get<time>(edge.tuple);
   DEBUG_PRINT("CompressedSparse::addEdge tupleTime %f currentTime %f\n",
     tupleTime, currentTime.load());
+  observeTime(tupleTime);
 
-  SourceType s = std::get<source>(tuple);
-  size_t index = hash(s) % capacity;
+  SourceType const& s = std::get<source>(edge.tuple);
+  uint64_t srcHash = hash(s);
+  uint64_t trgHash = hash(std::get<target>(edge.tuple));
+  size_t index = srcHash % capacity;
 
   DEBUG_PRINT("CompressedSparse::addEdge index %lu for tuple %s\n",  
-    index, sam::toString(tuple).c_str());
+    index, sam::toString(edge.tuple).c_str());
 
   std::lock_guard<std::mutex> lock(mutexes[index]);
 
-  // If we find a list that has entries where the source is the same
-  // as tuple's source, this is set to true.
-  bool found = false;
-  std::list<EdgeType>* emptyListPtr = 0;
-  size_t work = alle[index].size();
-  DEBUG_PRINT("CompressedSparse::addEdge size of bin %lu: %lu\n",
-    index, alle[index].size());
-  for (auto & l : alle[index]) {
-    if (l.size() > 0) {
-      DEBUG_PRINT("CompressedSparse::addEdge index %lu l.size %lu\n", 
-        index, l.size());
-      try {
-        SourceType s0 = std::get<source>(l.front().tuple);  
-        DEBUG_PRINT("CompressedSparse::addEdge s0 %s s %s for tuple %s\n",  
-          s0.c_str(), s.c_str(), sam::toString(tuple).c_str());
-
-        if (equal(s, s0)) 
-        {
-          DEBUG_PRINT("CompressedSparse::addEdge found list for tuple %s\n",
-            sam::toString(tuple).c_str());
-          found = true;
-          l.push_back(edge);
-          break;
-        }
-      } catch (std::exception e) {
-        std::string message = std::string("addEdge: Error accessing first "
-          "element of list") + e.what();  
-        throw CompressedSparseException(message);
-          
-      }
-    } else {
-      DEBUG_PRINT_SIMPLE("CompressedSparse::addEdge pointing to emptylist\n");
-      emptyListPtr = &l;
-    }
-  }
+  VertexTable& table = alle[index];
+  size_t work = 0;
+  VertexSlot* slot = findSlot(table, s, srcHash, work);
+
+  if (slot && slot->ring) {
+    DEBUG_PRINT("CompressedSparse::addEdge found vertex for tuple %s\n",
+      sam::toString(edge.tuple).c_str());
+    size_t bytesBefore = slot->ring->bytes();
+    slot->ring->push_back(edge, trgHash);
+    
+    // We can clean up edges of this vertex that have expired.
+    size_t removed = slot->ring->expire(currentTime.load(), window);
+    #ifdef METRICS
+    totalEdgesDeleted += removed;
+    #endif
+    work += removed;
+    adjustBytes(bytesBefore, slot->ring->bytes());
+    numLiveEdges.fetch_add(1);
+    numLiveEdges.fetch_sub(removed);
+  } else {
+    DEBUG_PRINT("CompressedSparse::addEdge creating vertex for tuple %s\n",  
+              sam::toString(edge.tuple).c_str());
 
-  // If we didn't find a list that has entries with the same source
-  // as tuple, then we need to create a new list or use an empty one.
-  if (!found) {
-    DEBUG_PRINT("CompressedSparse::addEdge didn't find list for tuple %s\n",  
-              sam::toString(tuple).c_str());
-    work += 1;
-    // If we found an empty list, use that list.
-    if (emptyListPtr) {
-      DEBUG_PRINT("CompressedSparse::addEdge found empty list for tuple %s\n",  
-              sam::toString(tuple).c_str());
-      emptyListPtr->push_back(edge);
-    } else {
-      // No empty lists, so we need to add another list to this slot
-      DEBUG_PRINT("CompressedSparse::addEdge creating list for tuple %s\n",  
-              sam::toString(tuple).c_str());
-      alle[index].push_back(std::list<EdgeType>());
-      alle[index].back().push_back(edge);
+    // Keep the table at most half full so probe sequences stay short.
+    if (!slot || 2 * (table.numVertices + 1) > table.numSlots) {
+      growTable(table);
+      slot = findSlot(table, s, srcHash, work);
     }
-  } else {
-    // If we did find a list, we can clean up edges that have expired.
-    work += cleanupEdges(index);
+    slot->hash = srcHash;
+    slot->vertex = s;
+    slot->ring = new RingType();
+    slot->ring->push_back(edge, trgHash);
+    table.numVertices++;
+    numBytes.fetch_add(slot->ring->bytes());
+    numLiveEdges.fetch_add(1);
+    numLiveVertices.fetch_add(1);
   }
   return work;
 }
 
+
 template <typename EdgeType, size_t source, size_t target, 
           size_t time, size_t duration,
           typename HF, typename EF>
 size_t
 CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
-cleanupEdges( size_t index )
+sweepBin(size_t index, double now)
 {
-  // Should only be called by addEdge and (maybe) findEdges, 
-  // which has this slot (alle[index]) locked out.
-  size_t work = 0;
-  for( auto & l : alle[index]) {
-    while (l.size() > 0 && 
-           currentTime.load() - std::get<time>(l.front().tuple) > window) {
-      work++;
-      DEBUG_PRINT("Deleting edge currentTime %f front time %f "
-        "window %f\n", currentTime.load(), std::get<time>(l.front().tuple),
-        window);
-      l.pop_front();
-      METRICS_INCREMENT(totalEdgesDeleted)
+  std::lock_guard<std::mutex> lock(mutexes[index]);
+  VertexTable& table = alle[index];
+
+  size_t removed = 0;
+  size_t freed = 0;
+  for (size_t k = 0; k < table.numSlots; k++) {
+    VertexSlot& slot = table.slots[k];
+    if (!slot.ring) continue;
+
+    size_t bytesBefore = slot.ring->bytes();
+    removed += slot.ring->expire(now, window);
+    if (slot.ring->empty()) {
+      numBytes.fetch_sub(bytesBefore);
+      delete slot.ring;
+      slot.ring = nullptr;
+      slot.vertex = NodeType();
+      freed++;
+    } else {
+      adjustBytes(bytesBefore, slot.ring->bytes());
     }
   }
-  return work;
-}
 
+  if (freed > 0) {
+    // Emptied slots break the probe sequences, so the table is rebuilt,
+    // shrinking it if it has become mostly empty.
+    table.numVertices -= freed;
+    numLiveVertices.fetch_sub(freed);
+    size_t newNumSlots = table.numSlots;
+    while (newNumSlots > 4 && 4 * table.numVertices < newNumSlots) {
+      newNumSlots /= 2;
+    }
+    rehashTable(table, table.numVertices > 0 ? newNumSlots : 0);
+  }
+
+  numLiveEdges.fetch_sub(removed);
+  return removed;
+}
 
 template <typename EdgeType, size_t source, size_t target, 
           size_t time, size_t duration,
           typename HF, typename EF>
 size_t
 CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
-countEdges()
-const
+expireSlice(size_t maxBins)
 {
-   // For fun we parallelized it
-  int numThreads = 4;
-  std::vector<std::thread> threads;
-  std::atomic<size_t> allCount(0);
-  for (int i = 0; i < numThreads; i++) {
-    threads.push_back(std::thread([i, numThreads, this, &allCount]() {
-      size_t count = 0;
-      int beg = get_begin_index(capacity, i, numThreads); 
-      int end = get_end_index(capacity, i, numThreads); 
-      for (int j = beg; j < end; j++) {
-        for (auto l1 : this->alle[j]) {
-          count += l1.size();
-        }
-      }
-      allCount.fetch_add(count); 
-    }));
+  double now = currentTime.load();
+  size_t removed = 0;
+  maxBins = std::min(maxBins, capacity);
+  for (size_t i = 0; i < maxBins; i++) {
+    size_t index = sweepCursor.fetch_add(1) % capacity;
+    removed += sweepBin(index, now);
   }
+  #ifdef METRICS
+  totalEdgesDeleted += removed;
+  #endif
+  return removed;
+}
 
-  for (int i = 0; i < numThreads; i++) {
-    threads[i].join();
+template <typename EdgeType, size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename HF, typename EF>
+void
+CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+degreeStatistics(size_t& numVertices, double& meanDegree,
+                 double& secondMoment) const
+{
+  numVertices = 0;
+  double sum = 0;
+  double sumSquares = 0;
+  for (size_t j = 0; j < capacity; j++) {
+    std::lock_guard<std::mutex> lock(mutexes[j]);
+    VertexTable const& table = alle[j];
+    for (size_t k = 0; k < table.numSlots; k++) {
+      RingType const* ring = table.slots[k].ring;
+      if (ring && !ring->empty()) {
+        double degree = ring->size();
+        numVertices++;
+        sum += degree;
+        sumSquares += degree * degree;
+      }
+    }
   }
+  meanDegree = numVertices > 0 ? sum / numVertices : 0;
+  secondMoment = numVertices > 0 ? sumSquares / numVertices : 0;
+}
 
-  return allCount.load();
+template <typename EdgeType, size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename HF, typename EF>
+template <typename F>
+void
+CompressedSparse<EdgeType, source, target, time, duration, HF, EF>::
+forEachEdge(F&& f) const
+{
+  for (size_t j = 0; j < capacity; j++) {
+    std::lock_guard<std::mutex> lock(mutexes[j]);
+    VertexTable const& table = alle[j];
+    for (size_t k = 0; k < table.numSlots; k++) {
+      RingType const* ring = table.slots[k].ring;
+      if (ring) {
+        for (size_t i = 0; i < ring->size(); i++) {
+          f(ring->edge(i));
+        }
+      }
+    }
+  }
 }
 
 
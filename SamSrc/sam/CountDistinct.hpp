@@ -0,0 +1,122 @@
+#ifndef SAM_COUNT_DISTINCT_HPP
+#define SAM_COUNT_DISTINCT_HPP
+
+/**
+ * Estimates the number of distinct values of a field per key (e.g. the
+ * distinct destination ports of a source) using HyperLogLog.
+ */
+
+#include <functional>
+#include <iostream>
+
+#include <sam/AbstractConsumer.hpp>
+#include <sam/BaseComputation.hpp>
+#include <sam/Features.hpp>
+#include <sam/FeatureProducer.hpp>
+#include <sam/HyperLogLog.hpp>
+#include <sam/KeyedState.hpp>
+#include <sam/Util.hpp>
+#include <sam/tuples/Edge.hpp>
+
+namespace sam {
+
+/**
+ * The memory per key is fixed by the precision (and N/b for the sliding
+ * window) no matter how many distinct values a key has, so a scanning host
+ * costs the same as any other.
+ */
+template <typename EdgeType,
+          size_t valueField, size_t... keyFields>
+class CountDistinct: public AbstractConsumer<EdgeType>,
+                     public BaseComputation,
+                     public FeatureProducer
+{
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+  typedef typename std::tuple_element<valueField, TupleType>::type ValueType;
+  typedef std::function<double(TupleType const&)> TimeFunction;
+
+private:
+  size_t N; ///> Items in the sliding window, 0 for the whole stream
+  size_t b; ///> Items in a basic window
+  size_t precision; ///> log2 of the number of HyperLogLog registers
+
+  KeyedState<std::shared_ptr<SlidingHyperLogLog>> allWindows;
+
+  TimeFunction timeFunction; ///> Gets the time of a tuple for evicting keys
+
+public:
+  /**
+   * Constructor.
+   * \param N The number of items in the sliding window, or 0 to count over
+   *   the whole stream.
+   * \param b The number of items in a basic window.  Ignored if N is 0.
+   * \param precision log2 of the number of registers.  The standard error
+   *   is about 1.04 / sqrt(2^precision).
+   * \param nodeId The nodeId of the node that is running this operator.
+   * \param featureMap The global featureMap that holds the features produced
+   *                   by this operator.
+   * \param identifier A unique identifier associated with this operator.
+   * \param keyTtl Keys not seen for this long (in tuple time) are evicted.
+   *               0 means keys are never evicted for age.
+   * \param maxStateBytes Memory budget for the per-key counters.  0 means no
+   *               limit.
+   * \param timeFunction Gets the time of a tuple.  Required if keyTtl > 0.
+   */
+  CountDistinct(size_t N, size_t b, size_t precision,
+                size_t nodeId,
+                std::shared_ptr<FeatureMap> featureMap,
+                std::string identifier,
+                double keyTtl = 0,
+                size_t maxStateBytes = 0,
+                TimeFunction timeFunction = TimeFunction()) :
+    BaseComputation(nodeId, featureMap, identifier),
+    N(N), b(b), precision(precision),
+    allWindows(keyTtl, maxStateBytes,
+      SlidingHyperLogLog::memoryUsage(N, b, precision)),
+    timeFunction(timeFunction)
+  {
+    // Checks the parameters before any key needs them.
+    SlidingHyperLogLog check(N, b, precision);
+    if (keyTtl > 0 && !timeFunction) {
+      throw KeyedStateException("CountDistinct: keyTtl requires a "
+        "timeFunction");
+    }
+  }
+
+  bool consume(EdgeType const& edge)
+  {
+    this->feedCount++;
+    if (this->feedCount % this->metricInterval == 0) {
+      std::cout << "CountDistinct NodeId " << this->nodeId
+                << " number of keys " << allWindows.size()
+                << " keys evicted " << allWindows.getKeysEvicted()
+                << " bytes held " << allWindows.getBytesHeld()
+                << " feedCount " << this->feedCount << std::endl;
+    }
+
+    // Generates unique key from key fields
+    std::string key = generateKey<keyFields...>(edge.tuple);
+
+    double time = timeFunction ? timeFunction(edge.tuple) : 0;
+    auto window = allWindows.get(key, time, [this]() {
+      return std::make_shared<SlidingHyperLogLog>(N, b, precision);
+    });
+
+    window->add(HyperLogLog::hash(std::get<valueField>(edge.tuple)));
+
+    double estimate = window->estimate();
+    SingleFeature feature(estimate);
+    this->featureMap->updateInsert(key, this->identifier, feature);
+
+    this->notifySubscribers(edge.id, estimate);
+
+    return true;
+  }
+
+  void terminate() {}
+};
+
+} // end namespace sam
+
+#endif
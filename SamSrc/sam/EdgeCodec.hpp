@@ -0,0 +1,278 @@
+#ifndef SAM_EDGE_CODEC_HPP
+#define SAM_EDGE_CODEC_HPP
+
+/**
+ * Binary wire format for edges sent between nodes.
+ *
+ * A message starts with a one byte marker followed by the fields of the
+ * label (for edge messages) and the tuple.  Numeric fields are written with
+ * their fixed width in host byte order (all the nodes of a cluster are
+ * assumed to share an architecture).  Strings are a uint32_t length
+ * followed by the characters.  The id of the edge is not sent since the
+ * receiving node assigns its own.
+ *
+ * The text messages created by Edge::toStringNoId() and sam::toString()
+ * never start with the marker bytes, so receivers can accept either
+ * format.  Compile with TEXT_WIRE_FORMAT to send text, which is easier to
+ * read when debugging.
+ */
+
+#include <sam/Util.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace sam {
+
+#define BINARY_EDGE_MARKER '\x01' ///> Message has a label and a tuple
+#define BINARY_TUPLE_MARKER '\x02' ///> Message has only a tuple
+#define BINARY_MIGRATE_MARKER '\x04' ///> Label and tuple of an edge that is
+                                     ///> moving to a new owner
+
+class EdgeCodecException : public std::runtime_error {
+public:
+  EdgeCodecException(char const * message) : std::runtime_error(message) { }
+  EdgeCodecException(std::string message) : std::runtime_error(message) { }
+};
+
+/**
+ * Encodes and decodes a single field.  Only arithmetic types and
+ * std::string are supported.
+ */
+template <typename T, typename Enable = void>
+struct FieldCodec
+{
+  static_assert(std::is_arithmetic<T>::value,
+    "FieldCodec only supports arithmetic types and std::string");
+};
+
+template <typename T>
+struct FieldCodec<T,
+  typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+  static void encode(T const& value, std::string& buffer)
+  {
+    buffer.append(reinterpret_cast<char const*>(&value), sizeof(T));
+  }
+
+  static char const* decode(char const* p, char const* end, T& value)
+  {
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(T))) {
+      throw EdgeCodecException("FieldCodec::decode message truncated");
+    }
+    std::memcpy(&value, p, sizeof(T));
+    return p + sizeof(T);
+  }
+};
+
+template <>
+struct FieldCodec<std::string>
+{
+  static void encode(std::string const& value, std::string& buffer)
+  {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    FieldCodec<uint32_t>::encode(length, buffer);
+    buffer.append(value);
+  }
+
+  static char const* decode(char const* p, char const* end,
+                            std::string& value)
+  {
+    uint32_t length;
+    p = FieldCodec<uint32_t>::decode(p, end, length);
+    if (static_cast<size_t>(end - p) < length) {
+      throw EdgeCodecException("FieldCodec::decode message truncated");
+    }
+    value.assign(p, length);
+    return p + length;
+  }
+};
+
+/**
+ * Base case for encodeFields.
+ */
+template <size_t I = 0, typename... Tp>
+inline typename std::enable_if<I == sizeof...(Tp), void>::type
+encodeFields(std::tuple<Tp...> const&, std::string&)
+{
+}
+
+/**
+ * Appends the fields of the tuple, starting at I, to the buffer.
+ */
+template <size_t I = 0, typename... Tp>
+inline typename std::enable_if<I < sizeof...(Tp), void>::type
+encodeFields(std::tuple<Tp...> const& t, std::string& buffer)
+{
+  typedef typename std::tuple_element<I, std::tuple<Tp...>>::type FieldType;
+  FieldCodec<FieldType>::encode(std::get<I>(t), buffer);
+  encodeFields<I + 1, Tp...>(t, buffer);
+}
+
+/**
+ * Base case for decodeFields.
+ */
+template <size_t I = 0, typename... Tp>
+inline typename std::enable_if<I == sizeof...(Tp), char const*>::type
+decodeFields(char const* p, char const*, std::tuple<Tp...>&)
+{
+  return p;
+}
+
+/**
+ * Reads the fields of the tuple, starting at I, from p.
+ * \return Returns a pointer to the first byte after the fields.
+ */
+template <size_t I = 0, typename... Tp>
+inline typename std::enable_if<I < sizeof...(Tp), char const*>::type
+decodeFields(char const* p, char const* end, std::tuple<Tp...>& t)
+{
+  typedef typename std::tuple_element<I, std::tuple<Tp...>>::type FieldType;
+  p = FieldCodec<FieldType>::decode(p, end, std::get<I>(t));
+  return decodeFields<I + 1, Tp...>(p, end, t);
+}
+
+/**
+ * True if the data starts with one of the binary markers.
+ */
+inline
+bool isBinaryMessage(char const* data, size_t size)
+{
+  return size > 0 &&
+    (data[0] == BINARY_EDGE_MARKER || data[0] == BINARY_TUPLE_MARKER ||
+     data[0] == BINARY_MIGRATE_MARKER);
+}
+
+/**
+ * True if the data is an edge made by EdgeCodec::encodeMigration().
+ */
+inline
+bool isMigrationMessage(char const* data, size_t size)
+{
+  return size > 0 && data[0] == BINARY_MIGRATE_MARKER;
+}
+
+/**
+ * Creates a binary message with just the tuple.  Used when only the tuple
+ * is at hand (e.g. the EdgeRequestMap).
+ */
+template <typename... Tp>
+std::string encodeTuple(std::tuple<Tp...> const& tuple)
+{
+  std::string buffer;
+  buffer.push_back(BINARY_TUPLE_MARKER);
+  encodeFields(tuple, buffer);
+  return buffer;
+}
+
+/**
+ * Creates the message to send for the tuple.  Binary unless compiled
+ * with TEXT_WIRE_FORMAT.
+ */
+template <typename... Tp>
+std::string tupleToMessage(std::tuple<Tp...> const& tuple)
+{
+  #ifdef TEXT_WIRE_FORMAT
+  return toString(tuple);
+  #else
+  return encodeTuple(tuple);
+  #endif
+}
+
+/**
+ * Encodes and decodes edges of type Edge<IdType, LabelType, TupleType>.
+ */
+template <typename EdgeType>
+class EdgeCodec
+{
+public:
+  typedef typename EdgeType::LocalIdType IdType;
+  typedef typename EdgeType::LocalLabelType LabelType;
+  typedef typename EdgeType::LocalTupleType TupleType;
+
+  /**
+   * Creates a binary message with the label and the tuple of the edge.
+   */
+  static std::string encode(EdgeType const& edge)
+  {
+    std::string buffer;
+    buffer.push_back(BINARY_EDGE_MARKER);
+    encodeFields(edge.label, buffer);
+    encodeFields(edge.tuple, buffer);
+    return buffer;
+  }
+
+  /**
+   * Same as encode() but marks the edge as being moved to the node that
+   * now owns one of its vertices, rather than being an edge to match.  
+   * Always binary.
+   */
+  static std::string encodeMigration(EdgeType const& edge)
+  {
+    std::string buffer = encode(edge);
+    buffer[0] = BINARY_MIGRATE_MARKER;
+    return buffer;
+  }
+
+  /**
+   * Creates an edge from a binary message made by encode(), 
+   * encodeMigration(), or encodeTuple().  If the message only had the tuple, the label is
+   * default constructed.
+   * \param id The id to give the edge.
+   * \param data Pointer to the start of the message.
+   * \param size The size of the message in bytes.
+   */
+  static EdgeType decode(IdType id, char const* data, size_t size)
+  {
+    if (!isBinaryMessage(data, size)) {
+      throw EdgeCodecException("EdgeCodec::decode message does not start "
+        "with a binary marker");
+    }
+    char const* end = data + size;
+    EdgeType edge;
+    edge.id = id;
+    char const* p = data + 1;
+    if (data[0] == BINARY_EDGE_MARKER || data[0] == BINARY_MIGRATE_MARKER) {
+      p = decodeFields(p, end, edge.label);
+    }
+    p = decodeFields(p, end, edge.tuple);
+    if (p != end) {
+      throw EdgeCodecException("EdgeCodec::decode message has " +
+        boost::lexical_cast<std::string>(end - p) + " extra bytes");
+    }
+    return edge;
+  }
+
+  /**
+   * Creates the message to send for the edge.  Binary unless compiled
+   * with TEXT_WIRE_FORMAT.
+   */
+  static std::string toMessage(EdgeType const& edge)
+  {
+    #ifdef TEXT_WIRE_FORMAT
+    return edge.toStringNoId();
+    #else
+    return encode(edge);
+    #endif
+  }
+
+  /**
+   * Creates an edge from a received message.  Binary messages are decoded
+   * in place; anything else is handed to the tuplizer as text.
+   */
+  template <typename Tuplizer>
+  static EdgeType fromMessage(IdType id, char const* data, size_t size,
+                              Tuplizer& tuplizer)
+  {
+    if (isBinaryMessage(data, size)) {
+      return decode(id, data, size);
+    }
+    return tuplizer(id, std::string(data, size));
+  }
+};
+
+} // end namespace sam
+
+#endif
@@ -5,6 +5,7 @@
 #include <sam/Null.hpp>
 #include <sam/Util.hpp>
 #include <sam/ZeroMQUtil.hpp>
+#include <algorithm>
 #include <stdexcept>
 #include <sam/tuples/VastNetflow.hpp>
 #include <sam/tuples/NetflowV5.hpp>
@@ -127,6 +128,21 @@ public:
     return false; 
   }
 
+  /**
+   * Widens the start and end time ranges of this request so that they
+   * also cover those of other.  Used to coalesce requests for the same
+   * source/target.
+   */
+  void widen(EdgeRequest const& other)
+  {
+    setStartTimeFirst(std::min(getStartTimeFirst(),
+                               other.getStartTimeFirst()));
+    setStartTimeSecond(std::max(getStartTimeSecond(),
+                                other.getStartTimeSecond()));
+    setEndTimeFirst(std::min(getEndTimeFirst(), other.getEndTimeFirst()));
+    setEndTimeSecond(std::max(getEndTimeSecond(), other.getEndTimeSecond()));
+  }
+
 };
 
 
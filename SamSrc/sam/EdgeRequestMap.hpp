@@ -2,6 +2,8 @@
 #define SAM_EDGE_REQUEST_MAP_HPP
 
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include <zmq.hpp>
 #include <boost/lexical_cast.hpp>
 #include <sam/EdgeRequest.hpp>
@@ -9,6 +11,8 @@
 #include <sam/Util.hpp>
 #include <sam/TemporalSet.hpp>
 #include <sam/ZeroMQUtil.hpp>
+#include <sam/EdgeCodec.hpp>
+#include <sam/RoutingTable.hpp>
 
 #define TOLERANCE 1.0
 
@@ -28,6 +32,13 @@ public:
  * mutex lock.  Each entry is a list of edge requests that hash to the
  * same location.
  *
+ * Requests are coalesced when added: there is at most one entry for each
+ * (source, target, return node), and a new request for the same key widens
+ * the time ranges of that entry instead of being appended.  Matching an
+ * edge only depends on the key and on when the entry expires, so one
+ * widened entry sends the same edges as the separate requests did, and the
+ * lists that process() scans stay as long as the number of distinct keys.
+ *
  * When process(tuple) is called, we find if there are any matching edge 
  * requests.  If so, we send the tuple to the appropriate node(s).
  */
@@ -44,11 +55,15 @@ public:
 public:
   /**
    * Constructor.  
+   * \param routingTable Says which nodes get the edges of a vertex, so
+   *   which nodes don't need to be sent a matching edge.  If null, vertices
+   *   are owned by a HashRing of all the nodes.
    */
    EdgeRequestMap(std::size_t numNodes,
                   std::size_t nodeId,
                   size_t tableCapacity,
-                  PushPull* edgeCommunicator);
+                  PushPull* edgeCommunicator,
+                  std::shared_ptr<RoutingTable> routingTable = nullptr);
 
   /**
    * Destructor.
@@ -57,9 +72,13 @@ public:
 
   /**
    * Add a request to the list.  This is called by the requestPullThread of
-   * the GraphStore class.  
+   * the GraphStore class.  If there is already an entry with the same
+   * source, target, and return node, its time ranges are widened to cover
+   * the request instead.
+   * \return Returns true if the request was coalesced into an existing
+   *   entry.
    */
-  void addRequest(EdgeRequestType request);
+  bool addRequest(EdgeRequestType request);
 
   /**
    * Given the tuple, finds if there are any open edge requests that are 
@@ -69,6 +88,16 @@ public:
    */
   size_t process(TupleType const& tuple);
 
+  /**
+   * Removes the requests for which shouldMove returns true and appends
+   * them to moved.  Used to hand requests to the new owner of their
+   * vertices when the cluster membership changes.
+   * \return Returns the number of requests removed.
+   */
+  template <typename Predicate>
+  size_t extractRequests(Predicate&& shouldMove,
+                         std::list<EdgeRequestType>& moved);
+
   #ifdef METRICS
   /**
    * Returns how many edges we've sent
@@ -84,6 +113,19 @@ public:
    * Returns how many total edge requests this class examines.
    */
   uint64_t getTotalEdgeRequestsViewed() { return edgeRequestsViewedCounter; }
+
+  /**
+   * Returns how many edge requests were added with addRequest.
+   */
+  size_t getTotalEdgeRequestsAdded() { return edgeRequestsAddedCounter; }
+
+  /**
+   * Returns how many of the added edge requests were coalesced into an
+   * existing entry rather than adding a new one.
+   */
+  size_t getTotalEdgeRequestsCoalesced() {
+    return edgeRequestsCoalescedCounter;
+  }
   #endif
 
   #ifdef DETAIL_TIMING
@@ -96,6 +138,24 @@ public:
    * Returns the total time spent waiting for a lock to an ale entry.
    */
   double getTotalTimeLock() { return totalTimeLock; }
+
+  /**
+   * Returns the total time process() held the lock to an ale entry.
+   */
+  double getTotalTimeLockHeld() { return totalTimeLockHeld; }
+
+  /**
+   * Returns how many times process() held the lock to an ale entry for
+   * less than 1us, 1us to 10us, and so on by factors of ten.  The last
+   * bin counts everything from 100ms up.
+   */
+  std::vector<size_t> getLockHoldHistogram() const {
+    std::vector<size_t> histogram;
+    for (size_t i = 0; i < NUM_LOCK_HOLD_BINS; i++) {
+      histogram.push_back(lockHoldCounts[i]);
+    }
+    return histogram;
+  }
   #endif
 	
   /**
@@ -111,6 +171,12 @@ private:
         std::function<bool(EdgeRequestType const&, TupleType const&)> 
           checkFunction);
 
+  /**
+   * Returns true if the two requests have the same source, target, and
+   * return node.  Null sources (targets) only match null sources (targets).
+   */
+  bool sameKey(EdgeRequestType const& r1, EdgeRequestType const& r2);
+
   //TODO move these from class template to std::functions.
   SourceHF sourceHash;
   TargetHF targetHash;
@@ -131,6 +197,8 @@ private:
 
   PushPull* edgeCommunicator;
 
+  std::shared_ptr<RoutingTable> routingTable;
+
   std::function<size_t(TupleType const&)> sourceIndexFunction;
   std::function<bool(EdgeRequestType const&, TupleType const&)> 
     sourceCheckFunction;
@@ -150,11 +218,33 @@ private:
   std::atomic<size_t> sendFailCounter; 
 
   std::atomic<uint64_t> edgeRequestsViewedCounter;
+
+  /// How many requests were added and how many of those were coalesced
+  std::atomic<size_t> edgeRequestsAddedCounter;
+  std::atomic<size_t> edgeRequestsCoalescedCounter;
   #endif 
 
   #ifdef DETAIL_TIMING
   double totalTimePush = 0;
   double totalTimeLock = 0;
+  double totalTimeLockHeld = 0;
+
+  static size_t const NUM_LOCK_HOLD_BINS = 7;
+  std::atomic<size_t> lockHoldCounts[NUM_LOCK_HOLD_BINS];
+
+  /**
+   * Adds how long (in seconds) process() held a lock to the histogram.
+   */
+  void addLockHold(double seconds) {
+    totalTimeLockHeld += seconds;
+    size_t bin = 0;
+    double limit = 1e-6;
+    while (bin < NUM_LOCK_HOLD_BINS - 1 && seconds >= limit) {
+      bin++;
+      limit *= 10;
+    }
+    lockHoldCounts[bin].fetch_add(1);
+  }
   #endif
 
   std::atomic<bool> terminated;
@@ -169,14 +259,27 @@ EdgeRequestMap<TupleType, source, target, time,
 EdgeRequestMap( std::size_t numNodes,
                 std::size_t nodeId,
                 size_t tableCapacity,
-                PushPull* edgeCommunicator)
+                PushPull* edgeCommunicator,
+                std::shared_ptr<RoutingTable> routingTable)
 {
   this->edgeCommunicator = edgeCommunicator;
+  this->routingTable = routingTable;
+  if (!this->routingTable) {
+    this->routingTable = std::make_shared<RoutingTable>(numNodes);
+  }
 
   #ifdef METRICS
   sendFailCounter = 0;
   edgePushCounter = 0;
   edgeRequestsViewedCounter = 0;
+  edgeRequestsAddedCounter = 0;
+  edgeRequestsCoalescedCounter = 0;
+  #endif
+
+  #ifdef DETAIL_TIMING
+  for (size_t i = 0; i < NUM_LOCK_HOLD_BINS; i++) {
+    lockHoldCounts[i] = 0;
+  }
   #endif
 
   sourceIndexFunction = [this](TupleType const& tuple) {
@@ -204,8 +307,7 @@ EdgeRequestMap( std::size_t numNodes,
     if (this->sourceEquals(src, edgeRequestSrc)) {
       
       size_t node = edgeRequest.getReturn();
-      // TODO: Partition info
-      if (this->targetHash(trg) % this->numNodes != node) {
+      if (!this->routingTable->receives(this->targetHash(trg), node)) {
         return true;
       }
     }
@@ -226,8 +328,7 @@ EdgeRequestMap( std::size_t numNodes,
       DEBUG_PRINT("Node %lu EdgeRequestMap::targetCheckFunction "
         "sourceHash(src) mod numNodes  %llu node %lu\n", 
         this->nodeId, sourceHash(src) % this->numNodes, node);
-      // TODO: Partition info
-      if (this->sourceHash(src) % this->numNodes != node) {
+      if (!this->routingTable->receives(this->sourceHash(src), node)) {
         DEBUG_PRINT("Node %lu targetCheckFunction returning true\n",
           this->nodeId);
         return true;
@@ -248,9 +349,8 @@ EdgeRequestMap( std::size_t numNodes,
     {
       size_t node = edgeRequest.getReturn();
 
-      // TODO: Partition info
-      if (sourceHash(src) % this->numNodes != node &&
-          targetHash(trg) % this->numNodes != node)
+      if (!this->routingTable->receives(sourceHash(src), node) &&
+          !this->routingTable->receives(targetHash(trg), node))
       {
         return true;
       }
@@ -287,7 +387,35 @@ EdgeRequestMap<TupleType, source, target, time,
 template <typename TupleType, size_t source, size_t target, size_t time,
           typename SourceHF, typename TargetHF,
           typename SourceEF, typename TargetEF>
-void
+bool
+EdgeRequestMap<TupleType, source, target, time,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+sameKey(EdgeRequestType const& r1, EdgeRequestType const& r2)
+{
+  if (r1.getReturn() != r2.getReturn()) {
+    return false;
+  }
+
+  SourceType src1 = r1.getSource();
+  SourceType src2 = r2.getSource();
+  if (isNull(src1) != isNull(src2) ||
+      (!isNull(src1) && !sourceEquals(src1, src2))) {
+    return false;
+  }
+
+  TargetType trg1 = r1.getTarget();
+  TargetType trg2 = r2.getTarget();
+  if (isNull(trg1) != isNull(trg2) ||
+      (!isNull(trg1) && !targetEquals(trg1, trg2))) {
+    return false;
+  }
+  return true;
+}
+
+template <typename TupleType, size_t source, size_t target, size_t time,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+bool
 EdgeRequestMap<TupleType, source, target, time,
   SourceHF, TargetHF, SourceEF, TargetEF>::
 addRequest(EdgeRequestType request)
@@ -317,13 +445,57 @@ addRequest(EdgeRequestType request)
     throw EdgeRequestMapException(message);
   }
 
-  mutexes[index].lock();
+  std::lock_guard<std::mutex> lock(mutexes[index]);
+
+  #ifdef METRICS
+  edgeRequestsAddedCounter.fetch_add(1);
+  #endif
+
+  for (auto& existing : ale[index]) {
+    if (sameKey(existing, request)) {
+      DEBUG_PRINT("Node %lu EdgeRequestMap::addRequest ale[%lu] Coalescing "
+        "request %s into %s\n", nodeId, index, request.toString().c_str(),
+        existing.toString().c_str())
+      existing.widen(request);
+
+      #ifdef METRICS
+      edgeRequestsCoalescedCounter.fetch_add(1);
+      #endif
+      return true;
+    }
+  }
 
   DEBUG_PRINT("Node %lu EdgeRequestMap::addRequest ale[%lu] Adding request "
     "%s\n", nodeId, index, request.toString().c_str())
   ale[index].push_back(request);
-  mutexes[index].unlock();
+  return false;
+}
 
+template <typename TupleType, size_t source, size_t target, size_t time,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+template <typename Predicate>
+size_t
+EdgeRequestMap<TupleType, source, target, time,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+extractRequests(Predicate&& shouldMove, std::list<EdgeRequestType>& moved)
+{
+  size_t numMoved = 0;
+  for (size_t i = 0; i < tableCapacity; i++) {
+    std::lock_guard<std::mutex> lock(mutexes[i]);
+    auto it = ale[i].begin();
+    while (it != ale[i].end()) {
+      if (shouldMove(*it)) {
+        auto next = std::next(it);
+        moved.splice(moved.end(), ale[i], it);
+        it = next;
+        numMoved++;
+      } else {
+        ++it;
+      }
+    }
+  }
+  return numMoved;
 }
 
 template <typename TupleType, size_t source, size_t target, size_t time,
@@ -361,16 +533,19 @@ process(TupleType const& tuple,
 
   double currentTime = std::get<time>(tuple);
 
-  // To prevent duplicates being sent, we keep track of which nodes has seen
-  // the tuple already.
-  bool sentEdges[numNodes];
-  for (size_t i = 0; i < numNodes; i++) sentEdges[i] = false;
+  // The nodes that want the tuple.  They are found while holding the lock
+  // on ale[index], but the tuple is sent after the lock is released so that
+  // a slow peer doesn't hold up addRequest and the other threads using
+  // this entry.  Each node only gets the tuple once.
+  std::vector<size_t> nodes;
+  std::vector<bool> wantsEdge(numNodes, false);
 
   DETAIL_TIMING_BEG1
-  mutexes[index].lock();
+  std::unique_lock<std::mutex> lock(mutexes[index]);
   DETAIL_TIMING_END_TOL1(nodeId, totalTimeLock, TOLERANCE, 
     "EdgeRequestMap::process obtaining lock exceeded "
     "tolerance")
+  DETAIL_TIMING_BEG2
   size_t count = 0;
 
   DEBUG_PRINT("Node %lu EdgeRequestMap::process number of requests to look at"
@@ -402,56 +577,67 @@ process(TupleType const& tuple,
 
       count++;
       if(checkFunction(*edgeRequest, tuple)) {
-        
         size_t node = edgeRequest->getReturn();
-        
-        if (!sentEdges[node]) {
-
-          if (!terminated) {
-           
-            std::string message = toString(tuple);
-            
-            DEBUG_PRINT("Node %lu->%lu EdgeRequestMap::process sending"
-              " edge %s\n", nodeId, node, toString(tuple).c_str());
-            
-            ////// Sending tuple and checking timing /////
-            
-            DETAIL_TIMING_BEG2
-            bool sent = edgeCommunicator->send(message, node);
-            DETAIL_TIMING_END_TOL2(nodeId, totalTimePush, TOLERANCE, 
-              "EdgeRequestMap::process sending message exceeded "
-              "tolerance")
-            
-            //// End sending tuple
-            
-            sentEdges[node] = true;
-            double edgeTime = std::get<time>(tuple);
-
-            if (!sent) {
-              DEBUG_PRINT("Node %lu->%lu EdgeRequestMap::process error sending"
-                " edge %s\n", nodeId, node, toString(tuple).c_str());
-              
-              #ifdef METRICS
-              sendFailCounter.fetch_add(1);
-              #endif
-
-            } else {
- 
-              #ifdef METRICS
-              edgePushCounter.fetch_add(1);
-              #endif
-            }
-          } else {
-            DEBUG_PRINT("Node %lu EdgeRequestMap::process existing because"
-              " terminated\n", nodeId);
-          }
+        if (!wantsEdge[node]) {
+          wantsEdge[node] = true;
+          nodes.push_back(node);
         }
       }
       ++edgeRequest;
     }
   }
 
-  mutexes[index].unlock();
+  lock.unlock();
+  #ifdef DETAIL_TIMING
+  detailTimingEnd = std::chrono::high_resolution_clock::now();
+  addLockHold(std::chrono::duration_cast<std::chrono::duration<double>>(
+    detailTimingEnd - detailTimingBegin).count());
+  #endif
+
+  if (nodes.empty()) {
+    return count;
+  }
+
+  if (terminated) {
+    DEBUG_PRINT("Node %lu EdgeRequestMap::process existing because"
+      " terminated\n", nodeId);
+    return count;
+  }
+
+  // Serialize once for all the nodes.
+  std::string message = tupleToMessage(tuple);
+
+  for (size_t node : nodes) {
+
+    DEBUG_PRINT("Node %lu->%lu EdgeRequestMap::process sending"
+      " edge %s\n", nodeId, node, toString(tuple).c_str());
+    
+    ////// Sending tuple and checking timing /////
+    
+    DETAIL_TIMING_BEG2
+    bool sent = edgeCommunicator->send(message, node);
+    DETAIL_TIMING_END_TOL2(nodeId, totalTimePush, TOLERANCE, 
+      "EdgeRequestMap::process sending message exceeded "
+      "tolerance")
+    
+    //// End sending tuple
+
+    if (!sent) {
+      DEBUG_PRINT("Node %lu->%lu EdgeRequestMap::process error sending"
+        " edge %s\n", nodeId, node, toString(tuple).c_str());
+      
+      #ifdef METRICS
+      sendFailCounter.fetch_add(1);
+      #endif
+
+    } else {
+
+      #ifdef METRICS
+      edgePushCounter.fetch_add(1);
+      #endif
+    }
+  }
+
   return count;
 }
 
@@ -0,0 +1,559 @@
+#ifndef SAM_EDGE_RING_HPP
+#define SAM_EDGE_RING_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <sam/Util.hpp>
+#include <sam/Simd.hpp>
+
+namespace sam {
+
+/**
+ * What EdgeRing::findMatches looks for: edges that haven't expired and
+ * whose start and end times are within the bounds.  If checkOther is true,
+ * the hash of the other endpoint must also equal other.
+ */
+struct EdgeFilter
+{
+  double startTimeFirst;
+  double startTimeSecond;
+  double endTimeFirst;
+  double endTimeSecond;
+
+  /// Edges with now - startTime >= window have expired.
+  double now;
+  double window;
+
+  bool checkOther = false;
+  uint64_t other = 0;
+};
+
+namespace ring_detail {
+
+/**
+ * Filter kernels.  Each looks at n edges given as columns and writes the
+ * offsets of the ones that pass the filter to out, returning how many 
+ * passed.  There is a scalar version and an AVX2 version that compares
+ * four edges at a time without branching; filter() picks one with 
+ * cpuHasAvx2().
+ */
+
+inline size_t filterScalar(EdgeFilter const& f, double const* startTimes,
+                           double const* endTimes, uint64_t const* others,
+                           size_t n, uint32_t* out)
+{
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    double s = startTimes[i];
+    double e = endTimes[i];
+    if (s >= f.startTimeFirst && s <= f.startTimeSecond &&
+        e >= f.endTimeFirst && e <= f.endTimeSecond &&
+        f.now - s < f.window &&
+        (!f.checkOther || others[i] == f.other)) 
+    {
+      out[count++] = static_cast<uint32_t>(i);
+    }
+  }
+  return count;
+}
+
+#if SAM_HAS_AVX2_KERNELS
+
+SAM_TARGET_AVX2
+inline size_t filterAvx2(EdgeFilter const& f, double const* startTimes,
+                         double const* endTimes, uint64_t const* others,
+                         size_t n, uint32_t* out)
+{
+  __m256d const startFirst = _mm256_set1_pd(f.startTimeFirst);
+  __m256d const startSecond = _mm256_set1_pd(f.startTimeSecond);
+  __m256d const endFirst = _mm256_set1_pd(f.endTimeFirst);
+  __m256d const endSecond = _mm256_set1_pd(f.endTimeSecond);
+  __m256d const now = _mm256_set1_pd(f.now);
+  __m256d const window = _mm256_set1_pd(f.window);
+  __m256i const other = _mm256_set1_epi64x(static_cast<int64_t>(f.other));
+
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d s = _mm256_loadu_pd(startTimes + i);
+    __m256d e = _mm256_loadu_pd(endTimes + i);
+    __m256d pass = _mm256_and_pd(
+      _mm256_and_pd(_mm256_cmp_pd(s, startFirst, _CMP_GE_OQ),
+                    _mm256_cmp_pd(s, startSecond, _CMP_LE_OQ)),
+      _mm256_and_pd(_mm256_cmp_pd(e, endFirst, _CMP_GE_OQ),
+                    _mm256_cmp_pd(e, endSecond, _CMP_LE_OQ)));
+    pass = _mm256_and_pd(pass, 
+      _mm256_cmp_pd(_mm256_sub_pd(now, s), window, _CMP_LT_OQ));
+    if (f.checkOther) {
+      __m256i o = _mm256_loadu_si256(
+        reinterpret_cast<__m256i const*>(others + i));
+      pass = _mm256_and_pd(pass, 
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(o, other)));
+    }
+
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(pass));
+    while (mask) {
+      out[count++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  size_t tail = filterScalar(f, startTimes + i, endTimes + i, others + i,
+                             n - i, out + count);
+  for (size_t j = count; j < count + tail; j++) {
+    out[j] += static_cast<uint32_t>(i);
+  }
+  return count + tail;
+}
+
+#endif
+
+inline size_t filter(EdgeFilter const& f, double const* startTimes,
+                     double const* endTimes, uint64_t const* others,
+                     size_t n, uint32_t* out)
+{
+#if SAM_HAS_AVX2_KERNELS
+  if (cpuHasAvx2()) {
+    return filterAvx2(f, startTimes, endTimes, others, n, out);
+  }
+#endif
+  return filterScalar(f, startTimes, endTimes, others, n, out);
+}
+
+} // end namespace ring_detail
+
+/**
+ * The time-ordered edges of a single vertex in the CompressedSparse graph.
+ *
+ * The ring keeps parallel circular arrays.  Three are the columns that
+ * are scanned when looking for edges: start time, end time, and the hash
+ * of the other endpoint.  findMatches filters them a block at a time with
+ * vectorized compares.  The last is the tuple arena that holds the full
+ * edges; a slot in the arena is only touched when the columns at the same
+ * offset match.  Edges are appended at the tail and expire from the head,
+ * so removing expired edges is a head-pointer bump.
+ *
+ * The ring is sorted by start time, which makes it a temporal index:
+ * findMatches binary searches for the first edge that can start in the
+ * requested range and stops at the first one that starts after it.  Edges
+ * mostly arrive in time order.  The few that arrive earlier than the
+ * newest edge go to a small unsorted late buffer that is scanned in full,
+ * and that is merged into the ring when it fills up.  Lookups are then
+ * O(log d + matches + LATE_CAPACITY) for a vertex with d edges.
+ */
+template <typename EdgeType, size_t time, size_t duration>
+class EdgeRing
+{
+public:
+  /**
+   * The hot part of an edge that is looked at for every candidate.  Stored
+   * as columns; record(i) gathers one.
+   */
+  struct Record {
+    double startTime; ///> Start time of the edge
+    double endTime; ///> Start time plus duration of the edge
+    uint64_t other; ///> Hash of the endpoint that isn't the ring's vertex
+  };
+
+  /// How many out-of-order edges are buffered before they are merged.
+  static size_t const LATE_CAPACITY = 16;
+
+private:
+  /**
+   * Edges that arrived with a start time earlier than the newest edge in
+   * the ring, in arrival order.  Allocated on the first late arrival and
+   * freed when it empties.
+   */
+  struct LateBuffer {
+    double startTimes[LATE_CAPACITY];
+    double endTimes[LATE_CAPACITY];
+    uint64_t others[LATE_CAPACITY];
+    EdgeType edges[LATE_CAPACITY];
+    size_t size = 0;
+  };
+
+  size_t head = 0; ///> Offset of the oldest edge
+  size_t numEdges = 0; ///> How many edges are in the ring (not late)
+  size_t mask; ///> capacity - 1, capacity is always a power of two
+
+  double* startTimes; ///> Start time of each edge, indexed like edges
+  double* endTimes; ///> Start time plus duration of each edge
+  uint64_t* others; ///> Hash of the other endpoint of each edge
+  EdgeType* edges; ///> The tuple arena
+
+  LateBuffer* late = nullptr; ///> Out-of-order edges, or null if none
+
+  /// How many offsets findMatches filters at a time.
+  static size_t const FILTER_BLOCK = 64;
+
+  /// Physical offset of the ith oldest edge in the ring.
+  size_t offset(size_t i) const { return (head + i) & mask; }
+
+  /**
+   * Doubles the capacity of the ring, copying the edges so that the head
+   * is at offset zero.
+   */
+  void grow();
+
+  /**
+   * Index of the first edge in the ring whose start time is >= t (or
+   * > t if strict), numEdges if there is none.
+   */
+  size_t lowerBound(double t, bool strict) const;
+
+  /**
+   * Merges the late buffer into the ring, keeping the ring sorted, and
+   * frees the buffer.  Only the edges newer than the oldest late edge move.
+   */
+  void mergeLate();
+
+  /**
+   * Filters the edges with indices [begin, end) in the ring, calling f on
+   * the ones that pass.
+   */
+  template <typename F>
+  size_t filterRange(EdgeFilter const& filter, size_t begin, size_t end,
+                     F& f) const;
+
+public:
+  /**
+   * \param initialCapacity How many edges the ring can hold before it
+   *   grows.  Rounded up to a power of two.
+   */
+  EdgeRing(size_t initialCapacity = 4);
+
+  ~EdgeRing();
+
+  EdgeRing(EdgeRing const&) = delete;
+  EdgeRing& operator=(EdgeRing const&) = delete;
+
+  /**
+   * Adds the edge.  It is appended at the tail of the ring unless it
+   * starts before the newest edge, in which case it is buffered as late.
+   * \param edge The edge to add.
+   * \param other Hash of the endpoint that isn't the ring's vertex.
+   */
+  void push_back(EdgeType const& edge, uint64_t other);
+
+  /**
+   * Removes edges that are older than currentTime - window.
+   * \return Returns the number of edges removed.
+   */
+  size_t expire(double currentTime, double window);
+
+  /// The number of edges, including late ones.
+  size_t size() const { return numEdges + numLate(); }
+
+  /// True if there are no edges.
+  bool empty() const { return size() == 0; }
+
+  /// How many edges are waiting in the late buffer.
+  size_t numLate() const { return late ? late->size : 0; }
+
+  /// How many edges can be stored in the ring before it grows.
+  size_t capacity() const { return mask + 1; }
+
+  /**
+   * The bytes allocated for the ring: the ring itself, its arrays, and
+   * the late buffer.  Doesn't count memory owned by the tuples (e.g.
+   * strings).
+   */
+  size_t bytes() const {
+    return sizeof(EdgeRing) + capacity() * 
+      (2 * sizeof(double) + sizeof(uint64_t) + sizeof(EdgeType)) +
+      (late ? sizeof(LateBuffer) : 0);
+  }
+
+  /**
+   * The ith record.  The first numEdges are the ring in time order, the
+   * rest are the late edges.
+   */
+  Record record(size_t i) const {
+    if (i >= numEdges) {
+      size_t j = i - numEdges;
+      return Record{late->startTimes[j], late->endTimes[j], late->others[j]};
+    }
+    size_t j = offset(i);
+    return Record{startTimes[j], endTimes[j], others[j]};
+  }
+
+  /**
+   * Calls f on each edge that passes the filter: first the matches in
+   * the ring, oldest first, then the late matches.  Edges are assumed to
+   * have non-negative durations, so no edge that starts after
+   * min(startTimeSecond, endTimeSecond) is looked at.
+   * \return Returns the number of edges that passed.
+   */
+  template <typename F>
+  size_t findMatches(EdgeFilter const& filter, F&& f) const;
+
+  /// The ith edge, in the same order as record(i).
+  EdgeType const& edge(size_t i) const {
+    return i >= numEdges ? late->edges[i - numEdges] : edges[offset(i)];
+  }
+};
+
+template <typename EdgeType, size_t time, size_t duration>
+size_t const EdgeRing<EdgeType, time, duration>::LATE_CAPACITY;
+
+template <typename EdgeType, size_t time, size_t duration>
+size_t const EdgeRing<EdgeType, time, duration>::FILTER_BLOCK;
+
+template <typename EdgeType, size_t time, size_t duration>
+EdgeRing<EdgeType, time, duration>::EdgeRing(size_t initialCapacity)
+{
+  size_t cap = 1;
+  while (cap < initialCapacity) cap <<= 1;
+  mask = cap - 1;
+  startTimes = new double[cap];
+  endTimes = new double[cap];
+  others = new uint64_t[cap];
+  edges = new EdgeType[cap];
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+EdgeRing<EdgeType, time, duration>::~EdgeRing()
+{
+  delete[] startTimes;
+  delete[] endTimes;
+  delete[] others;
+  delete[] edges;
+  delete late;
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+void
+EdgeRing<EdgeType, time, duration>::grow()
+{
+  size_t oldCapacity = mask + 1;
+  size_t newCapacity = oldCapacity << 1;
+  double* newStartTimes = new double[newCapacity];
+  double* newEndTimes = new double[newCapacity];
+  uint64_t* newOthers = new uint64_t[newCapacity];
+  EdgeType* newEdges = new EdgeType[newCapacity];
+  for (size_t i = 0; i < numEdges; i++) {
+    size_t j = offset(i);
+    newStartTimes[i] = startTimes[j];
+    newEndTimes[i] = endTimes[j];
+    newOthers[i] = others[j];
+    newEdges[i] = std::move(edges[j]);
+  }
+  delete[] startTimes;
+  delete[] endTimes;
+  delete[] others;
+  delete[] edges;
+  startTimes = newStartTimes;
+  endTimes = newEndTimes;
+  others = newOthers;
+  edges = newEdges;
+  head = 0;
+  mask = newCapacity - 1;
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+size_t
+EdgeRing<EdgeType, time, duration>::lowerBound(double t, bool strict) const
+{
+  size_t first = 0;
+  size_t count = numEdges;
+  while (count > 0) {
+    size_t step = count / 2;
+    double s = startTimes[offset(first + step)];
+    if (strict ? s <= t : s < t) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  return first;
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+void
+EdgeRing<EdgeType, time, duration>::mergeLate()
+{
+  size_t numLateEdges = late->size;
+
+  // Sort the late edges by start time.  There are only a few of them.
+  size_t order[LATE_CAPACITY];
+  for (size_t i = 0; i < numLateEdges; i++) {
+    size_t j = i;
+    while (j > 0 && 
+           late->startTimes[order[j - 1]] > late->startTimes[i]) 
+    {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  while (numEdges + numLateEdges > mask + 1) {
+    grow();
+  }
+
+  // Merge from the back, so each ring edge moves at most once and only
+  // the ones newer than the oldest late edge move at all.
+  size_t i = numEdges; // One past the next ring edge to place
+  size_t k = numEdges + numLateEdges; // One past the slot to fill
+  for (size_t l = numLateEdges; l > 0; l--) {
+    size_t j = order[l - 1];
+    while (i > 0 && startTimes[offset(i - 1)] > late->startTimes[j]) {
+      size_t from = offset(i - 1);
+      size_t to = offset(k - 1);
+      startTimes[to] = startTimes[from];
+      endTimes[to] = endTimes[from];
+      others[to] = others[from];
+      edges[to] = std::move(edges[from]);
+      i--;
+      k--;
+    }
+    size_t to = offset(k - 1);
+    startTimes[to] = late->startTimes[j];
+    endTimes[to] = late->endTimes[j];
+    others[to] = late->others[j];
+    edges[to] = std::move(late->edges[j]);
+    k--;
+  }
+  numEdges += numLateEdges;
+
+  delete late;
+  late = nullptr;
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+void
+EdgeRing<EdgeType, time, duration>::push_back(EdgeType const& edge,
+                                              uint64_t other)
+{
+  double startTime = std::get<time>(edge.tuple);
+  double endTime = startTime + std::get<duration>(edge.tuple);
+
+  if (numEdges > 0 && startTime < startTimes[offset(numEdges - 1)]) {
+    if (!late) {
+      late = new LateBuffer();
+    }
+    size_t j = late->size++;
+    late->startTimes[j] = startTime;
+    late->endTimes[j] = endTime;
+    late->others[j] = other;
+    late->edges[j] = edge;
+    if (late->size == LATE_CAPACITY) {
+      mergeLate();
+    }
+    return;
+  }
+
+  if (numEdges == mask + 1) {
+    grow();
+  }
+  size_t tail = offset(numEdges);
+  startTimes[tail] = startTime;
+  endTimes[tail] = endTime;
+  others[tail] = other;
+  edges[tail] = edge;
+  numEdges++;
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+size_t
+EdgeRing<EdgeType, time, duration>::expire(double currentTime, double window)
+{
+  size_t removed = 0;
+  while (numEdges > 0 && currentTime - startTimes[head] > window) {
+    // Release whatever the tuple holds on to (e.g. strings).
+    edges[head] = EdgeType();
+    head = (head + 1) & mask;
+    numEdges--;
+    removed++;
+  }
+
+  if (late) {
+    size_t kept = 0;
+    for (size_t j = 0; j < late->size; j++) {
+      if (currentTime - late->startTimes[j] > window) {
+        removed++;
+        continue;
+      }
+      if (kept != j) {
+        late->startTimes[kept] = late->startTimes[j];
+        late->endTimes[kept] = late->endTimes[j];
+        late->others[kept] = late->others[j];
+        late->edges[kept] = std::move(late->edges[j]);
+      }
+      kept++;
+    }
+    late->size = kept;
+    if (kept == 0) {
+      delete late;
+      late = nullptr;
+    }
+  }
+  return removed;
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+template <typename F>
+size_t
+EdgeRing<EdgeType, time, duration>::filterRange(EdgeFilter const& filter,
+                                                size_t begin, size_t end,
+                                                F& f) const
+{
+  uint32_t survivors[FILTER_BLOCK];
+  size_t numMatches = 0;
+
+  // The range is in at most two contiguous runs: up to the end of the
+  // arrays, then from the start of the arrays.
+  size_t start = offset(begin);
+  size_t firstRun = std::min(end - begin, mask + 1 - start);
+  std::pair<size_t, size_t> runs[2] = {
+    std::make_pair(start, firstRun), 
+    std::make_pair(size_t(0), end - begin - firstRun)};
+
+  for (auto const& run : runs) {
+    for (size_t done = 0; done < run.second; done += FILTER_BLOCK) {
+      size_t first = run.first + done;
+      size_t n = std::min(FILTER_BLOCK, run.second - done);
+      size_t count = ring_detail::filter(filter, startTimes + first, 
+        endTimes + first, others + first, n, survivors);
+      for (size_t k = 0; k < count; k++) {
+        f(edges[first + survivors[k]]);
+      }
+      numMatches += count;
+    }
+  }
+  return numMatches;
+}
+
+template <typename EdgeType, size_t time, size_t duration>
+template <typename F>
+size_t
+EdgeRing<EdgeType, time, duration>::findMatches(EdgeFilter const& filter,
+                                                F&& f) const
+{
+  // Only the edges starting in [startTimeFirst, last] can match.
+  double last = std::min(filter.startTimeSecond, filter.endTimeSecond);
+  size_t begin = lowerBound(filter.startTimeFirst, false);
+  size_t end = lowerBound(last, true);
+
+  size_t numMatches = 0;
+  if (begin < end) {
+    numMatches += filterRange(filter, begin, end, f);
+  }
+
+  if (late) {
+    uint32_t survivors[LATE_CAPACITY];
+    size_t count = ring_detail::filter(filter, late->startTimes,
+      late->endTimes, late->others, late->size, survivors);
+    for (size_t k = 0; k < count; k++) {
+      f(late->edges[survivors[k]]);
+    }
+    numMatches += count;
+  }
+  return numMatches;
+}
+
+} // end namespace sam
+
+#endif
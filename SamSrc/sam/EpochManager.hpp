@@ -0,0 +1,153 @@
+#ifndef SAM_EPOCH_MANAGER_HPP
+#define SAM_EPOCH_MANAGER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace sam {
+
+/**
+ * Epoch based memory reclamation for the lock-free containers (FeatureMap,
+ * StringInterner).
+ *
+ * Readers and writers wrap each operation in a Guard.  An object that has
+ * been unlinked from a container is handed to Guard::retire() and is
+ * deleted once every guard that could have seen it has exited, i.e. after
+ * the global epoch has advanced twice.
+ *
+ * Guards take one of a fixed number of participant slots for their
+ * lifetime, so a thread should not hold more than one Guard of the same
+ * manager at a time.
+ */
+class EpochManager
+{
+public:
+  static size_t const MAX_PARTICIPANTS = 64;
+  static size_t const COLLECT_THRESHOLD = 64;
+
+private:
+  struct Retired {
+    uint64_t epoch; ///> Global epoch when the object was retired
+    void* object;
+    void (*deleter)(void*);
+  };
+
+  struct Participant {
+    std::atomic<bool> claimed{false}; ///> A guard holds this slot
+    std::atomic<uint64_t> epoch{0}; ///> Epoch observed by the guard, 0 if idle
+    std::vector<Retired> retired; ///> Only touched by the guard holding it
+    char padding[64]; ///> Keeps participants off each other's cache lines
+  };
+
+  std::atomic<uint64_t> globalEpoch{1};
+  Participant participants[MAX_PARTICIPANTS];
+
+  /**
+   * Advances the global epoch if every active guard has seen the current
+   * one.
+   */
+  void tryAdvance() {
+    uint64_t global = globalEpoch.load();
+    for (size_t i = 0; i < MAX_PARTICIPANTS; i++) {
+      uint64_t epoch = participants[i].epoch.load();
+      if (epoch != 0 && epoch != global) return;
+    }
+    globalEpoch.compare_exchange_strong(global, global + 1);
+  }
+
+  /**
+   * Deletes the objects of the participant that no guard can still see.
+   */
+  void collect(Participant& participant) {
+    tryAdvance();
+    uint64_t global = globalEpoch.load();
+    auto& retired = participant.retired;
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); i++) {
+      if (retired[i].epoch + 2 <= global) {
+        retired[i].deleter(retired[i].object);
+      } else {
+        retired[kept++] = retired[i];
+      }
+    }
+    retired.resize(kept);
+  }
+
+public:
+  EpochManager() {}
+  EpochManager(EpochManager const&) = delete;
+  EpochManager& operator=(EpochManager const&) = delete;
+
+  /**
+   * No guards may be active when the manager is destroyed.
+   */
+  ~EpochManager() {
+    for (size_t i = 0; i < MAX_PARTICIPANTS; i++) {
+      for (auto& r : participants[i].retired) {
+        r.deleter(r.object);
+      }
+    }
+  }
+
+  /**
+   * Marks a critical section.  Pointers loaded from the container stay
+   * valid until the guard is destroyed.
+   */
+  class Guard
+  {
+  private:
+    EpochManager& manager;
+    Participant* participant;
+
+  public:
+    Guard(EpochManager& manager) : manager(manager)
+    {
+      size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+      participant = nullptr;
+      while (!participant) {
+        for (size_t i = 0; i < MAX_PARTICIPANTS; i++) {
+          Participant& p =
+            manager.participants[(start + i) % MAX_PARTICIPANTS];
+          bool expected = false;
+          if (!p.claimed.load() &&
+              p.claimed.compare_exchange_strong(expected, true))
+          {
+            participant = &p;
+            break;
+          }
+        }
+        if (!participant) std::this_thread::yield();
+      }
+      participant->epoch.store(manager.globalEpoch.load());
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    ~Guard() {
+      participant->epoch.store(0);
+      if (participant->retired.size() >= COLLECT_THRESHOLD) {
+        manager.collect(*participant);
+      }
+      participant->claimed.store(false);
+    }
+
+    Guard(Guard const&) = delete;
+    Guard& operator=(Guard const&) = delete;
+
+    /**
+     * Deletes the object once no guard can still be using it.  The object
+     * must already be unreachable from the container.
+     */
+    template <typename T>
+    void retire(T* object) {
+      participant->retired.push_back(Retired{manager.globalEpoch.load(),
+        object, [](void* p) { delete static_cast<T*>(p); }});
+    }
+  };
+};
+
+} // end namespace sam
+
+#endif
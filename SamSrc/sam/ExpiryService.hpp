@@ -0,0 +1,98 @@
+#ifndef SAM_EXPIRY_SERVICE_HPP
+#define SAM_EXPIRY_SERVICE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sam {
+
+class ExpiryServiceException : public std::runtime_error {
+public:
+  ExpiryServiceException(char const * message) : std::runtime_error(message) {}
+  ExpiryServiceException(std::string message) : std::runtime_error(message) {}
+};
+
+/**
+ * Expires edges in the background.  Each period, a thread calls every
+ * sweep function with sliceBins; a sweep function is expected to sweep
+ * that many bins of a graph (see CompressedSparse::expireSlice).  A pass
+ * over a graph of capacity bins is thereby spread over capacity /
+ * sliceBins periods, and no lock is held for longer than it takes to
+ * sweep one bin.
+ *
+ * Counters are kept of the slices swept and the edges removed.
+ */
+class ExpiryService
+{
+public:
+  /// Sweeps the given number of bins and returns the edges removed.
+  typedef std::function<size_t(size_t)> SweepFunction;
+
+private:
+  std::vector<SweepFunction> sweeps;
+  size_t sliceBins;
+  std::chrono::microseconds period;
+
+  std::atomic<bool> stopped;
+  std::thread sweepThread;
+
+  std::atomic<size_t> numSlices; ///> Calls made to the sweep functions
+  std::atomic<size_t> numRemoved; ///> Edges the sweeps removed
+
+  void sweepLoop() {
+    while (!stopped) {
+      for (SweepFunction const& sweep : sweeps) {
+        numRemoved.fetch_add(sweep(sliceBins));
+        numSlices.fetch_add(1);
+      }
+      std::this_thread::sleep_for(period);
+    }
+  }
+
+public:
+  /**
+   * \param sweeps The functions to call each period, one per graph.
+   * \param sliceBins How many bins each sweep function is asked to sweep.
+   * \param periodMicros How long to wait between rounds of sweeps.
+   */
+  ExpiryService(std::vector<SweepFunction> sweeps, size_t sliceBins,
+                size_t periodMicros = 1000) :
+    sweeps(sweeps), sliceBins(sliceBins), period(periodMicros),
+    stopped(false), numSlices(0), numRemoved(0)
+  {
+    if (sliceBins == 0) {
+      throw ExpiryServiceException("ExpiryService sliceBins must be > 0");
+    }
+    sweepThread = std::thread(&ExpiryService::sweepLoop, this);
+  }
+
+  ~ExpiryService() {
+    stop();
+  }
+
+  ExpiryService(ExpiryService const&) = delete;
+  ExpiryService& operator=(ExpiryService const&) = delete;
+
+  /**
+   * Stops the sweep thread after its current round.
+   */
+  void stop() {
+    stopped = true;
+    if (sweepThread.joinable()) {
+      sweepThread.join();
+    }
+  }
+
+  size_t getSliceBins() const { return sliceBins; }
+  size_t getNumSlices() const { return numSlices; }
+  size_t getNumRemoved() const { return numRemoved; }
+};
+
+} // end namespace sam
+
+#endif
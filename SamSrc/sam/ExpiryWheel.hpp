@@ -0,0 +1,191 @@
+#ifndef SAM_EXPIRY_WHEEL_HPP
+#define SAM_EXPIRY_WHEEL_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace sam {
+
+/**
+ * A timer wheel for items that expire at a known time.  Items are put in
+ * the slot that covers their expire time; each slot covers granularity
+ * units of time and there are numSlots of them.  Items that expire past
+ * the last slot wait in an overflow list and are moved into the wheel as
+ * it turns.
+ *
+ * expire(now) drops whole slots whose time range is over, so each item
+ * costs O(1) to insert and to drop.  Items in the slot that is partly over
+ * stay until the slot is dropped; callers that need exact expiry check each
+ * item as they go through them.
+ *
+ * The wheel starts at the stream time last given to expire() (or, before
+ * the first call, at the first item).  Items may arrive out of expire-time
+ * order; an item whose slot is at or before the current one goes in the
+ * current slot, so it is never dropped before the next expire() that is 
+ * past its expire time.
+ */
+template <typename T>
+class ExpiryWheel
+{
+private:
+  double granularity;
+  size_t mask; ///> numSlots - 1
+  std::vector<std::vector<T>> slots;
+
+  struct Overflow {
+    int64_t slot;
+    T item;
+  };
+  std::vector<Overflow> overflow;
+
+  ///> Number of the oldest slot that hasn't been dropped.  The wheel
+  ///> covers slots current to current + numSlots - 1.
+  int64_t current = 0;
+
+  ///> False until the first insert() or expire() sets current.
+  bool anchored = false;
+
+  size_t count = 0;
+
+  int64_t slotOf(double expireTime) const {
+    return static_cast<int64_t>(std::floor(expireTime / granularity));
+  }
+
+  bool inWheel(int64_t slot) const {
+    return slot < current + static_cast<int64_t>(slots.size());
+  }
+
+  /**
+   * Moves the overflow items that now fall in the wheel into it.  Items
+   * behind the wheel (expired) are dropped.
+   */
+  size_t redistribute() {
+    size_t dropped = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < overflow.size(); i++) {
+      if (overflow[i].slot < current) {
+        dropped++;
+      } else if (inWheel(overflow[i].slot)) {
+        slots[overflow[i].slot & mask].push_back(std::move(overflow[i].item));
+      } else {
+        if (kept != i) overflow[kept] = std::move(overflow[i]);
+        kept++;
+      }
+    }
+    overflow.erase(overflow.begin() + kept, overflow.end());
+    count -= dropped;
+    return dropped;
+  }
+
+public:
+  /**
+   * \param granularity The length of time covered by a slot.
+   * \param numSlots The number of slots, rounded up to a power of two.
+   */
+  ExpiryWheel(double granularity = 1.0, size_t numSlots = 64) :
+    granularity(granularity)
+  {
+    if (granularity <= 0) {
+      throw std::invalid_argument("ExpiryWheel granularity must be > 0");
+    }
+    size_t n = 1;
+    while (n < numSlots) n *= 2;
+    slots.resize(n);
+    mask = n - 1;
+  }
+
+  /**
+   * Adds an item that expires at expireTime.  If that is at or before the
+   * current slot, the item goes in the current slot.
+   */
+  void insert(T const& item, double expireTime) {
+    int64_t slot = slotOf(expireTime);
+    if (!anchored) {
+      current = slot;
+      anchored = true;
+    } else if (slot < current) {
+      slot = current;
+    }
+    if (inWheel(slot)) {
+      slots[slot & mask].push_back(item);
+    } else {
+      overflow.push_back(Overflow{slot, item});
+    }
+    count++;
+  }
+
+  /**
+   * Drops the slots whose whole time range is before now.
+   * \return The number of items dropped.
+   */
+  size_t expire(double now) {
+    int64_t nowSlot = slotOf(now);
+    if (!anchored || count == 0) {
+      // Nothing to drop, just follow the stream.
+      if (!anchored || nowSlot > current) current = nowSlot;
+      anchored = true;
+      return 0;
+    }
+    if (nowSlot <= current) return 0;
+
+    size_t dropped = 0;
+    if (nowSlot - current >= static_cast<int64_t>(slots.size())) {
+      // Far ahead of the wheel: everything in it is gone.
+      for (auto& slot : slots) {
+        dropped += slot.size();
+        slot.clear();
+      }
+      count -= dropped;
+      current = nowSlot;
+      return dropped + redistribute();
+    }
+
+    while (current < nowSlot) {
+      std::vector<T>& slot = slots[current & mask];
+      dropped += slot.size();
+      count -= slot.size();
+      slot.clear();
+      current++;
+      // The slot just freed now covers current + numSlots - 1.
+      if ((current & mask) == 0 && !overflow.empty()) {
+        dropped += redistribute();
+      }
+    }
+    return dropped;
+  }
+
+  /**
+   * Calls f on each item, soonest to expire first (except for the overflow
+   * items, which come last).
+   */
+  template <typename F>
+  void forEach(F&& f) const {
+    if (count == 0) return;
+    for (size_t i = 0; i < slots.size(); i++) {
+      for (T const& item : slots[(current + i) & mask]) f(item);
+    }
+    for (auto const& o : overflow) f(o.item);
+  }
+
+  template <typename F>
+  void forEach(F&& f) {
+    if (count == 0) return;
+    for (size_t i = 0; i < slots.size(); i++) {
+      for (T& item : slots[(current + i) & mask]) f(item);
+    }
+    for (auto& o : overflow) f(o.item);
+  }
+
+  size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  double getGranularity() const { return granularity; }
+};
+
+} // end namespace sam
+
+#endif
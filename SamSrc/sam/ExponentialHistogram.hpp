@@ -147,6 +147,25 @@ public:
     return numItems;
   }
 
+  /**
+   * Returns an estimate of the bytes held by this exponential histogram,
+   * including the levels.
+   */
+  size_t memoryUsage() const {
+    size_t slots = k + 2 + (numLevels - 1) * (k/2 + 2);
+    return sizeof(*this) + slots * sizeof(T) +
+           numLevels * (sizeof(T*) + sizeof(size_t) + 2 * sizeof(bool));
+  }
+
+  /**
+   * Returns an estimate of the bytes held by an exponential histogram
+   * with the given parameters without creating one.
+   */
+  static size_t memoryUsage(size_t N, size_t k) {
+    ExponentialHistogram<T> eh(N, k);
+    return eh.memoryUsage();
+  }
+
   static size_t getNumSlots(long N, int k) 
   {
     int size = 1;
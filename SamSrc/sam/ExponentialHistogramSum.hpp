@@ -6,15 +6,17 @@
  * exponential histograms.
  */
 
+#include <functional>
 #include <iostream>
-#include <map>
 
 #include <sam/AbstractConsumer.hpp>
 #include <sam/BaseComputation.hpp>
 #include <sam/ExponentialHistogram.hpp>
+#include <sam/FeatureBatch.hpp>
 #include <sam/Features.hpp>
 #include <sam/Util.hpp>
 #include <sam/FeatureProducer.hpp>
+#include <sam/KeyedState.hpp>
 #include <sam/tuples/Edge.hpp>
 
 namespace sam {
@@ -25,6 +27,10 @@ class ExponentialHistogramSum: public AbstractConsumer<EdgeType>,
                                public BaseComputation,
                                public FeatureProducer
 {
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+  typedef std::function<double(TupleType const&)> TimeFunction;
+
 private:
 
   // Determines number of buckets.  If there are k/2 + 2 buckets
@@ -36,7 +42,39 @@ private:
   size_t N; 
 
   // A mapping from keyFields to the associated exponential histogram.
-  std::map<std::string, std::shared_ptr<ExponentialHistogram<T>>> allWindows;
+  KeyedState<std::shared_ptr<ExponentialHistogram<T>>> allWindows;
+
+  // Gets the time of a tuple for evicting idle keys.
+  TimeFunction timeFunction;
+
+  /**
+   * Adds the value of the edge to the histogram of key and returns the new
+   * sum.
+   */
+  T add(EdgeType const& edge, std::string const& key)
+  {
+    this->feedCount++;
+
+    if (this->feedCount % this->metricInterval == 0) {
+      std::cout << "NodeId " << this->nodeId << " number of keys " 
+                << allWindows.size() << " keys evicted "
+                << allWindows.getKeysEvicted() << " bytes held "
+                << allWindows.getBytesHeld() << " feedCount "
+                << this->feedCount << std::endl;
+    }
+
+    // Create an exponential histogram if it doesn't exist for the given key
+    double time = timeFunction ? timeFunction(edge.tuple) : 0;
+    auto eh = allWindows.get(key, time, [this]() {
+      return std::make_shared<ExponentialHistogram<T>>(N, k);
+    });
+
+    // Update the data structure
+    T value = std::get<valueField>(edge.tuple);
+    eh->add(value);
+
+    return eh->getTotal();
+  }
 
 public:
   /**
@@ -49,14 +87,29 @@ public:
    * \param featureMap The global featureMap that holds the features produced
    *                   by this operator.
    * \param identifier A unique identifier associated with this operator.
+   * \param keyTtl Keys not seen for this long (in tuple time) are evicted.
+   *               0 means keys are never evicted for age.
+   * \param maxStateBytes Memory budget for the per-key histograms.  The
+   *               least recently used keys are evicted to stay under it.
+   *               0 means no limit.
+   * \param timeFunction Gets the time of a tuple.  Required if keyTtl > 0.
    */
   ExponentialHistogramSum(size_t N, size_t k,
                           size_t nodeId,
                           std::shared_ptr<FeatureMap> featureMap,
-                          std::string identifier) :
-                          BaseComputation(nodeId, featureMap, identifier) 
-                                          
+                          std::string identifier,
+                          double keyTtl = 0,
+                          size_t maxStateBytes = 0,
+                          TimeFunction timeFunction = TimeFunction()) :
+                          BaseComputation(nodeId, featureMap, identifier),
+                          allWindows(keyTtl, maxStateBytes,
+                            ExponentialHistogram<T>::memoryUsage(N, k)),
+                          timeFunction(timeFunction)
   {
+    if (keyTtl > 0 && !timeFunction) {
+      throw KeyedStateException("ExponentialHistogramSum: keyTtl requires "
+        "a timeFunction");
+    }
     this->N = N;
     this->k = k;
   }
@@ -67,30 +120,11 @@ public:
    */
   bool consume(EdgeType const& edge) 
   {
-    this->feedCount++;
-
-    if (this->feedCount % this->metricInterval == 0) {
-      std::cout << "NodeId " << this->nodeId << " number of keys " 
-                << allWindows.size() << " feedCount " << this->feedCount
-                << std::endl;
-    }
-
     // Generates unique key from key fields
     std::string key = generateKey<keyFields...>(edge.tuple);
 
-    // Create an exponential histogram if it doesn't exist for the given key
-    if (allWindows.count(key) == 0) {
-      auto eh = std::shared_ptr<ExponentialHistogram<T>>(
-                  new ExponentialHistogram<T>(N, k));
-      allWindows[key] = eh;
-    }
-
-    // Update the data structure
-    T value = std::get<valueField>(edge.tuple);
-    allWindows[key]->add(value);
-
     // Getting the current sum and providing that to the feature map.
-    T currentSum = allWindows[key]->getTotal();
+    T currentSum = add(edge, key);
     SingleFeature feature(currentSum);
 
     // Update the freature map with the new feature.  The feature map
@@ -104,6 +138,23 @@ public:
     return true;
   }
 
+  /**
+   * Processes the edges in order like consume(), but writes only the last
+   * sum of each key to the feature map, once the batch is done.
+   */
+  bool consumeBatch(EdgeType const* edges, size_t count)
+  {
+    FeatureBatch<SingleFeature> features;
+    for (size_t i = 0; i < count; i++) {
+      std::string key = generateKey<keyFields...>(edges[i].tuple);
+      T currentSum = add(edges[i], key);
+      this->notifySubscribers(edges[i].id, currentSum);
+      features.set(std::move(key), SingleFeature(currentSum));
+    }
+    features.flush(*this->featureMap, this->identifier);
+    return true;
+  }
+
   void terminate() {}
 
 };
@@ -116,6 +167,10 @@ class ExponentialHistogramAve: public AbstractConsumer<EdgeType>,
                                public BaseComputation,
                                public FeatureProducer
 {
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+  typedef std::function<double(TupleType const&)> TimeFunction;
+
 private:
 
   // Determines number of buckets.  If there are k/2 + 2 buckets
@@ -128,16 +183,32 @@ private:
 
   // Mapping from string key to the ExponentialHistogram representing the
   // key.
-  std::map<std::string, std::shared_ptr<ExponentialHistogram<T>>> allWindows;
+  KeyedState<std::shared_ptr<ExponentialHistogram<T>>> allWindows;
+
+  // Gets the time of a tuple for evicting idle keys.
+  TimeFunction timeFunction;
 
 public:
+  /**
+   * Constructor.  The parameters are the same as for
+   * ExponentialHistogramSum.
+   */
   ExponentialHistogramAve(size_t N, size_t k,
                           size_t nodeId,
                           std::shared_ptr<FeatureMap> featureMap,
-                          std::string identifier) :
-                          BaseComputation(nodeId, featureMap, identifier) 
-                                          
+                          std::string identifier,
+                          double keyTtl = 0,
+                          size_t maxStateBytes = 0,
+                          TimeFunction timeFunction = TimeFunction()) :
+                          BaseComputation(nodeId, featureMap, identifier),
+                          allWindows(keyTtl, maxStateBytes,
+                            ExponentialHistogram<T>::memoryUsage(N, k)),
+                          timeFunction(timeFunction)
   {
+    if (keyTtl > 0 && !timeFunction) {
+      throw KeyedStateException("ExponentialHistogramAve: keyTtl requires "
+        "a timeFunction");
+    }
     this->N = N;
     this->k = k;
   }
@@ -150,6 +221,10 @@ public:
         " NodeId " + boost::lexical_cast<std::string>(this->nodeId) + 
         " number of keys " + 
         boost::lexical_cast<std::string>(allWindows.size()) + 
+        " keys evicted " +
+        boost::lexical_cast<std::string>(allWindows.getKeysEvicted()) +
+        " bytes held " +
+        boost::lexical_cast<std::string>(allWindows.getBytesHeld()) +
         " feedCount " + boost::lexical_cast<std::string>(this->feedCount)+ "\n";
       printf("%s", message.c_str());
     }
@@ -158,25 +233,24 @@ public:
     std::string key = generateKey<keyFields...>(edge.tuple);
 
     // Create an exponential histogram if it doesn't exist for the given key
-    if (allWindows.count(key) == 0) {
-      auto eh = std::shared_ptr<ExponentialHistogram<T>>(
-                  new ExponentialHistogram<T>(N, k));
-      allWindows[key] = eh;
-    }
+    double time = timeFunction ? timeFunction(edge.tuple) : 0;
+    auto eh = allWindows.get(key, time, [this]() {
+      return std::make_shared<ExponentialHistogram<T>>(N, k);
+    });
 
     T value = std::get<valueField>(edge.tuple);
 
-    allWindows[key]->add(value);
+    eh->add(value);
 
     // Getting the current sum and providing that to the featuremap data
     // structure.
-    T currentSum = allWindows[key]->getTotal();
-    SingleFeature feature(currentSum/ allWindows[key]->getNumItems());
+    T currentSum = eh->getTotal();
+    SingleFeature feature(currentSum/ eh->getNumItems());
     this->featureMap->updateInsert(key, this->identifier, feature);
   
     // Notify any subscribers of the new value, which is a frequency.
     this->notifySubscribers(edge.id, 
-                            currentSum / allWindows[key]->getNumItems());
+                            currentSum / eh->getNumItems());
 
     return true;
   }
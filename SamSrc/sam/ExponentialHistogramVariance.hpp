@@ -7,8 +7,8 @@
  * sum of the squares.
  */
 
+#include <functional>
 #include <iostream>
-#include <map>
 
 #include <sam/AbstractConsumer.hpp>
 #include <sam/BaseComputation.hpp>
@@ -16,6 +16,7 @@
 #include <sam/Features.hpp>
 #include <sam/Util.hpp>
 #include <sam/FeatureProducer.hpp>
+#include <sam/KeyedState.hpp>
 #include <sam/tuples/Edge.hpp>
 
 namespace sam {
@@ -27,6 +28,10 @@ class ExponentialHistogramVariance :
   public BaseComputation,
   public FeatureProducer
 {
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+  typedef std::function<double(TupleType const&)> TimeFunction;
+
 private:
 
   // Determines number of buckets.  If there are k/2 + 2 buckets
@@ -37,18 +42,51 @@ private:
   // The size of the sliding window
   size_t N; 
 
-  std::map<std::string, std::shared_ptr<ExponentialHistogram<T>>> sums;
-  std::map<std::string, std::shared_ptr<ExponentialHistogram<T>>> squares;
+  // The sum of the items and the sum of the squares for one key.
+  struct SumsAndSquares {
+    ExponentialHistogram<T> sums;
+    ExponentialHistogram<T> squares;
+
+    SumsAndSquares(size_t N, size_t k) : sums(N, k), squares(N, k) {}
+  };
+
+  KeyedState<std::shared_ptr<SumsAndSquares>> allWindows;
+
+  // Gets the time of a tuple for evicting idle keys.
+  TimeFunction timeFunction;
 
 public:
+  /**
+   * Constructor.
+   * \param N The number of elements in the sliding window.
+   * \param k Determines the number of buckets.
+   * \param nodeId The nodeId of the node that is running this operator.
+   * \param featureMap The global featureMap that holds the features produced
+   *                   by this operator.
+   * \param identifier A unique identifier associated with this operator.
+   * \param keyTtl Keys not seen for this long (in tuple time) are evicted.
+   *               0 means keys are never evicted for age.
+   * \param maxStateBytes Memory budget for the per-key histograms.  0 means
+   *               no limit.
+   * \param timeFunction Gets the time of a tuple.  Required if keyTtl > 0.
+   */
   ExponentialHistogramVariance(size_t N, size_t k,
                           size_t nodeId,
                           std::shared_ptr<FeatureMap> featureMap,
-                          std::string identifier) :
+                          std::string identifier,
+                          double keyTtl = 0,
+                          size_t maxStateBytes = 0,
+                          TimeFunction timeFunction = TimeFunction()) :
                           BaseComputation(
-                            nodeId,featureMap, identifier) 
-                                          
+                            nodeId,featureMap, identifier),
+                          allWindows(keyTtl, maxStateBytes,
+                            2 * ExponentialHistogram<T>::memoryUsage(N, k)),
+                          timeFunction(timeFunction)
   {
+    if (keyTtl > 0 && !timeFunction) {
+      throw KeyedStateException("ExponentialHistogramVariance: keyTtl "
+        "requires a timeFunction");
+    }
     this->N = N;
     this->k = k;
   }
@@ -60,8 +98,13 @@ public:
       std::string message = "ExponentialHistogramVariance id " +
         this->identifier + " NodeId " +
         boost::lexical_cast<std::string>(this->nodeId) + 
-        " number of keys " + boost::lexical_cast<std::string>(sums.size())
-        + " feedCount " + boost::lexical_cast<std::string>(this->feedCount) +
+        " number of keys " +
+        boost::lexical_cast<std::string>(allWindows.size()) +
+        " keys evicted " +
+        boost::lexical_cast<std::string>(allWindows.getKeysEvicted()) +
+        " bytes held " +
+        boost::lexical_cast<std::string>(allWindows.getBytesHeld()) +
+        " feedCount " + boost::lexical_cast<std::string>(this->feedCount) +
         "\n";
         printf("%s", message.c_str());
     }
@@ -69,33 +112,24 @@ public:
     // Generates unique key from key fields
     std::string key = generateKey<keyFields...>(edge.tuple);
 
-    if (sums.count(key) == 0) {
-      auto eh = std::shared_ptr<ExponentialHistogram<T>>(
-                  new ExponentialHistogram<T>(N, k));
-      std::pair<std::string, 
-                std::shared_ptr<ExponentialHistogram<T>>> p(key, eh);
-      sums[key] = eh;
-
-      eh = std::shared_ptr<ExponentialHistogram<T>>(
-                  new ExponentialHistogram<T>(N, k));
-      p = std::pair<std::string, 
-                    std::shared_ptr<ExponentialHistogram<T>>>(key, eh);
-      squares[key] = eh;
-    }
+    double time = timeFunction ? timeFunction(edge.tuple) : 0;
+    auto window = allWindows.get(key, time, [this]() {
+      return std::make_shared<SumsAndSquares>(N, k);
+    });
 
     std::string sValue = boost::lexical_cast<std::string>(
                       std::get<valueField>(edge.tuple));
 
     T value = boost::lexical_cast<T>(sValue);
 
-    sums[key]->add(value);
-    squares[key]->add(value * value);
+    window->sums.add(value);
+    window->squares.add(value * value);
 
     // Getting the current variance and providing that to the featureMap
-    T currentSum = sums[key]->getTotal();
-    T currentSquares = squares[key]->getTotal();
+    T currentSum = window->sums.getTotal();
+    T currentSquares = window->squares.getTotal();
   
-    size_t numItems = sums[key]->getNumItems();
+    size_t numItems = window->sums.getNumItems();
     double currentVariance = calculateVariance(currentSquares, currentSum,
                                                numItems);
     SingleFeature feature(currentVariance);
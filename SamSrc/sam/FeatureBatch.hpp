@@ -0,0 +1,59 @@
+#ifndef SAM_FEATURE_BATCH_HPP
+#define SAM_FEATURE_BATCH_HPP
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sam/FeatureMap.hpp>
+
+namespace sam {
+
+/**
+ * Holds the features an operator produces while it works through a batch
+ * of edges (see AbstractConsumer::consumeBatch) so that only the last
+ * feature of each key is written to the FeatureMap, with the feature name
+ * interned once per batch.
+ */
+template <typename FeatureType>
+class FeatureBatch
+{
+private:
+  std::unordered_map<std::string, size_t> positions; ///> Key -> features
+  std::vector<std::pair<std::string, FeatureType>> features;
+
+public:
+  /**
+   * Sets the feature of the key, replacing any set earlier in the batch.
+   */
+  void set(std::string key, FeatureType const& feature) {
+    auto it = positions.find(key);
+    if (it == positions.end()) {
+      positions.emplace(key, features.size());
+      features.emplace_back(std::move(key), feature);
+    } else {
+      features[it->second].second = feature;
+    }
+  }
+
+  /**
+   * Writes the features to the map and empties the batch.
+   */
+  void flush(FeatureMap& featureMap, std::string const& featureName) {
+    if (features.empty()) return;
+    FeatureMap::IdType featureId = featureMap.getFeatureId(featureName);
+    for (auto const& p : features) {
+      featureMap.updateInsert(featureMap.getKeyId(p.first), featureId,
+                              p.second);
+    }
+    features.clear();
+    positions.clear();
+  }
+
+  size_t size() const { return features.size(); }
+};
+
+} // end namespace sam
+
+#endif
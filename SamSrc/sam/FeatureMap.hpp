@@ -3,72 +3,152 @@
 
 #include <iostream>
 #include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <sam/EpochManager.hpp>
 #include <sam/Features.hpp>
+#include <sam/StringInterner.hpp>
 #include <cstdio>
 
-#define MAP_EMPTY        0
-#define MAP_OCCUPIED     1
-#define MAP_INTERMEDIATE 2
-
 namespace sam {
 
+/**
+ * A concurrent map from (key, featureName) to a feature.
+ *
+ * Keys and feature names are interned to 32-bit ids, and the table is
+ * keyed on the pair of ids, so no combined string is built per access.
+ * Callers that look up the same key repeatedly can intern once with
+ * getKeyId()/getFeatureId() and use the id overloads.
+ *
+ * The table is open addressed with linear probing and lock-free:
+ *   - A slot is claimed by a CAS on its key and never changes key after.
+ *   - The value is a pointer to a std::shared_ptr<Feature>.  Updates copy
+ *     the feature, apply the update to the copy, and CAS the pointer, so
+ *     readers never see a feature being modified.  The replaced value is
+ *     reclaimed through the EpochManager.
+ *   - When the table is half full, a table twice the size is installed.
+ *     Writers move the old table over a chunk at a time.  A moved slot's
+ *     value is set to MOVED so writers still holding the old table retry
+ *     on the new one, and empty slots of the old table are tombstoned.
+ *     A slot that was claimed but had no value yet is sealed with
+ *     MOVED_EMPTY instead, since nothing follows it into the new table;
+ *     the writer that claimed it inserts afresh in the new one.
+ */
 class FeatureMap
 {
+public:
+  typedef StringInterner::IdType IdType;
+  typedef std::shared_ptr<Feature> FeaturePtr;
+
 private:
-  // The capacity of the parallel map.  Should be 2 * numkeys * numfeatures
-  int capacity;
+  static uint64_t const EMPTY = 0;
+  static uint64_t const TOMBSTONE = UINT64_MAX;
+
+  static size_t const MIGRATE_CHUNK = 64; ///> Slots migrated per update
+
+  struct Slot {
+    std::atomic<uint64_t> key{EMPTY}; ///> (keyId << 32) | featureId
+    std::atomic<FeaturePtr*> value{nullptr};
+  };
 
-  // An array of features as shared ptrs.
-  std::shared_ptr<Feature>* features;
+  struct Table {
+    size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> count{0}; ///> Slots claimed
+    std::atomic<Table*> older{nullptr}; ///> Table being migrated into this one
+    std::atomic<size_t> cursor{0}; ///> Next slot of this table to migrate
+    std::atomic<size_t> migrated{0}; ///> Slots of this table migrated
 
-  // The flag keeps track of if a slot is empty, occupied, or in an
-  // intermediate state.
-  std::atomic<int> volatile * flag;
+    Table(size_t capacity) : capacity(capacity), slots(new Slot[capacity]) {}
+    ~Table();
+  };
 
-  // An array of keys.  This is the combination of the key for the imux
-  // data structure and the name of the feature.
-  std::string* keys;
+  enum class ProbeResult { Found, Claimed, NotFound, Full };
+
+  StringInterner keyIds; ///> Interned keys (e.g. ip addresses)
+  StringInterner featureIds; ///> Interned feature names
+
+  std::atomic<Table*> current;
+
+  mutable EpochManager epochs;
+
+  static FeaturePtr* moved() {
+    return reinterpret_cast<FeaturePtr*>(uintptr_t(1));
+  }
+
+  static FeaturePtr* movedEmpty() {
+    return reinterpret_cast<FeaturePtr*>(uintptr_t(2));
+  }
+
+  static bool isMoved(FeaturePtr* v) {
+    return v == moved() || v == movedEmpty();
+  }
 
-public:   
   /**
-   * Capacity should be 2 * numkeys * numfeatures
+   * Seals a slot of a table being migrated: a value is replaced by MOVED,
+   * no value by MOVED_EMPTY.
+   * \return Returns what the slot held before, or MOVED/MOVED_EMPTY if it
+   *   was already sealed.
    */
-  FeatureMap(int capacity = 1000) {
-    this->capacity = capacity;  
-    features = new std::shared_ptr<Feature>[capacity];
-    flag = new std::atomic<int>[capacity];
-    keys = new std::string[capacity];
-
-    // TODO: Add parallel loop
-    for (int i = 0; i < capacity; i++) {
-      features[i] = 0;
-    }
-
-    // TODO: Add a parallel loop
-    for (int i = 0; i < capacity; i++) {
-      flag[i] = 0; 
-    }
+  static FeaturePtr* seal(std::atomic<FeaturePtr*>& value) {
+    FeaturePtr* v = value.load();
+    while (!isMoved(v) &&
+           !value.compare_exchange_strong(v, v ? moved() : movedEmpty())) {}
+    return v;
   }
 
-  ~FeatureMap() {
-    delete[] features; 
-    delete[] flag;  
-    delete[] keys;  
+  static uint64_t combine(IdType keyId, IdType featureId) {
+    return (static_cast<uint64_t>(keyId) << 32) | featureId;
   }
 
+  static size_t hashFunction(uint64_t key);
+
+  static ProbeResult probe(Table* table, uint64_t key, bool insert,
+                           size_t& index);
+  void grow(Table* table);
+  void claimed(Table* table);
+  FeaturePtr* takeFromOlder(Table* table, uint64_t key, Slot& slot);
+  void place(EpochManager::Guard& guard, uint64_t key, FeaturePtr* value);
+  void helpMigrate(EpochManager::Guard& guard, Table* table, bool all);
+
+public:
+  /**
+   * \param capacity The initial capacity.  The map grows as needed.
+   */
+  FeatureMap(int capacity = 1000);
+
+  ~FeatureMap();
+
+  FeatureMap(FeatureMap const&) = delete;
+  FeatureMap& operator=(FeatureMap const&) = delete;
+
   /**
-   * Inserts the feature to the key-featureName combo if it doesn't exist, or 
+   * Inserts the feature to the key-featureName combo if it doesn't exist, or
    * updates the feature if it does exist.
    * \param key The key identifying the entity (e.g. an IP address)
    * \param featureName The name of the feature (e.g. an operator name)
    * \param f The feature to be added.
-   * \return Returns true if the update took place.  False if there is no room
-   *         in the table.
+   * \return Returns true.  The map grows rather than running out of room.
    */
-  bool updateInsert(std::string const& key, 
-                     std::string const& featureName,  
-                     Feature const& f);
- 
+  bool updateInsert(std::string const& key,
+                    std::string const& featureName,
+                    Feature const& f);
+
+  bool updateInsert(IdType keyId, IdType featureId, Feature const& f);
+
+  /**
+   * Looks up the key/featureName combo with a single probe.
+   * \return Returns a handle to the feature, or an empty pointer if the
+   *   combo doesn't exist.  The handle stays valid after later updates,
+   *   which replace the feature rather than modify it.
+   */
+  std::shared_ptr<Feature const> find(std::string const& key,
+                                      std::string const& featureName) const;
+
+  std::shared_ptr<Feature const> find(IdType keyId, IdType featureId) const;
+
   /**
    * Gets a constant shared pointer to the feature found in the map with
    * the given key/featureName combo.
@@ -77,144 +157,330 @@ public:
    * \return Returns the feature if it exists.  Exception thrown if it doesn't.
    */
   std::shared_ptr<const Feature> at(std::string const& key,
-                               std::string const& featureName) const; 
+                               std::string const& featureName) const;
 
   /**
-   * Checks if the key/featureName combo exists.
-   */ 
+   * Checks if the key/featureName combo exists.  Prefer find() when the
+   * feature is used afterward.
+   */
   bool exists(std::string const& key,
-              std::string const& featureName) const; 
+              std::string const& featureName) const;
 
-private:
   /**
-   * The hash function used to hash the key-featureName combo.
-   * \param key The combined key-featureName combo.
-   * \returns Returns the int hash.
+   * Returns the id of the key, interning it if needed.
    */
-  unsigned int hashFunction(std::string const& key) const;
+  IdType getKeyId(std::string const& key) { return keyIds.intern(key); }
 
+  /**
+   * Returns the id of the feature name, interning it if needed.
+   */
+  IdType getFeatureId(std::string const& featureName) {
+    return featureIds.intern(featureName);
+  }
 };
 
 inline
-unsigned int FeatureMap::hashFunction(std::string const& key) const
+FeatureMap::Table::~Table()
 {
-  unsigned int hash = 0;
-  
-  for (int i = 0; i < key.size(); i++) {
-    hash = key[i] + (hash << 6) + (hash << 16) - hash;
+  for (size_t i = 0; i < capacity; i++) {
+    FeaturePtr* value = slots[i].value.load();
+    if (value && !isMoved(value)) delete value;
   }
+}
 
-  return hash;
+inline
+FeatureMap::FeatureMap(int capacity)
+{
+  size_t c = 16;
+  while (c < static_cast<size_t>(std::max(capacity, 0))) c *= 2;
+  current = new Table(c);
 }
 
 inline
-bool FeatureMap::exists(std::string const& key,
-                        std::string const& featureName) const
+FeatureMap::~FeatureMap()
 {
-  std::string combinedKey = key + featureName;
-  unsigned int hash = hashFunction(combinedKey);
-  int i = hash % capacity;
-  int index = i;
-  do
-  {
-    if (flag[i] == MAP_OCCUPIED) {
-      if (keys[i].compare(combinedKey) == 0)
-      {
-        return true;
+  Table* table = current.load();
+  while (table) {
+    Table* older = table->older.load();
+    delete table;
+    table = older;
+  }
+}
+
+inline
+size_t FeatureMap::hashFunction(uint64_t key)
+{
+  // Finalizer of splitmix64
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
+}
+
+/**
+ * Looks for the key in the table.  With insert, the first empty slot on
+ * the probe sequence is claimed for the key if it isn't there.
+ * \param index Set to the slot found or claimed.
+ */
+inline
+FeatureMap::ProbeResult
+FeatureMap::probe(Table* table, uint64_t key, bool insert, size_t& index)
+{
+  size_t mask = table->capacity - 1;
+  size_t hash = hashFunction(key);
+  for (size_t n = 0; n < table->capacity; n++) {
+    size_t i = (hash + n) & mask;
+    uint64_t slotKey = table->slots[i].key.load();
+    if (slotKey == EMPTY) {
+      if (!insert) return ProbeResult::NotFound;
+      if (table->slots[i].key.compare_exchange_strong(slotKey, key)) {
+        index = i;
+        return ProbeResult::Claimed;
       }
+      // slotKey now holds the key that beat us
     }
+    if (slotKey == key) {
+      index = i;
+      return ProbeResult::Found;
+    }
+  }
+  return ProbeResult::Full;
+}
 
-    i = (i + 1) % capacity;
-  } while (i != index && flag[i] != MAP_EMPTY);
-  return false;
+/**
+ * Installs a table twice the size that migrates from this one, unless
+ * this one is no longer the newest or is still migrating itself.
+ */
+inline
+void FeatureMap::grow(Table* table)
+{
+  if (table->older.load() || current.load() != table) return;
+  Table* bigger = new Table(table->capacity * 2);
+  bigger->older = table;
+  if (!current.compare_exchange_strong(table, bigger)) {
+    delete bigger;
+  }
+}
 
+/**
+ * Counts a claimed slot and grows the table if it is half full.
+ */
+inline
+void FeatureMap::claimed(Table* table)
+{
+  size_t count = table->count.fetch_add(1) + 1;
+  if (count * 2 > table->capacity) grow(table);
 }
 
+/**
+ * Takes the value of the key out of the older tables, leaving MOVED behind.
+ * If another thread is already moving it, waits until it lands in slot.
+ * A slot sealed before its value was stored (MOVED_EMPTY) has nothing to
+ * wait for.
+ * \return Returns the value taken, or nullptr if there was none or another
+ *   thread moved it.
+ */
 inline
-std::shared_ptr<Feature const> FeatureMap::at(std::string const& key, 
-                                          std::string const& featureName) const
+FeatureMap::FeaturePtr*
+FeatureMap::takeFromOlder(Table* table, uint64_t key, Slot& slot)
 {
-  std::string combinedKey = key + featureName;
-  unsigned int hash = hashFunction(combinedKey);
-  int i = hash % capacity;
-  int index = i;
-  do
+  for (Table* older = table->older.load(); older;
+       older = older->older.load())
   {
-    if (flag[i] != MAP_EMPTY) {
-      if (keys[i].compare(combinedKey) == 0)
+    size_t index;
+    if (probe(older, key, false, index) != ProbeResult::Found) continue;
+    FeaturePtr* v = seal(older->slots[index].value);
+    if (v == movedEmpty()) continue;
+    if (v != moved()) return v;
+    while (!slot.value.load()) std::this_thread::yield();
+    return nullptr;
+  }
+  return nullptr;
+}
+
+/**
+ * Puts a value taken out of an older table into the newest table.  If the
+ * key already has a value there, that one is newer, so it is applied on
+ * top of the value being placed.
+ */
+inline
+void FeatureMap::place(EpochManager::Guard& guard, uint64_t key,
+                       FeaturePtr* value)
+{
+  while (true) {
+    Table* table = current.load();
+    size_t index;
+    ProbeResult result = probe(table, key, true, index);
+    if (result == ProbeResult::Full) {
+      helpMigrate(guard, table, true);
+      grow(table);
+      continue;
+    }
+    if (result == ProbeResult::Claimed) claimed(table);
+
+    Slot& slot = table->slots[index];
+    FeaturePtr* v = nullptr;
+    if (slot.value.compare_exchange_strong(v, value)) return;
+    while (!isMoved(v)) {
+      FeaturePtr* combined = new FeaturePtr((*value)->createCopy());
+      (*combined)->update(**v);
+      if (slot.value.compare_exchange_strong(v, combined)) {
+        guard.retire(v);
+        guard.retire(value);
+        return;
+      }
+      delete combined;
+    }
+  }
+}
+
+/**
+ * Moves one chunk (or, with all, every remaining slot) of the older table
+ * into this one.
+ */
+inline
+void FeatureMap::helpMigrate(EpochManager::Guard& guard, Table* table,
+                             bool all)
+{
+  Table* older = table->older.load();
+  if (!older) return;
+  do {
+    size_t start = older->cursor.fetch_add(MIGRATE_CHUNK);
+    if (start >= older->capacity) break;
+    size_t end = std::min(start + MIGRATE_CHUNK, older->capacity);
+    for (size_t i = start; i < end; i++) {
+      Slot& oldSlot = older->slots[i];
+      uint64_t key = oldSlot.key.load();
+      if (key == EMPTY &&
+          oldSlot.key.compare_exchange_strong(key, TOMBSTONE))
       {
-        return std::static_pointer_cast<Feature const>( features[i] );
+        continue;
       }
+      FeaturePtr* v = seal(oldSlot.value);
+      if (v && !isMoved(v)) place(guard, key, v);
+    }
+    if (older->migrated.fetch_add(end - start) + (end - start) ==
+        older->capacity)
+    {
+      table->older = nullptr;
+      guard.retire(older);
+      return;
     }
+  } while (all);
 
-    i = (i + 1) % capacity;
-  } while (i != index && flag[i] != MAP_EMPTY);
-  throw std::out_of_range("No value found for key " + key + ":" + 
-                          featureName + "\n");
-                          
+  // Another thread has the last chunks; wait for it when asked for all.
+  while (all && table->older.load() == older) std::this_thread::yield();
 }
 
 inline
-bool FeatureMap::updateInsert(std::string const& key, 
-                               std::string const& featureName,  
-                               Feature const& f) 
+bool FeatureMap::updateInsert(std::string const& key,
+                              std::string const& featureName,
+                              Feature const& f)
 {
-  std::string combinedKey = key + featureName;
-  unsigned int hash = hashFunction(combinedKey);
-  //std::cout << "hash " << hash << std::endl;
-  //std::cout << "capacity " << capacity << std::endl;
-  int i = hash % capacity;
-  //std::cout << "i " << i << std::endl;
-  int index = i;
-  //std::cout << "updateInsert " << key << std::endl;
-  do
-  {
-    if (flag[i] == MAP_EMPTY ||
-        flag[i] == MAP_INTERMEDIATE)
-    {
-      //std::cout << "firstif " << key << std::endl;
-      do
-      {
-        int expected = MAP_EMPTY;
-        bool b = std::atomic_compare_exchange_strong(&flag[i], &expected,
-                                            MAP_INTERMEDIATE);
-        if (b) {
-          //std::cout << "secondif " << key << std::endl;
-          //std::cout << "i " << i << std::endl;
-          features[i] = f.createCopy(); 
-          //std::cout << "blah" << std::endl;
-          keys[i] = combinedKey;
-          //std::cout << "blah1" << std::endl;
-          flag[i] = MAP_OCCUPIED;
-          //std::cout << "blah2" << std::endl;
-          return true;
-        }
-
-      } while (flag[i] != MAP_OCCUPIED);
+  return updateInsert(keyIds.intern(key), featureIds.intern(featureName), f);
+}
+
+inline
+bool FeatureMap::updateInsert(IdType keyId, IdType featureId,
+                              Feature const& f)
+{
+  uint64_t key = combine(keyId, featureId);
+  EpochManager::Guard guard(epochs);
+  while (true) {
+    Table* table = current.load();
+    helpMigrate(guard, table, false);
+
+    size_t index;
+    ProbeResult result = probe(table, key, true, index);
+    if (result == ProbeResult::Full) {
+      // Either the table was replaced while we held it or it filled faster
+      // than it migrated.
+      helpMigrate(guard, current.load(), true);
+      grow(table);
+      continue;
     }
+    if (result == ProbeResult::Claimed) claimed(table);
 
-    if (flag[i] == MAP_OCCUPIED && 
-        (combinedKey.compare(keys[i]) == 0))
-    {
-      bool b;
-      do
-      {
-        int expected = MAP_OCCUPIED;
-        b = std::atomic_compare_exchange_strong(&flag[i], &expected,
-                                                   MAP_INTERMEDIATE);
-      } while (!b);
-
-      features[i]->update(f);
-      flag[i] = MAP_OCCUPIED;
-      return true;
+    Slot& slot = table->slots[index];
+    FeaturePtr* v = slot.value.load();
+    if (!v) {
+      // New to this table, but it may still have a value in the older one.
+      FeaturePtr* old = takeFromOlder(table, key, slot);
+      if (old) {
+        place(guard, key, old);
+        continue;
+      }
+      FeaturePtr* fresh = new FeaturePtr(f.createCopy());
+      if (slot.value.compare_exchange_strong(v, fresh)) return true;
+      delete fresh;
+    }
+
+    // Copy on write so readers never see a feature mid update.
+    while (!isMoved(v)) {
+      FeaturePtr* updated = new FeaturePtr((*v)->createCopy());
+      (*updated)->update(f);
+      if (slot.value.compare_exchange_strong(v, updated)) {
+        guard.retire(v);
+        return true;
+      }
+      delete updated;
+    }
+  }
+}
+
+inline
+std::shared_ptr<Feature const> FeatureMap::find(IdType keyId,
+                                                IdType featureId) const
+{
+  uint64_t key = combine(keyId, featureId);
+  EpochManager::Guard guard(epochs);
+  Table* table = current.load();
+  while (table) {
+    size_t index;
+    if (probe(table, key, false, index) == ProbeResult::Found) {
+      FeaturePtr* v = table->slots[index].value.load();
+      if (isMoved(v)) {
+        // Moved to a newer table since we started.
+        table = current.load();
+        continue;
+      }
+      if (v) return std::static_pointer_cast<Feature const>(*v);
     }
+    table = table->older.load();
+  }
+  return std::shared_ptr<Feature const>();
+}
 
-    i = (i + 1) % capacity;
-  } while (i != index);
-    
-  return false;
+inline
+std::shared_ptr<Feature const>
+FeatureMap::find(std::string const& key, std::string const& featureName) const
+{
+  IdType keyId = keyIds.find(key);
+  if (keyId == StringInterner::NO_ID) return std::shared_ptr<Feature const>();
+  IdType featureId = featureIds.find(featureName);
+  if (featureId == StringInterner::NO_ID) {
+    return std::shared_ptr<Feature const>();
+  }
+  return find(keyId, featureId);
+}
+
+inline
+bool FeatureMap::exists(std::string const& key,
+                        std::string const& featureName) const
+{
+  return static_cast<bool>(find(key, featureName));
 }
 
+inline
+std::shared_ptr<Feature const> FeatureMap::at(std::string const& key,
+                                          std::string const& featureName) const
+{
+  auto feature = find(key, featureName);
+  if (!feature) {
+    throw std::out_of_range("No value found for key " + key + ":" +
+                            featureName + "\n");
+  }
+  return feature;
+}
 
 }
 
@@ -145,12 +145,19 @@ bool FeatureSubscriber::update(std::size_t key,
   //std::lock_guard<std::mutex> lock(mu);
   if (initCalled) {
     int index = key % capacity;
-    int featureIndex = featureIndices[featureName];
+    // find() rather than [], since feature producers on different threads
+    // call update at the same time.
+    auto it = featureIndices.find(featureName);
+    if (it == featureIndices.end()) {
+      throw std::logic_error("update was called with a feature that was not"
+        " added: " + featureName);
+    }
+    int featureIndex = it->second;
     values[index * numFeatures + featureIndex] = value;
-    counts[index].fetch_add(1);
 
-    if (counts[index] >= numFeatures) {
-      // counts[indes] >= numFeatures indicates that we have collected
+    // Only the update that brings the count to numFeatures writes the row.
+    if (counts[index].fetch_add(1) + 1 == numFeatures) {
+      // counts[index] reaching numFeatures indicates that we have collected
       // all of the features associated with the input item (i.e. netflow
       // or whatever tuple).
 
@@ -1,7 +1,9 @@
 #ifndef FEATURES_HPP
 #define FEATURES_HPP
 
+#include <algorithm>
 #include <exception>
+#include <memory>
 #include <boost/lexical_cast.hpp>
 #include <vector>
 
@@ -296,6 +298,74 @@ public:
 };
 
 
+/**
+ * A feature that summarizes a distribution, produced by Quantile.  It holds
+ * the items of a quantile sketch sorted with their cumulative ranks, so any
+ * quantile can be asked for with
+ *   feature->evaluate<double>([](Feature const* f) {
+ *     return static_cast<QuantileFeature const*>(f)->getQuantile(0.9); });
+ * getValue() returns the quantile the producer was configured with (the
+ * median by default).  The summary is shared between copies and never
+ * changed once made.
+ */
+class QuantileFeature: public Feature
+{
+public:
+  struct Summary {
+    std::vector<double> values; ///> Sorted values
+    std::vector<double> ranks; ///> Fraction of the items <= values[i]
+  };
+
+private:
+  std::shared_ptr<Summary const> summary;
+
+public:
+  QuantileFeature(std::shared_ptr<Summary const> summary, double q = 0.5) :
+    summary(summary)
+  {
+    value = getQuantile(q);
+  }
+
+  /**
+   * Returns the smallest value whose rank is at least q, or 0 if the
+   * summary is empty.
+   */
+  double getQuantile(double q) const {
+    if (!summary || summary->values.empty()) return 0;
+    auto it = std::lower_bound(summary->ranks.begin(), summary->ranks.end(),
+                               q);
+    if (it == summary->ranks.end()) return summary->values.back();
+    return summary->values[it - summary->ranks.begin()];
+  }
+
+  std::shared_ptr<Summary const> getSummary() const { return summary; }
+
+  void update(Feature const& feature) {
+    summary = static_cast<QuantileFeature const&>(feature).summary;
+    value = static_cast<QuantileFeature const&>(feature).value;
+  }
+
+  std::shared_ptr<Feature> createCopy() const {
+    std::shared_ptr<Feature> copy(new QuantileFeature(*this));
+    return copy;
+  }
+
+  bool operator==(Feature const& other) const {
+    if (QuantileFeature const* f =
+        dynamic_cast<QuantileFeature const*>(&other))
+    {
+      return f->value == value && f->summary == summary;
+    }
+    return false;
+  }
+
+  std::string toString() const {
+    std::string rString = "QuantileFeature " +
+      boost::lexical_cast<std::string>(value);
+    return rString;
+  }
+};
+
 
 }
 
@@ -2,10 +2,12 @@
 #define FILTER_HPP
 
 #include <string>
+#include <vector>
 #include <sam/Expression.hpp>
 #include <sam/AbstractConsumer.hpp>
 #include <sam/BaseComputation.hpp>
 #include <sam/BaseProducer.hpp>
+#include <sam/FeatureBatch.hpp>
 
 using std::string;
 
@@ -33,6 +35,12 @@ public:
 
   bool consume(EdgeType const& edge);
 
+  /**
+   * Evaluates the expression on each edge, writes the features of the batch
+   * to the feature map at once, and then feeds the edges on under one lock.
+   */
+  bool consumeBatch(EdgeType const* edges, size_t count);
+
   void terminate();
 
 };
@@ -61,11 +69,37 @@ bool Filter<EdgeType, keyFields...>::consume(EdgeType const& edge)
 }
 
 template <typename EdgeType, size_t... keyFields>
-void Filter<EdgeType, keyFields...>::terminate()
+bool Filter<EdgeType, keyFields...>::consumeBatch(EdgeType const* edges,
+                                                  size_t count) 
 {
-  for (auto consumer : this->consumers) {
-    consumer->terminate();
+  FeatureBatch<BooleanFeature> features;
+  std::vector<bool> results(count, false);
+  for (size_t i = 0; i < count; i++) {
+    string key = generateKey<keyFields...>(edges[i].tuple);
+    double result = 0;
+    if (expression->evaluate(key, edges[i].tuple, result)) {
+      features.set(std::move(key), BooleanFeature(result));
+      results[i] = result;
+    }
   }
+  features.flush(*this->featureMap, this->identifier);
+
+  // Same output as consume() for each edge.
+  auto lock = this->feedLock();
+  for (size_t i = 0; i < count; i++) {
+    if (results[i]) {
+      this->feedLocked(edges[i]);
+    }
+    this->feedLocked(edges[i]);
+  }
+
+  return true;
+}
+
+template <typename EdgeType, size_t... keyFields>
+void Filter<EdgeType, keyFields...>::terminate()
+{
+  this->terminateConsumers();
 }
 
 
@@ -14,20 +14,29 @@
 #include <sam/AbstractConsumer.hpp>
 #include <sam/CompressedSparse.hpp>
 #include <sam/SubgraphQuery.hpp>
+#include <sam/QueryTrie.hpp>
 #include <sam/SubgraphQueryResultMap.hpp>
 #include <sam/EdgeRequestMap.hpp>
 #include <sam/ZeroMQUtil.hpp>
+#include <sam/EdgeCodec.hpp>
 #include <sam/FeatureMap.hpp>
 #include <sam/AbstractSubgraphPrinter.hpp>
+#include <sam/SpscQueue.hpp>
+#include <sam/Backoff.hpp>
+#include <sam/IngestQueue.hpp>
+#include <sam/ExpiryService.hpp>
+#include <sam/RoutingTable.hpp>
 #include <zmq.hpp>
 #include <thread>
 #include <cstdlib>
-#include <future>
+#include <map>
+#include <memory>
 
 namespace sam {
 
 #define MAX_NUM_FUTURES 1028
 #define TOLERANCE 1.0 
+#define CONSUME_QUEUE_LENGTH 1024
 
 class GraphStoreException : public std::runtime_error {
 public:
@@ -135,6 +144,29 @@ private:
   PushPull* edgeCommunicator;
   PushPull* requestCommunicator;
 
+  /// If not null, the pull threads of the edge and request communicators
+  /// push what they receive here, and the drain threads of the queues do
+  /// the processing (handleEdges and handleRequests).
+  std::unique_ptr<IngestQueue<EdgeType>> edgeIngest;
+  std::unique_ptr<IngestQueue<EdgeRequestType>> requestIngest;
+
+  /// If not null, sweeps expired edges out of the csr and csc in the
+  /// background (see startExpiry).
+  std::unique_ptr<ExpiryService> expiryService;
+
+  /**
+   * Processes edges that other nodes sent in answer to our edge requests:
+   * checks them against the partial results and sends out the edge 
+   * requests that come of it.
+   */
+  void handleEdges(EdgeType const* edges, size_t count);
+
+  /**
+   * Processes edge requests from other nodes: keeps them for future edges
+   * and answers them with the edges we already have.
+   */
+  void handleRequests(EdgeRequestType const* requests, size_t count);
+
   /// Flag indicating terminate was called.
   std::atomic<bool> terminated; 
   
@@ -145,30 +177,104 @@ private:
   /// This is the count of how many edges we failed to send from this class
   /// and not from the EdgeRequestMap.
   std::atomic<size_t> edgePushFails; 
+
+  #ifdef METRICS
+  /// How many edge requests processEdgeRequests didn't send because they
+  /// were coalesced with another request for the same source/target.
+  std::atomic<size_t> edgeRequestsSuppressedCounter;
+  #endif
   
   size_t numNodes; ///> How many total nodes there are
   size_t nodeId; ///> The node id of this node
 
+  /// Says which nodes get the edges of a vertex and keeps the per-node
+  /// load gauges used to place edge requests.
+  std::shared_ptr<RoutingTable> routingTable;
+
   std::shared_ptr<csrType> csr; ///> Compressed Sparse Row graph
   std::shared_ptr<cscType> csc; ///> Compressed Sparse column graph
+
+  double timeWindow; ///> How long edges are kept
   std::vector<std::shared_ptr<QueryType>> queries; ///> The list of queries.
+
+  /// The queries merged by shared prefix.  checkSubgraphQueries starts
+  /// one result per root, which stands in for all the queries of the root
+  /// until they diverge.
+  QueryTrie<QueryType> queryTrie;
   
   /// Keeps track of how many consume threads are active.
   std::atomic<size_t> consumeThreadsActive; 
-  
-  size_t currentFuture = 0;
-  std::future<bool> futures[MAX_NUM_FUTURES];
 
-  bool cycled = false;
+  /// How many worker threads consume edges.  If zero, consume() does the
+  /// work on the caller's thread.
+  size_t numConsumeThreads = 0;
+
+  /// One queue per consume thread.  consume() is the only producer.
+  std::vector<std::unique_ptr<SpscQueue<EdgeType>>> consumeQueues;
+  std::vector<std::thread> consumeThreads;
+
+  /// Tells the consume threads to drain their queues and exit.
+  std::atomic<bool> stopConsumeThreads;
+
+  /// The most edges a consume thread takes off of its queue at once.
+  static size_t const CONSUME_BATCH_SIZE = 64;
+
+  /**
+   * The loop run by each consume thread.  Pulls runs of edges off of its 
+   * queue and calls consumeBatchDoesTheWork until stopConsumeThreads is set
+   * and the queue is empty.
+   */
+  void consumeLoop(size_t threadId);
+
+  /**
+   * Adds the edge to the graph and checks it against the partial results
+   * and the registered queries.  Edge requests that need to go to other
+   * nodes are added to edgeRequests.
+   */
+  void processEdge(EdgeType const& edge,
+                   std::list<EdgeRequestType>& edgeRequests);
+
+  /**
+   * consumeDoesTheWork for a run of edges.  The edge requests of the whole
+   * run are sent together at the end.
+   */
+  void consumeBatchDoesTheWork(EdgeType const* edges, size_t count);
+
+  /**
+   * Stops the consume threads after they have worked through everything 
+   * in their queues.
+   */
+  void joinConsumeThreads();
 
   void processRequestAgainstGraph(EdgeRequestType const& edgeRequest);
   
   /**
    * This goes through the list of new edge requests and sends them out to
-   * the appropriate nodes.
+   * the appropriate nodes.  Requests in the list for the same source and
+   * target are sent once (see coalesceEdgeRequests).
    */
   size_t processEdgeRequests(std::list<EdgeRequestType> const& edgeRequests);
 
+  /**
+   * Merges the requests that have the same source and target into one
+   * request whose time ranges cover them all.  The other node then looks
+   * up and sends each matching edge once instead of once per partial
+   * result that wants it; the partial results filter the edges by their
+   * own time constraints when the edges come back.
+   *
+   * Only requests from the same list are merged.  A request sent earlier
+   * can't stand in for a new one, since the edges it already returned
+   * were checked against the partial results existing at the time.
+   */
+  std::list<EdgeRequestType> 
+  coalesceEdgeRequests(std::list<EdgeRequestType> const& edgeRequests);
+
+  /**
+   * Sends the edge request to the owner of its bound vertex, or to the
+   * less loaded owner if both the source and target are bound.
+   */
+  void routeEdgeRequest(EdgeRequestType const& edgeRequest);
+
   /**
    * Sends the edge request out.  Uses the address function to determine
    * which node to send the request to.
@@ -218,7 +324,22 @@ public:
    *   to keep.
    * \param featureMap The featureMap that is being used by this node.
    * \param maxFutures The number of async threads that can be created.
+   *   No longer used; numConsumeThreads controls consume concurrency.
    * \param local Boolean indicating that we are on one node.
+   * \param numConsumeThreads How many threads process consumed edges.
+   *   Edges are sharded onto the threads by the hash of the source, so
+   *   edges from the same source are processed in the order consumed.
+   *   If zero, consume() does all the work on the calling thread.
+   * \param ingestCapacity If greater than zero, the edges and edge requests
+   *   received from other nodes wait in IngestQueues of this capacity and
+   *   are processed on the queues' threads, so a slow graph doesn't hold up
+   *   the pull threads.  If zero, the pull threads do the processing.
+   * \param ingestPolicy What happens to received edges and edge requests
+   *   when an IngestQueue is full.
+   * \param routingTable Says which nodes get the edges of a vertex.  Must
+   *   agree with the one given to the ZeroMQPushPull that partitions the
+   *   edges.  If null, vertices are owned by a HashRing of
+   *   all the nodes.
    */
   GraphStore(
              std::size_t numNodes,
@@ -238,7 +359,11 @@ public:
 #endif
              std::shared_ptr<FeatureMap> featureMap,
              size_t maxFutures = MAX_NUM_FUTURES,
-             bool local=false);
+             bool local=false,
+             size_t numConsumeThreads = 0,
+             size_t ingestCapacity = 0,
+             IngestPolicy ingestPolicy = IngestPolicy::Block,
+             std::shared_ptr<RoutingTable> routingTable = nullptr);
 
   ~GraphStore();
 
@@ -254,6 +379,13 @@ public:
   bool consume(EdgeType const& edge);
   bool consumeDoesTheWork(EdgeType const& edge);
 
+  /**
+   * consume() for a batch of edges.  With no consume threads, the batch is
+   * processed on the calling thread and its edge requests are sent once at
+   * the end.
+   */
+  bool consumeBatch(EdgeType const* edges, size_t count);
+
   /**
    * Called by producer to indicate that no more data is coming and that this
    * consumer should clean up and exit.
@@ -269,16 +401,135 @@ public:
         " finalized");
     }
     queries.push_back(query);
+    queryTrie.add(query);
   }
 
+  /**
+   * The registered queries merged by shared prefix.
+   */
+  QueryTrie<QueryType> const& getQueryTrie() const { return queryTrie; }
+
   size_t checkSubgraphQueries(EdgeType const& edge,
                             std::list<EdgeRequestType>& edgeRequests);
 
+  /**
+   * The RoutingTable that says which nodes get the edges of a vertex.
+   */
+  std::shared_ptr<RoutingTable> getRoutingTable() const { 
+    return routingTable; 
+  }
+
+  /**
+   * Adds the node to the cluster: makes it a member of the RoutingTable,
+   * reopens the sockets to it, and moves to it what it now owns (see
+   * rebalance()).  Must be called on every node already in the cluster.
+   * \return Returns the number of edges and edge requests moved.
+   */
+  size_t addNode(size_t node);
+
+  /**
+   * Takes the node out of the RoutingTable and moves what it owned to the
+   * other members (see rebalance()).  Must be called on every node,
+   * including the one being drained.  A drained node still finishes the
+   * partial results it holds, so it should keep running until they have
+   * expired.
+   * \return Returns the number of edges and edge requests moved.
+   */
+  size_t drainNode(size_t node);
+
+  /**
+   * Moves state to the new owners after the RoutingTable membership 
+   * changed:
+   * - Edges in the graph go to any new owner of their source or target
+   *   that didn't already have them.  Only the old owner of the source
+   *   sends, so each node gets each edge once.  The edges stay here 
+   *   until they expire.
+   * - Stored edge requests for vertices this node no longer gets are sent
+   *   on to the new owners.
+   * - Partial results waiting on a vertex whose edges used to come here
+   *   make new edge requests.
+   * Edges that arrive while the nodes are rebalancing can be missed.
+   * Replicated hubs are not moved.
+   * \return Returns the number of edges and edge requests moved.
+   */
+  size_t rebalance();
+
+  /**
+   * The IngestQueues of received edges and edge requests, or null if the
+   * pull threads process them directly.
+   */
+  IngestQueue<EdgeType> const* getEdgeIngestQueue() const {
+    return edgeIngest.get();
+  }
+  IngestQueue<EdgeRequestType> const* getRequestIngestQueue() const {
+    return requestIngest.get();
+  }
+
+  /**
+   * Counts the edges in the graph.  Constant time.
+   */
+  size_t countEdges() const { return csr->countEdges(); }
+
+  /**
+   * The bytes allocated for the csr and csc (see 
+   * CompressedSparse::getNumBytes).
+   */
+  size_t getNumGraphBytes() const { 
+    return csr->getNumBytes() + csc->getNumBytes(); 
+  }
+
+  /**
+   * Starts expiring edges in the background.  Every periodMicros, 
+   * sliceBins bins of the csr and of the csc are swept for edges older 
+   * than the time window, and vertices left without edges are freed (see
+   * CompressedSparse::expireSlice).  Otherwise edges are only expired when
+   * their vertex gets a new edge.  Stopped by terminate().
+   */
+  void startExpiry(size_t sliceBins, size_t periodMicros = 1000) {
+    if (expiryService) {
+      throw GraphStoreException("GraphStore::startExpiry expiry has already"
+        " been started");
+    }
+    std::shared_ptr<csrType> csr = this->csr;
+    std::shared_ptr<cscType> csc = this->csc;
+    expiryService.reset(new ExpiryService({
+      [csr](size_t maxBins) { return csr->expireSlice(maxBins); },
+      [csc](size_t maxBins) { return csc->expireSlice(maxBins); }},
+      sliceBins, periodMicros));
+  }
+
+  /**
+   * The background expiry, or null if startExpiry wasn't called.
+   */
+  ExpiryService const* getExpiryService() const { 
+    return expiryService.get(); 
+  }
+
+  /**
+   * Returns statistics about the edges held on this node (degrees from 
+   * the csr and csc, and the arrival rate over the time window), for 
+   * planning queries with SubgraphQuery::finalize(QueryStatistics).  If 
+   * the graph is empty, returns the default statistics.  Linear operation.
+   */
+  QueryStatistics getQueryStatistics() const;
+
   /**
    * Returns the total number of completed query results were produced.
    */
   size_t getNumResults() const { return resultMap->getNumResults(); }
 
+  /**
+   * Returns the number of intermediate results that have been stored, and
+   * the number that would have been stored if the registered queries did
+   * not share partial results for their common prefixes.
+   */
+  uint64_t getNumPartialResults() const { 
+    return resultMap->getNumPartialResults(); 
+  }
+  uint64_t getNumIndependentPartialResults() const { 
+    return resultMap->getNumIndependentPartialResults(); 
+  }
+
   /**
    * Resets the results to be nothing.
    */ 
@@ -373,6 +624,22 @@ public:
   size_t getTotalEdgeRequestMapRequestsViewed() {
     return edgeRequestMap->getTotalEdgeRequestsViewed();
   }
+
+  /**
+   * Returns how many received edge requests the EdgeRequestMap coalesced
+   * into an existing entry.
+   */
+  size_t getTotalEdgeRequestMapRequestsCoalesced() {
+    return edgeRequestMap->getTotalEdgeRequestsCoalesced();
+  }
+
+  /**
+   * Returns how many edge requests this node didn't send because they were
+   * coalesced with another request for the same source/target.
+   */
+  size_t getTotalEdgeRequestsSuppressed() const {
+    return edgeRequestsSuppressedCounter;
+  }
   #endif
 
   #ifdef TIMING
@@ -397,6 +664,21 @@ public:
     return edgeRequestMap->getTotalTimeLock();
   }
 
+  /**
+   * Returns how long the edgeRequestMap held locks to entries of the ale.
+   */
+  double getTotalTimeEdgeRequestMapLockHeld() const {
+    return edgeRequestMap->getTotalTimeLockHeld();
+  }
+
+  /**
+   * Returns the histogram of how long the edgeRequestMap held locks to
+   * entries of the ale (see EdgeRequestMap::getLockHoldHistogram).
+   */
+  std::vector<size_t> getEdgeRequestMapLockHoldHistogram() const {
+    return edgeRequestMap->getLockHoldHistogram();
+  }
+
   double getTotalTimeConsumeAddEdge() const {
     return totalTimeConsumeAddEdge;
   }
@@ -520,9 +802,12 @@ checkSubgraphQueries(EdgeType const& edge,
 
   size_t totalWork = 0;
 
-  for (std::shared_ptr<const QueryType> query : queries) 
+  // Queries with the same first edge are checked once, and share the
+  // result until they diverge.
+  for (auto const& root : queryTrie.getRoots()) 
   {
     totalWork++;
+    std::shared_ptr<const QueryType> query = root->representative();
 
     //TODO: Don't really like this.  I think SubgraphQueryResult should
     // have a constructor that just takes the query, and then we can
@@ -538,16 +823,20 @@ checkSubgraphQueries(EdgeType const& edge,
     {
 
       // We only want one node to own the query result, so we make sure
-      // that this node owns the source
+      // that this node owns the source (or the target if the source is a
+      // replicated hub, see RoutingTable::resultOwner).
       SourceType src = std::get<source>(edge.tuple);
+      TargetType trg = std::get<target>(edge.tuple);
       
       DEBUG_PRINT("Node %lu GraphStore::checkSubgraphQueries src %s "
         "soruceHash(src) %llu numNodes %lu sourceHash(src) mod numNodes %llu\n",
         nodeId, src.c_str(), sourceHash(src), numNodes, 
         sourceHash(src) % numNodes);
 
-      if (sourceHash(src) % numNodes == nodeId) {
-        ResultType queryResult(query, edge);
+      if (routingTable->resultOwner(sourceHash(src), targetHash(trg)) == 
+          nodeId) 
+      {
+        ResultType queryResult(root, edge);
 
         DEBUG_PRINT("Node %lu GraphStore::checkSubgraphQueries adding"
           " queryResult %s from tuple %s\n", this->nodeId, 
@@ -607,47 +896,12 @@ processEdgeRequests(std::list<EdgeRequestType> const& edgeRequests)
   // Don't want to issue more edge requests if we've been terminated.
   if (!terminated) {
     
-    for(auto edgeRequest : edgeRequests) {
+    for(auto edgeRequest : coalesceEdgeRequests(edgeRequests)) {
 
       DEBUG_PRINT("Node %lu GraphStore::processEdgeRequests() processing"
         " edgeRequest %s\n", this->nodeId, edgeRequest.toString().c_str());
 
-      if (isNull(edgeRequest.getTarget()) && isNull(edgeRequest.getSource()))
-      {
-        throw GraphStoreException("In GraphStore::processEdgeRequests, both the"
-          " source and the target of an edge request was null.  Don't know what"
-          " do with that.");
-      }
-      else 
-      if (!isNull(edgeRequest.getTarget()) && isNull(edgeRequest.getSource()))
-      {
-        //If the target is not null but the source is, we send the edge request
-        //to whomever owns the target.
-        sendEdgeRequest(edgeRequest, targetAddressFunction);
-      }
-      else 
-      if (isNull(edgeRequest.getTarget()) && !isNull(edgeRequest.getSource()))
-      {
-        //If the source is not null but the target is, we send the edge request
-        //to whomever owns the source.
-        sendEdgeRequest(edgeRequest, sourceAddressFunction);
-      }
-      else 
-      if (!isNull(edgeRequest.getTarget()) && !isNull(edgeRequest.getSource()))
-      {
-        //If both source and target are not null, it doesn't really matter
-        //to which node we send the edge request, since both nodes will have
-        //matching edges.
-
-        //TODO partition info        
-        // load balancing by splitting our requests 
-        if (rand() % 2 == 0 )
-        {
-          sendEdgeRequest(edgeRequest, sourceAddressFunction);
-        } else {
-          sendEdgeRequest(edgeRequest, targetAddressFunction);
-        }
-      }
+      routeEdgeRequest(edgeRequest);
     }
   } else {
     DEBUG_PRINT("Node %lu GraphStore::processEdgeRequests() there are %lu "
@@ -658,6 +912,227 @@ processEdgeRequests(std::list<EdgeRequestType> const& edgeRequests)
   return edgeRequests.size();
 }
 
+template <typename EdgeType, typename Tuplizer,
+          size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+size_t
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+addNode(size_t node)
+{
+  routingTable->addNode(node);
+  if (node != nodeId) {
+    edgeCommunicator->reopen(node);
+    requestCommunicator->reopen(node);
+  }
+  return rebalance();
+}
+
+template <typename EdgeType, typename Tuplizer,
+          size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+size_t
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+drainNode(size_t node)
+{
+  routingTable->drainNode(node);
+  return rebalance();
+}
+
+template <typename EdgeType, typename Tuplizer,
+          size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+QueryStatistics
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+getQueryStatistics() const
+{
+  QueryStatistics statistics;
+  size_t numSources, numTargets;
+  double meanOut, outSecond, meanIn, inSecond;
+  csr->degreeStatistics(numSources, meanOut, outSecond);
+  csc->degreeStatistics(numTargets, meanIn, inSecond);
+  if (numSources == 0 || numTargets == 0) {
+    return statistics;
+  }
+
+  statistics.numVertices = std::max(numSources, numTargets);
+  statistics.numEdges = numSources * meanOut;
+  statistics.edgeRate = timeWindow > 0 ? 
+    statistics.numEdges / timeWindow : statistics.numEdges;
+  statistics.meanOutDegree = meanOut;
+  statistics.outDegreeSecondMoment = outSecond;
+  statistics.meanInDegree = meanIn;
+  statistics.inDegreeSecondMoment = inSecond;
+  return statistics;
+}
+
+template <typename EdgeType, typename Tuplizer,
+          size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+size_t
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+rebalance()
+{
+  // Find the edges to move first so the graph isn't locked while sending.
+  std::list<std::pair<size_t, EdgeType>> movedEdges;
+  csr->forEachEdge([&](EdgeType const& edge) {
+    size_t srcHash = sourceHash(std::get<source>(edge.tuple));
+    size_t trgHash = targetHash(std::get<target>(edge.tuple));
+    size_t oldSourceOwner = routingTable->previousOwner(srcHash);
+    size_t oldTargetOwner = routingTable->previousOwner(trgHash);
+    if (oldSourceOwner != nodeId) {
+      return;
+    }
+
+    size_t newSourceOwner = routingTable->owner(srcHash);
+    size_t newTargetOwner = routingTable->owner(trgHash);
+    if (newSourceOwner != oldSourceOwner && 
+        newSourceOwner != oldTargetOwner) 
+    {
+      movedEdges.push_back(std::make_pair(newSourceOwner, edge));
+    }
+    if (newTargetOwner != oldSourceOwner && 
+        newTargetOwner != oldTargetOwner &&
+        newTargetOwner != newSourceOwner) 
+    {
+      movedEdges.push_back(std::make_pair(newTargetOwner, edge));
+    }
+  });
+
+  for (auto const& p : movedEdges) {
+    bool sent = edgeCommunicator->send(
+      EdgeCodec<EdgeType>::encodeMigration(p.second), p.first);
+    if (!sent) {
+      printf("Node %lu->%lu GraphStore::rebalance failed sending edge %s\n",
+        nodeId, p.first, sam::toString(p.second.tuple).c_str());
+    }
+  }
+
+  // Hand on the edge requests for vertices that no longer come here.
+  std::list<EdgeRequestType> movedRequests;
+  edgeRequestMap->extractRequests([this](EdgeRequestType const& request) {
+    SourceType src = request.getSource();
+    TargetType trg = request.getTarget();
+    bool here = 
+      (!isNull(src) && routingTable->receives(sourceHash(src), nodeId)) ||
+      (!isNull(trg) && routingTable->receives(targetHash(trg), nodeId));
+    return !here;
+  }, movedRequests);
+
+  // Not processEdgeRequests, since requests with different return nodes
+  // must not be coalesced.
+  for (auto const& request : movedRequests) {
+    routeEdgeRequest(request);
+  }
+
+  std::list<EdgeRequestType> newRequests;
+  resultMap->reissueEdgeRequests(newRequests);
+  processEdgeRequests(newRequests);
+
+  edgeCommunicator->flush();
+  requestCommunicator->flush();
+
+  DEBUG_PRINT("Node %lu GraphStore::rebalance moved %lu edges, %lu edge "
+    "requests, and made %lu new edge requests\n", nodeId, movedEdges.size(),
+    movedRequests.size(), newRequests.size());
+
+  return movedEdges.size() + movedRequests.size();
+}
+
+template <typename EdgeType, typename Tuplizer,
+          size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+void
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+routeEdgeRequest(EdgeRequestType const& edgeRequest)
+{
+  if (isNull(edgeRequest.getTarget()) && isNull(edgeRequest.getSource()))
+  {
+    throw GraphStoreException("In GraphStore::routeEdgeRequest, both the"
+      " source and the target of an edge request was null.  Don't know what"
+      " do with that.");
+  }
+  else 
+  if (!isNull(edgeRequest.getTarget()) && isNull(edgeRequest.getSource()))
+  {
+    //If the target is not null but the source is, we send the edge request
+    //to whomever owns the target.
+    sendEdgeRequest(edgeRequest, targetAddressFunction);
+  }
+  else 
+  if (isNull(edgeRequest.getTarget()) && !isNull(edgeRequest.getSource()))
+  {
+    //If the source is not null but the target is, we send the edge request
+    //to whomever owns the source.
+    sendEdgeRequest(edgeRequest, sourceAddressFunction);
+  }
+  else 
+  if (!isNull(edgeRequest.getTarget()) && !isNull(edgeRequest.getSource()))
+  {
+    //If both source and target are not null, it doesn't really matter
+    //to which node we send the edge request, since both nodes will have
+    //matching edges.
+
+    // Send it to whichever of the two owners has less load.
+    size_t sourceNode = sourceAddressFunction(edgeRequest);
+    size_t targetNode = targetAddressFunction(edgeRequest);
+    if (routingTable->leastLoaded(sourceNode, targetNode) == sourceNode)
+    {
+      sendEdgeRequest(edgeRequest, sourceAddressFunction);
+    } else {
+      sendEdgeRequest(edgeRequest, targetAddressFunction);
+    }
+  }
+}
+
+template <typename EdgeType, typename Tuplizer,
+          size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+std::list<typename GraphStore<EdgeType, Tuplizer, source, target, time, 
+  duration, SourceHF, TargetHF, SourceEF, TargetEF>::EdgeRequestType>
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+coalesceEdgeRequests(std::list<EdgeRequestType> const& edgeRequests)
+{
+  typedef std::pair<std::string, std::string> KeyType;
+  std::list<EdgeRequestType> coalesced;
+  std::map<KeyType, EdgeRequestType*> byKey;
+
+  for (auto const& edgeRequest : edgeRequests) {
+    KeyType key(edgeRequest.getSource(), edgeRequest.getTarget());
+    auto it = byKey.find(key);
+    if (it == byKey.end()) {
+      coalesced.push_back(edgeRequest);
+      byKey[key] = &coalesced.back();
+    } else {
+      it->second->widen(edgeRequest);
+      #ifdef METRICS
+      edgeRequestsSuppressedCounter.fetch_add(1);
+      #endif
+    }
+  }
+
+  DEBUG_PRINT("Node %lu GraphStore::coalesceEdgeRequests %lu edge requests "
+    "coalesced into %lu\n", nodeId, edgeRequests.size(), coalesced.size());
+  return coalesced;
+}
+
 template <typename EdgeType, typename Tuplizer,
           size_t source, size_t target,
           size_t time, size_t duration,
@@ -671,6 +1146,7 @@ sendEdgeRequest(EdgeRequestType const& edgeRequest,
 {
   std::string message = edgeRequest.serialize();
   size_t node = addressFunction(edgeRequest);
+  routingTable->addLoad(node);
 
   bool sent = requestCommunicator->send(message, node);
 
@@ -695,39 +1171,54 @@ consume(EdgeType const& edge)
   DEBUG_PRINT("Node %lu GraphStore::consume processing tuple %s\n",
     nodeId, edge.toString().c_str());
 
-  DEBUG_PRINT("Node %lu GraphStore::consume about to launch async (total"
-    " asnyc threads right now %lu) for tuple %s\n",
-    nodeId, consumeThreadsActive.load(), edge.toString().c_str());
-  
-  // TODO threading isn't working
-  //if (cycled) {
-  //  printf("currentFuture %lu\n", currentFuture);
-  //  futures[currentFuture].get();
-  //}
-
-
-  //TODO async isn't working now.
-  //futures[currentFuture] = std::async(std::launch::async, [this, &myEdge]() {
-  //  return this->consumeDoesTheWork(myEdge);
-  //});
-  this->consumeDoesTheWork(edge);
-  // TODO currentFuture++;
-  //auto _ = std::async(std::launch::async, [this, &tuple]() {
-  // return this->consumeDoesTheWork(tuple);
-  //});a
-
-  // TODO
-  //if (currentFuture >= maxFutures) {
-  //  printf("currentFuture %lu maxFutures %lu\n", currentFuture, maxFutures);
-  //  cycled = true;
-  //  currentFuture = 0;
-  //}
+  if (numConsumeThreads == 0) {
+    this->consumeDoesTheWork(edge);
+  } else {
+    // Shard on the source so that all the edges of a vertex go through the
+    // same queue in order.  The hash is divided by numNodes first since the
+    // node that owns the source was picked with the low end of the hash.
+    SourceType src = std::get<source>(edge.tuple);
+    size_t shard = (sourceHash(src) / numNodes) % numConsumeThreads;
+    while (!consumeQueues[shard]->push(edge)) {
+      std::this_thread::yield();
+    }
+  }
 
   consumeCount++;
 
   return true;
 }
 
+template <typename EdgeType, typename Tuplizer, 
+          size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF, 
+          typename SourceEF, typename TargetEF> 
+bool
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+consumeBatch(EdgeType const* edges, size_t count)
+{
+  DEBUG_PRINT("Node %lu GraphStore::consumeBatch processing %lu tuples\n",
+    nodeId, count);
+
+  if (numConsumeThreads == 0) {
+    this->consumeBatchDoesTheWork(edges, count);
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      SourceType src = std::get<source>(edges[i].tuple);
+      size_t shard = (sourceHash(src) / numNodes) % numConsumeThreads;
+      while (!consumeQueues[shard]->push(edges[i])) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  consumeCount += count;
+
+  return true;
+}
+
 
 template <typename EdgeType, typename Tuplizer, 
           size_t source, size_t target, 
@@ -756,44 +1247,13 @@ consumeDoesTheWork(EdgeType const& edge)
   DEBUG_PRINT("Node %lu GraphStore::consumeDoesTheWork tuple %s\n", nodeId, 
     edge.toString().c_str());
 
-
-  // Adds the edge to the graph
-  DETAIL_TIMING_BEG1
-  size_t workAddEdge = addEdge(edge);
-  DETAIL_TIMING_END_TOL1(nodeId, totalTimeConsumeAddEdge, TOLERANCE, 
-                     "GraphStore::consumeDoesTheWork addEdge")
-
-  // Check against existing queryResults.  The edgeRequest list is populated
-  // with edge requests when we find we need a tuple that will reside 
-  // elsewhere.
-  DETAIL_TIMING_BEG2
   std::list<EdgeRequestType> edgeRequests;
-  //resultMapLock.lock();
-  size_t workResultMapProcess = 
-    resultMap->process(edge, edgeRequests);
-  //resultMapLock.unlock();
-  DETAIL_TIMING_END_TOL2(nodeId, totalTimeConsumeResultMapProcess,  TOLERANCE,
-                     "GraphStore::consumeDoesTheWork resultMap->process")
-
-  // See if anybody needs this tuple and send it out to them.
-  DETAIL_TIMING_BEG2
-  size_t workEdgeRequestMap = edgeRequestMap->process(edge.tuple);
-  DETAIL_TIMING_END_TOL2(nodeId, totalTimeConsumeEdgeRequestMapProcess, 
-    TOLERANCE, "GraphStore::consumeDoesTheWork edgeRequestMap->process")
-
-  // Check against all registered queries
-  
-  size_t workCheckSubgraphQueries = 0;
-
-  DETAIL_TIMING_BEG2
-  workCheckSubgraphQueries = checkSubgraphQueries(edge, edgeRequests);
-  DETAIL_TIMING_END_TOL2(nodeId, totalTimeConsumeCheckSubgraphQueries, 
-    TOLERANCE, "GraphStore::consumeDoesTheWork checkSubgraphQueries")
+  processEdge(edge, edgeRequests);
 
   // Send out the edge requests to the other nodes.
-  DETAIL_TIMING_BEG2
+  DETAIL_TIMING_BEG1
   size_t workProcessEdgeRequests = processEdgeRequests(edgeRequests);
-  DETAIL_TIMING_END_TOL2(nodeId, totalTimeConsumeProcessEdgeRequests, TOLERANCE,
+  DETAIL_TIMING_END_TOL1(nodeId, totalTimeConsumeProcessEdgeRequests, TOLERANCE,
                      "GraphStore::consumeDoesTheWork processEdgeRequests")
 
   #ifdef TIMING
@@ -830,6 +1290,73 @@ consumeDoesTheWork(EdgeType const& edge)
   return true;
 }
 
+template <typename EdgeType, typename Tuplizer, 
+          size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF, 
+          typename SourceEF, typename TargetEF> 
+void
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+processEdge(EdgeType const& edge, std::list<EdgeRequestType>& edgeRequests)
+{
+  // Adds the edge to the graph
+  DETAIL_TIMING_BEG1
+  size_t workAddEdge = addEdge(edge);
+  DETAIL_TIMING_END_TOL1(nodeId, totalTimeConsumeAddEdge, TOLERANCE, 
+                     "GraphStore::processEdge addEdge")
+
+  // Check against existing queryResults.  The edgeRequest list is populated
+  // with edge requests when we find we need a tuple that will reside 
+  // elsewhere.
+  DETAIL_TIMING_BEG2
+  //resultMapLock.lock();
+  size_t workResultMapProcess = 
+    resultMap->process(edge, edgeRequests);
+  //resultMapLock.unlock();
+  DETAIL_TIMING_END_TOL2(nodeId, totalTimeConsumeResultMapProcess,  TOLERANCE,
+                     "GraphStore::processEdge resultMap->process")
+
+  // See if anybody needs this tuple and send it out to them.
+  DETAIL_TIMING_BEG2
+  size_t workEdgeRequestMap = edgeRequestMap->process(edge.tuple);
+  DETAIL_TIMING_END_TOL2(nodeId, totalTimeConsumeEdgeRequestMapProcess, 
+    TOLERANCE, "GraphStore::processEdge edgeRequestMap->process")
+
+  // Check against all registered queries
+  
+  size_t workCheckSubgraphQueries = 0;
+
+  DETAIL_TIMING_BEG2
+  workCheckSubgraphQueries = checkSubgraphQueries(edge, edgeRequests);
+  DETAIL_TIMING_END_TOL2(nodeId, totalTimeConsumeCheckSubgraphQueries, 
+    TOLERANCE, "GraphStore::processEdge checkSubgraphQueries")
+}
+
+template <typename EdgeType, typename Tuplizer, 
+          size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF, 
+          typename SourceEF, typename TargetEF> 
+void
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+consumeBatchDoesTheWork(EdgeType const* edges, size_t count)
+{
+  consumeThreadsActive.fetch_add(1);
+
+  DEBUG_PRINT("Node %lu GraphStore::consumeBatchDoesTheWork %lu tuples\n",
+    nodeId, count);
+
+  std::list<EdgeRequestType> edgeRequests;
+  for (size_t i = 0; i < count; i++) {
+    processEdge(edges[i], edgeRequests);
+  }
+  processEdgeRequests(edgeRequests);
+
+  consumeThreadsActive.fetch_add(-1);
+}
+
 template <typename EdgeType, typename Tuplizer, 
           size_t source, size_t target, 
           size_t time, size_t duration,
@@ -844,19 +1371,22 @@ terminate()
     " %lu\n", nodeId, consumeThreadsActive.load());
   if (!terminated) {  
 
-    terminated = true;
+    if (expiryService) {
+      expiryService->stop();
+    }
+
+    // The consume threads need to finish before we set terminated, 
+    // otherwise the edge requests from the edges still in the queues
+    // would be dropped.
+    joinConsumeThreads();
 
-    /*futuresLock.lock();
-    for (size_t i = 0; i < MAX_NUM_FUTURES; i++) {
-       printf("Node %lu i %lu MAX_NUM_FUTURES %lu\n", nodeId, i, 
-         MAX_NUM_FUTURES);
-       try {
-         futures[i].get();
-       } catch (std::system_error e) {
-         printf("Caught exception with future %s\n", e.what());
-       }
+    // Likewise for what was received and is still waiting to be processed.
+    if (edgeIngest) {
+      edgeIngest->flush();
+      requestIngest->flush();
     }
-    futuresLock.unlock();*/
+
+    terminated = true;
 
     // If terminate was called, we aren't going to receive any more
     // edges, so we can push out the terminate signal to all the edge request
@@ -893,6 +1423,60 @@ terminate()
   printf("Node %lu exiting GraphStore::terminate\n", nodeId);
 }
 
+template <typename EdgeType, typename Tuplizer, 
+          size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF, 
+          typename SourceEF, typename TargetEF> 
+void 
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+consumeLoop(size_t threadId) 
+{
+  SpscQueue<EdgeType>& queue = *consumeQueues[threadId];
+  std::vector<EdgeType> edges(CONSUME_BATCH_SIZE);
+  Backoff backoff;
+  while (true) {
+    size_t count = queue.popBatch(edges.data(), CONSUME_BATCH_SIZE);
+    if (count > 0) {
+      backoff.reset();
+      try {
+        consumeBatchDoesTheWork(edges.data(), count);
+      } catch (std::exception const& e) {
+        printf("Node %lu consume thread %lu caught exception: %s\n",
+          nodeId, threadId, e.what());
+      }
+    } else if (stopConsumeThreads) {
+      // The producer is done, so once the queue is empty we can exit.
+      // Check once more since the stop flag may have been set after the 
+      // last push.
+      if (queue.size() == 0) {
+        break;
+      }
+    } else {
+      backoff.wait();
+    }
+  }
+  DEBUG_PRINT("Node %lu consume thread %lu exiting\n", nodeId, threadId);
+}
+
+template <typename EdgeType, typename Tuplizer, 
+          size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF, 
+          typename SourceEF, typename TargetEF> 
+void 
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+joinConsumeThreads() 
+{
+  stopConsumeThreads = true;
+  for (auto& thread : consumeThreads) {
+    thread.join();
+  }
+  consumeThreads.clear();
+}
+
 /**
  * Constructor
  */
@@ -921,9 +1505,17 @@ GraphStore(
 #endif
              std::shared_ptr<FeatureMap> featureMap,
              size_t maxFutures,
-             bool local)
+             bool local,
+             size_t numConsumeThreads,
+             size_t ingestCapacity,
+             IngestPolicy ingestPolicy,
+             std::shared_ptr<RoutingTable> routingTable)
 {
   this->featureMap = featureMap;
+  this->routingTable = routingTable;
+  if (!this->routingTable) {
+    this->routingTable = std::make_shared<RoutingTable>(numNodes);
+  }
 
   if (maxFutures > MAX_NUM_FUTURES) {
     std::string msg = "maxFutures must be less than " + 
@@ -934,13 +1526,13 @@ GraphStore(
 
   sourceAddressFunction = [this](EdgeRequestType const& edgeRequest) {
     SourceType src = edgeRequest.getSource();
-    size_t node = sourceHash(src) % this->numNodes;
+    size_t node = this->routingTable->owner(sourceHash(src));
     return node;
   };
 
   targetAddressFunction = [this](EdgeRequestType const& edgeRequest) {
-    TargetType trg = edgeRequest.getSource();
-    size_t node = targetHash(trg) % this->numNodes;
+    TargetType trg = edgeRequest.getTarget();
+    size_t node = this->routingTable->owner(targetHash(trg));
     return node;
   };
 
@@ -950,58 +1542,63 @@ GraphStore(
 
   edgePushCounter = 0;
   edgePushFails = 0;
+  #ifdef METRICS
+  edgeRequestsSuppressedCounter = 0;
+  #endif
   consumeThreadsActive = 0;
 
+  this->timeWindow = timeWindow;
   csr = std::make_shared<csrType>(graphCapacity, timeWindow); 
   csc = std::make_shared<cscType>(graphCapacity, timeWindow); 
   
   resultMap = 
     std::make_shared< ResultMapType>( numNodes, nodeId, 
-      tableCapacity, resultsCapacity, *csr, *csc);
+      tableCapacity, resultsCapacity, *csr, *csc, 1.0, this->routingTable);
 
 
   typedef PushPull::FunctionType FunctionType;
+  typedef PushPull::RawFunctionType RawFunctionType;
+
+  if (ingestCapacity > 0) {
+    edgeIngest.reset(new IngestQueue<EdgeType>(ingestCapacity,
+      [this](EdgeType const* edges, size_t count) {
+        handleEdges(edges, count);
+      }, ingestPolicy));
+    requestIngest.reset(new IngestQueue<EdgeRequestType>(ingestCapacity,
+      [this](EdgeRequestType const* requests, size_t count) {
+        handleRequests(requests, count);
+      }, ingestPolicy));
+  }
 
-  auto edgeCallback = [this](std::string str) 
+  auto edgeCallback = [this](char const* data, size_t size) 
   {
     // We give the edge a new id that is unique to this node.
     size_t id = idGenerator->generate();
 
-    // Change the string into the expected tuple type.
-    EdgeType edge = tuplizer(id, str);
+    // Decode the message (binary, or text as a fallback) into an edge.
+    EdgeType edge = EdgeCodec<EdgeType>::fromMessage(id, data, size, 
+                                                     tuplizer);
+
+    // An edge moved here by rebalance() belongs in the graph, and was
+    // already matched against the queries by the node that consumed it.
+    if (isMigrationMessage(data, size)) {
+      DEBUG_PRINT("Node %lu GraphStore::edgeCallback received a migrated"
+        " tuple %s\n", this->nodeId, sam::toString(edge.tuple).c_str());
+      addEdge(edge);
+      return;
+    }
 
     DEBUG_PRINT("Node %lu GraphStore::edgeCallback received a"
       " tuple %s\n", this->nodeId, sam::toString(edge.tuple).c_str());
 
-    // Do we need to do this?
-    // Add the edge to the graph
-    //addEdge(tuple);
-
-    DEBUG_PRINT("Node %lu GraphStore::edgeCallback added edge %s\n",
-      this->nodeId, sam::toString(edge.tuple).c_str());
-
-    DETAIL_TIMING_BEG1
-    // Process the new edge over results and see if it satifies
-    // queries.  If it does, there may be new edge requests.
-    std::list<EdgeRequestType> edgeRequests;
-    //resultMapLock.lock();
-    resultMap->process(edge, edgeRequests);
-    //resultMapLock.unlock();
-    DETAIL_TIMING_END_TOL1(this->nodeId, totalTimeEdgeCallbackResultMapProcess, 
-      TOLERANCE, "GraphStore::edgeCallback resultMap->process")
-
-    DEBUG_PRINT("Node %lu GraphStore::edgeCallback processed"
-      " edge %s\n", this->nodeId, sam::toString(edge.tuple).c_str());
-
-    // Send out the edge requests to the other nodes.
-    DETAIL_TIMING_BEG2
-    processEdgeRequests(edgeRequests);
-    DETAIL_TIMING_END_TOL2(this->nodeId, 
-      totalTimeEdgeCallbackProcessEdgeRequests, TOLERANCE, 
-      "GraphStore::edgeCallbackk processEdgeRequests")
+    if (edgeIngest) {
+      edgeIngest->push(edge);
+    } else {
+      handleEdges(&edge, 1);
+    }
   };
 
-  std::vector<FunctionType> edgeCommunicatorFunctions;
+  std::vector<RawFunctionType> edgeCommunicatorFunctions;
   edgeCommunicatorFunctions.push_back(edgeCallback);
 
   edgeCommunicator = new PushPull(numNodes, nodeId, numPushSockets,
@@ -1017,47 +1614,20 @@ GraphStore(
   }
 
   edgeRequestMap = std::make_shared< RequestMapType>( 
-    numNodes, nodeId, tableCapacity, edgeCommunicator);
+    numNodes, nodeId, tableCapacity, edgeCommunicator, this->routingTable);
 
   auto requestCallback = [this](std::string str)
   {
-      
-    // When we get an edge request, we need to check against
-    // the graph (existing matches) and add it to the list 
-    // so that any new matches are caught.  Since there are
-    // two other threads that add to the graph 
-    // (the edgeRequest pull thread and the consume thread),
-    // we need a lock to make sure we don't miss edges are add
-    // edge multiple times. 
-    
-    //generalLock.lock();
-
     EdgeRequestType request(str);
     DEBUG_PRINT("Node %lu GraphStore::requestCallback received an edge request"
       " length = %lu: %s %s\n", this->nodeId, str.size(), str.c_str(),
       request.toString().c_str());
 
-    DETAIL_TIMING_BEG1
-    edgeRequestMap->addRequest(request);
-    DETAIL_TIMING_END_TOL1(this->nodeId, 
-      totalTimeRequestCallbackAddRequest, 
-      TOLERANCE, "GraphStore::requestCallback edgeRequestMap->addRequest")
-    DEBUG_PRINT("Node %lu RequestPullThread added edge request to map"
-      ": %s\n", this->nodeId, request.toString().c_str());
-      
-
-    DETAIL_TIMING_BEG2
-    processRequestAgainstGraph(request);
-    DETAIL_TIMING_END_TOL2(this->nodeId, 
-      totalTimeRequestCallbackProcessAgainstGraph, 
-      TOLERANCE, "GraphStore::requestCallback processRequestAgainstGraph")
-    DEBUG_PRINT("Node %lu RequestPullThread processed edge request"
-      " against graph: %s\n", this->nodeId, request.toString().c_str());
-      
-
-    DEBUG_PRINT("Node %lu RequestPullThread processed edge request"
-      ": %s\n", this->nodeId, request.toString().c_str());
-      
+    if (requestIngest) {
+      requestIngest->push(request);
+    } else {
+      handleRequests(&request, 1);
+    }
   };
 
   std::vector<FunctionType> requestCommunicatorFunctions;
@@ -1073,6 +1643,17 @@ GraphStore(
 #endif
   myRand = std::mt19937(rd());
   dist = std::uniform_real_distribution<>(0.0, 1.0);
+
+  // Start the consume threads last since they touch everything above.
+  this->numConsumeThreads = numConsumeThreads;
+  stopConsumeThreads = false;
+  for (size_t i = 0; i < numConsumeThreads; i++) {
+    consumeQueues.push_back(std::unique_ptr<SpscQueue<EdgeType>>(
+      new SpscQueue<EdgeType>(CONSUME_QUEUE_LENGTH)));
+  }
+  for (size_t i = 0; i < numConsumeThreads; i++) {
+    consumeThreads.push_back(std::thread(&GraphStore::consumeLoop, this, i));
+  }
 }
 
 template <typename EdgeType, typename Tuplizer, 
@@ -1086,12 +1667,88 @@ GraphStore<EdgeType, Tuplizer, source, target, time, duration,
 {
   terminate();
 
+  // The handlers send through both communicators, so the queues stop
+  // first.  Anything received from here on is dropped.
+  if (edgeIngest) {
+    edgeIngest->stop();
+    requestIngest->stop();
+    if (edgeIngest->getNumDropped() + requestIngest->getNumDropped() > 0) {
+      printf("Node %lu GraphStore ingest queues dropped %lu edges and %lu "
+        "edge requests\n", nodeId, edgeIngest->getNumDropped(),
+        requestIngest->getNumDropped());
+    }
+  }
+
   delete requestCommunicator;
   delete edgeCommunicator;
 
   DEBUG_PRINT("Node %lu end of ~GraphStore\n", nodeId);
 }
 
+template <typename EdgeType, typename Tuplizer, 
+          size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF, 
+          typename SourceEF, typename TargetEF> 
+void
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+handleEdges(EdgeType const* edges, size_t count)
+{
+  // Process the new edges over results and see if they satisfy
+  // queries.  If they do, there may be new edge requests.
+  std::list<EdgeRequestType> edgeRequests;
+  DETAIL_TIMING_BEG1
+  for (size_t i = 0; i < count; i++) {
+    resultMap->process(edges[i], edgeRequests);
+    DEBUG_PRINT("Node %lu GraphStore::handleEdges processed"
+      " edge %s\n", this->nodeId, sam::toString(edges[i].tuple).c_str());
+  }
+  DETAIL_TIMING_END_TOL1(this->nodeId, totalTimeEdgeCallbackResultMapProcess, 
+    TOLERANCE, "GraphStore::handleEdges resultMap->process")
+
+  // Send out the edge requests to the other nodes.
+  DETAIL_TIMING_BEG2
+  processEdgeRequests(edgeRequests);
+  DETAIL_TIMING_END_TOL2(this->nodeId, 
+    totalTimeEdgeCallbackProcessEdgeRequests, TOLERANCE, 
+    "GraphStore::handleEdges processEdgeRequests")
+}
+
+template <typename EdgeType, typename Tuplizer, 
+          size_t source, size_t target, 
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF, 
+          typename SourceEF, typename TargetEF> 
+void
+GraphStore<EdgeType, Tuplizer, source, target, time, duration,
+  SourceHF, TargetHF, SourceEF, TargetEF>::
+handleRequests(EdgeRequestType const* requests, size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    // When we get an edge request, we need to check against
+    // the graph (existing matches) and add it to the list 
+    // so that any new matches are caught.
+    EdgeRequestType const& request = requests[i];
+
+    DETAIL_TIMING_BEG1
+    edgeRequestMap->addRequest(request);
+    DETAIL_TIMING_END_TOL1(this->nodeId, 
+      totalTimeRequestCallbackAddRequest, 
+      TOLERANCE, "GraphStore::handleRequests edgeRequestMap->addRequest")
+    DEBUG_PRINT("Node %lu GraphStore::handleRequests added edge request to "
+      "map: %s\n", this->nodeId, request.toString().c_str());
+
+    DETAIL_TIMING_BEG2
+    processRequestAgainstGraph(request);
+    DETAIL_TIMING_END_TOL2(this->nodeId, 
+      totalTimeRequestCallbackProcessAgainstGraph, 
+      TOLERANCE, "GraphStore::handleRequests processRequestAgainstGraph")
+    DEBUG_PRINT("Node %lu GraphStore::handleRequests processed edge request"
+      " against graph: %s\n", this->nodeId, request.toString().c_str());
+  }
+}
+
 template <typename EdgeType, typename Tuplizer, 
           size_t source, size_t target, 
           size_t time, size_t duration,
@@ -1158,57 +1815,55 @@ processRequestAgainstGraph(EdgeRequestType const& edgeRequest)
   DEBUG_PRINT("Node %lu GraphStore::processRequestAgainstGraph found"
     " %lu edges\n", nodeId, foundEdges.size());
 
-  for (auto edge : foundEdges) {
+  // findEdges has already released the graph's lock.  Pick out and
+  // serialize the edges the node needs first, then send them all, so that
+  // no lock is held while waiting on the network.
+  std::vector<std::string> messages;
+  for (auto const& edge : foundEdges) {
     SourceType src = std::get<source>(edge.tuple);
     TargetType trg = std::get<target>(edge.tuple);
-    size_t srcHash = sourceHash(src) % numNodes;
-    size_t trgHash = targetHash(trg) % numNodes;
-
     // Only send the message of the node won't get the message anyway.
-    if (srcHash != node && trgHash != node) {
-
-      std::string message = sam::toString(edge.tuple);
-      //zmq::message_t message = tupleToZmq(edge);
-
-      double placeholder = 0;
-      DETAIL_TIMING_BEG1
-      DETAIL_TIMING_END_TOL1(nodeId, placeholder, TOLERANCE, 
-        "GraphStore::processRequestAgainstGraph obtaining lock exceeded "
-        "tolerance")
-      if (!terminated) {
-        DEBUG_PRINT("Node %lu->%lu GraphStore::processRequestAgainstGraph"
-          " sending edge %s\n", nodeId, node, message.c_str());
-        DETAIL_TIMING_BEG1
-        //#ifdef NOBLOCK
-        //bool sent = edgePushers[node]->send(message, ZMQ_NOBLOCK);     
-        //if (!sent) { 
-        //  edgePushFails.fetch_add(1);
-        //  edgePushCounter.fetch_add(-1);
-        //  DEBUG_PRINT("Node %lu->%lu GraphStore::processRequestAgainstGraph"
-        //    " failed sending edge: %s\n",
-        //    nodeId, node, sam::toString(edge).c_str()); 
-        //}
-        //#elif defined NOBLOCK_WHILE
-        //bool sent = false;
-        //while(!sent) {
-        //  sent = edgePushers[node]->send(message, ZMQ_NOBLOCK);
-        //}
-        //#else
-        bool sent = edgeCommunicator->send(message, node);
-        if (!sent) { 
-          edgePushFails.fetch_add(1);
-          DEBUG_PRINT("Node %lu->%lu GraphStore::processRequestAgainstGraph"
-            " failed sending edge: %s\n", nodeId, node, message.c_str()); 
-            
-        } else {
-          edgePushCounter.fetch_add(1);
-        }
-        //#endif
-        DETAIL_TIMING_END_TOL1(nodeId, placeholder, TOLERANCE, 
-          "GraphStore::processRequestAgainstGraph sending message exceeded "
-          "tolerance")
-      }
+    if (!routingTable->receives(sourceHash(src), node) &&
+        !routingTable->receives(targetHash(trg), node)) 
+    {
+      DEBUG_PRINT("Node %lu->%lu GraphStore::processRequestAgainstGraph"
+        " will send edge %s\n", nodeId, node, 
+        sam::toString(edge.tuple).c_str());
+      messages.push_back(tupleToMessage(edge.tuple));
+    }
+  }
+
+  for (auto const& message : messages) {
+    if (terminated) {
+      break;
+    }
+
+    double placeholder = 0;
+    DETAIL_TIMING_BEG1
+    //#ifdef NOBLOCK
+    //bool sent = edgePushers[node]->send(message, ZMQ_NOBLOCK);     
+    //if (!sent) { 
+    //  edgePushFails.fetch_add(1);
+    //  edgePushCounter.fetch_add(-1);
+    //}
+    //#elif defined NOBLOCK_WHILE
+    //bool sent = false;
+    //while(!sent) {
+    //  sent = edgePushers[node]->send(message, ZMQ_NOBLOCK);
+    //}
+    //#else
+    bool sent = edgeCommunicator->send(message, node);
+    if (!sent) { 
+      edgePushFails.fetch_add(1);
+      DEBUG_PRINT("Node %lu->%lu GraphStore::processRequestAgainstGraph"
+        " failed sending edge\n", nodeId, node); 
+    } else {
+      edgePushCounter.fetch_add(1);
     }
+    //#endif
+    DETAIL_TIMING_END_TOL1(nodeId, placeholder, TOLERANCE, 
+      "GraphStore::processRequestAgainstGraph sending message exceeded "
+      "tolerance")
   }
 }
 
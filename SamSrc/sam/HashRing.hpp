@@ -0,0 +1,138 @@
+#ifndef SAM_HASH_RING_HPP
+#define SAM_HASH_RING_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sam {
+
+class HashRingException : public std::runtime_error {
+public:
+  HashRingException(char const * message) : std::runtime_error(message) {}
+  HashRingException(std::string message) : std::runtime_error(message) {}
+};
+
+/**
+ * A consistent-hash ring over a set of member nodes.  Each member is placed
+ * at pointsPerNode pseudo-random points on a 64-bit circle, and a hash is
+ * owned by the member with the first point at or after it.  Adding or
+ * removing a member only moves the hashes between its points and their
+ * predecessors, about 1 / (number of members) of the hashes, instead of
+ * nearly all of them as with hash % numNodes.
+ *
+ * A ring is immutable; adding or removing a member makes a new ring (see
+ * RoutingTable), so lookups need no locking.
+ */
+class HashRing
+{
+private:
+  /// (point on the circle, node), sorted by point
+  std::vector<std::pair<uint64_t, size_t>> points;
+
+  /// The members, sorted
+  std::vector<size_t> members;
+
+  size_t pointsPerNode;
+
+public:
+  /**
+   * Scrambles a hash so that similar hashes (e.g. from similar strings)
+   * are spread around the circle.  The splitmix64 finalizer.
+   */
+  static uint64_t mix(uint64_t x)
+  {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  /**
+   * \param members The ids of the nodes on the ring.  Must not be empty.
+   * \param pointsPerNode How many points each node has on the circle.
+   *   More points spread the hashes more evenly.
+   */
+  HashRing(std::vector<size_t> members, size_t pointsPerNode = 64) :
+    members(members), pointsPerNode(pointsPerNode)
+  {
+    if (members.empty()) {
+      throw HashRingException("HashRing must have at least one member");
+    }
+    if (pointsPerNode == 0) {
+      throw HashRingException("HashRing pointsPerNode must be > 0");
+    }
+    std::sort(this->members.begin(), this->members.end());
+    this->members.erase(
+      std::unique(this->members.begin(), this->members.end()),
+      this->members.end());
+
+    points.reserve(this->members.size() * pointsPerNode);
+    for (size_t node : this->members) {
+      for (size_t i = 0; i < pointsPerNode; i++) {
+        points.push_back(std::make_pair(mix((uint64_t(node) << 32) | i),
+                                        node));
+      }
+    }
+    std::sort(points.begin(), points.end());
+  }
+
+  /**
+   * The member that owns the hash.
+   */
+  size_t owner(uint64_t hash) const
+  {
+    uint64_t point = mix(hash);
+    auto it = std::lower_bound(points.begin(), points.end(),
+      std::make_pair(point, size_t(0)));
+    if (it == points.end()) {
+      it = points.begin();
+    }
+    return it->second;
+  }
+
+  /**
+   * Returns true if the node is on the ring.
+   */
+  bool contains(size_t node) const
+  {
+    return std::binary_search(members.begin(), members.end(), node);
+  }
+
+  std::vector<size_t> const& getMembers() const { return members; }
+
+  size_t size() const { return members.size(); }
+
+  size_t getPointsPerNode() const { return pointsPerNode; }
+
+  /**
+   * A ring with the node added.
+   */
+  HashRing with(size_t node) const
+  {
+    std::vector<size_t> newMembers = members;
+    newMembers.push_back(node);
+    return HashRing(newMembers, pointsPerNode);
+  }
+
+  /**
+   * A ring with the node removed.  Throws if it is the last member.
+   */
+  HashRing without(size_t node) const
+  {
+    std::vector<size_t> newMembers;
+    for (size_t member : members) {
+      if (member != node) {
+        newMembers.push_back(member);
+      }
+    }
+    return HashRing(newMembers, pointsPerNode);
+  }
+};
+
+} // end namespace sam
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef SAM_HEAVY_HITTERS_HPP
+#define SAM_HEAVY_HITTERS_HPP
+
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sam {
+
+class HeavyHittersException : public std::runtime_error {
+public:
+  HeavyHittersException(char const * message) : std::runtime_error(message) {}
+  HeavyHittersException(std::string message) : std::runtime_error(message) {}
+};
+
+/**
+ * Finds the most frequent keys of a stream with the Space-Saving algorithm
+ * (Metwally et al.).  At most capacity keys are counted.  When a new key
+ * arrives and the table is full, it replaces the key with the smallest
+ * count and takes over that count plus one.  A count therefore never
+ * underestimates, and any key seen more than total / capacity times is
+ * in the table.
+ *
+ * The counts are kept in a stream-summary: a list of buckets sorted by
+ * count, each holding the keys with that count.  Counting a key moves it
+ * to the next bucket, and the key to replace is any key of the first
+ * bucket, so add() is O(1) whether or not the key is in the table.
+ *
+ * Thread safe; every call takes the same lock.
+ */
+template <typename K, typename Hash = std::hash<K>>
+class HeavyHitters
+{
+private:
+  /// The keys that have the same count.
+  struct Bucket
+  {
+    size_t count;
+    std::list<K> keys;
+  };
+  typedef typename std::list<Bucket>::iterator BucketIterator;
+
+  /// Where a key is in the stream-summary.
+  struct Entry
+  {
+    BucketIterator bucket;
+    typename std::list<K>::iterator key;
+  };
+
+  size_t capacity;
+  size_t total = 0; ///> How many keys have been added
+  std::list<Bucket> buckets; ///> Sorted by increasing count
+  std::unordered_map<K, Entry, Hash> entries;
+  mutable std::mutex mutex;
+
+  /**
+   * Moves the key to the bucket with one more count, making that bucket
+   * if there isn't one.  Called with the lock held.
+   * \return Returns the key's new count.
+   */
+  size_t increment(Entry& entry)
+  {
+    BucketIterator bucket = entry.bucket;
+    size_t count = bucket->count + 1;
+    BucketIterator next = std::next(bucket);
+    if (next == buckets.end() || next->count != count) {
+      next = buckets.insert(next, Bucket{count, std::list<K>()});
+    }
+    next->keys.splice(next->keys.end(), bucket->keys, entry.key);
+    entry.bucket = next;
+    if (bucket->keys.empty()) {
+      buckets.erase(bucket);
+    }
+    return count;
+  }
+
+public:
+  /**
+   * \param capacity How many keys are counted.
+   */
+  HeavyHitters(size_t capacity) : capacity(capacity)
+  {
+    if (capacity == 0) {
+      throw HeavyHittersException("HeavyHitters capacity must be > 0");
+    }
+    entries.reserve(capacity);
+  }
+
+  /**
+   * Counts one occurrence of the key.
+   * \return Returns the key's (over)estimated count.
+   */
+  size_t add(K const& key)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    total++;
+
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      return increment(it->second);
+    }
+
+    if (entries.size() < capacity) {
+      if (buckets.empty() || buckets.front().count != 1) {
+        buckets.push_front(Bucket{1, std::list<K>()});
+      }
+      BucketIterator first = buckets.begin();
+      first->keys.push_back(key);
+      entries.emplace(key, Entry{first, std::prev(first->keys.end())});
+      return 1;
+    }
+
+    // Replace a key with the smallest count
+    BucketIterator min = buckets.begin();
+    auto replaced = entries.find(min->keys.front());
+    Entry entry = replaced->second;
+    entries.erase(replaced);
+    *entry.key = key;
+    return increment(entries.emplace(key, entry).first->second);
+  }
+
+  /**
+   * The estimated count of the key, or 0 if it isn't being counted.
+   */
+  size_t getCount(K const& key) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    return it == entries.end() ? 0 : it->second.bucket->count;
+  }
+
+  /**
+   * How many keys have been added.
+   */
+  size_t getTotal() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total;
+  }
+
+  /**
+   * Returns the keys whose estimated count is more than fraction of the
+   * total, with their counts.
+   */
+  std::vector<std::pair<K, size_t>> getHeavyHitters(double fraction) const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<K, size_t>> hitters;
+    for (auto bucket = buckets.rbegin(); bucket != buckets.rend() &&
+         bucket->count > fraction * total; ++bucket)
+    {
+      for (K const& key : bucket->keys) {
+        hitters.emplace_back(key, bucket->count);
+      }
+    }
+    return hitters;
+  }
+};
+
+} // end namespace sam
+
+#endif
@@ -0,0 +1,349 @@
+#ifndef SAM_HYPER_LOG_LOG_HPP
+#define SAM_HYPER_LOG_LOG_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+#include <sam/Simd.hpp>
+
+namespace sam {
+
+class HyperLogLogException : public std::runtime_error {
+public:
+  HyperLogLogException(char const * message) : std::runtime_error(message) { }
+  HyperLogLogException(std::string message) : std::runtime_error(message) { }
+};
+
+namespace hll_detail {
+
+/**
+ * Register kernels.  Each has a scalar version and an AVX2 version that
+ * handles 32 registers at a time; the callers pick one with cpuHasAvx2().
+ */
+
+/// dst[i] = max(dst[i], src[i])
+inline void mergeScalar(uint8_t* dst, uint8_t const* src, size_t m)
+{
+  for (size_t i = 0; i < m; i++) {
+    if (src[i] > dst[i]) dst[i] = src[i];
+  }
+}
+
+/// Sum of 2^-r over the registers and the number of zero registers.
+inline void sumScalar(uint8_t const* registers, size_t m,
+                      double& sum, size_t& zeros)
+{
+  sum = 0;
+  zeros = 0;
+  for (size_t i = 0; i < m; i++) {
+    sum += std::ldexp(1.0, -registers[i]);
+    zeros += registers[i] == 0;
+  }
+}
+
+#if SAM_HAS_AVX2_KERNELS
+
+SAM_TARGET_AVX2
+inline void mergeAvx2(uint8_t* dst, uint8_t const* src, size_t m)
+{
+  size_t i = 0;
+  for (; i + 32 <= m; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(dst + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_max_epu8(a, b));
+  }
+  mergeScalar(dst + i, src + i, m - i);
+}
+
+/**
+ * 2^-r is built directly as a float: exponent 127 - r, zero mantissa.
+ * Registers are at most 65 so the exponent never underflows.
+ */
+SAM_TARGET_AVX2
+inline void sumAvx2(uint8_t const* registers, size_t m,
+                    double& sum, size_t& zeros)
+{
+  __m256i const bias = _mm256_set1_epi32(127);
+  __m256i const zero = _mm256_setzero_si256();
+  sum = 0;
+  zeros = 0;
+  size_t i = 0;
+  for (; i + 32 <= m; i += 32) {
+    __m256i r = _mm256_loadu_si256(
+      reinterpret_cast<__m256i const*>(registers + i));
+    zeros += __builtin_popcount(static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(r, zero))));
+
+    __m256 acc = _mm256_setzero_ps();
+    for (int j = 0; j < 4; j++) {
+      __m256i r32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+        reinterpret_cast<__m128i const*>(registers + i + 8 * j)));
+      __m256i bits = _mm256_slli_epi32(_mm256_sub_epi32(bias, r32), 23);
+      acc = _mm256_add_ps(acc, _mm256_castsi256_ps(bits));
+    }
+    // A block is summed in float (relative error around 1e-7, far below
+    // the error of the estimate); the blocks are added up in double.
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),
+                             _mm256_extractf128_ps(acc, 1));
+    half = _mm_hadd_ps(half, half);
+    half = _mm_hadd_ps(half, half);
+    sum += _mm_cvtss_f32(half);
+  }
+  double tailSum;
+  size_t tailZeros;
+  sumScalar(registers + i, m - i, tailSum, tailZeros);
+  sum += tailSum;
+  zeros += tailZeros;
+}
+
+#endif
+
+inline void merge(uint8_t* dst, uint8_t const* src, size_t m)
+{
+#if SAM_HAS_AVX2_KERNELS
+  if (cpuHasAvx2()) return mergeAvx2(dst, src, m);
+#endif
+  mergeScalar(dst, src, m);
+}
+
+inline void sum(uint8_t const* registers, size_t m, double& sum,
+                size_t& zeros)
+{
+#if SAM_HAS_AVX2_KERNELS
+  if (cpuHasAvx2()) return sumAvx2(registers, m, sum, zeros);
+#endif
+  sumScalar(registers, m, sum, zeros);
+}
+
+/**
+ * Finalizer of MurmurHash3; std::hash of an integer is the integer itself,
+ * which would leave the high bits empty.
+ */
+inline uint64_t mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+} // end namespace hll_detail
+
+/**
+ * HyperLogLog distinct counter (Flajolet et al.) with 2^precision one byte
+ * registers.  Besides the registers it keeps the sum of 2^-r and the number
+ * of zero registers up to date on every change, so estimate() is O(1).
+ * merge() and recount() go over all of the registers with the vectorized
+ * kernels.
+ */
+class HyperLogLog
+{
+  friend class SlidingHyperLogLog;
+
+public:
+  static size_t const MIN_PRECISION = 4;
+  static size_t const MAX_PRECISION = 16;
+
+private:
+  size_t precision;
+  std::vector<uint8_t> registers;
+  double inverseSum; ///> Sum of 2^-r over the registers
+  size_t zeros; ///> Number of zero registers
+
+  /**
+   * merge() without the recount, for merging several in a row.
+   */
+  void mergeRegisters(HyperLogLog const& other) {
+    if (other.precision != precision) {
+      throw HyperLogLogException("HyperLogLog::merge precisions differ");
+    }
+    hll_detail::merge(registers.data(), other.registers.data(),
+                      registers.size());
+  }
+
+public:
+  /**
+   * \param precision log2 of the number of registers.  The standard error
+   *   is about 1.04 / sqrt(2^precision).
+   */
+  HyperLogLog(size_t precision = 10) : precision(precision)
+  {
+    if (precision < MIN_PRECISION || precision > MAX_PRECISION) {
+      throw HyperLogLogException("HyperLogLog precision must be between " +
+        boost::lexical_cast<std::string>(size_t(MIN_PRECISION)) + " and " +
+        boost::lexical_cast<std::string>(size_t(MAX_PRECISION)));
+    }
+    registers.assign(size_t(1) << precision, 0);
+    inverseSum = registers.size();
+    zeros = registers.size();
+  }
+
+  /**
+   * Hashes a value for add().
+   */
+  template <typename T>
+  static uint64_t hash(T const& value) {
+    return hll_detail::mix(std::hash<T>()(value));
+  }
+
+  /**
+   * Adds a hashed item.  Returns true if a register changed.
+   */
+  bool add(uint64_t hash) {
+    size_t index = hash >> (64 - precision);
+    uint64_t rest = hash << precision;
+    uint8_t rank = rest == 0 ? 64 - precision + 1 : __builtin_clzll(rest) + 1;
+    return raise(index, rank);
+  }
+
+  /**
+   * Sets the register to rank if that is bigger.  Returns true if it was.
+   */
+  bool raise(size_t index, uint8_t rank) {
+    uint8_t old = registers[index];
+    if (rank <= old) return false;
+    registers[index] = rank;
+    inverseSum += std::ldexp(1.0, -rank) - std::ldexp(1.0, -old);
+    if (old == 0) zeros--;
+    return true;
+  }
+
+  /**
+   * Takes the maximum of each register with the other's.
+   * \throws HyperLogLogException if the precisions differ.
+   */
+  void merge(HyperLogLog const& other) {
+    mergeRegisters(other);
+    recount();
+  }
+
+  /**
+   * Recomputes the sum and number of zeros from the registers.
+   */
+  void recount() {
+    hll_detail::sum(registers.data(), registers.size(), inverseSum, zeros);
+  }
+
+  void clear() {
+    std::memset(registers.data(), 0, registers.size());
+    inverseSum = registers.size();
+    zeros = registers.size();
+  }
+
+  /**
+   * Estimate of the number of distinct items, with linear counting for
+   * small cardinalities.
+   */
+  double estimate() const {
+    double m = registers.size();
+    double alpha;
+    switch (registers.size()) {
+      case 16: alpha = 0.673; break;
+      case 32: alpha = 0.697; break;
+      case 64: alpha = 0.709; break;
+      default: alpha = 0.7213 / (1 + 1.079 / m);
+    }
+    double raw = alpha * m * m / inverseSum;
+    if (raw <= 2.5 * m && zeros > 0) {
+      return m * std::log(m / zeros);
+    }
+    return raw;
+  }
+
+  size_t getPrecision() const { return precision; }
+
+  std::vector<uint8_t> const& getRegisters() const { return registers; }
+
+  size_t memoryUsage() const {
+    return sizeof(*this) + registers.capacity();
+  }
+
+  static size_t memoryUsage(size_t precision) {
+    return sizeof(HyperLogLog) + (size_t(1) << precision);
+  }
+};
+
+/**
+ * Distinct count over a sliding window of N items made of basic windows of
+ * b items, each with its own HyperLogLog.  A separate HyperLogLog holds the
+ * merge of all of the basic windows, so adding an item and estimating are
+ * O(1); when a basic window is dropped the merge is rebuilt from the
+ * remaining ones with the vectorized kernels, once every b items.
+ * With N == 0 there is a single HyperLogLog over the whole stream.
+ */
+class SlidingHyperLogLog
+{
+private:
+  size_t N;
+  size_t b;
+  std::vector<HyperLogLog> basicWindows; ///> Ring of N/b + 1 windows
+  size_t current = 0; ///> Index of the basic window being filled
+  size_t currentCount = 0; ///> Items in the current basic window
+  HyperLogLog window; ///> Merge of the basic windows
+
+public:
+  SlidingHyperLogLog(size_t N, size_t b, size_t precision) :
+    N(N), b(b), window(precision)
+  {
+    if (N > 0) {
+      if (b == 0 || b > N) {
+        throw HyperLogLogException("SlidingHyperLogLog: b must be > 0 and "
+          "<= N");
+      }
+      basicWindows.assign(N / b + 1, HyperLogLog(precision));
+    }
+  }
+
+  void add(uint64_t hash) {
+    if (N == 0) {
+      window.add(hash);
+      return;
+    }
+    if (currentCount == b) rotate();
+    basicWindows[current].add(hash);
+    window.add(hash);
+    currentCount++;
+  }
+
+  double estimate() const { return window.estimate(); }
+
+  size_t memoryUsage() const {
+    size_t bytes = sizeof(*this) + window.memoryUsage();
+    for (auto const& hll : basicWindows) bytes += hll.memoryUsage();
+    return bytes;
+  }
+
+  static size_t memoryUsage(size_t N, size_t b, size_t precision) {
+    size_t numWindows = N > 0 && b > 0 ? N / b + 2 : 1;
+    return sizeof(SlidingHyperLogLog) +
+           numWindows * HyperLogLog::memoryUsage(precision);
+  }
+
+private:
+  /**
+   * Starts a new basic window in place of the oldest one, so the window
+   * holds the new basic window and the N/b full ones before it.
+   */
+  void rotate() {
+    current = (current + 1) % basicWindows.size();
+    basicWindows[current].clear();
+    currentCount = 0;
+
+    window.clear();
+    for (auto const& hll : basicWindows) window.mergeRegisters(hll);
+    window.recount();
+  }
+};
+
+} // end namespace sam
+
+#endif
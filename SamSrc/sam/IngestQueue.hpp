@@ -0,0 +1,233 @@
+#ifndef SAM_INGEST_QUEUE_HPP
+#define SAM_INGEST_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sam/MpscQueue.hpp>
+#include <sam/Backoff.hpp>
+
+namespace sam {
+
+class IngestQueueException : public std::runtime_error {
+public:
+  IngestQueueException(char const * message) : std::runtime_error(message) {}
+  IngestQueueException(std::string message) : std::runtime_error(message) {}
+};
+
+/**
+ * What push() does when the queue is full.
+ */
+enum class IngestPolicy {
+  Block, ///> Wait for the drain thread to make room.
+  Drop ///> Drop the item and count it.
+};
+
+/**
+ * Puts a bounded MpscQueue between the threads that receive items (e.g.
+ * the pull threads of a PushPull) and the code that processes them.  The
+ * receiving threads only push, so a slow pipeline doesn't hold up polling
+ * the sockets.  A drain thread pops runs of up to batchSize items and
+ * hands each run to the handler.  Threads that have to wait (the drain
+ * thread on an empty queue, push() on a full one, flush()) wait with a
+ * Backoff, so an idle queue doesn't use a whole core.
+ *
+ * Counters are kept of the items pushed, dropped and handled, of pushes
+ * that found the queue full, and of the most items ever waiting.
+ */
+template <typename T>
+class IngestQueue
+{
+public:
+  typedef std::function<void(T const* items, size_t count)> HandlerType;
+
+private:
+  MpscQueue<T> queue;
+  HandlerType handler;
+  IngestPolicy policy;
+  size_t batchSize;
+
+  std::atomic<bool> stopped; ///> No more items are accepted
+  std::atomic<bool> finished; ///> The drain thread exits once it is empty
+  std::atomic<size_t> numPushing; ///> push() calls in progress
+  std::thread drainThread;
+
+  std::atomic<size_t> numPushed; ///> Items that made it into the queue
+  std::atomic<size_t> numDropped; ///> Items dropped (full or stopped)
+  std::atomic<size_t> numFull; ///> Pushes that found the queue full
+  std::atomic<size_t> numHandled; ///> Items given to the handler
+  std::atomic<size_t> maxOccupancy; ///> Most items seen waiting
+
+  void drainLoop();
+
+  /**
+   * The body of push().  Called with numPushing counting this call.
+   */
+  bool tryPush(T const& item);
+
+  void noteOccupancy() {
+    size_t occupancy = queue.size();
+    size_t max = maxOccupancy.load(std::memory_order_relaxed);
+    while (occupancy > max &&
+           !maxOccupancy.compare_exchange_weak(max, occupancy)) {}
+  }
+
+public:
+  /**
+   * \param capacity How many items can wait in the queue.
+   * \param handler Called on the drain thread with each run of items.
+   * \param policy What push() does when the queue is full.
+   * \param batchSize The most items given to the handler at once.
+   */
+  IngestQueue(size_t capacity, HandlerType handler,
+              IngestPolicy policy = IngestPolicy::Block,
+              size_t batchSize = 64) :
+    queue(capacity), handler(handler), policy(policy), batchSize(batchSize),
+    stopped(false), finished(false), numPushing(0), numPushed(0), numDropped(0), numFull(0), numHandled(0),
+    maxOccupancy(0)
+  {
+    if (batchSize == 0) {
+      throw IngestQueueException("IngestQueue batchSize must be > 0");
+    }
+    drainThread = std::thread(&IngestQueue::drainLoop, this);
+  }
+
+  ~IngestQueue() {
+    stop();
+  }
+
+  IngestQueue(IngestQueue const&) = delete;
+  IngestQueue& operator=(IngestQueue const&) = delete;
+
+  /**
+   * Adds the item.  Can be called from any number of threads.
+   * \return Returns false if the item was dropped, either because the
+   *   queue was full under IngestPolicy::Drop or because stop() was called.
+   */
+  bool push(T const& item);
+
+  /**
+   * Waits until the handler has been given every item pushed before the
+   * call.
+   */
+  void flush();
+
+  /**
+   * Hands the items still waiting to the handler and stops the drain
+   * thread.  Pushes that were under way when stop() was called finish
+   * first, so every item counted as pushed is handled.  Items pushed after
+   * stop() are dropped.
+   */
+  void stop();
+
+  size_t size() const { return queue.size(); }
+  size_t capacity() const { return queue.capacity(); }
+  size_t getNumPushed() const { return numPushed; }
+  size_t getNumDropped() const { return numDropped; }
+  size_t getNumFull() const { return numFull; }
+  size_t getNumHandled() const { return numHandled; }
+  size_t getMaxOccupancy() const { return maxOccupancy; }
+};
+
+template <typename T>
+bool IngestQueue<T>::push(T const& item)
+{
+  // Counted before stopped is checked, so stop() either sees this push
+  // and waits for it, or this push sees stopped.
+  numPushing.fetch_add(1);
+  bool pushed = tryPush(item);
+  numPushing.fetch_sub(1);
+  return pushed;
+}
+
+template <typename T>
+bool IngestQueue<T>::tryPush(T const& item)
+{
+  if (stopped) {
+    numDropped.fetch_add(1);
+    return false;
+  }
+
+  if (!queue.push(item)) {
+    numFull.fetch_add(1);
+    if (policy == IngestPolicy::Drop) {
+      numDropped.fetch_add(1);
+      return false;
+    }
+    Backoff backoff;
+    while (!queue.push(item)) {
+      if (stopped) {
+        numDropped.fetch_add(1);
+        return false;
+      }
+      backoff.wait();
+    }
+  }
+  numPushed.fetch_add(1);
+  noteOccupancy();
+  return true;
+}
+
+template <typename T>
+void IngestQueue<T>::flush()
+{
+  size_t pushed = numPushed;
+  Backoff backoff;
+  while (numHandled < pushed && drainThread.joinable()) {
+    backoff.wait();
+  }
+}
+
+template <typename T>
+void IngestQueue<T>::stop()
+{
+  if (stopped.exchange(true)) {
+    return;
+  }
+  Backoff backoff;
+  while (numPushing > 0) {
+    backoff.wait();
+  }
+  finished = true;
+  if (drainThread.joinable()) {
+    drainThread.join();
+  }
+}
+
+template <typename T>
+void IngestQueue<T>::drainLoop()
+{
+  std::vector<T> items(batchSize);
+  Backoff backoff;
+  while (true) {
+    size_t count = queue.popBatch(items.data(), batchSize);
+    if (count > 0) {
+      backoff.reset();
+      try {
+        handler(items.data(), count);
+      } catch (std::exception const& e) {
+        printf("IngestQueue handler caught exception: %s\n", e.what());
+      }
+      numHandled.fetch_add(count);
+    } else if (finished) {
+      // Every push has returned, but the last slots written may not be
+      // visible yet.  Once the queue is empty there is nothing left.
+      if (queue.size() == 0) {
+        break;
+      }
+      std::this_thread::yield();
+    } else {
+      backoff.wait();
+    }
+  }
+}
+
+} // end namespace sam
+
+#endif
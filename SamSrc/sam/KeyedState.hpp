@@ -0,0 +1,220 @@
+#ifndef SAM_KEYED_STATE_HPP
+#define SAM_KEYED_STATE_HPP
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+namespace sam {
+
+class KeyedStateException : public std::runtime_error {
+public:
+  KeyedStateException(char const * message) : std::runtime_error(message) { }
+  KeyedStateException(std::string message) : std::runtime_error(message) { }
+};
+
+/**
+ * A function object that pulls the time out of a tuple.  Operators that
+ * evict idle keys take a std::function<double(TupleType const&)>; this
+ * gives one for a time field, e.g. TimeFieldFunction<TimeSeconds>().
+ */
+template <size_t timeField>
+struct TimeFieldFunction
+{
+  template <typename TupleType>
+  double operator()(TupleType const& tuple) const {
+    return std::get<timeField>(tuple);
+  }
+};
+
+/**
+ * Per-key state for the windowed operators (one sliding window per key).
+ *
+ * Lookup is a hash table.  The entries are also on an intrusive list
+ * ordered by last access, which is used for two kinds of eviction:
+ *   - keys that haven't been seen for more than ttl (in tuple time) are
+ *     dropped, and
+ *   - when the estimated bytes held go over maxBytes, the least recently
+ *     used keys are dropped.
+ * Both are checked from the cold end of the list each time a key is
+ * accessed, so eviction is amortized O(1).  The key being accessed is
+ * never evicted.  Tuple time is assumed to be roughly increasing; a key
+ * that is out of order in time is kept until it is at the cold end.
+ *
+ * \tparam ValueType The per-key state.  Usually a std::shared_ptr to a
+ *   sliding window.
+ */
+template <typename ValueType>
+class KeyedState
+{
+private:
+  struct Entry {
+    ValueType value;
+    double lastTime = 0; ///> Tuple time of the last access
+    std::string const* key = nullptr; ///> Points at the key in the table
+    Entry* newer = nullptr; ///> Toward the most recently used end
+    Entry* older = nullptr; ///> Toward the least recently used end
+
+    Entry(ValueType const& value) : value(value) {}
+  };
+
+  typedef std::unordered_map<std::string, Entry> TableType;
+
+  TableType table; ///> Nodes are stable, so the list can point into them
+
+  Entry* newest = nullptr; ///> Most recently used entry
+  Entry* oldest = nullptr; ///> Least recently used entry
+
+  double ttl; ///> Keys idle longer than this are evicted. 0 means never.
+  size_t maxBytes; ///> Budget for bytesHeld.  0 means no limit.
+  size_t valueBytes; ///> Estimate of the memory held by one value
+
+  size_t bytesHeld = 0; ///> Estimate of the memory held by all keys
+  size_t keysEvicted = 0; ///> Total number of keys evicted
+
+  void unlink(Entry* entry);
+  void pushNewest(Entry* entry);
+  void erase(Entry* entry);
+
+  /// Estimated memory of one key and its value.  Uses the size of the key
+  /// rather than its capacity, which differs between copies of a string,
+  /// so that an entry is charged and refunded the same amount.
+  size_t entryBytes(std::string const& key) const {
+    return sizeof(typename TableType::value_type) + key.size() + valueBytes;
+  }
+
+public:
+  /**
+   * \param ttl How long (in tuple time) a key can go without being seen
+   *   before it is evicted.  0 means keys are never evicted for age.
+   * \param maxBytes The memory budget.  The least recently used keys are
+   *   evicted to stay under it.  0 means no limit.
+   * \param valueBytes An estimate of the memory held by one value, used
+   *   to account against maxBytes.
+   */
+  KeyedState(double ttl = 0, size_t maxBytes = 0,
+             size_t valueBytes = sizeof(ValueType));
+
+  KeyedState(KeyedState const&) = delete;
+  KeyedState& operator=(KeyedState const&) = delete;
+
+  /**
+   * Returns the value for the key, creating it with factory() if it isn't
+   * there.  The key becomes the most recently used, and then idle and
+   * over budget keys are evicted.  The reference is good until the next
+   * call to get().
+   * \param key The key.
+   * \param time The tuple time of the access.
+   * \param factory Creates the value for a new key.
+   */
+  template <typename Factory>
+  ValueType& get(std::string const& key, double time, Factory&& factory);
+
+  /**
+   * Returns a pointer to the value of the key, or nullptr if the key isn't
+   * present.  Does not count as an access.
+   */
+  ValueType* find(std::string const& key);
+
+  /**
+   * Calls function(key, value) on every key.
+   */
+  template <typename Function>
+  void forEach(Function&& function) const {
+    for (auto const& p : table) {
+      function(p.first, p.second.value);
+    }
+  }
+
+  size_t size() const { return table.size(); }
+  size_t getBytesHeld() const { return bytesHeld; }
+  size_t getKeysEvicted() const { return keysEvicted; }
+};
+
+template <typename ValueType>
+KeyedState<ValueType>::KeyedState(double ttl, size_t maxBytes,
+                                  size_t valueBytes) :
+  ttl(ttl), maxBytes(maxBytes), valueBytes(valueBytes)
+{
+  if (ttl < 0) {
+    throw KeyedStateException("KeyedState ttl must not be negative");
+  }
+}
+
+template <typename ValueType>
+void KeyedState<ValueType>::unlink(Entry* entry)
+{
+  if (entry->newer) entry->newer->older = entry->older;
+  else newest = entry->older;
+  if (entry->older) entry->older->newer = entry->newer;
+  else oldest = entry->newer;
+  entry->newer = entry->older = nullptr;
+}
+
+template <typename ValueType>
+void KeyedState<ValueType>::pushNewest(Entry* entry)
+{
+  entry->older = newest;
+  entry->newer = nullptr;
+  if (newest) newest->newer = entry;
+  newest = entry;
+  if (!oldest) oldest = entry;
+}
+
+template <typename ValueType>
+void KeyedState<ValueType>::erase(Entry* entry)
+{
+  unlink(entry);
+  bytesHeld -= entryBytes(*entry->key);
+  keysEvicted++;
+  // Copy the key since erasing frees the string it points at.
+  std::string key = *entry->key;
+  table.erase(key);
+}
+
+template <typename ValueType>
+template <typename Factory>
+ValueType&
+KeyedState<ValueType>::get(std::string const& key, double time,
+                           Factory&& factory)
+{
+  auto it = table.find(key);
+  Entry* entry;
+  if (it == table.end()) {
+    it = table.emplace(key, Entry(factory())).first;
+    entry = &it->second;
+    entry->key = &it->first;
+    bytesHeld += entryBytes(it->first);
+  } else {
+    entry = &it->second;
+    unlink(entry);
+  }
+  entry->lastTime = time;
+  pushNewest(entry);
+
+  if (ttl > 0) {
+    while (oldest != entry && time - oldest->lastTime > ttl) {
+      erase(oldest);
+    }
+  }
+  if (maxBytes > 0) {
+    while (oldest != entry && bytesHeld > maxBytes) {
+      erase(oldest);
+    }
+  }
+  return entry->value;
+}
+
+template <typename ValueType>
+ValueType* KeyedState<ValueType>::find(std::string const& key)
+{
+  auto it = table.find(key);
+  if (it == table.end()) return nullptr;
+  return &it->second.value;
+}
+
+} // end namespace sam
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef SAM_KLL_SKETCH_HPP
+#define SAM_KLL_SKETCH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+namespace sam {
+
+class KllSketchException : public std::runtime_error {
+public:
+  KllSketchException(char const * message) : std::runtime_error(message) { }
+  KllSketchException(std::string message) : std::runtime_error(message) { }
+};
+
+/**
+ * A KLL quantile sketch (Karnin, Lang and Liberty).  Items are kept in
+ * levels; an item at level h stands for 2^h items of the stream.  When the
+ * sketch holds more items than its capacity, the lowest level that is over
+ * its own capacity is sorted and every other item is promoted to the next
+ * level (the offset is chosen at random), halving the level.  The capacity
+ * of a level shrinks by 2/3 for each level below the top, so the sketch
+ * holds about 3k items whatever the length of the stream.
+ *
+ * Updates are amortized O(log k).  Two sketches with the same k can be
+ * merged, which is what makes the sketch usable over sliding windows made
+ * of smaller windows.
+ */
+template <typename T>
+class KllSketch
+{
+public:
+  static size_t const DEFAULT_K = 200;
+  static size_t const MIN_LEVEL_CAPACITY = 2;
+
+private:
+  size_t k;
+  std::vector<std::vector<T>> levels; ///> levels[h] holds items of weight 2^h
+  std::vector<size_t> capacities; ///> Capacity of each level
+  size_t totalCapacity = 0;
+  size_t numRetained = 0; ///> Number of items held over all levels
+  uint64_t n = 0; ///> Number of items the sketch summarizes
+  uint64_t randomState = 0x9E3779B97F4A7C15ull; ///> For the compaction offset
+
+  void addLevel();
+  void compress();
+  void compact(size_t level);
+  bool randomBit();
+
+public:
+  /**
+   * \param k Determines the accuracy.  The rank error is about 1.7 / k.
+   */
+  KllSketch(size_t k = DEFAULT_K);
+
+  /**
+   * Adds an item to the sketch.
+   */
+  void update(T item);
+
+  /**
+   * Adds the items of the other sketch to this one.
+   * \throws KllSketchException if the sketches have different k.
+   */
+  void merge(KllSketch<T> const& other);
+
+  /**
+   * Returns the number of items summarized by the sketch.
+   */
+  uint64_t getN() const { return n; }
+
+  /**
+   * Returns the number of items held by the sketch.
+   */
+  size_t getNumRetained() const { return numRetained; }
+
+  size_t getK() const { return k; }
+
+  /**
+   * The held items with their weights, sorted by item.
+   */
+  std::vector<std::pair<T, uint64_t>> getSortedView() const;
+
+  /**
+   * Returns an estimate of the item with the given rank (0 is the
+   * minimum, 1 the maximum).
+   * \throws KllSketchException if the sketch is empty.
+   */
+  T getQuantile(double q) const;
+
+  /**
+   * Returns an estimate of the bytes held by this sketch.
+   */
+  size_t memoryUsage() const;
+
+  /**
+   * Returns an estimate of the bytes held by a sketch with the given k
+   * that has seen many items.
+   */
+  static size_t memoryUsage(size_t k) {
+    return sizeof(KllSketch<T>) + 3 * k * sizeof(T) +
+           32 * (sizeof(std::vector<T>) + sizeof(size_t));
+  }
+};
+
+template <typename T>
+KllSketch<T>::KllSketch(size_t k) : k(k)
+{
+  if (k < MIN_LEVEL_CAPACITY) {
+    throw KllSketchException("KllSketch k must be at least " +
+      boost::lexical_cast<std::string>(size_t(MIN_LEVEL_CAPACITY)));
+  }
+  addLevel();
+}
+
+/**
+ * Adds a level on top and recomputes the capacities, which depend on the
+ * distance of each level from the top.
+ */
+template <typename T>
+void KllSketch<T>::addLevel()
+{
+  levels.emplace_back();
+  capacities.resize(levels.size());
+  totalCapacity = 0;
+  size_t numLevels = levels.size();
+  for (size_t h = 0; h < numLevels; h++) {
+    size_t depth = numLevels - 1 - h;
+    size_t capacity = static_cast<size_t>(
+      std::ceil(k * std::pow(2.0 / 3.0, depth)));
+    capacities[h] = capacity < MIN_LEVEL_CAPACITY ? MIN_LEVEL_CAPACITY :
+                                                    capacity;
+    totalCapacity += capacities[h];
+  }
+}
+
+template <typename T>
+bool KllSketch<T>::randomBit()
+{
+  // xorshift64
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+  return randomState & 1;
+}
+
+template <typename T>
+void KllSketch<T>::update(T item)
+{
+  levels[0].push_back(item);
+  numRetained++;
+  n++;
+  if (numRetained >= totalCapacity) compress();
+}
+
+/**
+ * Compacts the lowest level that is over its capacity until the sketch is
+ * back under its total capacity.  Usually one compaction is enough (the
+ * lazy variant of KLL).
+ */
+template <typename T>
+void KllSketch<T>::compress()
+{
+  while (numRetained >= totalCapacity) {
+    size_t level = 0;
+    while (levels[level].size() < capacities[level]) {
+      level++;
+      if (level == levels.size()) return;
+    }
+    compact(level);
+  }
+}
+
+template <typename T>
+void KllSketch<T>::compact(size_t level)
+{
+  if (level + 1 == levels.size()) addLevel();
+  std::vector<T>& items = levels[level];
+  std::vector<T>& above = levels[level + 1];
+
+  // With an odd number of items the last one stays behind.
+  bool odd = items.size() % 2 == 1;
+  T leftOver = odd ? items.back() : T();
+  if (odd) items.pop_back();
+
+  std::sort(items.begin(), items.end());
+  size_t offset = randomBit() ? 1 : 0;
+  for (size_t i = offset; i < items.size(); i += 2) {
+    above.push_back(items[i]);
+  }
+  numRetained -= items.size() / 2;
+  items.clear();
+
+  // A level's capacity shrinks as levels are added above it, so give back
+  // the memory it needed when it was nearer the top.
+  if (items.capacity() > 2 * capacities[level]) {
+    std::vector<T>().swap(items);
+    items.reserve(capacities[level]);
+  }
+  if (odd) items.push_back(leftOver);
+}
+
+template <typename T>
+void KllSketch<T>::merge(KllSketch<T> const& other)
+{
+  if (other.k != k) {
+    throw KllSketchException("KllSketch::merge sketches have different k");
+  }
+  while (levels.size() < other.levels.size()) addLevel();
+  for (size_t h = 0; h < other.levels.size(); h++) {
+    levels[h].insert(levels[h].end(), other.levels[h].begin(),
+                     other.levels[h].end());
+  }
+  numRetained += other.numRetained;
+  n += other.n;
+  compress();
+}
+
+template <typename T>
+std::vector<std::pair<T, uint64_t>> KllSketch<T>::getSortedView() const
+{
+  std::vector<std::pair<T, uint64_t>> view;
+  view.reserve(numRetained);
+  for (size_t h = 0; h < levels.size(); h++) {
+    uint64_t weight = uint64_t(1) << h;
+    for (T const& item : levels[h]) view.emplace_back(item, weight);
+  }
+  std::sort(view.begin(), view.end());
+  return view;
+}
+
+template <typename T>
+T KllSketch<T>::getQuantile(double q) const
+{
+  if (n == 0) {
+    throw KllSketchException("KllSketch::getQuantile on an empty sketch");
+  }
+  auto view = getSortedView();
+  uint64_t total = 0;
+  for (auto const& p : view) total += p.second;
+
+  double target = q * total;
+  uint64_t cumulative = 0;
+  for (auto const& p : view) {
+    cumulative += p.second;
+    if (cumulative >= target) return p.first;
+  }
+  return view.back().first;
+}
+
+template <typename T>
+size_t KllSketch<T>::memoryUsage() const
+{
+  size_t bytes = sizeof(*this) +
+    levels.capacity() * sizeof(std::vector<T>) +
+    capacities.capacity() * sizeof(size_t);
+  for (auto const& level : levels) bytes += level.capacity() * sizeof(T);
+  return bytes;
+}
+
+} // end namespace sam
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef SAM_MPSC_QUEUE_HPP
+#define SAM_MPSC_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace sam {
+
+/**
+ * A bounded, lock-free queue for any number of producer threads and one
+ * consumer thread.  Each slot has a sequence number that tells producers
+ * whether the slot is free for the position they claimed and tells the
+ * consumer whether the item in it has been written, so producers only
+ * contend on the tail counter and never wait on each other's writes.
+ */
+template <typename T>
+class MpscQueue
+{
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  /// head and tail are kept on separate cache lines by padding rather 
+  /// than alignas, since plain new doesn't honor over-alignment before 
+  /// C++17.
+  static size_t const CACHE_LINE = 64;
+
+  size_t mask; ///> capacity - 1, capacity is always a power of two
+  Slot* slots; ///> The ring of slots
+
+  char padHead[CACHE_LINE];
+
+  /// Next position to pop.  Written only by the consumer.
+  std::atomic<size_t> head;
+
+  char padTail[CACHE_LINE];
+
+  /// Next position to claim.  Producers race on it with compare exchange.
+  std::atomic<size_t> tail;
+
+  char padEnd[CACHE_LINE];
+
+public:
+  /**
+   * \param capacity How many items the queue can hold.  Rounded up to a
+   *   power of two.
+   */
+  MpscQueue(size_t capacity) : head(0), tail(0)
+  {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    mask = cap - 1;
+    slots = new Slot[cap];
+    for (size_t i = 0; i < cap; i++) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpscQueue()
+  {
+    delete[] slots;
+  }
+
+  MpscQueue(MpscQueue const&) = delete;
+  MpscQueue& operator=(MpscQueue const&) = delete;
+
+  /**
+   * Adds the item to the back of the queue.  Called by any producer.
+   * \return Returns false if the queue is full.
+   */
+  bool push(T const& item)
+  {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots[pos & mask];
+      size_t seq = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // The slot is free for pos; claim pos.
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The consumer hasn't freed the slot from the last time around.
+        return false;
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->item = item;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Removes the item at the front of the queue.  Called by the consumer.
+   * \return Returns false if the queue is empty (or the item at the front
+   *   is still being written).
+   */
+  bool pop(T& item)
+  {
+    return popBatch(&item, 1) == 1;
+  }
+
+  /**
+   * Removes up to max items from the front of the queue into out.  Called
+   * by the consumer.
+   * \return Returns the number of items removed.
+   */
+  size_t popBatch(T* out, size_t max)
+  {
+    size_t pos = head.load(std::memory_order_relaxed);
+    size_t n = 0;
+    while (n < max) {
+      Slot& slot = slots[(pos + n) & mask];
+      if (slot.sequence.load(std::memory_order_acquire) != pos + n + 1) {
+        break;
+      }
+      out[n] = std::move(slot.item);
+      // Free the slot for the position one lap ahead.
+      slot.sequence.store(pos + n + mask + 1, std::memory_order_release);
+      n++;
+    }
+    head.store(pos + n, std::memory_order_release);
+    return n;
+  }
+
+  /**
+   * The number of items claimed and not yet popped.  Only a snapshot if
+   * other threads are active.
+   */
+  size_t size() const
+  {
+    size_t h = head.load(std::memory_order_acquire);
+    size_t t = tail.load(std::memory_order_acquire);
+    // Items may be popped and pushed between the two loads, so the
+    // difference can overshoot.
+    return t > h ? std::min(t - h, mask + 1) : 0;
+  }
+
+  size_t capacity() const { return mask + 1; }
+};
+
+} // end namespace sam
+
+#endif
@@ -54,9 +54,9 @@ public:
     // time a DestIp talks to a SrcIp, that stays around forever, no matter
     // how long ago it took place.  
     for (auto id : identifiers) {
-      if (featureMap->exists(origKey, edge.id)) {
-        std::shared_ptr<const Feature> origFeature = 
-          featureMap->at(origKey, id);
+      std::shared_ptr<const Feature> origFeature = 
+        featureMap->find(origKey, id);
+      if (origFeature) {
         std::map<std::string, std::shared_ptr<Feature>> localFeatureMap;
         localFeatureMap[projectKey] = origFeature->createCopy();
         MapFeature mapFeature(localFeatureMap);
@@ -0,0 +1,201 @@
+#ifndef SAM_QUANTILE_HPP
+#define SAM_QUANTILE_HPP
+
+/**
+ * Estimates quantiles (e.g. the median) of a field over a sliding window
+ * using KLL sketches.
+ */
+
+#include <deque>
+#include <functional>
+#include <iostream>
+
+#include <sam/AbstractConsumer.hpp>
+#include <sam/BaseComputation.hpp>
+#include <sam/Features.hpp>
+#include <sam/FeatureProducer.hpp>
+#include <sam/KeyedState.hpp>
+#include <sam/KllSketch.hpp>
+#include <sam/Util.hpp>
+#include <sam/tuples/Edge.hpp>
+
+namespace sam {
+
+class QuantileException : public std::runtime_error {
+public:
+  QuantileException(char const * message) : std::runtime_error(message) { }
+  QuantileException(std::string message) : std::runtime_error(message) { }
+};
+
+/**
+ * The window of a key is made of N/b basic windows of b items, each with
+ * its own sketch.  When a basic window fills up, the oldest one is dropped
+ * and the rest are merged into a QuantileFeature, so the feature reflects
+ * the last N items as of the last full basic window.  The cost of the
+ * merge is spread over the b items of a basic window; the rest of the
+ * updates only touch the sketch of the current basic window.
+ */
+template <typename T, typename EdgeType,
+          size_t valueField, size_t... keyFields>
+class Quantile: public AbstractConsumer<EdgeType>,
+                public BaseComputation,
+                public FeatureProducer
+{
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+  typedef std::function<double(TupleType const&)> TimeFunction;
+
+private:
+  size_t N; ///> Total number of items in the window
+  size_t b; ///> Number of items in a basic window
+  size_t k; ///> Accuracy of the sketches
+  double q; ///> The quantile given to subscribers and by getValue()
+
+  struct Window {
+    std::deque<KllSketch<T>> full; ///> Full basic windows, oldest first
+    KllSketch<T> current; ///> The basic window being filled
+    size_t currentCount = 0;
+    double value = 0; ///> Quantile q of the last published feature
+
+    Window(size_t k) : current(k) {}
+  };
+
+  KeyedState<std::shared_ptr<Window>> allWindows;
+
+  TimeFunction timeFunction; ///> Gets the time of a tuple for evicting keys
+
+  std::shared_ptr<QuantileFeature::Summary const>
+  summarize(Window const& window) const;
+
+public:
+  /**
+   * Constructor.
+   * \param N The number of items in the sliding window.
+   * \param b The number of items in a basic window.
+   * \param k Determines the accuracy of the sketches; the rank error is
+   *   about 1.7 / k.
+   * \param q The quantile given to subscribers, e.g. 0.5 for the median.
+   *   Any quantile can be read from the published QuantileFeature.
+   * \param nodeId The nodeId of the node that is running this operator.
+   * \param featureMap The global featureMap that holds the features produced
+   *                   by this operator.
+   * \param identifier A unique identifier associated with this operator.
+   * \param keyTtl Keys not seen for this long (in tuple time) are evicted.
+   *               0 means keys are never evicted for age.
+   * \param maxStateBytes Memory budget for the per-key windows.  0 means no
+   *               limit.
+   * \param timeFunction Gets the time of a tuple.  Required if keyTtl > 0.
+   */
+  Quantile(size_t N, size_t b, size_t k, double q,
+           size_t nodeId,
+           std::shared_ptr<FeatureMap> featureMap,
+           std::string identifier,
+           double keyTtl = 0,
+           size_t maxStateBytes = 0,
+           TimeFunction timeFunction = TimeFunction());
+
+  bool consume(EdgeType const& edge);
+
+  void terminate() {}
+};
+
+template <typename T, typename EdgeType,
+          size_t valueField, size_t... keyFields>
+Quantile<T, EdgeType, valueField, keyFields...>::Quantile(
+  size_t N, size_t b, size_t k, double q,
+  size_t nodeId,
+  std::shared_ptr<FeatureMap> featureMap,
+  std::string identifier,
+  double keyTtl,
+  size_t maxStateBytes,
+  TimeFunction timeFunction) :
+  BaseComputation(nodeId, featureMap, identifier),
+  N(N), b(b), k(k), q(q),
+  allWindows(keyTtl, maxStateBytes,
+    (b > 0 ? N / b + 1 : 1) * KllSketch<T>::memoryUsage(k)),
+  timeFunction(timeFunction)
+{
+  if (b == 0 || b > N) {
+    throw QuantileException("Quantile: b must be > 0 and <= N");
+  }
+  if (q < 0 || q > 1) {
+    throw QuantileException("Quantile: q must be in [0, 1]");
+  }
+  if (keyTtl > 0 && !timeFunction) {
+    throw KeyedStateException("Quantile: keyTtl requires a timeFunction");
+  }
+}
+
+/**
+ * Merges the full basic windows and turns the result into ranks.
+ */
+template <typename T, typename EdgeType,
+          size_t valueField, size_t... keyFields>
+std::shared_ptr<QuantileFeature::Summary const>
+Quantile<T, EdgeType, valueField, keyFields...>::summarize(
+  Window const& window) const
+{
+  KllSketch<T> merged(k);
+  for (auto const& sketch : window.full) merged.merge(sketch);
+
+  auto view = merged.getSortedView();
+  double total = 0;
+  for (auto const& p : view) total += p.second;
+
+  auto summary = std::make_shared<QuantileFeature::Summary>();
+  summary->values.reserve(view.size());
+  summary->ranks.reserve(view.size());
+  double cumulative = 0;
+  for (auto const& p : view) {
+    cumulative += p.second;
+    summary->values.push_back(static_cast<double>(p.first));
+    summary->ranks.push_back(cumulative / total);
+  }
+  return summary;
+}
+
+template <typename T, typename EdgeType,
+          size_t valueField, size_t... keyFields>
+bool Quantile<T, EdgeType, valueField, keyFields...>::consume(
+  EdgeType const& edge)
+{
+  this->feedCount++;
+  if (this->feedCount % this->metricInterval == 0) {
+    std::cout << "Quantile NodeId " << this->nodeId << " number of keys "
+              << allWindows.size() << " keys evicted "
+              << allWindows.getKeysEvicted() << " bytes held "
+              << allWindows.getBytesHeld() << " feedCount "
+              << this->feedCount << std::endl;
+  }
+
+  // Generates unique key from key fields
+  std::string key = generateKey<keyFields...>(edge.tuple);
+
+  double time = timeFunction ? timeFunction(edge.tuple) : 0;
+  auto window = allWindows.get(key, time, [this]() {
+    return std::make_shared<Window>(k);
+  });
+
+  T value = static_cast<T>(std::get<valueField>(edge.tuple));
+  window->current.update(value);
+  window->currentCount++;
+
+  if (window->currentCount == b) {
+    window->full.push_back(std::move(window->current));
+    window->current = KllSketch<T>(k);
+    window->currentCount = 0;
+    if (window->full.size() > N / b) window->full.pop_front();
+
+    QuantileFeature feature(summarize(*window), q);
+    window->value = feature.getValue();
+    this->featureMap->updateInsert(key, this->identifier, feature);
+  }
+
+  this->notifySubscribers(edge.id, window->value);
+
+  return true;
+}
+
+} // end namespace sam
+
+#endif
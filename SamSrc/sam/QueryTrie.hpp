@@ -0,0 +1,206 @@
+#ifndef SAM_QUERY_TRIE_HPP
+#define SAM_QUERY_TRIE_HPP
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+namespace sam {
+
+/**
+ * A node of a QueryTrie.  All the queries of a node accept the same first
+ * depth edges (see SubgraphQuery::matchesEdge), so a partial result for
+ * those edges can stand in for one result per query.  After depth edges
+ * the queries diverge: the ones that have exactly depth edges are
+ * complete, and the rest continue in the children.
+ */
+template <typename QueryType>
+struct QueryTrieNode
+{
+  typedef std::shared_ptr<const QueryType> QueryPointer;
+  typedef std::shared_ptr<const QueryTrieNode<QueryType>> NodePointer;
+
+  /// How many leading edges the queries share.
+  size_t depth = 0;
+
+  /// The queries that go through this node.  The first stands in for the
+  /// others while the edges are shared.
+  std::vector<QueryPointer> queries;
+
+  /// The queries that are complete after depth edges.
+  std::vector<QueryPointer> completes;
+
+  /// One child for each way the remaining queries continue.
+  std::vector<NodePointer> children;
+
+  /// The largest max time extent of the queries, so that a shared partial
+  /// result lives as long as any of its queries needs it.
+  double maxTimeExtent = 0;
+
+  QueryPointer representative() const { return queries.front(); }
+
+  /**
+   * Returns true if partial results at this node stand in for more than
+   * one query.
+   */
+  bool isShared() const { return queries.size() > 1; }
+};
+
+/**
+ * Merges subgraph queries into a trie of their shared edge-description
+ * prefixes.  The queries are compared edge by edge in their sorted (plan)
+ * order, so two queries share a prefix if their first edges are matched
+ * by the same tuples with the same variable bindings.  For example,
+ * triangle queries that differ only in the time constraint of the last
+ * edge share their first two edges.
+ *
+ * The trie is compressed: a node covers the whole run of edges that its
+ * queries share, and only branches where they diverge.  It is rebuilt
+ * when a query is added, which happens before streaming starts.
+ */
+template <typename QueryType>
+class QueryTrie
+{
+public:
+  typedef QueryTrieNode<QueryType> NodeType;
+  typedef typename NodeType::QueryPointer QueryPointer;
+  typedef typename NodeType::NodePointer NodePointer;
+
+private:
+  std::vector<QueryPointer> queries;
+
+  /// One root for each distinct first edge.
+  std::vector<NodePointer> roots;
+
+  /**
+   * Splits the queries into groups that match on the given edge.
+   */
+  static std::vector<std::vector<QueryPointer>>
+  partition(std::vector<QueryPointer> const& queries, size_t index)
+  {
+    std::vector<std::vector<QueryPointer>> groups;
+    for (QueryPointer const& query : queries) {
+      auto it = std::find_if(groups.begin(), groups.end(),
+        [&](std::vector<QueryPointer> const& group) {
+          return group.front()->matchesEdge(index, *query);
+        });
+      if (it == groups.end()) {
+        groups.push_back(std::vector<QueryPointer>(1, query));
+      } else {
+        it->push_back(query);
+      }
+    }
+    return groups;
+  }
+
+  /**
+   * Builds the node for queries that all match on their first depth edges.
+   */
+  static NodePointer build(std::vector<QueryPointer> const& queries,
+                           size_t depth)
+  {
+    auto node = std::make_shared<NodeType>();
+    node->queries = queries;
+    QueryPointer first = queries.front();
+
+    // Extend the shared run while every query has the next edge and it
+    // matches.
+    bool shared = true;
+    while (shared) {
+      for (QueryPointer const& query : queries) {
+        if (query->size() == depth || !first->matchesEdge(depth, *query)) {
+          shared = false;
+          break;
+        }
+      }
+      if (shared) depth++;
+    }
+    node->depth = depth;
+
+    std::vector<QueryPointer> remaining;
+    for (QueryPointer const& query : queries) {
+      node->maxTimeExtent = std::max(node->maxTimeExtent,
+                                     query->getMaxTimeExtent());
+      if (query->size() == depth) {
+        node->completes.push_back(query);
+      } else {
+        remaining.push_back(query);
+      }
+    }
+
+    for (auto const& group : partition(remaining, depth)) {
+      node->children.push_back(build(group, depth + 1));
+    }
+    return node;
+  }
+
+  static size_t countNodes(NodePointer const& node)
+  {
+    size_t count = 1;
+    for (NodePointer const& child : node->children) {
+      count += countNodes(child);
+    }
+    return count;
+  }
+
+  static void print(NodePointer const& node, std::string indent,
+                    std::string& out)
+  {
+    out += indent + "depth " + boost::lexical_cast<std::string>(node->depth) +
+      " queries " + boost::lexical_cast<std::string>(node->queries.size()) +
+      " complete " + boost::lexical_cast<std::string>(node->completes.size()) +
+      "\n";
+    for (NodePointer const& child : node->children) {
+      print(child, indent + "  ", out);
+    }
+  }
+
+public:
+  /**
+   * Adds a finalized query and rebuilds the trie.  Queries without edges
+   * can't match anything and are ignored.
+   */
+  void add(QueryPointer query)
+  {
+    if (query->size() == 0) return;
+    queries.push_back(query);
+    roots.clear();
+    for (auto const& group : partition(queries, 0)) {
+      roots.push_back(build(group, 1));
+    }
+  }
+
+  /**
+   * The roots of the trie, one for each distinct first edge.
+   */
+  std::vector<NodePointer> const& getRoots() const { return roots; }
+
+  size_t numQueries() const { return queries.size(); }
+
+  /**
+   * The number of nodes in the trie.
+   */
+  size_t numNodes() const
+  {
+    size_t count = 0;
+    for (NodePointer const& root : roots) {
+      count += countNodes(root);
+    }
+    return count;
+  }
+
+  std::string toString() const
+  {
+    std::string out;
+    for (NodePointer const& root : roots) {
+      print(root, "", out);
+    }
+    return out;
+  }
+};
+
+} // end namespace sam
+
+#endif
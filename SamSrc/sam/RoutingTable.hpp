@@ -0,0 +1,327 @@
+#ifndef SAM_ROUTING_TABLE_HPP
+#define SAM_ROUTING_TABLE_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <sam/HashRing.hpp>
+#include <sam/HeavyHitters.hpp>
+
+namespace sam {
+
+class RoutingTableException : public std::runtime_error {
+public:
+  RoutingTableException(char const * message) : std::runtime_error(message) {}
+  RoutingTableException(std::string message) : std::runtime_error(message) {}
+};
+
+/**
+ * Decides which nodes get the edges of a vertex.  Vertices are known by
+ * their hash, from the same hash functions that ZeroMQPushPull partitions
+ * with.  A vertex is owned by a node picked with a consistent-hash ring
+ * (HashRing) over the member nodes.  That node gets all of the vertex's
+ * edges and answers edge requests about it.
+ *
+ * numNodes is how many nodes the cluster can have (the size of the
+ * PushPull socket mesh).  All of them start as members.  Nodes can be 
+ * drained (drainNode()) and added back (addNode()) while running; only
+ * about 1 / (number of members) of the vertices change owner.  The ring 
+ * from before the last change is kept (previousOwner()) so that the nodes
+ * can work out what has to move (see GraphStore::rebalance()).  Like the
+ * hubs, membership changes have to be made on every node.
+ *
+ * Hub vertices (DNS servers, proxies) can make their owner the hotspot of
+ * the cluster, so they can be replicated:
+ * - ZeroMQPushPull sends a hub's edges to every node, so no node needs to
+ *   request them.
+ * - Ownership of a result that starts with an edge out of a hub is split
+ *   by the target of the edge (see resultOwner()).
+ *
+ * Hubs can be named up front with replicate().  They can also be found
+ * while running: when hubFraction is greater than zero, observe() counts
+ * vertices with a HeavyHitters sketch and replicates any vertex with more
+ * than hubFraction of the observations (and at least minHubCount).  All
+ * the nodes must agree on the hubs, and sketches kept by different
+ * processes would not, so hub detection is for nodes in one process that
+ * share the table.  Each node registers with attach(), and observe() does
+ * nothing until all numNodes nodes have attached; a table in a
+ * multi-process deployment, which only sees its own process's nodes, never
+ * promotes.  A hub is replicated from when it is promoted.  Its earlier
+ * edges stay on its owner, so results spanning the promotion can be
+ * missed.
+ *
+ * The table also keeps a load gauge per node.  A request that either of
+ * two nodes can answer goes to the one with less load (leastLoaded()).
+ */
+class RoutingTable
+{
+private:
+  size_t numNodes;
+
+  /// The current and previous rings.  Rings are never freed while the table
+  /// lives (see retired), so readers can use them without a lock.
+  std::atomic<HashRing const*> ring;
+  std::atomic<HashRing const*> previousRing;
+  std::vector<std::unique_ptr<HashRing const>> retired;
+  std::atomic<size_t> epoch; ///> How many membership changes there have been
+  mutable std::mutex ringMutex; ///> Serializes membership changes
+
+  std::unordered_set<size_t> hubs; ///> Hashes of the replicated vertices
+  std::atomic<size_t> numHubs; ///> Lets isReplicated skip the lock
+  mutable std::mutex hubMutex;
+
+  std::vector<bool> attached; ///> Which nodes share the table
+  std::atomic<size_t> numAttached;
+
+  double hubFraction; ///> If > 0, observe() promotes hubs
+  size_t minHubCount; ///> Fewest observations before promoting a hub
+  HeavyHitters<size_t> sketch;
+
+  std::unique_ptr<std::atomic<size_t>[]> loads; ///> One gauge per node
+
+public:
+  /**
+   * \param numNodes How many nodes the cluster can have.
+   * \param hubFraction If greater than zero, observe() replicates vertices
+   *   seen in more than this fraction of the observations.
+   * \param minHubCount How many times a vertex must be observed before it
+   *   can be promoted.
+   * \param sketchCapacity How many vertices the HeavyHitters sketch counts.
+   * \param pointsPerNode How many points each node has on the HashRing.
+   */
+  RoutingTable(size_t numNodes,
+               double hubFraction = 0,
+               size_t minHubCount = 1000,
+               size_t sketchCapacity = 100,
+               size_t pointsPerNode = 64) :
+    numNodes(numNodes), epoch(0), numHubs(0), attached(numNodes, false),
+    numAttached(0), hubFraction(hubFraction),
+    minHubCount(minHubCount), sketch(sketchCapacity),
+    loads(new std::atomic<size_t>[numNodes])
+  {
+    if (numNodes == 0) {
+      throw RoutingTableException("RoutingTable numNodes must be > 0");
+    }
+    std::vector<size_t> members;
+    for (size_t i = 0; i < numNodes; i++) {
+      loads[i] = 0;
+      members.push_back(i);
+    }
+    retired.emplace_back(new HashRing(members, pointsPerNode));
+    ring = retired.back().get();
+    previousRing = ring.load();
+  }
+
+  /**
+   * How many nodes the cluster can have.
+   */
+  size_t getNumNodes() const { return numNodes; }
+
+  /**
+   * The node that owns the vertex with the given hash.
+   */
+  size_t owner(size_t hash) const { return ring.load()->owner(hash); }
+
+  /**
+   * The node that owned the vertex before the last membership change.
+   */
+  size_t previousOwner(size_t hash) const { 
+    return previousRing.load()->owner(hash); 
+  }
+
+  /**
+   * Returns true if the node is a member of the cluster.
+   */
+  bool isMember(size_t node) const { return ring.load()->contains(node); }
+
+  /**
+   * The member nodes, sorted.
+   */
+  std::vector<size_t> getMembers() const { 
+    return ring.load()->getMembers(); 
+  }
+
+  /**
+   * How many membership changes there have been.
+   */
+  size_t getEpoch() const { return epoch; }
+
+  /**
+   * Makes the node a member.  The vertices it now owns have to be moved to
+   * it (see GraphStore::addNode()).
+   */
+  void addNode(size_t node)
+  {
+    if (node >= numNodes) {
+      throw RoutingTableException("RoutingTable::addNode node " +
+        std::to_string(node) + " >= numNodes " + std::to_string(numNodes));
+    }
+    std::lock_guard<std::mutex> lock(ringMutex);
+    HashRing const* current = ring.load();
+    if (current->contains(node)) {
+      return;
+    }
+    setRing(new HashRing(current->with(node)));
+  }
+
+  /**
+   * Removes the node from the members.  Its vertices are given to the
+   * other members.
+   */
+  void drainNode(size_t node)
+  {
+    std::lock_guard<std::mutex> lock(ringMutex);
+    HashRing const* current = ring.load();
+    if (!current->contains(node)) {
+      return;
+    }
+    if (current->size() == 1) {
+      throw RoutingTableException("RoutingTable::drainNode can't drain the "
+        "last member");
+    }
+    setRing(new HashRing(current->without(node)));
+  }
+
+  /**
+   * Returns true if the edges of the vertex are sent to every node.
+   */
+  bool isReplicated(size_t hash) const
+  {
+    if (numHubs == 0) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(hubMutex);
+    return hubs.count(hash) > 0;
+  }
+
+  /**
+   * Returns true if the node is sent the edges of the vertex by
+   * ZeroMQPushPull, i.e. it doesn't have to ask for them.
+   */
+  bool receives(size_t hash, size_t node) const
+  {
+    return owner(hash) == node || isReplicated(hash);
+  }
+
+  /**
+   * Same as receives(), but before the last membership change.
+   */
+  bool previouslyReceived(size_t hash, size_t node) const
+  {
+    return previousOwner(hash) == node || isReplicated(hash);
+  }
+
+  /**
+   * Which node makes the results that start with an edge from the source
+   * to the target.  Normally the owner of the source.  If only the source
+   * is a hub, every node gets the edge, so the owner of the target makes
+   * the results and the hub's results are spread over the cluster.
+   */
+  size_t resultOwner(size_t sourceHash, size_t targetHash) const
+  {
+    if (isReplicated(sourceHash) && !isReplicated(targetHash)) {
+      return owner(targetHash);
+    }
+    return owner(sourceHash);
+  }
+
+  /**
+   * Makes the vertex a hub.  Its edges are sent to every node from now on.
+   */
+  void replicate(size_t hash)
+  {
+    std::lock_guard<std::mutex> lock(hubMutex);
+    if (hubs.insert(hash).second) {
+      numHubs.fetch_add(1);
+    }
+  }
+
+  size_t getNumReplicated() const { return numHubs; }
+
+  /**
+   * Returns true if observe() promotes hubs.
+   */
+  bool detectsHubs() const { return hubFraction > 0; }
+
+  /**
+   * Registers a node as using this table (see ZeroMQPushPull).
+   */
+  void attach(size_t node)
+  {
+    if (node >= numNodes) {
+      throw RoutingTableException("RoutingTable::attach node " +
+        std::to_string(node) + " >= numNodes " + std::to_string(numNodes));
+    }
+    std::lock_guard<std::mutex> lock(hubMutex);
+    if (!attached[node]) {
+      attached[node] = true;
+      numAttached.fetch_add(1);
+    }
+  }
+
+  /**
+   * Returns true if all the nodes have attached, i.e. they all see the
+   * same hubs.
+   */
+  bool isShared() const { return numAttached == numNodes; }
+
+  /**
+   * Counts an occurrence of the vertex and replicates it if it has become
+   * a heavy hitter.  Does nothing unless hubFraction is greater than zero
+   * and the table is shared by all the nodes.
+   * \return Returns true if the vertex was promoted by this call.
+   */
+  bool observe(size_t hash)
+  {
+    if (!detectsHubs() || !isShared()) {
+      return false;
+    }
+    size_t count = sketch.add(hash);
+    if (count >= minHubCount && count > hubFraction * sketch.getTotal() &&
+        !isReplicated(hash))
+    {
+      replicate(hash);
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * Adds to the load gauge of the node.
+   */
+  void addLoad(size_t node, size_t amount = 1) {
+    loads[node].fetch_add(amount);
+  }
+
+  size_t getLoad(size_t node) const { return loads[node]; }
+
+  /**
+   * Of two nodes that can both do some work, returns the one with less
+   * load.  Ties go to node1.
+   */
+  size_t leastLoaded(size_t node1, size_t node2) const
+  {
+    return getLoad(node2) < getLoad(node1) ? node2 : node1;
+  }
+
+private:
+  /**
+   * Makes newRing current and the current ring previous.  Called with
+   * ringMutex held.
+   */
+  void setRing(HashRing const* newRing)
+  {
+    retired.emplace_back(newRing);
+    previousRing = ring.load();
+    ring = newRing;
+    epoch.fetch_add(1);
+  }
+};
+
+} // end namespace sam
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef SAM_SIMD_HPP
+#define SAM_SIMD_HPP
+
+/**
+ * Helpers for code with vectorized kernels.  The library is built without
+ * -mavx2, so AVX2 kernels are compiled per function with SAM_TARGET_AVX2
+ * and picked at run time with cpuHasAvx2(); every kernel has a scalar
+ * fallback.  Defining SAM_NO_SIMD turns the vectorized kernels off.
+ */
+
+#if !defined(SAM_NO_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+  #define SAM_HAS_AVX2_KERNELS 1
+  #include <immintrin.h>
+  #define SAM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define SAM_HAS_AVX2_KERNELS 0
+  #define SAM_TARGET_AVX2
+#endif
+
+namespace sam {
+
+/**
+ * True if the processor supports AVX2 (and the kernels were compiled).
+ */
+inline bool cpuHasAvx2()
+{
+#if SAM_HAS_AVX2_KERNELS
+  static bool const hasAvx2 = __builtin_cpu_supports("avx2");
+  return hasAvx2;
+#else
+  return false;
+#endif
+}
+
+} // end namespace sam
+
+#endif
@@ -6,14 +6,15 @@
  * (i.e. O(N) where N is the size of the sliding window).
  */
 
+#include <functional>
 #include <iostream>
-#include <map>
 #include <boost/lexical_cast.hpp>
 #include <sam/AbstractConsumer.hpp>
 #include <sam/BaseComputation.hpp>
 #include <sam/Features.hpp>
 #include <sam/Util.hpp>
 #include <sam/FeatureProducer.hpp>
+#include <sam/KeyedState.hpp>
 #include <sam/tuples/Edge.hpp>
 
 namespace sam 
@@ -58,6 +59,13 @@ public:
   T getSum() {
     return sum;
   }
+
+  /**
+   * Returns an estimate of the bytes held by a data structure of size N.
+   */
+  static size_t memoryUsage(size_t N) {
+    return sizeof(SimpleSumDataStructure<T>) + N * sizeof(T);
+  }
 };
 
 }
@@ -71,31 +79,49 @@ class SimpleSum: public AbstractConsumer<EdgeType>,
 {
 public:
   typedef typename EdgeType::LocalTupleType TupleType;
+  typedef std::function<double(TupleType const&)> TimeFunction;
 private:
   size_t N; ///> Size of sliding window
   typedef SimpleSumDetails::SimpleSumDataStructure<T> value_t;
 
   /// Mapping from the key (e.g. an ip field) to the simple sum 
   /// data structure that is keeping track of the values seen.
-  std::map<std::string, value_t*> allWindows; 
+  KeyedState<std::shared_ptr<value_t>> allWindows; 
+
+  /// Gets the time of a tuple for evicting idle keys.
+  TimeFunction timeFunction;
   
   // Where the most recent item is located in the array.
   size_t top = 0;
   
 public:
+  /**
+   * Constructor.
+   * \param N The size of the sliding window.
+   * \param nodeId The id of the node running this computation.
+   * \param featureMap The FeatureMap object that stores results.
+   * \param identifier The identifier for this feature producer.
+   * \param keyTtl Keys not seen for this long (in tuple time) are evicted.
+   *   0 means keys are never evicted for age.
+   * \param maxStateBytes Memory budget for the per-key windows.  0 means
+   *   no limit.
+   * \param timeFunction Gets the time of a tuple.  Required if keyTtl > 0.
+   */
   SimpleSum(size_t N,
             size_t nodeId,
             std::shared_ptr<FeatureMap> featureMap,
-            std::string identifier) :
-    BaseComputation(nodeId, featureMap, identifier) 
+            std::string identifier,
+            double keyTtl = 0,
+            size_t maxStateBytes = 0,
+            TimeFunction timeFunction = TimeFunction()) :
+    BaseComputation(nodeId, featureMap, identifier),
+    allWindows(keyTtl, maxStateBytes, value_t::memoryUsage(N)),
+    timeFunction(timeFunction)
   {
-    this->N = N;
-  }
-
-  ~SimpleSum()   {
-    for (auto p : allWindows) {
-      delete p.second;
+    if (keyTtl > 0 && !timeFunction) {
+      throw KeyedStateException("SimpleSum: keyTtl requires a timeFunction");
     }
+    this->N = N;
   }
 
   bool consume(EdgeType const& edge) 
@@ -105,15 +131,17 @@ public:
     this->feedCount++;
     if (this->feedCount % this->metricInterval == 0) {
       std::cout << "SimpleSum: NodeId " << this->nodeId << " feedCount " 
-                << this->feedCount << std::endl;
+                << this->feedCount << " number of keys " << allWindows.size()
+                << " keys evicted " << allWindows.getKeysEvicted()
+                << " bytes held " << allWindows.getBytesHeld() << std::endl;
     }
 
     // Generates unique key from key fields 
     std::string key = generateKey<keyFields...>(tuple);
-    if (allWindows.count(key) == 0) {
-      auto value = new value_t(N); 
-      allWindows[key] = value;
-    }
+    double time = timeFunction ? timeFunction(tuple) : 0;
+    auto window = allWindows.get(key, time, [this]() {
+      return std::make_shared<value_t>(N);
+    });
 
     std::string sValue = 
       boost::lexical_cast<std::string>(std::get<valueField>(tuple));
@@ -127,10 +155,10 @@ public:
       value = 0;
     }
 
-    allWindows[key]->insert(value);
+    window->insert(value);
     
     // Getting the current sum and providing that to the featureMap.
-    T currentSum = allWindows[key]->getSum();
+    T currentSum = window->getSum();
     SingleFeature feature(currentSum);
     this->featureMap->updateInsert(key, this->identifier, feature);
 
@@ -139,18 +167,30 @@ public:
     return true;
   }
 
+  /**
+   * Returns the sum for the key.  Throws a KeyedStateException if the key
+   * isn't present (it was never seen or it was evicted).
+   */
   T getSum(std::string key) {
-    return allWindows[key]->getSum();
+    auto window = allWindows.find(key);
+    if (!window) {
+      throw KeyedStateException("SimpleSum::getSum no state for key " + key);
+    }
+    return (*window)->getSum();
   }
 
   std::vector<std::string> keys() const {
     std::vector<std::string> theKeys;
-    for (auto p : allWindows) {
-      theKeys.push_back(p.first);
-    }
+    allWindows.forEach([&theKeys](std::string const& key,
+                                  std::shared_ptr<value_t> const&) {
+      theKeys.push_back(key);
+    });
     return theKeys;
   }
 
+  size_t getKeysEvicted() const { return allWindows.getKeysEvicted(); }
+  size_t getBytesHeld() const { return allWindows.getBytesHeld(); }
+
   void terminate() {}
 };
 
@@ -3,6 +3,8 @@
 
 #include <queue>
 #include <map>
+#include <iterator>
+#include <set>
 #include <vector>
 #include <stdexcept>
 #include <string>
@@ -27,6 +29,22 @@ private:
   std::queue<DormantWindow<K>> queue; ///> All the dormant windows
   std::map<K, size_t> globalInfo; ///> Global counts on frequent keys
   int numDormant; ///> The number of dormant windows (N/b - 1)
+
+  /// Orders (count, key) pairs by descending count, then by key.
+  struct RankCompare {
+    bool operator()(std::pair<size_t, K> const& a,
+                    std::pair<size_t, K> const& b) const
+    {
+      return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+  };
+
+  /// The entries of globalInfo ordered by count, kept up to date as
+  /// globalInfo changes so the top elements are read without sorting.
+  std::set<std::pair<size_t, K>, RankCompare> ranking;
+
+  std::vector<std::string> topKeys; ///> The top k keys in string format
+  std::vector<double> topFrequencies; ///> Frequencies of the top k keys
   
 public:
   SlidingWindow(int N, int b, int k) : active(b)
@@ -44,12 +62,30 @@ public:
 
   int getNumDormant() const { return numDormant; }
 
+  /**
+   * Returns an estimate of the most bytes a sliding window with the given
+   * parameters holds: b distinct keys in the active window, and k keys in
+   * each dormant window and in the global counts for each dormant window.
+   * Tree nodes are counted as three pointers plus the pair.
+   */
+  static size_t memoryUsage(size_t N, size_t b, size_t k) {
+    size_t pairBytes = sizeof(std::pair<K, size_t>);
+    size_t numDormant = b > 0 ? N / b : 0;
+    return sizeof(SlidingWindow<K>) +
+           b * (pairBytes + 3 * sizeof(void*)) +
+           numDormant * (sizeof(DormantWindow<K>) + k * pairBytes) +
+           numDormant * k * (pairBytes + 3 * sizeof(void*));
+  }
+
   /**
    * Adds the given key to the sliding window.
    * \param key
+   * \return Returns true if the top k keys or their frequencies changed.
+   *   They only change when the active window becomes dormant.
    */
-  void add(K key) 
+  bool add(K key) 
   {
+    bool rotated = false;
     // If the counter is less than b, we add the key to the active window
     if (counter < b) {
       active.update(key);
@@ -64,14 +100,16 @@ public:
       active = ActiveWindow<K>(b); // Create a new active window
       active.update(key);
       counter = 1;
+      rotated = true;
     }
     
     // Check to see if we need to get rid of the oldest dormant window.
     if (queue.size() > numDormant) {
-      DormantWindow<K> oldest = queue.front();
+      removeFromGlobal(queue.front());
       queue.pop();
-      removeFromGlobal(oldest);
     }
+
+    return rotated && refreshTopK();
   }
 
   size_t getNumActiveElements() {
@@ -91,18 +129,21 @@ public:
       throw std::out_of_range(message);
     }
 
-    std::vector<std::pair<K, size_t>> pairs;
-    for (auto itr = globalInfo.begin(); itr != globalInfo.end(); ++itr)
-      pairs.push_back(*itr);
-
-    std::sort(pairs.begin(), pairs.end(),
-     [=](std::pair<K, size_t> const & a, std::pair<K, size_t> const & b)
-              {
-               return a.second > b.second;
-              }
-    );
+    auto itr = std::next(ranking.begin(), i);
+    return std::pair<K, size_t>(itr->second, itr->first);
+  }
 
-    return pairs[i];
+  /**
+   * Returns the first n elements in descending order of count.
+   */
+  std::vector<std::pair<K, size_t>> getTopK(size_t n) const {
+    std::vector<std::pair<K, size_t>> pairs;
+    for (auto itr = ranking.begin(); itr != ranking.end() && n > 0;
+         ++itr, --n)
+    {
+      pairs.push_back(std::pair<K, size_t>(itr->second, itr->first));
+    }
+    return pairs;
   }
 
   /**
@@ -110,22 +151,16 @@ public:
    */
   std::vector<string> getKeys() {
     std::vector<string> keys;
-    int limit = globalInfo.size();  
-    for (int i = 0; i < limit; i++) {
-      auto p = getIthElement(i);
-      string key = boost::lexical_cast<string>(p.first);
-      keys.push_back(key);
+    for (auto const& p : ranking) {
+      keys.push_back(boost::lexical_cast<string>(p.second));
     }
     return keys;
   }
 
   std::vector<double> getFrequencies() {
     std::vector<double> frequencies;
-    int limit = globalInfo.size();  
-    for (int i = 0; i < limit; i++) {
-      auto p = getIthElement(i);
-      double count = boost::lexical_cast<double>(p.second);
-      frequencies.push_back(count);
+    for (auto const& p : ranking) {
+      frequencies.push_back(static_cast<double>(p.first));
     }
 
     double total = static_cast<double>(getNumDormantElements()); 
@@ -138,24 +173,74 @@ public:
     return frequencies;
   }
 
+  /**
+   * The top k keys in string format in descending order.  Updated when
+   * add() returns true.
+   */
+  std::vector<std::string> const& getTopKeys() const { return topKeys; }
+
+  /**
+   * The frequencies of the top k keys.  Updated when add() returns true.
+   */
+  std::vector<double> const& getTopFrequencies() const {
+    return topFrequencies;
+  }
+
 private:
 
+  /**
+   * Recomputes the top k keys and frequencies from the ranking.
+   * \return Returns true if they changed.
+   */
+  bool refreshTopK()
+  {
+    std::vector<std::string> keys;
+    std::vector<double> frequencies;
+    double total = static_cast<double>(getNumDormantElements());
+    size_t n = 0;
+    for (auto itr = ranking.begin(); itr != ranking.end() && n < k;
+         ++itr, ++n)
+    {
+      keys.push_back(boost::lexical_cast<std::string>(itr->second));
+      frequencies.push_back(itr->first / total);
+    }
+    if (keys == topKeys && frequencies == topFrequencies) {
+      return false;
+    }
+    topKeys.swap(keys);
+    topFrequencies.swap(frequencies);
+    return true;
+  }
+
+  /**
+   * Sets the global count of the key, keeping the ranking in step.  A
+   * count of zero removes the key.
+   */
+  void setGlobalCount(K const& key, size_t oldCount, size_t newCount)
+  {
+    if (oldCount > 0) {
+      ranking.erase(std::pair<size_t, K>(oldCount, key));
+    }
+    if (newCount > 0) {
+      globalInfo[key] = newCount;
+      ranking.insert(std::pair<size_t, K>(newCount, key));
+    } else {
+      globalInfo.erase(key);
+    }
+  }
+
   /**
    * Addes the specified Dormant window's stats to the global stats.
    * \param newDormant
    */
-  void addToGlobal(DormantWindow<K> newDormant) 
+  void addToGlobal(DormantWindow<K> const& newDormant) 
   {
     int actualK = newDormant.getNumKeys() < k ? newDormant.getNumKeys() : k;
     for (int i = 0; i < actualK; i++) {
       std::pair<K, size_t> t = newDormant.getIthMostFrequent(i);
-      K key = t.first;
-      size_t value = t.second;
-      if (globalInfo.count(key) > 0) {
-        globalInfo[key] = globalInfo[key] + value;
-      } else {
-        globalInfo[key] = value;
-      }
+      auto itr = globalInfo.find(t.first);
+      size_t oldCount = itr != globalInfo.end() ? itr->second : 0;
+      setGlobalCount(t.first, oldCount, oldCount + t.second);
     }
   }
   
@@ -164,20 +249,16 @@ private:
    * global stats.
    * \param oldest
    */
-  void removeFromGlobal(DormantWindow<K> oldest)
+  void removeFromGlobal(DormantWindow<K> const& oldest)
   {
     int actualK = oldest.getNumKeys() < k ? oldest.getNumKeys() : k;
     for (int i = 0; i < actualK; i++) {
       std::pair<K, size_t> t = oldest.getIthMostFrequent(i);
-      K key = t.first;
-      size_t value = t.second;
-      if (globalInfo.count(key) > 0) {
-        size_t newValue = globalInfo[key] - value;
-        globalInfo[key] = newValue;
-
-        if (globalInfo[key] <= 0) {
-          globalInfo.erase(key);
-        }
+      auto itr = globalInfo.find(t.first);
+      if (itr != globalInfo.end()) {
+        size_t oldCount = itr->second;
+        size_t newCount = oldCount > t.second ? oldCount - t.second : 0;
+        setGlobalCount(t.first, oldCount, newCount);
       } 
     }
   }
@@ -0,0 +1,152 @@
+#ifndef SAM_SMALL_HASH_SET_HPP
+#define SAM_SMALL_HASH_SET_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace sam {
+
+/**
+ * A set of 64-bit keys (ids or hashes) that is meant to stay small.  The
+ * first INLINE_CAPACITY keys are kept in the object itself and searched
+ * linearly, so a small set doesn't touch the heap.  Past that the keys
+ * move to an open addressed table with linear probing that doubles when
+ * it is half full.
+ */
+class SmallHashSet
+{
+public:
+  static size_t const INLINE_CAPACITY = 4;
+
+private:
+  size_t count = 0;
+  size_t capacity = 0; ///> Size of table, 0 while the keys are inline
+  bool hasZero = false; ///> 0 marks an empty slot of table, so kept here
+  uint64_t inlineKeys[INLINE_CAPACITY] = {};
+  std::unique_ptr<uint64_t[]> table;
+
+  size_t slotOf(uint64_t key) const {
+    // Fibonacci hashing, so keys that differ only in high bits spread out.
+    return ((key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+  }
+
+  bool tableContains(uint64_t key) const {
+    for (size_t i = slotOf(key); table[i] != 0; i = (i + 1) & (capacity - 1))
+    {
+      if (table[i] == key) return true;
+    }
+    return false;
+  }
+
+  void tableInsert(uint64_t key) {
+    size_t i = slotOf(key);
+    while (table[i] != 0) i = (i + 1) & (capacity - 1);
+    table[i] = key;
+  }
+
+  void rehash(size_t newCapacity) {
+    std::unique_ptr<uint64_t[]> old = std::move(table);
+    size_t oldCapacity = capacity;
+    table.reset(new uint64_t[newCapacity]());
+    capacity = newCapacity;
+    if (oldCapacity == 0) {
+      for (size_t i = 0; i < count - hasZero; i++) tableInsert(inlineKeys[i]);
+    } else {
+      for (size_t i = 0; i < oldCapacity; i++) {
+        if (old[i] != 0) tableInsert(old[i]);
+      }
+    }
+  }
+
+public:
+  SmallHashSet() {}
+
+  SmallHashSet(SmallHashSet const& other) :
+    count(other.count), capacity(other.capacity), hasZero(other.hasZero)
+  {
+    std::copy(other.inlineKeys, other.inlineKeys + INLINE_CAPACITY,
+              inlineKeys);
+    if (capacity > 0) {
+      table.reset(new uint64_t[capacity]);
+      std::memcpy(table.get(), other.table.get(),
+                  capacity * sizeof(uint64_t));
+    }
+  }
+
+  SmallHashSet(SmallHashSet&& other) :
+    count(other.count), capacity(other.capacity), hasZero(other.hasZero),
+    table(std::move(other.table))
+  {
+    std::copy(other.inlineKeys, other.inlineKeys + INLINE_CAPACITY,
+              inlineKeys);
+    other.clear();
+  }
+
+  SmallHashSet& operator=(SmallHashSet const& other) {
+    if (this != &other) *this = SmallHashSet(other);
+    return *this;
+  }
+
+  SmallHashSet& operator=(SmallHashSet&& other) {
+    if (this != &other) {
+      count = other.count;
+      capacity = other.capacity;
+      hasZero = other.hasZero;
+      std::copy(other.inlineKeys, other.inlineKeys + INLINE_CAPACITY,
+                inlineKeys);
+      table = std::move(other.table);
+      other.clear();
+    }
+    return *this;
+  }
+
+  /**
+   * Adds the key.  Returns true if it wasn't already in the set.
+   */
+  bool insert(uint64_t key) {
+    if (contains(key)) return false;
+    if (key == 0) {
+      hasZero = true;
+    } else if (capacity == 0 && count - hasZero < INLINE_CAPACITY) {
+      inlineKeys[count - hasZero] = key;
+    } else {
+      if (capacity == 0 || 2 * (count - hasZero + 1) > capacity) {
+        rehash(capacity == 0 ? 4 * INLINE_CAPACITY : 2 * capacity);
+      }
+      tableInsert(key);
+    }
+    count++;
+    return true;
+  }
+
+  bool contains(uint64_t key) const {
+    if (key == 0) return hasZero;
+    if (capacity == 0) {
+      return std::find(inlineKeys, inlineKeys + (count - hasZero), key) !=
+             inlineKeys + (count - hasZero);
+    }
+    return tableContains(key);
+  }
+
+  void clear() {
+    count = 0;
+    capacity = 0;
+    hasZero = false;
+    table.reset();
+  }
+
+  size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  /**
+   * Bytes held on the heap.
+   */
+  size_t heapBytes() const { return capacity * sizeof(uint64_t); }
+};
+
+} // end namespace sam
+
+#endif
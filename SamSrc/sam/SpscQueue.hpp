@@ -0,0 +1,122 @@
+#ifndef SAM_SPSC_QUEUE_HPP
+#define SAM_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace sam {
+
+/**
+ * A bounded, lock-free queue for exactly one producer thread and one
+ * consumer thread.  push() is only ever called by the producer and pop()
+ * only by the consumer.  The head and tail indices live on separate cache
+ * lines so the two threads don't bounce a line between them.  They are
+ * kept apart by padding rather than alignas, since plain new doesn't
+ * honor over-alignment before C++17.
+ */
+template <typename T>
+class SpscQueue
+{
+private:
+  static size_t const CACHE_LINE = 64;
+
+  size_t mask; ///> capacity - 1, capacity is always a power of two
+  T* items; ///> The ring of items
+
+  char padHead[CACHE_LINE];
+
+  /// Next slot to pop.  Written only by the consumer.
+  std::atomic<size_t> head;
+
+  char padTail[CACHE_LINE];
+
+  /// Next slot to push.  Written only by the producer.
+  std::atomic<size_t> tail;
+
+  char padEnd[CACHE_LINE];
+
+public:
+  /**
+   * \param capacity How many items the queue can hold.  Rounded up to a
+   *   power of two.
+   */
+  SpscQueue(size_t capacity) : head(0), tail(0)
+  {
+    size_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+    mask = cap - 1;
+    items = new T[cap];
+  }
+
+  ~SpscQueue()
+  {
+    delete[] items;
+  }
+
+  SpscQueue(SpscQueue const&) = delete;
+  SpscQueue& operator=(SpscQueue const&) = delete;
+
+  /**
+   * Adds the item to the back of the queue.  Called by the producer.
+   * \return Returns false if the queue is full.
+   */
+  bool push(T const& item)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) > mask) {
+      return false;
+    }
+    items[t & mask] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Removes the item at the front of the queue.  Called by the consumer.
+   * \return Returns false if the queue is empty.
+   */
+  bool pop(T& item)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(items[h & mask]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Removes up to max items from the front of the queue into out, with
+   * one update of head for all of them.  Called by the consumer.
+   * \return Returns the number of items removed.
+   */
+  size_t popBatch(T* out, size_t max)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t available = tail.load(std::memory_order_acquire) - h;
+    size_t n = available < max ? available : max;
+    for (size_t i = 0; i < n; i++) {
+      out[i] = std::move(items[(h + i) & mask]);
+    }
+    head.store(h + n, std::memory_order_release);
+    return n;
+  }
+
+  /**
+   * The number of items in the queue.  Only a snapshot if the other
+   * thread is active.
+   */
+  size_t size() const
+  {
+    return tail.load(std::memory_order_acquire) -
+           head.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return mask + 1; }
+};
+
+} // end namespace sam
+
+#endif
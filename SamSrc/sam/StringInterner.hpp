@@ -0,0 +1,383 @@
+#ifndef SAM_STRING_INTERNER_HPP
+#define SAM_STRING_INTERNER_HPP
+
+#include <sam/EpochManager.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <boost/lexical_cast.hpp>
+
+namespace sam {
+
+class StringInternerException : public std::runtime_error {
+public:
+  StringInternerException(char const * message) :
+    std::runtime_error(message) { }
+  StringInternerException(std::string message) :
+    std::runtime_error(message) { }
+};
+
+/**
+ * Maps strings to dense 32-bit ids and back.  Ids start at 1; 0 (NO_ID)
+ * means the string has not been interned.
+ *
+ * The lookup table is open addressed with linear probing.  A slot is
+ * claimed with a CAS to BUSY while its string is written, then published
+ * with the id.  When the table is half full a table twice the size is
+ * installed and the old one is migrated a chunk at a time by the threads
+ * that call intern(), so writers never stop for a resize.  Lookups check
+ * the new table and then the old one until the migration is done, after
+ * which the old table is reclaimed through the EpochManager.
+ */
+class StringInterner
+{
+public:
+  typedef uint32_t IdType;
+  static IdType const NO_ID = 0;
+
+private:
+  static IdType const EMPTY = 0;
+  static IdType const BUSY = UINT32_MAX;
+  static IdType const TOMBSTONE = UINT32_MAX - 1; ///> Old table, never used
+
+  static size_t const MIGRATE_CHUNK = 64; ///> Slots migrated per intern()
+
+  static size_t const CHUNK_BITS = 12; ///> Strings per chunk is 2^CHUNK_BITS
+  static size_t const CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+  static size_t const MAX_CHUNKS = size_t(1) << 16;
+
+  struct Slot {
+    std::atomic<uint32_t> hash{0}; ///> Hash of the string
+    std::atomic<IdType> id{EMPTY};
+  };
+
+  struct Table {
+    size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> count{0}; ///> Slots claimed
+    std::atomic<Table*> older{nullptr}; ///> Table being migrated into this one
+    std::atomic<size_t> cursor{0}; ///> Next slot of this table to migrate
+    std::atomic<size_t> migrated{0}; ///> Slots of this table migrated
+
+    Table(size_t capacity) : capacity(capacity), slots(new Slot[capacity]) {}
+  };
+
+  enum class ProbeResult { Found, Claimed, NotFound, Full };
+
+  std::atomic<Table*> current;
+
+  /// Reverse lookup.  The strings of ids [i * CHUNK_SIZE, (i+1) * CHUNK_SIZE)
+  /// are in chunks[i].  Chunks are never moved, so references stay valid.
+  std::unique_ptr<std::atomic<std::string*>[]> chunks;
+  std::atomic<IdType> nextId{1};
+
+  mutable EpochManager epochs;
+
+  static uint32_t hashString(std::string const& str) {
+    uint64_t hash = std::hash<std::string>()(str);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+  }
+
+  std::string& stringAt(IdType id) const;
+  IdType newId(std::string const& str);
+
+  ProbeResult probe(Table* table, std::string const& str, uint32_t hash,
+                    bool insert, size_t& index) const;
+  void grow(Table* table);
+  void claimed(Table* table);
+  void copyInto(Table* table, IdType id, uint32_t hash);
+  void helpMigrate(EpochManager::Guard& guard, Table* table, bool all);
+  IdType find(Table* table, std::string const& str, uint32_t hash) const;
+
+public:
+  /**
+   * \param capacity The initial number of slots.  The table grows as
+   *   needed.
+   */
+  StringInterner(size_t capacity = 1024);
+  ~StringInterner();
+
+  StringInterner(StringInterner const&) = delete;
+  StringInterner& operator=(StringInterner const&) = delete;
+
+  /**
+   * Returns the id of the string, giving it a new one if it doesn't have
+   * one yet.
+   */
+  IdType intern(std::string const& str);
+
+  /**
+   * Returns the id of the string, or NO_ID if it hasn't been interned.
+   */
+  IdType find(std::string const& str) const;
+
+  /**
+   * Returns the string with the given id.
+   * \throws StringInternerException if the id hasn't been given out.
+   */
+  std::string const& lookup(IdType id) const;
+
+  /**
+   * The number of ids given out.  A race between two threads interning the
+   * same new string while the table is resized can use up an id that is
+   * never returned, so this can be a little more than the number of
+   * distinct strings.
+   */
+  size_t size() const { return nextId.load() - 1; }
+};
+
+inline
+StringInterner::StringInterner(size_t capacity) :
+  chunks(new std::atomic<std::string*>[MAX_CHUNKS])
+{
+  size_t c = 16;
+  while (c < capacity) c *= 2;
+  current = new Table(c);
+  for (size_t i = 0; i < MAX_CHUNKS; i++) chunks[i] = nullptr;
+}
+
+inline
+StringInterner::~StringInterner()
+{
+  Table* table = current.load();
+  while (table) {
+    Table* older = table->older.load();
+    delete table;
+    table = older;
+  }
+  for (size_t i = 0; i < MAX_CHUNKS; i++) {
+    delete[] chunks[i].load();
+  }
+}
+
+inline
+std::string& StringInterner::stringAt(IdType id) const
+{
+  return chunks[id >> CHUNK_BITS].load()[id & (CHUNK_SIZE - 1)];
+}
+
+inline
+StringInterner::IdType StringInterner::newId(std::string const& str)
+{
+  IdType id = nextId.fetch_add(1);
+  if (id >= MAX_CHUNKS * CHUNK_SIZE || id >= TOMBSTONE) {
+    throw StringInternerException("StringInterner ran out of ids");
+  }
+  size_t chunk = id >> CHUNK_BITS;
+  if (!chunks[chunk].load()) {
+    std::string* fresh = new std::string[CHUNK_SIZE];
+    std::string* expected = nullptr;
+    if (!chunks[chunk].compare_exchange_strong(expected, fresh)) {
+      delete[] fresh;
+    }
+  }
+  stringAt(id) = str;
+  return id;
+}
+
+/**
+ * Looks for the string in the table.  With insert, the first empty slot
+ * on the probe sequence is claimed (left BUSY) if the string isn't there.
+ * \param index Set to the slot found or claimed.
+ */
+inline
+StringInterner::ProbeResult
+StringInterner::probe(Table* table, std::string const& str, uint32_t hash,
+                      bool insert, size_t& index) const
+{
+  size_t mask = table->capacity - 1;
+  for (size_t n = 0; n < table->capacity; n++) {
+    size_t i = (hash + n) & mask;
+    Slot& slot = table->slots[i];
+    IdType id = slot.id.load();
+    while (true) {
+      if (id == BUSY) {
+        std::this_thread::yield();
+        id = slot.id.load();
+        continue;
+      }
+      if (id == EMPTY && insert) {
+        if (slot.id.compare_exchange_strong(id, BUSY)) {
+          index = i;
+          return ProbeResult::Claimed;
+        }
+        continue; // id now holds what beat us
+      }
+      break;
+    }
+    if (id == EMPTY) return ProbeResult::NotFound;
+    if (id == TOMBSTONE) continue;
+    if (slot.hash.load() == hash && stringAt(id) == str) {
+      index = i;
+      return ProbeResult::Found;
+    }
+  }
+  return ProbeResult::Full;
+}
+
+/**
+ * Installs a table twice the size that migrates from this one, unless
+ * this one is no longer the newest or is still migrating itself.
+ */
+inline
+void StringInterner::grow(Table* table)
+{
+  if (table->older.load() || current.load() != table) return;
+  Table* bigger = new Table(table->capacity * 2);
+  bigger->older = table;
+  if (!current.compare_exchange_strong(table, bigger)) {
+    delete bigger;
+  }
+}
+
+/**
+ * Counts a claimed slot and grows the table if it is half full.
+ */
+inline
+void StringInterner::claimed(Table* table)
+{
+  size_t count = table->count.fetch_add(1) + 1;
+  if (count * 2 > table->capacity) grow(table);
+}
+
+/**
+ * Adds an existing id to the table unless its string is already there.
+ */
+inline
+void StringInterner::copyInto(Table* table, IdType id, uint32_t hash)
+{
+  size_t index;
+  if (probe(table, stringAt(id), hash, true, index) ==
+      ProbeResult::Claimed)
+  {
+    table->slots[index].hash = hash;
+    table->slots[index].id = id;
+    claimed(table);
+  }
+}
+
+/**
+ * Moves one chunk (or, with all, every remaining slot) of the older table
+ * into this one.  Empty slots of the older table are tombstoned so that
+ * writers still holding the older table can't add to it afterward.
+ */
+inline
+void StringInterner::helpMigrate(EpochManager::Guard& guard, Table* table,
+                                 bool all)
+{
+  Table* older = table->older.load();
+  if (!older) return;
+  do {
+    size_t start = older->cursor.fetch_add(MIGRATE_CHUNK);
+    if (start >= older->capacity) break;
+    size_t end = std::min(start + MIGRATE_CHUNK, older->capacity);
+    for (size_t i = start; i < end; i++) {
+      Slot& slot = older->slots[i];
+      IdType id = slot.id.load();
+      while (id == EMPTY || id == BUSY) {
+        if (id == BUSY) {
+          std::this_thread::yield();
+          id = slot.id.load();
+        } else if (slot.id.compare_exchange_strong(id, TOMBSTONE)) {
+          id = TOMBSTONE;
+        }
+      }
+      if (id != TOMBSTONE) {
+        copyInto(table, id, slot.hash.load());
+      }
+    }
+    if (older->migrated.fetch_add(end - start) + (end - start) ==
+        older->capacity)
+    {
+      table->older = nullptr;
+      guard.retire(older);
+      return;
+    }
+  } while (all);
+
+  // Another thread has the last chunks; wait for it when asked for all.
+  while (all && table->older.load() == older) std::this_thread::yield();
+}
+
+inline
+StringInterner::IdType StringInterner::intern(std::string const& str)
+{
+  uint32_t hash = hashString(str);
+  EpochManager::Guard guard(epochs);
+  while (true) {
+    Table* table = current.load();
+    helpMigrate(guard, table, false);
+
+    size_t index;
+    ProbeResult result = probe(table, str, hash, true, index);
+    if (result == ProbeResult::Found) {
+      // If the table was replaced after we loaded it, the newest table
+      // decides the id.
+      if (current.load() != table) continue;
+      return table->slots[index].id.load();
+    }
+    if (result == ProbeResult::Full) {
+      // The table was replaced while we held it, or it filled faster than
+      // it migrated.  Finish the migration and try the newest table.
+      helpMigrate(guard, current.load(), true);
+      grow(table);
+      continue;
+    }
+
+    // Claimed a slot.  The string may already have an id in the older
+    // table, which has to be kept.
+    Slot& slot = table->slots[index];
+    IdType id = NO_ID;
+    Table* older = table->older.load();
+    if (older) id = find(older, str, hash);
+    if (id == NO_ID) id = newId(str);
+    slot.hash = hash;
+    slot.id = id;
+    claimed(table);
+
+    if (current.load() != table) continue;
+    return id;
+  }
+}
+
+/**
+ * Read only lookup in one table and the tables it is migrating from.
+ */
+inline
+StringInterner::IdType
+StringInterner::find(Table* table, std::string const& str,
+                     uint32_t hash) const
+{
+  for (; table; table = table->older.load()) {
+    size_t index;
+    if (probe(table, str, hash, false, index) == ProbeResult::Found) {
+      return table->slots[index].id.load();
+    }
+  }
+  return NO_ID;
+}
+
+inline
+StringInterner::IdType StringInterner::find(std::string const& str) const
+{
+  EpochManager::Guard guard(epochs);
+  return find(current.load(), str, hashString(str));
+}
+
+inline
+std::string const& StringInterner::lookup(IdType id) const
+{
+  if (id == NO_ID || id >= nextId.load()) {
+    throw StringInternerException("StringInterner::lookup unknown id " +
+      boost::lexical_cast<std::string>(id));
+  }
+  return stringAt(id);
+}
+
+} // end namespace sam
+
+#endif
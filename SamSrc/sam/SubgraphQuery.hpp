@@ -15,6 +15,7 @@
 #include <sam/EdgeDescription.hpp>
 #include <sam/FeatureMap.hpp>
 #include <sam/VertexConstraintChecker.hpp>
+#include <sstream>
 
 #define MAX_START_END_OFFSET 100
 
@@ -26,6 +27,70 @@ public:
   SubgraphQueryException(std::string message) : std::runtime_error(message) {}
 };
 
+/**
+ * Runtime statistics about the graph that SubgraphQuery::finalize uses to
+ * plan the order in which edges are matched.  The defaults describe a
+ * small, uniform graph, so without real statistics the plan only follows
+ * the vertex constraints and the connectivity of the query.
+ * GraphStore::getQueryStatistics fills this in from the csr and csc.
+ */
+struct QueryStatistics
+{
+  /// About how many vertices the graph has.
+  double numVertices = 1000;
+
+  /// About how many edges the graph holds.
+  double numEdges = 1000;
+
+  /// Edges arriving per second.
+  double edgeRate = 1;
+
+  /// The mean out-degree (csr) and in-degree (csc) of the vertices.
+  double meanOutDegree = 1;
+  double meanInDegree = 1;
+
+  /// The mean of the squared out-degrees and in-degrees.
+  double outDegreeSecondMoment = 1;
+  double inDegreeSecondMoment = 1;
+
+  /**
+   * The expected out-degree of a vertex reached by following an edge.
+   * High-degree vertices are reached more often, so this is
+   * E[d^2] / E[d] rather than the mean.
+   */
+  double excessOutDegree() const {
+    return meanOutDegree > 0 ? outDegreeSecondMoment / meanOutDegree : 0;
+  }
+
+  /**
+   * The expected in-degree of a vertex reached by following an edge.
+   */
+  double excessInDegree() const {
+    return meanInDegree > 0 ? inDegreeSecondMoment / meanInDegree : 0;
+  }
+};
+
+/**
+ * One step of the plan chosen by SubgraphQuery::finalize.
+ */
+struct QueryPlanStep
+{
+  std::string edgeId;
+  std::string source;
+  std::string target;
+
+  /// Whether the source/target is bound by an earlier step.
+  bool sourceBound = false;
+  bool targetBound = false;
+
+  /// Estimated matches per partial result (for the anchor, matching edges
+  /// per second).
+  double fanOut = 0;
+
+  /// Estimated partial results per second after this step.
+  double partialResults = 0;
+};
+
 /**
  * This class represents a subgraph query.  The overall process is to
  * create a subgraph query with a constructor, add expressions to the query,
@@ -46,7 +111,8 @@ public:
  *
  * The finalize takes the list of edge descriptions that have been built up
  * by the add addExpression methods, does some checks, and then sorts them
- * by starttime.
+ * by starttime.  Edges with the same starttime are put in the order 
+ * estimated to create the fewest partial results (see explain()).
  */
 template <typename TupleType, size_t source, size_t target,  
           size_t time, size_t duration>
@@ -89,6 +155,17 @@ private:
 
   std::shared_ptr<const VertexConstraintChecker<SubgraphQueryType>> check;
 
+  /// The vertex variables in the order they first appear in sortedEdges.
+  /// The index of a variable is its slot, which SubgraphQueryResult uses
+  /// instead of the name.
+  std::vector<std::string> variables;
+
+  /// The slots of the source and target variables of each sorted edge.
+  std::vector<std::pair<size_t, size_t>> edgeSlots;
+
+  /// The plan chosen by finalize, one step per sorted edge.
+  std::vector<QueryPlanStep> plan;
+
   std::list<VertexConstraintExpression> emptyList;
 public:
   
@@ -135,6 +212,43 @@ public:
     return sortedEdges[index];
   }
 
+  /**
+   * Returns the number of vertex variables.  Only valid after finalize().
+   */
+  size_t numVariables() const { return variables.size(); }
+
+  /**
+   * Returns the name of the variable in the given slot.
+   */
+  std::string const& getVariable(size_t slot) const { 
+    return variables[slot]; 
+  }
+
+  /**
+   * Returns the slot of the source variable of the ith sorted edge.
+   */
+  size_t getSourceSlot(size_t index) const { 
+    return edgeSlots[index].first; 
+  }
+
+  /**
+   * Returns the slot of the target variable of the ith sorted edge.
+   */
+  size_t getTargetSlot(size_t index) const { 
+    return edgeSlots[index].second; 
+  }
+
+  /**
+   * Returns true if the ith sorted edge of this query and of the other
+   * query accept the same edges given the same bindings of the earlier
+   * edges: the source and target have the same slots and vertex 
+   * constraints, and the time ranges are the same.  If the first i+1 edges
+   * of two queries match, the queries can share partial results for them
+   * (see QueryTrie).  Both queries must be finalized and use the same
+   * FeatureMap.
+   */
+  bool matchesEdge(size_t index, SubgraphQueryType const& other) const;
+
   /**
    * Adds a TimeEdgeExpression to the subgraph query.  The TimeEdgeExpression
    * specifies start/end time for an edge.
@@ -166,9 +280,32 @@ public:
   /**
    * This is called after all the expressions have been added.  If sorts
    * the EdgeDescriptions by start time.  It also calculates the overall
-   * time that the query can take.
+   * time that the query can take.  Uses default statistics to plan.
+   */
+  void finalize() { finalize(QueryStatistics()); }
+
+  /**
+   * Like finalize(), but edges with the same start time are ordered by 
+   * estimated cost using the given statistics.  Edges must still be 
+   * matched in increasing time, so only edges whose start times tie can
+   * be reordered.  Among those, the anchor (first edge) is the most 
+   * selective one, and each later edge is the one that creates the fewest
+   * partial results given the variables bound so far.
    */
-  void finalize();
+  void finalize(QueryStatistics const& statistics);
+
+  /**
+   * Returns a description of the chosen plan: the edges in the order they
+   * are matched and the estimated partial-result fan-out of each.  Vertex
+   * variables bound by an earlier step are marked with *.  Only valid 
+   * after finalize().
+   */
+  std::string explain() const;
+
+  /**
+   * Returns the plan chosen by finalize.
+   */
+  std::vector<QueryPlanStep> const& getPlan() const { return plan; }
 
   /**
    * Returns the maximum time difference in seconds between start and end times
@@ -346,6 +483,44 @@ satisfiesFirst(TupleType const& tuple) const
   return false; 
 }*/
 
+template <typename TupleType, size_t source, size_t target, 
+          size_t time, size_t duration>
+bool SubgraphQuery<TupleType, source, target, time, duration>::
+matchesEdge(size_t index, SubgraphQueryType const& other) const
+{
+  if (index >= sortedEdges.size() || index >= other.sortedEdges.size()) {
+    return false;
+  }
+  if (index == 0 && 
+      zeroTimeRelativeToStart() != other.zeroTimeRelativeToStart()) 
+  {
+    return false;
+  }
+
+  EdgeDesc const& edge = sortedEdges[index];
+  EdgeDesc const& otherEdge = other.sortedEdges[index];
+  if (edgeSlots[index] != other.edgeSlots[index] ||
+      edge.startTimeRange != otherEdge.startTimeRange ||
+      edge.endTimeRange != otherEdge.endTimeRange)
+  {
+    return false;
+  }
+
+  auto sameConstraints = [this, &other](std::string const& variable,
+                                        std::string const& otherVariable) {
+    auto const& constraints = getConstraints(variable);
+    auto const& otherConstraints = other.getConstraints(otherVariable);
+    return std::equal(constraints.begin(), constraints.end(),
+                      otherConstraints.begin(), otherConstraints.end(),
+      [](VertexConstraintExpression const& a, 
+         VertexConstraintExpression const& b) {
+        return a.op == b.op && a.featureName == b.featureName;
+      });
+  };
+  return sameConstraints(edge.getSource(), otherEdge.getSource()) &&
+         sameConstraints(edge.getTarget(), otherEdge.getTarget());
+}
+
 template <typename TupleType, size_t source, size_t target, 
           size_t time, size_t duration>
 size_t SubgraphQuery<TupleType, source, target, time, duration>::size() const 
@@ -375,8 +550,14 @@ SubgraphQuery<TupleType, source, target,
 
 template <typename TupleType, size_t source, size_t target, 
           size_t time, size_t duration>
-void SubgraphQuery<TupleType, source, target, time, duration>::finalize()
+void SubgraphQuery<TupleType, source, target, time, duration>::
+finalize(QueryStatistics const& statistics)
 {
+  if (finalized) {
+    throw SubgraphQueryException("SubgraphQuery::finalize() The query has "
+      "already been finalized.");
+  }
+
   // Confirm that all edges have a start time or end time
   for (auto keypair : edges) {
 
@@ -393,27 +574,125 @@ void SubgraphQuery<TupleType, source, target, time, duration>::finalize()
     edge.fixTimeRange(maxOffset);
   }
 
+  EdgeList unplanned;
   transform(edges.begin(), edges.end(), 
-            back_inserter(sortedEdges), [](auto val){ return val.second;}); 
+            back_inserter(unplanned), [](auto val){ return val.second;}); 
 
-  sort(sortedEdges.begin(), sortedEdges.end(), 
+  stable_sort(unplanned.begin(), unplanned.end(), 
     [](EdgeDesc const & i, 
        EdgeDesc const & j){
       return i.startTimeRange.first < j.startTimeRange.first; 
     });
 
-  if (zeroTimeRelativeToStart()) {
-    maxTimeExtent = sortedEdges[sortedEdges.size()-1].endTimeRange.second 
-                    - sortedEdges[0].startTimeRange.first;
-  } else {
-    maxTimeExtent = sortedEdges[sortedEdges.size()-1].endTimeRange.second 
-                    - sortedEdges[0].endTimeRange.first;
+  // Greedy plan.  At each step the candidates are the remaining edges with
+  // the earliest start time, and we take the cheapest.  Ties keep the
+  // start time order.
+  double numVertices = std::max(1.0, statistics.numVertices);
+  auto selectivity = [this, numVertices](std::string const& variable) {
+    return check->estimateSelectivity(variable, numVertices);
+  };
+  std::set<std::string> bound;
+  double partialResults = 1;
+  while (!unplanned.empty()) {
+    double earliest = unplanned.front().startTimeRange.first;
+    size_t best = 0;
+    QueryPlanStep bestStep;
+    for (size_t i = 0; i < unplanned.size() && 
+         unplanned[i].startTimeRange.first == earliest; i++)
+    {
+      EdgeDesc const& edge = unplanned[i];
+      QueryPlanStep step;
+      step.edgeId = edge.edgeId;
+      step.source = edge.getSource();
+      step.target = edge.getTarget();
+      step.sourceBound = bound.count(step.source) > 0;
+      step.targetBound = bound.count(step.target) > 0;
+      double sourceSel = selectivity(step.source);
+      double targetSel = selectivity(step.target);
+
+      if (sortedEdges.empty()) {
+        step.fanOut = statistics.edgeRate * sourceSel * targetSel; 
+      } else if (step.sourceBound && step.targetBound) {
+        step.fanOut = statistics.excessOutDegree() / numVertices;
+      } else if (step.sourceBound) {
+        step.fanOut = statistics.excessOutDegree() * targetSel;
+      } else if (step.targetBound) {
+        step.fanOut = statistics.excessInDegree() * sourceSel;
+      } else {
+        step.fanOut = statistics.numEdges * sourceSel * targetSel;
+      }
+
+      if (i == 0 || step.fanOut < bestStep.fanOut) {
+        best = i;
+        bestStep = step;
+      }
+    }
+
+    partialResults *= bestStep.fanOut;
+    bestStep.partialResults = partialResults;
+    plan.push_back(bestStep);
+    bound.insert(bestStep.source);
+    bound.insert(bestStep.target);
+    sortedEdges.push_back(unplanned[best]);
+    unplanned.erase(unplanned.begin() + best);
+  }
+
+  if (!sortedEdges.empty()) {
+    // The last edge to start isn't necessarily the last to end.
+    double lastEnd = sortedEdges[0].endTimeRange.second;
+    for (EdgeDesc const& edge : sortedEdges) {
+      lastEnd = std::max(lastEnd, edge.endTimeRange.second);
+    }
+
+    if (zeroTimeRelativeToStart()) {
+      maxTimeExtent = lastEnd - sortedEdges[0].startTimeRange.first;
+    } else {
+      maxTimeExtent = lastEnd - sortedEdges[0].endTimeRange.first;
+    }
+  }
 
+  // Give each variable a slot
+  auto slotOf = [this](std::string const& variable) {
+    auto it = std::find(variables.begin(), variables.end(), variable);
+    if (it != variables.end()) return size_t(it - variables.begin());
+    variables.push_back(variable);
+    return variables.size() - 1;
+  };
+  for (EdgeDesc const& edge : sortedEdges) {
+    size_t sourceSlot = slotOf(edge.getSource());
+    size_t targetSlot = slotOf(edge.getTarget());
+    edgeSlots.push_back(std::make_pair(sourceSlot, targetSlot));
   }
 
   finalized = true;
 }
 
+template <typename TupleType, size_t source, size_t target, 
+          size_t time, size_t duration>
+std::string SubgraphQuery<TupleType, source, target, time, duration>::
+explain() const
+{
+  if (!finalized) {
+    throw SubgraphQueryException("SubgraphQuery::explain() Tried to explain "
+      "the plan, but finalize has not been called yet.");
+  }
+
+  std::ostringstream out;
+  for (size_t i = 0; i < plan.size(); i++) {
+    QueryPlanStep const& step = plan[i];
+    out << i << ": " << step.edgeId << " (" << step.source
+        << (step.sourceBound ? "*" : "") << " -> " << step.target
+        << (step.targetBound ? "*" : "") << ")";
+    if (i == 0) {
+      out << " anchor, ~" << step.fanOut << " matches/s";
+    } else {
+      out << " fan-out ~" << step.fanOut;
+    }
+    out << ", ~" << step.partialResults << " partial results/s\n";
+  }
+  return out.str();
+}
+
 template <typename TupleType, size_t source, size_t target, 
           size_t time, size_t duration>
 void SubgraphQuery<TupleType, source, target, time, duration>::
@@ -2,11 +2,14 @@
 #define SAM_SUBGRAPH_QUERY_RESULT_HPP
 
 #include <sam/SubgraphQuery.hpp>
+#include <sam/QueryTrie.hpp>
 #include <sam/Null.hpp>
 #include <sam/EdgeRequest.hpp>
+#include <sam/RoutingTable.hpp>
 #include <sam/Util.hpp>
 #include <sam/VertexConstraintChecker.hpp>
-#include <set>
+#include <sam/SmallHashSet.hpp>
+#include <memory>
 
 namespace sam {
 
@@ -30,6 +33,11 @@ public:
  * resides outside this class.
  *
  * The source and target fields need to be of the same type.
+ *
+ * A result can also be made from a node of a QueryTrie, in which case it
+ * stands in for every query of the node until it has matched the edges
+ * they share.  Then atFork() is true and fork() makes the results for the
+ * individual queries (or for the nodes further down the trie).
  */
 template <typename EdgeType, size_t source, size_t target, 
           size_t time, size_t duration>
@@ -47,16 +55,38 @@ public:
     SubgraphQueryType;
   typedef EdgeDescription<TupleType, time, duration> EdgeDescriptionType;
   typedef EdgeRequest<TupleType, source, target> EdgeRequestType;
+  typedef QueryTrieNode<SubgraphQueryType> TrieNodeType;
   
+  /// The most variables a query can have.  The bindings are kept inline.
+  static size_t const MAX_VARIABLES = 8;
+
 private:
+  /// A link of the list of result edges, newest first.  Links are never
+  /// changed once made, so when addEdge creates a result from this one the
+  /// new result adds one link in front of this result's list instead of 
+  /// copying its edges.
+  struct PathNode {
+    EdgeType edge;
+    std::shared_ptr<PathNode const> previous;
+
+    PathNode(EdgeType const& edge, std::shared_ptr<PathNode const> previous) :
+      edge(edge), previous(std::move(previous)) {}
+  };
+
   /// The SubgraphQuery that this is a result for.
   std::shared_ptr<const SubgraphQueryType> subgraphQuery;
 
-  /// A mapping from the variable name to the bound value.
-  std::map<std::string, NodeType> var2BoundValue;
+  /// The edges that satisfied the edge descriptions, newest first.
+  std::shared_ptr<PathNode const> path;
 
-  /// A vector of edges that satisfied the edge descriptions.
-  std::vector<EdgeType> resultEdges;
+  /// If not null, this result stands in for all the queries of the trie
+  /// node, and subgraphQuery is the node's representative.
+  std::shared_ptr<const TrieNodeType> shared;
+
+  /// The value bound to each variable slot (see SubgraphQuery::getVariable),
+  /// which points at the source or target of the edge in path that bound 
+  /// it.  nullptr if the variable is unbound.
+  NodeType const* boundValues[MAX_VARIABLES] = {};
 
   /// Index to current edge we are trying to satisfy.
   size_t currentEdge = 0;
@@ -76,9 +106,9 @@ private:
   /// same partial result.  For example, two edge requests can be produced
   /// return the same edge to this node.  When we try to map against the
   /// query result, the same edge will fulfill the same criteria twice.
-  /// We want to prevent that.  We create a string from time,source,target,
-  /// and then store them in this set so that we only see it once.
-  std::set<std::string> seenEdges;
+  /// We want to prevent that.  We hash time, source, target, and duration
+  /// (see fingerprint()) and store the hashes so that we only see it once.
+  SmallHashSet seenEdges;
 
 public:
   /**
@@ -97,6 +127,18 @@ public:
   SubgraphQueryResult(std::shared_ptr<const SubgraphQueryType>  query, 
                       EdgeType firstEdge);
 
+  /**
+   * Makes a result for the queries of a QueryTrie node.  Like the other
+   * constructor, assumes the first edge description has been satisfied.
+   * If the node has only one query, this is the same as making a result
+   * for that query.
+   * \param node The node of the QueryTrie.
+   * \param firstEdge The first edge that satisfies the first edge 
+   *   description.
+   */
+  SubgraphQueryResult(std::shared_ptr<const TrieNodeType> node,
+                      EdgeType firstEdge);
+
   /** 
    * Tries to add the edge to the subgraph query result. If successful
    * returns true along with the new query result.  This result remains
@@ -188,16 +230,15 @@ public:
    * \param nodeId The id of the node running this code.  Used to determine
    *               if the next edge will be sent to this node by the 
    *               partitioner (in ZeroMQPushPull).
-   * \param numNodes The number of nodes in the cluster.  Used to determin
-   *                 if the next edge will be sent to this node by the 
-   *                 partitioner (in ZeroMQPushPull).
+   * \param routingTable Says which nodes the partitioner sends the edges
+   *                     of a vertex to.
    */
   template <typename SourceHF, typename TargetHF>
   size_t hash(SourceHF const& sourceHash, 
               TargetHF const& targetHash,
               std::list<EdgeRequestType> & edgeRequests,
               size_t nodeId,
-              size_t numNodes) 
+              RoutingTable const& routingTable) 
               const;
 
   /**
@@ -205,35 +246,66 @@ public:
    */
   bool complete() const {
     DEBUG_PRINT("SubgraphQueryResult::complete() %s\n", toString().c_str());
-    return currentEdge == numEdges; 
+    return currentEdge == numEdges && !shared; 
   } 
 
+  /**
+   * Returns true if this result stands in for several queries and has 
+   * matched all the edges they share, so it needs to be forked.
+   */
+  bool atFork() const {
+    return shared && currentEdge == numEdges;
+  }
+
+  /**
+   * When atFork(), returns one result for each query that is complete and
+   * one for each child of the trie node.  The results share this one's
+   * edges.
+   */
+  std::vector<SubgraphQueryResultType> fork() const;
+
+  /**
+   * The number of queries that this result stands in for.
+   */
+  size_t numQueries() const {
+    return shared ? shared->queries.size() : 1;
+  }
+
   /**
    * Returns a string representation of the query result
    */
   std::string toString() const {
-    if (resultEdges.size() != currentEdge) {
-      std::string message = "resultEdges.size() was not equal to currentEdge " +
-        boost::lexical_cast<std::string>(resultEdges.size()) + " != " +
-        boost::lexical_cast<std::string>(currentEdge);
+    std::vector<PathNode const*> nodes;
+    for (PathNode const* node = path.get(); node; node = node->previous.get())
+    {
+      nodes.push_back(node);
+    }
+    if (nodes.size() != currentEdge) {
+      std::string message = "number of result edges was not equal to "
+        "currentEdge " + boost::lexical_cast<std::string>(nodes.size()) + 
+        " != " + boost::lexical_cast<std::string>(currentEdge);
       throw SubgraphQueryResultException(message); 
     }
     std::string rString = "Result Edges: ";
-    size_t i = 0;
-    for(EdgeType const& edge : resultEdges) {
-      TupleType t = edge.tuple;
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+      EdgeType const& edge = (*it)->edge;
+      TupleType const& t = edge.tuple;
       rString = rString + " ResultTuple " + 
         "Id " + boost::lexical_cast<std::string>(edge.id) +
         " Time " + boost::lexical_cast<std::string>(std::get<time>(t)) +
         " Duration " + boost::lexical_cast<std::string>(std::get<duration>(t)) +
         " Source " + boost::lexical_cast<std::string>(std::get<source>(t)) +
         " Target " + boost::lexical_cast<std::string>(std::get<target>(t));
-      //rString = rString + "ResultTuple " + sam::toString(t) + " ";  
     }
     rString += " startTime" + boost::lexical_cast<std::string>(startTime);
     rString += " var2BoundValue ";
-    for(auto key : var2BoundValue) {
-      rString += key.first + "->" + key.second + " ";
+    if (subgraphQuery) {
+      for (size_t i = 0; i < subgraphQuery->numVariables(); i++) {
+        if (boundValues[i]) {
+          rString += subgraphQuery->getVariable(i) + "->" + 
+            boost::lexical_cast<std::string>(*boundValues[i]) + " ";
+        }
+      }
     }
     rString += " currentEdge: " + boost::lexical_cast<std::string>(currentEdge);
     rString += " numEdges: " + boost::lexical_cast<std::string>(numEdges);
@@ -243,11 +315,11 @@ public:
   /**
    * Returns true if none of the result edges have the given sam id.
    */
-  bool noSamId(size_t samId) 
+  bool noSamId(size_t samId) const
   {
-    size_t i = 0;
-    for (EdgeType const& edge : resultEdges) {
-      if (edge.id == samId) {
+    for (PathNode const* node = path.get(); node; node = node->previous.get())
+    {
+      if (node->edge.id == samId) {
         return false;
       }
     }
@@ -264,7 +336,15 @@ public:
   }
 
   EdgeType getResultTuple(size_t i) const {
-    return resultEdges[i];
+    if (i >= currentEdge) {
+      throw SubgraphQueryResultException("SubgraphQueryResult::"
+        "getResultTuple index " + boost::lexical_cast<std::string>(i) +
+        " is past the number of result edges " + 
+        boost::lexical_cast<std::string>(currentEdge));
+    }
+    PathNode const* node = path.get();
+    for (size_t j = currentEdge - 1; j > i; j--) node = node->previous.get();
+    return node->edge;
   }
 
 private:
@@ -272,6 +352,28 @@ private:
   void addTimeInfoFromCurrent(EdgeRequestType & edgeRequest,
                               double previousStartTime) const;
   double getPreviousStartTime() const;
+
+  /**
+   * Checks the edge against the variable bindings of the current edge
+   * description.  Returns false if either end is bound to a different
+   * value; otherwise sets bindSource/bindTarget to whether that end is 
+   * unbound and needs to be bound by the edge.
+   */
+  bool checkBindings(EdgeType const& edge, 
+                     bool& bindSource, bool& bindTarget) const;
+
+  /**
+   * Appends the edge to the result and binds the variables that checkBindings
+   * said were unbound.
+   */
+  void extend(EdgeType const& edge, bool bindSource, bool bindTarget);
+
+  /**
+   * A 64-bit hash of the source, target, time, and duration of the edge.
+   * Edges that come back from edge requests get new ids, so the id can't
+   * be used to spot a repeated edge.
+   */
+  static uint64_t fingerprint(EdgeType const& edge);
     
 };
 
@@ -292,6 +394,13 @@ SubgraphQueryResult(std::shared_ptr<const SubgraphQueryType> query,
     throw SubgraphQueryResultException("Subgraph query passed to "
       "SubgraphQueryResult is not finalized.");
   }
+
+  if (query->numVariables() > MAX_VARIABLES) {
+    throw SubgraphQueryResultException("SubgraphQueryResult supports at most "
+      + boost::lexical_cast<std::string>(size_t(MAX_VARIABLES)) + 
+      " variables but the query has " + 
+      boost::lexical_cast<std::string>(query->numVariables()));
+  }
  
   numEdges = subgraphQuery->size();
 
@@ -313,6 +422,63 @@ SubgraphQueryResult(std::shared_ptr<const SubgraphQueryType> query,
   }
 }
 
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration>
+SubgraphQueryResult<EdgeType, source, target, time, duration>::
+SubgraphQueryResult(std::shared_ptr<const TrieNodeType> node,
+                    EdgeType firstEdge) : 
+  SubgraphQueryResult(node->representative(), firstEdge)
+{
+  if (node->isShared()) {
+    shared = node;
+    numEdges = node->depth;
+    expireTime = startTime + node->maxTimeExtent;
+  }
+}
+
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration>
+std::vector<SubgraphQueryResult<EdgeType, source, target, time, duration>>
+SubgraphQueryResult<EdgeType, source, target, time, duration>::
+fork() const
+{
+  if (!atFork()) {
+    throw SubgraphQueryResultException("SubgraphQueryResult::fork() Tried "
+      "to fork a result that is not at a fork.");
+  }
+
+  // A copy of this result that continues with the given query.
+  auto forQuery = [this](std::shared_ptr<const SubgraphQueryType> query) {
+    if (query->numVariables() > MAX_VARIABLES) {
+      throw SubgraphQueryResultException("SubgraphQueryResult supports at "
+        "most " + boost::lexical_cast<std::string>(size_t(MAX_VARIABLES)) +
+        " variables but the query has " + 
+        boost::lexical_cast<std::string>(query->numVariables()));
+    }
+    SubgraphQueryResultType result(*this);
+    result.shared = nullptr;
+    result.subgraphQuery = query;
+    result.numEdges = query->size();
+    result.expireTime = startTime + query->getMaxTimeExtent();
+    return result;
+  };
+
+  std::vector<SubgraphQueryResultType> results;
+  for (auto const& query : shared->completes) {
+    results.push_back(forQuery(query));
+  }
+  for (auto const& child : shared->children) {
+    SubgraphQueryResultType result = forQuery(child->representative());
+    if (child->isShared()) {
+      result.shared = child;
+      result.numEdges = child->depth;
+      result.expireTime = startTime + child->maxTimeExtent;
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
 template <typename EdgeType, size_t source, size_t target,
           size_t time, size_t duration>
 SubgraphQueryResult<EdgeType, source, target, time, duration>::
@@ -347,12 +513,78 @@ double
 SubgraphQueryResult<EdgeType, source, target, time, duration>::
 getPreviousStartTime() const
 {
-  if (resultEdges.size() > 0) {
-    return std::get<time>(resultEdges.at(resultEdges.size() - 1).tuple);
+  if (path) {
+    return std::get<time>(path->edge.tuple);
   }
   return std::numeric_limits<double>::lowest();
 }
 
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration>
+uint64_t
+SubgraphQueryResult<EdgeType, source, target, time, duration>::
+fingerprint(EdgeType const& edge)
+{
+  typedef typename std::tuple_element<time, TupleType>::type TimeType;
+  typedef typename std::tuple_element<duration, TupleType>::type 
+    DurationType;
+
+  auto combine = [](uint64_t h, uint64_t v) {
+    return h ^ (v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2));
+  };
+  uint64_t h = std::hash<NodeType>()(std::get<source>(edge.tuple));
+  h = combine(h, std::hash<NodeType>()(std::get<target>(edge.tuple)));
+  h = combine(h, std::hash<TimeType>()(std::get<time>(edge.tuple)));
+  h = combine(h, std::hash<DurationType>()(std::get<duration>(edge.tuple)));
+  return h;
+}
+
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration>
+bool
+SubgraphQueryResult<EdgeType, source, target, time, duration>::
+checkBindings(EdgeType const& edge, bool& bindSource, bool& bindTarget) const
+{
+  NodeType const* src = boundValues[subgraphQuery->getSourceSlot(currentEdge)];
+  NodeType const* trg = boundValues[subgraphQuery->getTargetSlot(currentEdge)];
+
+  if (src && *src != std::get<source>(edge.tuple)) {
+    DEBUG_PRINT("SubgraphQueryResult::checkBindings: edgeSource %s "
+      " did not match bound source %s for tuple %s\n", 
+      std::get<source>(edge.tuple).c_str(), src->c_str(),
+      sam::toString(edge.tuple).c_str());
+    return false;
+  }
+  if (trg && *trg != std::get<target>(edge.tuple)) {
+    DEBUG_PRINT("SubgraphQueryResult::checkBindings: edgeTarget %s "
+      " did not match bound target %s for tuple %s\n", 
+      std::get<target>(edge.tuple).c_str(), trg->c_str(),
+      sam::toString(edge.tuple).c_str());
+    return false;
+  }
+  bindSource = src == nullptr;
+  bindTarget = trg == nullptr;
+  return true;
+}
+
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration>
+void
+SubgraphQueryResult<EdgeType, source, target, time, duration>::
+extend(EdgeType const& edge, bool bindSource, bool bindTarget)
+{
+  path = std::make_shared<PathNode const>(edge, std::move(path));
+  if (bindSource) {
+    boundValues[subgraphQuery->getSourceSlot(currentEdge)] = 
+      &std::get<source>(path->edge.tuple);
+  }
+  if (bindTarget) {
+    boundValues[subgraphQuery->getTargetSlot(currentEdge)] = 
+      &std::get<target>(path->edge.tuple);
+  }
+  currentEdge++;
+}
+
 template <typename EdgeType, size_t source, size_t target,
           size_t time, size_t duration>
 template <typename SourceHF, typename TargetHF>
@@ -362,7 +594,7 @@ hash(SourceHF const& sourceHash,
      TargetHF const& targetHash,
      std::list<EdgeRequestType> & edgeRequests,
      size_t nodeId,
-     size_t numNodes) 
+     RoutingTable const& routingTable) 
      const
 {
   // Get the source that we are looking for.  If the source is unbound,
@@ -391,9 +623,9 @@ hash(SourceHF const& sourceHash,
     DEBUG_PRINT("SubgraphQueryResult::hash: source is unbound, target is bound to"
       " %s\n", trg.c_str());
   
-    // If the target hashes to a different node, we need to make an edge
+    // If the target's edges go to a different node, we need to make an edge
     // request to that node.  
-    if (targetHash(trg) % numNodes != nodeId) {
+    if (!routingTable.receives(targetHash(trg), nodeId)) {
 
       EdgeRequestType edgeRequest;
       edgeRequest.setTarget(trg);
@@ -420,11 +652,11 @@ hash(SourceHF const& sourceHash,
     // If the source hashes to a different node, we need to make an edge
     // request to that node.
     #ifdef DEBUG
-    printf("SubgraphQueryResult::hash: sourceHash %llu %llu "
-      " numNodes %lu nodeId %lu\n", sourceHash(src), sourceHash(src) % numNodes,
-      numNodes, nodeId); 
+    printf("SubgraphQueryResult::hash: sourceHash %llu %lu "
+      " nodeId %lu\n", sourceHash(src), 
+      routingTable.owner(sourceHash(src)), nodeId); 
     #endif
-    if (sourceHash(src) % numNodes != nodeId) {
+    if (!routingTable.receives(sourceHash(src), nodeId)) {
 
       EdgeRequestType edgeRequest;
       edgeRequest.setSource(src);
@@ -447,8 +679,8 @@ hash(SourceHF const& sourceHash,
     // Need to make edge requests if both the source or target
     // map to a different node.  If either one maps to this node,
     // then we will get the edge.
-    if (sourceHash(src) % numNodes != nodeId &&
-        targetHash(trg) % numNodes != nodeId)
+    if (!routingTable.receives(sourceHash(src), nodeId) &&
+        !routingTable.receives(targetHash(trg), nodeId))
     {
       // It doesn't matter which node we send the edge request to
       EdgeRequestType edgeRequest;
@@ -507,14 +739,6 @@ bool
 SubgraphQueryResult<EdgeType, source, target, time, duration>::
 addEdgeInPlace(EdgeType const& edge)
 {
-  if (resultEdges.size() != currentEdge) {
-    std::string message = "addEdgeInPlace resultEdges.size() was not equal"
-      " to currentEdge " +
-      boost::lexical_cast<std::string>(resultEdges.size()) + " != " +
-      boost::lexical_cast<std::string>(currentEdge);
-    throw SubgraphQueryResultException(message); 
-  }
-
   if (currentEdge >= numEdges) {
     std::string message = "SubgraphQueryResult::addEdge Tried to add an edge " 
       "but the query has already been satisfied, i.e. currentEdge(" + 
@@ -530,72 +754,16 @@ addEdgeInPlace(EdgeType const& edge)
     return false;
   }
 
-  EdgeDescriptionType const& edgeDescription = 
-    subgraphQuery->getEdgeDescription(currentEdge);
-  std::string src = edgeDescription.getSource();
-  std::string trg = edgeDescription.getTarget();
-
-  // Case when the source has been bound but the target has not
-  if (var2BoundValue.count(src) > 0 &&
-      var2BoundValue.count(trg) == 0)
-  {
-    
-    NodeType edgeSource = std::get<source>(edge.tuple);
-    
-    if (edgeSource == var2BoundValue[src]) {
-      
-      NodeType edgeTarget = std::get<target>(edge.tuple);
-      var2BoundValue[trg] = edgeTarget;
-      
-    } else {
-      return false;
-    } 
-
-  } else if (var2BoundValue.count(src) == 0 && 
-             var2BoundValue.count(trg) > 0) {
-    
-    NodeType edgeTarget = std::get<target>(edge.tuple);
-    
-    if (edgeTarget == var2BoundValue[trg]) {
-      
-      NodeType edgeSource = std::get<source>(edge.tuple);
-      var2BoundValue[src] = edgeSource;
-        
-    } else {
-      return false;
-    } 
-  } else if (var2BoundValue.count(src) == 0 &&
-             var2BoundValue.count(trg) == 0)
-  { 
-    DEBUG_PRINT("Setting %s->%s and %s->%s\n", src.c_str(), 
-      std::get<source>(edge.tuple).c_str(), trg.c_str(), 
-      std::get<target>(edge.tuple).c_str());
-
-    var2BoundValue[src] = std::get<source>(edge.tuple);
-    var2BoundValue[trg] = std::get<target>(edge.tuple);
-  } else {
-
-    NodeType edgeTarget = std::get<target>(edge.tuple);
-    NodeType edgeSource = std::get<target>(edge.tuple);
-
-    if (edgeTarget != var2BoundValue[trg] ||
-        edgeSource != var2BoundValue[src])
-    {
-      return false;
-    }
+  bool bindSource, bindTarget;
+  if (!checkBindings(edge, bindSource, bindTarget)) {
+    return false;
   }
 
-  resultEdges.push_back(edge);
-  currentEdge++;
+  extend(edge, bindSource, bindTarget);
 
   DEBUG_PRINT_SIMPLE("Add edge in place returning true\n");
 
-  std::string edgeKey = 
-    boost::lexical_cast<std::string>(std::get<source>(edge.tuple)) +
-    boost::lexical_cast<std::string>(std::get<target>(edge.tuple)) +
-    boost::lexical_cast<std::string>(std::get<time>(edge.tuple)) +
-    boost::lexical_cast<std::string>(std::get<duration>(edge.tuple));
-  seenEdges.insert(edgeKey);
+  seenEdges.insert(fingerprint(edge));
   return true;
 }
 
@@ -605,18 +773,11 @@ std::pair<bool, SubgraphQueryResult<EdgeType, source, target, time, duration>>
 SubgraphQueryResult<EdgeType, source, target, time, duration>::
 addEdge(EdgeType const& edge)
 {
-  // Create a string from the source, target, time, and duration.  Check to see
+  // Hash the source, target, time, and duration.  Check to see
   // if that is in seenEdges.  If not, add it and continue processing.  If
   // so, do not continue processing.  This prevents duplicate subgraphs to
   // be created.
-  std::string edgeKey = 
-    boost::lexical_cast<std::string>(std::get<source>(edge.tuple)) +
-    boost::lexical_cast<std::string>(std::get<target>(edge.tuple)) +
-    boost::lexical_cast<std::string>(std::get<time>(edge.tuple)) +
-    boost::lexical_cast<std::string>(std::get<duration>(edge.tuple));
-  if (seenEdges.count(edgeKey) < 1) {
-
-    seenEdges.insert(edgeKey);
+  if (seenEdges.insert(fingerprint(edge))) {
 
     DEBUG_PRINT("SubgraphQueryResult::addEdge trying to add edge %s to result"
       " %s\n", sam::toString(edge.tuple).c_str(), toString().c_str());
@@ -633,7 +794,7 @@ addEdge(EdgeType const& edge)
     // and also it fits the existing variable bindings.
 
     if (currentEdge >= 1) {
-      double previousTime = std::get<time>(resultEdges[currentEdge - 1].tuple);
+      double previousTime = std::get<time>(path->edge.tuple);
       double currentTime = std::get<time>(edge.tuple); 
       
       if (currentTime <= previousTime) {
@@ -643,9 +804,6 @@ addEdge(EdgeType const& edge)
     }
 
     // Checking against edge description constraints
-    //EdgeDescriptionType const& edgeDescription = 
-    //  subgraphQuery->getEdgeDescription(currentEdge);
-
     if (!subgraphQuery->satisfiesConstraints(currentEdge, edge.tuple, 
       startTime)) 
     {
@@ -655,117 +813,21 @@ addEdge(EdgeType const& edge)
           SubgraphQueryResultType());
     }
 
-
-    /*if (!edgeDescription.satisfiesEdgeConstraints(
-          currentEdge, this->startTime)) {
-
-      DEBUG_PRINT("SubgraphQueryResult::addEdge this tuple %s did not satisfy"
-        " this edgeDescription %s\n", sam::toString(edge).c_str(), 
-        edgeDescription.toString().c_str());
-
+    bool bindSource, bindTarget;
+    if (!checkBindings(edge, bindSource, bindTarget)) {
       return std::pair<bool, SubgraphQueryResultType>(false, 
         SubgraphQueryResultType());
     }
 
-    if (!subgraphQuery->satisfiesVertexConstraints(currentEdge, edge))
-    {
-      return std::pair<bool, SubgraphQueryResultType>(false,
-        SubgraphQueryResultType()); 
-    }*/
-   
-    /*std::string src = edgeDescription.getSource();
-    std::string trg = edgeDescription.getTarget();
-
-    VertexConstraintChecker<SubgraphQueryType> check(*featureMap, 
-                                                     *subgraphQuery);
-    if (!check(src, edgeSource)) {
-      return std::pair<bool, SubgraphQueryResultType>(false,
-        SubgraphQueryResultType()); 
-    }
-    if (!check(trg, edgeTarget)) {
-      return std::pair<bool, SubgraphQueryResultType>(false,
-        SubgraphQueryResultType()); 
-    }*/
-
+    // The new result shares the edges of this one.
     SubgraphQueryResultType newResult(*this);
-
-    EdgeDescriptionType const& edgeDescription = 
-      subgraphQuery->getEdgeDescription(currentEdge);
-    std::string src = edgeDescription.getSource();
-    std::string trg = edgeDescription.getTarget();
-    NodeType edgeSource = std::get<source>(edge.tuple);
-    NodeType edgeTarget = std::get<target>(edge.tuple);
-
-    // Case when the source has been bound but the target has not
-    if (var2BoundValue.count(src) > 0 &&
-        var2BoundValue.count(trg) == 0)
-    {
-      
-      if (edgeSource == var2BoundValue.at(src)) {
-        
-        NodeType edgeTarget = std::get<target>(edge.tuple);
-        newResult.var2BoundValue[trg] = edgeTarget;
-        
-      } else {
-
-        DEBUG_PRINT("SubgraphQueryResult::addEdge: edgeSource %s "
-          " did not match var2BoundValue.at(src) %s for tuple %s\n", 
-          edgeSource.c_str(), var2BoundValue.at(src).c_str(),
-          sam::toString(edge.tuple).c_str());
-        return std::pair<bool, SubgraphQueryResultType>(false, 
-          SubgraphQueryResultType());
-      } 
-
-    } else if (var2BoundValue.count(src) == 0 && 
-               var2BoundValue.count(trg) > 0) 
-    {
-      
-      if (edgeTarget == var2BoundValue.at(trg)) {
-        
-        NodeType edgeSource = std::get<source>(edge.tuple);
-        newResult.var2BoundValue[src] = edgeSource;
-          
-      } else {
-        DEBUG_PRINT("SubgraphQueryResult::addEdge: edgeTarget %s "
-          " did not match var2BoundValue.at(trg) %s for tuple %s\n", 
-          edgeTarget.c_str(), var2BoundValue.at(trg).c_str(),
-          sam::toString(edge.tuple).c_str());
-
-        return std::pair<bool, SubgraphQueryResultType>(false, 
-          SubgraphQueryResultType());
-      } 
-    } else if (var2BoundValue.count(src) == 0 &&
-               var2BoundValue.count(trg) == 0)
-    { 
-      newResult.var2BoundValue[src] = edgeSource; 
-      newResult.var2BoundValue[trg] = edgeTarget;
-    } else {
-      
-      if (edgeTarget != var2BoundValue.at(trg) ||
-          edgeSource != var2BoundValue.at(src))
-      {
-        DEBUG_PRINT("SubgraphQueryResult::addEdge: edgeTarget %s "
-          " did not match var2BoundValue.at(trg) %s or edgeSource %s "
-          " dis not match var2BoundValue.at(src) %s for tuple %s\n", 
-          edgeTarget.c_str(), var2BoundValue.at(trg).c_str(),
-          edgeSource.c_str(), var2BoundValue.at(src).c_str(),
-          sam::toString(edge.tuple).c_str());
-
-
-
-        return std::pair<bool, SubgraphQueryResultType>(false,
-          SubgraphQueryResultType());
-      }
-
-    }
-
-    newResult.resultEdges.push_back(edge);
-    newResult.currentEdge++;
+    newResult.extend(edge, bindSource, bindTarget);
 
     DEBUG_PRINT("SubgraphQueryResult::addEdge: Added edge %s, update query:"
       " %s\n", sam::toString(edge.tuple).c_str(), newResult.toString().c_str());
 
-    return std::pair<bool, SubgraphQueryResultType>(true, newResult);
+    return std::pair<bool, SubgraphQueryResultType>(true, 
+      std::move(newResult));
   } else {
     DEBUG_PRINT("SubgraphQueryResult::addEdge: Did not add edge %s to query %s"
       " because the edge had already been seen before.\n", 
@@ -791,10 +853,10 @@ getCurrentSource() const
     throw SubgraphQueryResultException(message);   
   }
 
-  std::string sourceVar = subgraphQuery->getEdgeDescription(
-                            currentEdge).getSource();
-  if (var2BoundValue.count(sourceVar) > 0) {
-    return var2BoundValue.at(sourceVar);
+  NodeType const* value = 
+    boundValues[subgraphQuery->getSourceSlot(currentEdge)];
+  if (value) {
+    return *value;
   } else {
     return nullValue<NodeType>();
   }
@@ -814,10 +876,10 @@ getCurrentTarget() const
     throw SubgraphQueryResultException(message);   
   }
 
-  std::string targetVar = subgraphQuery->getEdgeDescription(
-                            currentEdge).getTarget();
-  if (var2BoundValue.count(targetVar) > 0) {
-    return var2BoundValue.at(targetVar);
+  NodeType const* value = 
+    boundValues[subgraphQuery->getTargetSlot(currentEdge)];
+  if (value) {
+    return *value;
   } else {
     return nullValue<NodeType>();
   }
@@ -4,6 +4,8 @@
 #include <sam/SubgraphQueryResult.hpp>
 #include <sam/CompressedSparse.hpp>
 #include <sam/AbstractSubgraphPrinter.hpp>
+#include <sam/ExpiryWheel.hpp>
+#include <atomic>
 #include <limits>
 
 namespace sam {
@@ -21,6 +23,12 @@ public:
  *    can be added to any existing intermediate results.
  * 2) add(result, edgeRequests) which adds a new intermediate result
  *    to the hash map.
+ *
+ * The intermediate results of each bin are kept in an ExpiryWheel ordered
+ * by expire time, so expired results are dropped a slot at a time rather
+ * than erased one by one.  Each call to process(edge, edgeRequests) also
+ * sweeps one more bin round robin, so bins that no edge hashes to don't
+ * hold on to dead results.
  */
 template <typename EdgeType, size_t source, size_t target,
           size_t time, size_t duration,
@@ -69,16 +77,29 @@ private:
   /// The total number of query results
   std::atomic<uint64_t> numQueryResults; 
 
+  /// The number of intermediate results stored, and the number that 
+  /// matching each query independently would have stored.  They differ
+  /// when results stand in for several queries (see QueryTrie).
+  std::atomic<uint64_t> numPartialResults;
+  std::atomic<uint64_t> numIndependentPartialResults;
+
   /// mutexes for each list element of alr.
   std::mutex* mutexes;
 
-  /// An array of lists of results.  The first level is an 
-  /// array of size tableCapacity.  
-  std::vector<QueryResultType> *alr;
+  /// The intermediate results.  An array of size tableCapacity of
+  /// wheels ordered by expire time.
+  ExpiryWheel<QueryResultType> *alr;
+
+  /// The next bin to be swept by process(edge, edgeRequests).
+  std::atomic<size_t> sweepCursor;
 
   size_t numNodes;
   size_t nodeId;
 
+  /// Says which nodes get the edges of a vertex, so which edges need to be
+  /// requested.
+  std::shared_ptr<RoutingTable> routingTable;
+
   std::shared_ptr<PrinterType> printer;
 
   #ifdef DETAIL_TIMING
@@ -93,8 +114,8 @@ private:
   #endif
 
   #ifdef METRICS
-  size_t totalResultsDeleted = 0;
-  size_t totalResultsCreated = 0;
+  std::atomic<size_t> totalResultsDeleted{0};
+  std::atomic<size_t> totalResultsCreated{0};
   #endif
 
 public:
@@ -104,13 +125,20 @@ public:
    * \param nodeId The node id of this node.
    * \param tableCapacity How many bins for intermediate query results.
    * \param resultsCapacity How many completed queries can be stored.
+   * \param expiryGranularity The length of time covered by a slot of the
+   *   expiry wheels.  Expired results are dropped within about this long.
+   * \param routingTable Says which nodes get the edges of a vertex.  If
+   *   null, vertices are owned by a HashRing of all the nodes.
    */
   SubgraphQueryResultMap( size_t numNodes,
                           size_t nodeId,
                           size_t tableCapacity,
                           size_t resultsCapacity,
                           CsrType const& _csr,
-                          CscType const& _csc);
+                          CscType const& _csc,
+                          double expiryGranularity = 1.0,
+                          std::shared_ptr<RoutingTable> routingTable = 
+                            nullptr);
 
   ~SubgraphQueryResultMap();
 
@@ -139,6 +167,16 @@ public:
   void add(QueryResultType const& result, 
            std::list<EdgeRequestType>& edgeRequests);
 
+  /**
+   * Called after the cluster membership changes.  Makes edge requests for
+   * the intermediate results that are waiting on a vertex whose edges used
+   * to come to this node but now go elsewhere.  Requests that were already
+   * made are handed on by the old owner of the vertex, not remade here.
+   * \param edgeRequests The new edge requests are added here.
+   * \return Returns the number of edge requests added.
+   */
+  size_t reissueEdgeRequests(std::list<EdgeRequestType>& edgeRequests);
+
   /**
    * Returns the number of completed results that have been created.
    */
@@ -153,6 +191,22 @@ public:
     numQueryResults = 0;
   }
 
+  /**
+   * Returns the number of intermediate results that have been stored.
+   */
+  uint64_t getNumPartialResults() const {
+    return numPartialResults;
+  }
+
+  /**
+   * Returns the number of intermediate results that would have been stored
+   * if each query were matched on its own.  The difference with 
+   * getNumPartialResults() is the savings of sharing query prefixes.
+   */
+  uint64_t getNumIndependentPartialResults() const {
+    return numIndependentPartialResults;
+  }
+
   /**
    * Returns the number of intermediate results in the table.
    * Does not block other threads, so the number of intermediate
@@ -252,6 +306,30 @@ private:
         std::function<bool(QueryResultType const&)> checkFunction );
 
   size_t processAgainstGraph(std::list<QueryResultType>& rehash);
+
+  /**
+   * Adds the result to the list, or if it is at a fork (see 
+   * SubgraphQueryResult::atFork()), the results it forks into.
+   */
+  void pushForked(std::list<QueryResultType>& results,
+                  QueryResultType const& result);
+
+  /**
+   * Adds an intermediate result to its bin.  The caller holds the bin's
+   * mutex.
+   */
+  void insert(size_t index, QueryResultType const& result);
+
+  /**
+   * Drops the whole slots of expired results from the bin.  The caller 
+   * holds the bin's mutex.
+   */
+  void expireBin(size_t index, double currentTime);
+
+  /**
+   * Expires the bin if no one else holds it.
+   */
+  void trySweep(size_t index, double currentTime);
 };
 
 /// Constructor
@@ -266,9 +344,15 @@ SubgraphQueryResultMap<EdgeType, source, target, time, duration,
                          size_t tableCapacity,
                          size_t resultCapacity,
                          CsrType const& _csr,
-                         CscType const& _csc) :
-                         csc(_csc), csr(_csr)
+                         CscType const& _csc,
+                         double expiryGranularity,
+                         std::shared_ptr<RoutingTable> routingTable) :
+                         csc(_csc), csr(_csr), routingTable(routingTable)
 {
+  if (!this->routingTable) {
+    this->routingTable = std::make_shared<RoutingTable>(numNodes);
+  }
+
   sourceIndexFunction = [this](TupleType const& tuple) {
     SourceType src = std::get<source>(tuple);
     size_t index = this->sourceHash(src) % this->tableCapacity;
@@ -318,11 +402,16 @@ SubgraphQueryResultMap<EdgeType, source, target, time, duration,
   queryResults.resize(resultCapacity);
   
   numQueryResults = 0;
+  numPartialResults = 0;
+  numIndependentPartialResults = 0;
 
   mutexes = new std::mutex[tableCapacity];
 
-  alr = new std::vector<QueryResultType>[tableCapacity];
-
+  alr = new ExpiryWheel<QueryResultType>[tableCapacity];
+  for (size_t i = 0; i < tableCapacity; i++) {
+    alr[i] = ExpiryWheel<QueryResultType>(expiryGranularity);
+  }
+  sweepCursor = 0;
 }
 
 /// Destructor
@@ -354,7 +443,7 @@ add(QueryResultType const& result,
     " edge request size %lu\n", nodeId, edgeRequests.size())
 
   std::list<QueryResultType> localQueryResults;
-  localQueryResults.push_back(result);
+  pushForked(localQueryResults, result);
 
   processAgainstGraph(localQueryResults);
 
@@ -367,7 +456,7 @@ add(QueryResultType const& result,
       // The hash function also adds an edge request to the list if the
       // thing we are looking for isn't going to come to this node.    
       size_t newIndex = localQueryResult.hash(sourceHash, targetHash,
-                                    edgeRequests, nodeId, numNodes) 
+                                    edgeRequests, nodeId, *routingTable) 
                                     % tableCapacity;
       std::string requestString = "";
       for(auto request : edgeRequests) {
@@ -395,10 +484,8 @@ add(QueryResultType const& result,
       DEBUG_PRINT("Node %lu SubgraphQueryResultMap::add result %s "
         " adding to alr[%lu]\n", nodeId, 
         localQueryResult.toString().c_str(), newIndex);
-      alr[newIndex].push_back(localQueryResult);
+      insert(newIndex, localQueryResult);
       mutexes[newIndex].unlock();
-
-      METRICS_INCREMENT(totalResultsCreated)
  
     } else {
       DEBUG_PRINT("Node %lu Complete query! %s\n", nodeId, 
@@ -436,7 +523,7 @@ add_nocheck(QueryResultType const& result,
     // The hash function also adds an edge request to the list if the
     // thing we are looking for isn't going to come to this node.    
     size_t newIndex = result.hash(sourceHash, targetHash,
-                                  edgeRequests, nodeId, numNodes) 
+                                  edgeRequests, nodeId, *routingTable) 
                                   % tableCapacity;
     std::string requestString = "";
     for(auto request : edgeRequests) {
@@ -461,11 +548,9 @@ add_nocheck(QueryResultType const& result,
     //}
      
     mutexes[newIndex].lock();
-    alr[newIndex].push_back(result);
+    insert(newIndex, result);
     mutexes[newIndex].unlock(); 
 
-    METRICS_INCREMENT(totalResultsCreated)
-
   } else {
     DEBUG_PRINT("Node %lu Complete query! %s\n", nodeId, 
       result.toString().c_str());
@@ -512,6 +597,11 @@ process(EdgeType const& edge,
                           sourceTargetIndexFunction, sourceTargetCheckFunction);
   DETAIL_TIMING_END2(totalTimeProcessSourceTarget)
 
+  // Sweep one more bin so that every bin is eventually expired, even ones
+  // that no edge hashes to.
+  trySweep(sweepCursor.fetch_add(1) % tableCapacity,
+           std::get<time>(edge.tuple));
+
   DEBUG_PRINT("Node %lu End of SubgraphQueryResultMap edgeRequests.size()"
     " %lu\n", nodeId, edgeRequests.size())
 
@@ -588,7 +678,7 @@ processAgainstGraph(std::list<QueryResultType>& rehash)
               "iter %lu Created a new QueryResult: %s\n", nodeId, iter,
               p.second.toString().c_str());
             // push the new result to the end of the rehash list.
-            rehash.push_back(p.second);
+            pushForked(rehash, p.second);
           }
         }
 
@@ -627,7 +717,7 @@ processAgainstGraph(std::list<QueryResultType>& rehash)
               "iter %lu Created a new QueryResult: %s\n", nodeId, iter,
               p.second.toString().c_str());
             // push the new result to the end of the rehash list.
-            rehash.push_back(p.second);
+            pushForked(rehash, p.second);
           }
         }
 
@@ -693,49 +783,45 @@ process(EdgeType const& edge,
     "edgeRequests, indexFunction, checkFunction) alr[%lu].size() %lu "
     "tuple %s\n", nodeId, index, alr[index].size(), 
     toString(edge.tuple).c_str());
+
+  // Whole slots of expired results are dropped at once.  Results in the
+  // slot that is partly expired are skipped below.
+  expireBin(index, currentTime);
     
-  for(auto l = this->alr[index].begin();
-        l != this->alr[index].end(); ) 
+  alr[index].forEach([&](QueryResultType& l)
   {
     totalWork++;
-    if (l->isExpired(currentTime)) {
-      DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process(tuple, "
-      "edgeRequests, indexFunction, checkFunction) tuple %s deleting "
-      "result %s", nodeId, toString(edge.tuple).c_str(), l->toString().c_str());
-      l = this->alr[index].erase(l);
-      METRICS_INCREMENT(this->totalResultsDeleted)
-    } else {
-      if (checkFunction(*l)) {
-        DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process "
-         "considering %s\n", nodeId, l->toString().c_str());
-
-        // Make sure none of the edges has the same samId as the current tuple
-        if (l->noSamId(edge.id)) {
-          // The following call tries to add the tuple to the existing 
-          // intermediate result, l.  If succesful, l remains the same
-          // but a new intermediate result is created.
-
-          DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process about to try"
-           " and add tuple %s to result %s\n", nodeId, 
-           toString(edge.tuple).c_str(), l->toString().c_str());
-          
-          std::pair<bool, QueryResultType> p = l->addEdge(edge);
-          if (p.first) {
-
-            DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process added "
-              "tuple %s to result %s\n", nodeId, 
-              toString(edge.tuple).c_str(), l->toString().c_str());
-
-            rehash.push_back(p.second);
-          }
-        } else {
-          DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process had the id "
-            "already \n", this->nodeId);
+    if (l.isExpired(currentTime)) return;
+
+    if (checkFunction(l)) {
+      DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process "
+       "considering %s\n", nodeId, l.toString().c_str());
+
+      // Make sure none of the edges has the same samId as the current tuple
+      if (l.noSamId(edge.id)) {
+        // The following call tries to add the tuple to the existing 
+        // intermediate result, l.  If succesful, l remains the same
+        // but a new intermediate result is created.
+
+        DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process about to try"
+         " and add tuple %s to result %s\n", nodeId, 
+         toString(edge.tuple).c_str(), l.toString().c_str());
+        
+        std::pair<bool, QueryResultType> p = l.addEdge(edge);
+        if (p.first) {
+
+          DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process added "
+            "tuple %s to result %s\n", nodeId, 
+            toString(edge.tuple).c_str(), l.toString().c_str());
+
+          pushForked(rehash, p.second);
         }
+      } else {
+        DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process had the id "
+          "already \n", this->nodeId);
       }
-    ++l;
     }
-  }
+  });
   mutexes[index].unlock();
   DEBUG_PRINT("Node %lu SubgraphQueryResultMap::process total work after for "
     "loop %lu\n", nodeId, totalWork);
@@ -768,6 +854,104 @@ process(EdgeType const& edge,
   return totalWork;
 }
 
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+void
+SubgraphQueryResultMap<EdgeType, source, target, time, duration,
+                       SourceHF, TargetHF, SourceEF, TargetEF>::
+insert(size_t index, QueryResultType const& result)
+{
+  alr[index].insert(result, result.getExpireTime());
+  METRICS_INCREMENT(totalResultsCreated)
+  numPartialResults.fetch_add(1);
+  numIndependentPartialResults.fetch_add(result.numQueries());
+}
+
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+void
+SubgraphQueryResultMap<EdgeType, source, target, time, duration,
+                       SourceHF, TargetHF, SourceEF, TargetEF>::
+expireBin(size_t index, double currentTime)
+{
+  #ifdef METRICS
+  totalResultsDeleted += alr[index].expire(currentTime);
+  #else
+  alr[index].expire(currentTime);
+  #endif
+}
+
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+void
+SubgraphQueryResultMap<EdgeType, source, target, time, duration,
+                       SourceHF, TargetHF, SourceEF, TargetEF>::
+pushForked(std::list<QueryResultType>& results, 
+           QueryResultType const& result)
+{
+  if (result.atFork()) {
+    for (QueryResultType const& forked : result.fork()) {
+      results.push_back(forked);
+    }
+  } else {
+    results.push_back(result);
+  }
+}
+
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+void
+SubgraphQueryResultMap<EdgeType, source, target, time, duration,
+                       SourceHF, TargetHF, SourceEF, TargetEF>::
+trySweep(size_t index, double currentTime)
+{
+  if (mutexes[index].try_lock()) {
+    expireBin(index, currentTime);
+    mutexes[index].unlock();
+  }
+}
+
+template <typename EdgeType, size_t source, size_t target,
+          size_t time, size_t duration,
+          typename SourceHF, typename TargetHF,
+          typename SourceEF, typename TargetEF>
+size_t
+SubgraphQueryResultMap<EdgeType, source, target, time, duration,
+                       SourceHF, TargetHF, SourceEF, TargetEF>::
+reissueEdgeRequests(std::list<EdgeRequestType>& edgeRequests)
+{
+  size_t numAdded = 0;
+  for (size_t i = 0; i < tableCapacity; i++) {
+    std::lock_guard<std::mutex> lock(mutexes[i]);
+    alr[i].forEach([&](QueryResultType const& result) {
+      std::list<EdgeRequestType> requests;
+      result.hash(sourceHash, targetHash, requests, nodeId, *routingTable);
+      for (auto const& request : requests) {
+        SourceType src = request.getSource();
+        TargetType trg = request.getTarget();
+        bool wasHere = 
+          (!isNull(src) && 
+           routingTable->previouslyReceived(sourceHash(src), nodeId)) ||
+          (!isNull(trg) && 
+           routingTable->previouslyReceived(targetHash(trg), nodeId));
+        if (wasHere) {
+          edgeRequests.push_back(request);
+          numAdded++;
+        }
+      }
+    });
+  }
+  return numAdded;
+}
+
 }
 
 
@@ -80,6 +80,7 @@ void PopularSites::run()
 
     parallelFeed(edge);
   }
+  waitForConsumers();
 }
 
 
@@ -206,6 +207,7 @@ void TopKProducer::run() {
     }
 
   }
+  waitForConsumers();
 }
 
 std::list<std::string> const& TopKProducer::getServerIps() const
@@ -265,6 +267,7 @@ void GeneralNetflowProducer::run()
       parallelFeed(edge);
     }  
   }
+  waitForConsumers();
 }
 
 }
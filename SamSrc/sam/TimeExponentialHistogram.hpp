@@ -0,0 +1,174 @@
+#ifndef TIME_EXPONENTIAL_HISTOGRAM_HPP
+#define TIME_EXPONENTIAL_HISTOGRAM_HPP
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+namespace sam {
+
+/**
+ * An exponential histogram (Datar et al.) over a window of time rather than
+ * a window of N items.  Each bucket holds the sum of a power of two number
+ * of items and the time of the newest of them.  If there are more than
+ * k/2 + 2 buckets of the same size (k + 2 buckets if the bucket size
+ * equals 1), the oldest two buckets of that size are combined, so the
+ * number of buckets grows with the log of the number of items in the
+ * window.
+ *
+ * Items with time t are in the window at time now if t > now - duration.
+ * Buckets are expired lazily, when an item is added or the total is asked
+ * for, so a histogram that isn't touched costs nothing.  The oldest bucket
+ * can straddle the edge of the window; it is counted in full until its
+ * newest item expires, which bounds the error by the size of that bucket.
+ */
+template <typename T>
+class TimeExponentialHistogram
+{
+public:
+  struct Bucket {
+    T sum; ///> Sum of the items in the bucket
+    size_t count; ///> Number of items in the bucket, a power of two
+    double time; ///> Time of the newest item in the bucket
+  };
+
+private:
+  double duration; ///> Length of the window in the units of the times
+  size_t k;
+
+  std::vector<Bucket> buckets; ///> Oldest bucket first
+
+  T total = 0; ///> Sum of the items in the buckets
+  size_t numItems = 0; ///> Number of items in the buckets
+
+  ///> Newest time seen.  Items that arrive out of order are treated as if
+  ///> they arrived at this time.
+  double latest = std::numeric_limits<double>::lowest();
+
+public:
+  /**
+   * \param duration The length of the window.
+   * \param k Determines the number of buckets of each size.
+   */
+  TimeExponentialHistogram(double duration, size_t k) :
+    duration(duration), k(k)
+  {
+    if (duration <= 0) {
+      throw std::out_of_range("Duration of a time window must be > 0, was " +
+                              boost::lexical_cast<std::string>(duration));
+    }
+  }
+
+  /**
+   * Adds the item with the given time to the window and expires the
+   * buckets that have fallen out of it.
+   */
+  void add(T item, double time) {
+    if (time > latest) latest = time;
+    expire(latest);
+
+    total = total + item;
+    numItems++;
+    buckets.push_back(Bucket{item, 1, latest});
+    merge();
+  }
+
+  /**
+   * Drops the buckets whose newest item is no longer in the window at the
+   * given time.
+   */
+  void expire(double time) {
+    size_t i = 0;
+    while (i < buckets.size() && buckets[i].time <= time - duration) {
+      total = total - buckets[i].sum;
+      numItems -= buckets[i].count;
+      i++;
+    }
+    if (i > 0) buckets.erase(buckets.begin(), buckets.begin() + i);
+  }
+
+  /**
+   * Returns the sum of the items in the window at the given time.
+   */
+  T getTotal(double time) {
+    expire(time);
+    return total;
+  }
+
+  /**
+   * Returns the sum as of the last add() or expire().
+   */
+  T getTotal() const { return total; }
+
+  /**
+   * Returns the number of items in the window at the given time.
+   */
+  size_t getNumItems(double time) {
+    expire(time);
+    return numItems;
+  }
+
+  /**
+   * Returns the number of items as of the last add() or expire().
+   */
+  size_t getNumItems() const { return numItems; }
+
+  size_t getNumBuckets() const { return buckets.size(); }
+
+  double getDuration() const { return duration; }
+
+  /**
+   * Returns an estimate of the bytes held by this histogram.
+   */
+  size_t memoryUsage() const {
+    return sizeof(*this) + buckets.capacity() * sizeof(Bucket);
+  }
+
+  /**
+   * Returns an estimate of the bytes held by a histogram with the given k
+   * when there are maxItems items in its window.
+   */
+  static size_t memoryUsage(size_t k, size_t maxItems) {
+    size_t numBuckets = k + 2;
+    for (size_t size = 2; size <= maxItems; size *= 2) {
+      numBuckets += k/2 + 2;
+    }
+    return sizeof(TimeExponentialHistogram<T>) + numBuckets * sizeof(Bucket);
+  }
+
+private:
+  size_t limit(size_t count) const {
+    return count == 1 ? k + 2 : k/2 + 2;
+  }
+
+  /**
+   * Combines buckets after an add.  Bucket sizes never decrease toward the
+   * oldest bucket, so the buckets of a size are contiguous.  Starting with
+   * the newest run, if a run has too many buckets its two oldest are
+   * combined, which adds one to the run of the next size.
+   */
+  void merge() {
+    size_t end = buckets.size(); // One past the newest bucket of the run
+    size_t count = 1;
+    while (end > 0) {
+      size_t start = end;
+      while (start > 0 && buckets[start - 1].count == count) start--;
+      if (end - start <= limit(count)) return;
+
+      Bucket& older = buckets[start];
+      Bucket& newer = buckets[start + 1];
+      older.sum = older.sum + newer.sum;
+      older.count = older.count + newer.count;
+      older.time = newer.time;
+      buckets.erase(buckets.begin() + start + 1);
+
+      end = start + 1;
+      count *= 2;
+    }
+  }
+};
+
+}
+#endif
@@ -0,0 +1,217 @@
+#ifndef TIME_EXPONENTIAL_HISTOGRAM_SUM_HPP
+#define TIME_EXPONENTIAL_HISTOGRAM_SUM_HPP
+
+/**
+ * Calculates the sum and average over a sliding window of time using
+ * exponential histograms.  These are the time based counterparts of
+ * ExponentialHistogramSum and ExponentialHistogramAve: instead of the last
+ * N items of a key, the window holds the items of the key from the last
+ * duration seconds (as given by the timeField of the tuples).
+ */
+
+#include <functional>
+#include <iostream>
+
+#include <sam/AbstractConsumer.hpp>
+#include <sam/BaseComputation.hpp>
+#include <sam/TimeExponentialHistogram.hpp>
+#include <sam/Features.hpp>
+#include <sam/Util.hpp>
+#include <sam/FeatureProducer.hpp>
+#include <sam/KeyedState.hpp>
+#include <sam/tuples/Edge.hpp>
+
+namespace sam {
+
+/**
+ * The number of items in a window assumed when estimating the memory of a
+ * time based histogram for the KeyedState budget.
+ */
+size_t const TIME_EH_EXPECTED_ITEMS = 1 << 20;
+
+template <typename T, typename EdgeType,
+          size_t valueField, size_t timeField, size_t... keyFields>
+class TimeExponentialHistogramSum: public AbstractConsumer<EdgeType>,
+                                   public BaseComputation,
+                                   public FeatureProducer
+{
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+
+private:
+
+  // Determines number of buckets.  If there are k/2 + 2 buckets
+  // of the same size (k + 2 buckets if the bucket size equals 1),
+  // the oldest two buckets are combined.
+  size_t k;
+
+  // The length of the sliding window in the units of timeField.
+  double duration;
+
+  // A mapping from keyFields to the associated exponential histogram.
+  KeyedState<std::shared_ptr<TimeExponentialHistogram<T>>> allWindows;
+
+public:
+  /**
+   * Constructor.  A key that hasn't been seen for longer than duration has
+   * an empty window, so it is evicted.
+   * \param duration The length of the sliding window in the units of
+   *                 timeField (e.g. seconds).
+   * \param k Determines the number of buckets.  If there are k/2 + 2 buckets
+   *          of the same size (k + 2 buckets if bucket size equals 1),
+   *          the oldest two buckets are combined.
+   * \param nodeId The nodeId of the node that is running this operator.
+   * \param featureMap The global featureMap that holds the features produced
+   *                   by this operator.
+   * \param identifier A unique identifier associated with this operator.
+   * \param maxStateBytes Memory budget for the per-key histograms.  The
+   *               least recently used keys are evicted to stay under it.
+   *               0 means no limit.
+   */
+  TimeExponentialHistogramSum(double duration, size_t k,
+                              size_t nodeId,
+                              std::shared_ptr<FeatureMap> featureMap,
+                              std::string identifier,
+                              size_t maxStateBytes = 0) :
+                              BaseComputation(nodeId, featureMap, identifier),
+                              allWindows(duration, maxStateBytes,
+                                TimeExponentialHistogram<T>::memoryUsage(k,
+                                  TIME_EH_EXPECTED_ITEMS))
+  {
+    if (duration <= 0) {
+      throw std::out_of_range("TimeExponentialHistogramSum: duration must "
+        "be > 0");
+    }
+    this->duration = duration;
+    this->k = k;
+  }
+
+  /**
+   * Main method of an operator.  Processes the tuple.
+   * \param input The tuple to process.
+   */
+  bool consume(EdgeType const& edge)
+  {
+    this->feedCount++;
+
+    if (this->feedCount % this->metricInterval == 0) {
+      std::cout << "NodeId " << this->nodeId << " number of keys "
+                << allWindows.size() << " keys evicted "
+                << allWindows.getKeysEvicted() << " bytes held "
+                << allWindows.getBytesHeld() << " feedCount "
+                << this->feedCount << std::endl;
+    }
+
+    // Generates unique key from key fields
+    std::string key = generateKey<keyFields...>(edge.tuple);
+
+    // Create an exponential histogram if it doesn't exist for the given key
+    double time = std::get<timeField>(edge.tuple);
+    auto eh = allWindows.get(key, time, [this]() {
+      return std::make_shared<TimeExponentialHistogram<T>>(duration, k);
+    });
+
+    // Update the data structure, which also expires old buckets.
+    T value = std::get<valueField>(edge.tuple);
+    eh->add(value, time);
+
+    // Getting the current sum and providing that to the feature map.
+    T currentSum = eh->getTotal();
+    SingleFeature feature(currentSum);
+    this->featureMap->updateInsert(key, this->identifier, feature);
+
+    this->notifySubscribers(edge.id, currentSum);
+
+    return true;
+  }
+
+  void terminate() {}
+
+};
+
+template <typename T, typename EdgeType,
+          size_t valueField, size_t timeField, size_t... keyFields>
+class TimeExponentialHistogramAve: public AbstractConsumer<EdgeType>,
+                                   public BaseComputation,
+                                   public FeatureProducer
+{
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+
+private:
+
+  // Determines number of buckets.
+  size_t k;
+
+  // The length of the sliding window in the units of timeField.
+  double duration;
+
+  // Mapping from string key to the histogram representing the key.
+  KeyedState<std::shared_ptr<TimeExponentialHistogram<T>>> allWindows;
+
+public:
+  /**
+   * Constructor.  The parameters are the same as for
+   * TimeExponentialHistogramSum.
+   */
+  TimeExponentialHistogramAve(double duration, size_t k,
+                              size_t nodeId,
+                              std::shared_ptr<FeatureMap> featureMap,
+                              std::string identifier,
+                              size_t maxStateBytes = 0) :
+                              BaseComputation(nodeId, featureMap, identifier),
+                              allWindows(duration, maxStateBytes,
+                                TimeExponentialHistogram<T>::memoryUsage(k,
+                                  TIME_EH_EXPECTED_ITEMS))
+  {
+    if (duration <= 0) {
+      throw std::out_of_range("TimeExponentialHistogramAve: duration must "
+        "be > 0");
+    }
+    this->duration = duration;
+    this->k = k;
+  }
+
+  bool consume(EdgeType const& edge)
+  {
+    this->feedCount++;
+    if (this->feedCount % this->metricInterval == 0) {
+      std::string message = "TimeExponentialHistogramAve id " +
+        this->identifier + " NodeId " +
+        boost::lexical_cast<std::string>(this->nodeId) +
+        " number of keys " +
+        boost::lexical_cast<std::string>(allWindows.size()) +
+        " keys evicted " +
+        boost::lexical_cast<std::string>(allWindows.getKeysEvicted()) +
+        " bytes held " +
+        boost::lexical_cast<std::string>(allWindows.getBytesHeld()) +
+        " feedCount " + boost::lexical_cast<std::string>(this->feedCount)+ "\n";
+      printf("%s", message.c_str());
+    }
+
+    // Generates unique key from key fields
+    std::string key = generateKey<keyFields...>(edge.tuple);
+
+    double time = std::get<timeField>(edge.tuple);
+    auto eh = allWindows.get(key, time, [this]() {
+      return std::make_shared<TimeExponentialHistogram<T>>(duration, k);
+    });
+
+    T value = std::get<valueField>(edge.tuple);
+    eh->add(value, time);
+
+    // The window holds at least the item just added.
+    T currentSum = eh->getTotal();
+    SingleFeature feature(currentSum / eh->getNumItems());
+    this->featureMap->updateInsert(key, this->identifier, feature);
+
+    this->notifySubscribers(edge.id, currentSum / eh->getNumItems());
+
+    return true;
+  }
+
+  void terminate() {}
+};
+
+}
+#endif
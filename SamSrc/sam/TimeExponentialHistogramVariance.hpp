@@ -0,0 +1,141 @@
+#ifndef TIME_EXPONENTIAL_HISTOGRAM_VARIANCE_HPP
+#define TIME_EXPONENTIAL_HISTOGRAM_VARIANCE_HPP
+
+/**
+ * The time based counterpart of ExponentialHistogramVariance.  The window
+ * of a key holds its items from the last duration seconds (as given by the
+ * timeField of the tuples) and keeps track of the sum of the items and the
+ * sum of the squares.
+ */
+
+#include <functional>
+#include <iostream>
+
+#include <sam/AbstractConsumer.hpp>
+#include <sam/BaseComputation.hpp>
+#include <sam/TimeExponentialHistogram.hpp>
+#include <sam/TimeExponentialHistogramSum.hpp>
+#include <sam/Features.hpp>
+#include <sam/Util.hpp>
+#include <sam/FeatureProducer.hpp>
+#include <sam/KeyedState.hpp>
+#include <sam/tuples/Edge.hpp>
+
+namespace sam {
+
+template <typename T, typename EdgeType,
+          size_t valueField, size_t timeField, size_t... keyFields>
+class TimeExponentialHistogramVariance :
+  public AbstractConsumer<EdgeType>,
+  public BaseComputation,
+  public FeatureProducer
+{
+public:
+  typedef typename EdgeType::LocalTupleType TupleType;
+
+private:
+
+  // Determines number of buckets.
+  size_t k;
+
+  // The length of the sliding window in the units of timeField.
+  double duration;
+
+  // The sum of the items and the sum of the squares for one key.  Both
+  // see the same items at the same times, so their buckets line up.
+  struct SumsAndSquares {
+    TimeExponentialHistogram<T> sums;
+    TimeExponentialHistogram<T> squares;
+
+    SumsAndSquares(double duration, size_t k) :
+      sums(duration, k), squares(duration, k) {}
+  };
+
+  KeyedState<std::shared_ptr<SumsAndSquares>> allWindows;
+
+public:
+  /**
+   * Constructor.  The parameters are the same as for
+   * TimeExponentialHistogramSum.
+   */
+  TimeExponentialHistogramVariance(double duration, size_t k,
+                          size_t nodeId,
+                          std::shared_ptr<FeatureMap> featureMap,
+                          std::string identifier,
+                          size_t maxStateBytes = 0) :
+                          BaseComputation(
+                            nodeId,featureMap, identifier),
+                          allWindows(duration, maxStateBytes,
+                            2 * TimeExponentialHistogram<T>::memoryUsage(k,
+                              TIME_EH_EXPECTED_ITEMS))
+  {
+    if (duration <= 0) {
+      throw std::out_of_range("TimeExponentialHistogramVariance: duration "
+        "must be > 0");
+    }
+    this->duration = duration;
+    this->k = k;
+  }
+
+  bool consume(EdgeType const& edge)
+  {
+    this->feedCount++;
+    if (this->feedCount % this->metricInterval == 0) {
+      std::string message = "TimeExponentialHistogramVariance id " +
+        this->identifier + " NodeId " +
+        boost::lexical_cast<std::string>(this->nodeId) +
+        " number of keys " +
+        boost::lexical_cast<std::string>(allWindows.size()) +
+        " keys evicted " +
+        boost::lexical_cast<std::string>(allWindows.getKeysEvicted()) +
+        " bytes held " +
+        boost::lexical_cast<std::string>(allWindows.getBytesHeld()) +
+        " feedCount " + boost::lexical_cast<std::string>(this->feedCount) +
+        "\n";
+        printf("%s", message.c_str());
+    }
+
+    // Generates unique key from key fields
+    std::string key = generateKey<keyFields...>(edge.tuple);
+
+    double time = std::get<timeField>(edge.tuple);
+    auto window = allWindows.get(key, time, [this]() {
+      return std::make_shared<SumsAndSquares>(duration, k);
+    });
+
+    std::string sValue = boost::lexical_cast<std::string>(
+                      std::get<valueField>(edge.tuple));
+
+    T value = boost::lexical_cast<T>(sValue);
+
+    window->sums.add(value, time);
+    window->squares.add(value * value, time);
+
+    // Getting the current variance and providing that to the featureMap
+    T currentSum = window->sums.getTotal();
+    T currentSquares = window->squares.getTotal();
+
+    size_t numItems = window->sums.getNumItems();
+    double currentVariance = calculateVariance(currentSquares, currentSum,
+                                               numItems);
+    SingleFeature feature(currentVariance);
+    this->featureMap->updateInsert(key, this->identifier, feature);
+
+    notifySubscribers(edge.id, currentVariance);
+
+    return true;
+  }
+
+  void terminate() {}
+
+private:
+  double calculateVariance(T sumOfSquares, T sum, size_t numItems) {
+    double variance = boost::lexical_cast<double>(sumOfSquares) / numItems -
+                boost::lexical_cast<double>(sum * sum) / (numItems * numItems);
+    return variance;
+  }
+
+};
+
+}
+#endif
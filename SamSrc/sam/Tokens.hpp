@@ -382,11 +382,12 @@ public:
                 std::tuple<Ts...> const& input)
   {
     //std::cout << "FuncToken evaluate " << std::endl;
-    if (this->featureMap->exists(key, identifier)) {
+    auto feature = this->featureMap->find(key, identifier);
+    if (feature) {
       //std::cout << "Key identifier exists in feature map " << key << " "
       //          << identifier << std::endl;
       try {
-        double d = this->featureMap->at(key, identifier)->evaluate(function);
+        double d = feature->evaluate(function);
         //std::cout << "Got d " << d << std::endl;
         mystack.push(d);
       } catch (std::exception e) {
@@ -448,11 +449,11 @@ public:
 
     // Check to see if the feature has been added before
     bool exists = false;
-    if (this->featureMap->exists(key, identifier)) { 
+    auto previous = this->featureMap->find(key, identifier);
+    if (previous) { 
 
       // If the feature exists, we can return previous value
       exists = true;
-      auto feature = this->featureMap->at(key, identifier);
       
       // Getting the value of the feature through this function
       auto valueFunc = [](Feature const * feature)->double { 
@@ -460,7 +461,7 @@ public:
       };
 
       // Pushing back the previous value onto the stack.
-      double result = feature->template evaluate<double>(valueFunc); 
+      double result = previous->template evaluate<double>(valueFunc); 
       mystack.push(result);
     } 
 
@@ -1,15 +1,17 @@
 #ifndef TOPK_HPP
 #define TOPK_HPP
 
+#include <functional>
 #include <vector>
 #include <string>
-#include <map>
 
 #include <sam/SlidingWindow.hpp>
 #include <sam/AbstractConsumer.hpp>
 #include <sam/BaseComputation.hpp>
+#include <sam/FeatureBatch.hpp>
 #include <sam/Util.hpp>
 #include <sam/FeatureProducer.hpp>
+#include <sam/KeyedState.hpp>
 
 namespace sam {
 
@@ -29,13 +31,25 @@ class TopK: public AbstractConsumer<EdgeType>,
 public: 
   typedef typename EdgeType::LocalTupleType TupleType;
   typedef typename std::tuple_element<valueField, TupleType>::type ValueType;
+  typedef std::function<double(TupleType const&)> TimeFunction;
 private:
 
   size_t N; ///>Total number of elements
   size_t b; ///>Number of elements per window
   size_t k; ///>Top k elements managed
 
-  std::map<std::string, std::shared_ptr<SlidingWindow<ValueType>>> allWindows; 
+  KeyedState<std::shared_ptr<SlidingWindow<ValueType>>> allWindows; 
+
+  TimeFunction timeFunction; ///> Gets the time of a tuple for evicting keys
+
+  typedef std::shared_ptr<SlidingWindow<ValueType>> WindowPointer;
+
+  /**
+   * Adds the value of the edge to the sliding window of key and returns the
+   * window.  changed is set if the top k changed.
+   */
+  WindowPointer add(EdgeType const& edge, std::string const& key,
+                    bool& changed);
   
 public:
   /**
@@ -46,15 +60,29 @@ public:
    * \param nodeId The id of the node running this computation.
    * \param featureMap The FeatureMap object that stores results.
    * \param identifier The identifier for this feature producer.
+   * \param keyTtl Keys not seen for this long (in tuple time) are evicted.
+   *   0 means keys are never evicted for age.
+   * \param maxStateBytes Memory budget for the per-key sliding windows.
+   *   0 means no limit.
+   * \param timeFunction Gets the time of a tuple.  Required if keyTtl > 0.
    */
   TopK(size_t N, size_t b, size_t k,
        size_t nodeId,
        std::shared_ptr<FeatureMap> featureMap,
-       string identifier);
+       string identifier,
+       double keyTtl = 0,
+       size_t maxStateBytes = 0,
+       TimeFunction timeFunction = TimeFunction());
      
 
   bool consume(EdgeType const& edge);
 
+  /**
+   * Processes the edges in order like consume(), but writes only the last
+   * changed top k of each key to the feature map, once the batch is done.
+   */
+  bool consumeBatch(EdgeType const* edges, size_t count);
+
   void terminate() {}
      
 };
@@ -67,9 +95,18 @@ TopK<EdgeType, valueField, keyFields...>::TopK(
       size_t k,
       size_t nodeId,
       std::shared_ptr<FeatureMap> featureMap,
-      std::string identifier) :
-      BaseComputation(nodeId, featureMap, identifier)
+      std::string identifier,
+      double keyTtl,
+      size_t maxStateBytes,
+      TimeFunction timeFunction) :
+      BaseComputation(nodeId, featureMap, identifier),
+      allWindows(keyTtl, maxStateBytes,
+                 SlidingWindow<ValueType>::memoryUsage(N, b, k)),
+      timeFunction(timeFunction)
 {
+  if (keyTtl > 0 && !timeFunction) {
+    throw TopKException("TopK: keyTtl requires a timeFunction");
+  }
   this->N = N;
   this->b = b;
   this->k = k;
@@ -77,42 +114,55 @@ TopK<EdgeType, valueField, keyFields...>::TopK(
 
 template <typename EdgeType,
           size_t valueField, size_t... keyFields>
-bool TopK<EdgeType, valueField, keyFields...>::consume(
-  EdgeType const& edge) 
+typename TopK<EdgeType, valueField, keyFields...>::WindowPointer
+TopK<EdgeType, valueField, keyFields...>::add(
+  EdgeType const& edge, std::string const& key, bool& changed)
 {
-  DEBUG_PRINT("Node %lu TopK::consume %s\n", nodeId, 
-              sam::toString(edge.tuple).c_str());
   this->feedCount++;
   if (this->feedCount % this->metricInterval == 0) {
     std::cout << "NodeId " << this->nodeId << " allWindows.size() " 
-              << allWindows.size() << std::endl;
+              << allWindows.size() << " keys evicted "
+              << allWindows.getKeysEvicted() << " bytes held "
+              << allWindows.getBytesHeld() << std::endl;
   }
 
-  // Creating a hopefully unique key from the key fields
-  std::string key = generateKey<keyFields...>(edge.tuple);
- 
   // Create a new sliding window if we haven't seen this key before 
-  if (allWindows.count(key) == 0) {
-    auto sw = std::shared_ptr<SlidingWindow<ValueType>>(
-                new SlidingWindow<ValueType>(N,b,k));
-    std::pair<std::string, std::shared_ptr<
-              SlidingWindow<ValueType>>> p(key, sw);
-    allWindows[key] = sw;    
-  }
+  double time = timeFunction ? timeFunction(edge.tuple) : 0;
+  auto sw = allWindows.get(key, time, [this]() {
+    return std::make_shared<SlidingWindow<ValueType>>(N, b, k);
+  });
   
   ValueType value = std::get<valueField>(edge.tuple);
   
-  auto sw = allWindows[key];
-  sw->add(value);
+  // The top k only change when the active window becomes dormant, so the
+  // feature is only updated then.
+  changed = sw->add(value);
+  return sw;
+}
+
+template <typename EdgeType,
+          size_t valueField, size_t... keyFields>
+bool TopK<EdgeType, valueField, keyFields...>::consume(
+  EdgeType const& edge) 
+{
+  DEBUG_PRINT("Node %lu TopK::consume %s\n", nodeId, 
+              sam::toString(edge.tuple).c_str());
+
+  // Creating a hopefully unique key from the key fields
+  std::string key = generateKey<keyFields...>(edge.tuple);
+
+  bool changed;
+  auto sw = add(edge, key, changed);
 
-  std::vector<string> keys        = sw->getKeys();
-  std::vector<double> frequencies = sw->getFrequencies();
+  std::vector<double> const& frequencies = sw->getTopFrequencies();
   
-  if (keys.size() > 0 && frequencies.size() > 0) {
-    TopKFeature feature(keys, frequencies);
-    DEBUG_PRINT("Node %lu TopK::consume keys.size() %lu\n",
-      nodeId, keys.size());
-    this->featureMap->updateInsert(key, this->identifier, feature);
+  if (frequencies.size() > 0) {
+    if (changed) {
+      TopKFeature feature(sw->getTopKeys(), frequencies);
+      DEBUG_PRINT("Node %lu TopK::consume keys.size() %lu\n",
+        nodeId, frequencies.size());
+      this->featureMap->updateInsert(key, this->identifier, feature);
+    }
 
     // notifySubscribers only takes doubles right now
     notifySubscribers(edge.id, frequencies[0]);
@@ -123,8 +173,33 @@ bool TopK<EdgeType, valueField, keyFields...>::consume(
   return true;
 }
 
+template <typename EdgeType,
+          size_t valueField, size_t... keyFields>
+bool TopK<EdgeType, valueField, keyFields...>::consumeBatch(
+  EdgeType const* edges, size_t count) 
+{
+  DEBUG_PRINT("Node %lu TopK::consumeBatch %lu tuples\n", nodeId, count);
+
+  FeatureBatch<TopKFeature> features;
+  for (size_t i = 0; i < count; i++) {
+    std::string key = generateKey<keyFields...>(edges[i].tuple);
+
+    bool changed;
+    auto sw = add(edges[i], key, changed);
+
+    std::vector<double> const& frequencies = sw->getTopFrequencies();
+    if (frequencies.size() > 0) {
+      if (changed) {
+        features.set(std::move(key), 
+                     TopKFeature(sw->getTopKeys(), frequencies));
+      }
+      notifySubscribers(edges[i].id, frequencies[0]);
+    }
+  }
+  features.flush(*this->featureMap, this->identifier);
 
-
+  return true;
+}
 
 }
 
@@ -50,9 +50,7 @@ template <typename InputEdgeType,
 void TransformProducer<InputEdgeType, 
                        OutputEdgeType, keyFields...>::terminate()
 {
-  for (auto consumer : this->consumers) {
-    consumer->terminate();
-  }
+  this->terminateConsumers();
 }
 
 template <typename InputEdgeType, 
@@ -7,6 +7,10 @@
 
 namespace sam {
 
+/// The fraction of vertices assumed to pass an "in" constraint whose 
+/// feature doesn't exist yet.
+#define DEFAULT_IN_SELECTIVITY 0.1
+
 class VertexConstraintCheckerException : public std::runtime_error {
 public:
   VertexConstraintCheckerException(char const * message) : 
@@ -82,14 +86,14 @@ public:
         " %s\n", variable.c_str(), vertex.c_str(), featureName.c_str());
     
       // If the feature doesn't exist, return false. 
-      if (!featureMap->exists("", featureName)) {
+      auto feature = featureMap->find("", featureName);
+      if (!feature) {
         DEBUG_PRINT("VertexConstraintChecker returning false for "
             "variable %s and vertex %s becaure featureName %s doesn't exist\n",
             variable.c_str(), vertex.c_str(), featureName.c_str());
         return false;
       }
 
-      auto feature = featureMap->at("", featureName);
       switch(constraint.op)
       {
         case VertexOperator::In:
@@ -118,6 +122,46 @@ public:
     return true;
   }
 
+  /**
+   * Estimates the fraction of vertices that pass the constraints on the
+   * variable, for planning the query.  An "in" constraint passes the keys
+   * of its TopK feature, so about numKeys / numVertices of the vertices.
+   * If the feature doesn't exist yet, DEFAULT_IN_SELECTIVITY is used.
+   * \param variable The variable name of the vertex.
+   * \param numVertices About how many vertices there are.
+   */
+  double estimateSelectivity(std::string variable, double numVertices) const
+  {
+    double selectivity = 1;
+    for (auto constraint : subgraphQuery->getConstraints(variable))
+    {
+      double inFraction = DEFAULT_IN_SELECTIVITY;
+      auto feature = featureMap->find("", constraint.featureName);
+      if (feature && numVertices > 0) {
+        double numKeys = feature->template evaluate<double>(
+          [](Feature const * feature)->double {
+            return static_cast<TopKFeature const *>(feature)->
+              getKeys().size();
+          });
+        inFraction = std::min(1.0, numKeys / numVertices);
+      }
+
+      switch(constraint.op)
+      {
+        case VertexOperator::In:
+          selectivity *= inFraction;
+          break;
+        case VertexOperator::NotIn:
+          selectivity *= 1 - inFraction;
+          break;
+        default:
+          throw VertexConstraintCheckerException(
+            "Unsupported vertex constraint.");   
+      }
+    }
+    return selectivity;
+  }
+
   /**
    *
    * \param variable The variable name of the vertex.
@@ -0,0 +1,264 @@
+#ifndef SAM_VERTEX_INTERNER_HPP
+#define SAM_VERTEX_INTERNER_HPP
+
+#include <sam/StringInterner.hpp>
+#include <sam/Util.hpp>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace sam {
+
+/**
+ * Maps vertices (usually IP addresses) to dense 32-bit ids and back, so
+ * that the structures of a node can hash and compare vertices as integers.
+ * Ids are local to the node: two nodes give the same vertex different ids,
+ * so anything that crosses nodes (edge requests, partitioning) must still
+ * use the vertex itself.
+ *
+ * IPv4 and IPv6 addresses are parsed straight from the characters and
+ * interned by their 4 or 16 byte binary form, so an address that is
+ * written differently (e.g. IPv6 with or without zero compression, or an
+ * IPv4-mapped IPv6 address) gets the id of the same address.  lookup()
+ * returns addresses in their canonical text form.  IPv4 octets with
+ * leading zeros are not treated as addresses, since some tools read them
+ * as octal.  Anything else is interned as text.
+ *
+ * The tables are StringInterners, so intern() can be called from any
+ * number of threads.
+ */
+class VertexInterner
+{
+public:
+  typedef StringInterner::IdType IdType;
+  static IdType const NO_ID = StringInterner::NO_ID;
+
+private:
+  /// Set on the ids of addresses.  StringInterner ids stay below 2^28.
+  static IdType const ADDRESS_FLAG = IdType(1) << 31;
+
+  StringInterner names; ///> Vertices that aren't addresses
+  StringInterner addresses; ///> Binary addresses, 4 or 16 bytes
+
+  /**
+   * Sets key to the binary form of the address and returns true if the
+   * characters are an IPv4 or IPv6 address.
+   */
+  static bool addressKey(char const* data, size_t length, std::string& key);
+
+public:
+  /**
+   * \param capacity The initial number of slots of each table.  The
+   *   tables grow as needed.
+   */
+  VertexInterner(size_t capacity = 1024) :
+    names(capacity), addresses(capacity) {}
+
+  VertexInterner(VertexInterner const&) = delete;
+  VertexInterner& operator=(VertexInterner const&) = delete;
+
+  /**
+   * Returns the id of the vertex, giving it a new one if it doesn't have
+   * one yet.
+   */
+  IdType intern(std::string const& vertex);
+
+  /**
+   * intern() for a vertex that hasn't been copied out of the input yet,
+   * e.g. a field of a CSV line.  Addresses don't need a std::string.
+   */
+  IdType intern(char const* data, size_t length);
+
+  /**
+   * Returns the id of the vertex, or NO_ID if it hasn't been interned.
+   */
+  IdType find(std::string const& vertex) const;
+
+  /**
+   * Returns the vertex with the given id.
+   * \throws StringInternerException if the id hasn't been given out.
+   */
+  std::string lookup(IdType id) const;
+
+  static bool isAddress(IdType id) { return (id & ADDRESS_FLAG) != 0; }
+
+  /**
+   * Parses a dotted quad.  address is in network byte order.
+   */
+  static bool parseIpv4(char const* data, size_t length, uint32_t& address);
+
+  /**
+   * Parses an IPv6 address, including the forms with zero compression and
+   * with a trailing dotted quad.
+   */
+  static bool parseIpv6(char const* data, size_t length,
+                        unsigned char (&address)[16]);
+
+  /**
+   * The number of ids given out (see StringInterner::size()).
+   */
+  size_t size() const { return names.size() + addresses.size(); }
+
+  /**
+   * The interner shared by everything running on this node.
+   */
+  static VertexInterner& local() {
+    static VertexInterner interner;
+    return interner;
+  }
+};
+
+inline
+bool VertexInterner::parseIpv4(char const* data, size_t length,
+                               uint32_t& address)
+{
+  if (length < 7 || length > 15) return false;
+  unsigned char octets[4];
+  size_t octet = 0;
+  size_t i = 0;
+  while (true) {
+    size_t start = i;
+    unsigned value = 0;
+    while (i < length && data[i] >= '0' && data[i] <= '9' && i - start < 3) {
+      value = value * 10 + (data[i] - '0');
+      i++;
+    }
+    size_t digits = i - start;
+    if (digits == 0 || value > 255 || (digits > 1 && data[start] == '0')) {
+      return false;
+    }
+    octets[octet++] = static_cast<unsigned char>(value);
+    if (octet == 4) break;
+    if (i == length || data[i] != '.') return false;
+    i++;
+  }
+  if (i != length) return false;
+  std::memcpy(&address, octets, 4);
+  return true;
+}
+
+inline
+bool VertexInterner::parseIpv6(char const* data, size_t length,
+                               unsigned char (&address)[16])
+{
+  if (length < 2 || length >= INET6_ADDRSTRLEN) return false;
+  // Cheap rejection before copying for inet_pton.
+  bool colon = false;
+  for (size_t i = 0; i < length; i++) {
+    char c = data[i];
+    if (c == ':') {
+      colon = true;
+    } else if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+                 (c >= 'A' && c <= 'F') || c == '.'))
+    {
+      return false;
+    }
+  }
+  if (!colon) return false;
+  char buffer[INET6_ADDRSTRLEN];
+  std::memcpy(buffer, data, length);
+  buffer[length] = '\0';
+  return inet_pton(AF_INET6, buffer, address) == 1;
+}
+
+inline
+bool VertexInterner::addressKey(char const* data, size_t length,
+                                std::string& key)
+{
+  uint32_t v4;
+  if (parseIpv4(data, length, v4)) {
+    key.assign(reinterpret_cast<char const*>(&v4), 4);
+    return true;
+  }
+  unsigned char v6[16];
+  if (parseIpv6(data, length, v6)) {
+    static unsigned char const mapped[12] =
+      {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    if (std::memcmp(v6, mapped, 12) == 0) {
+      key.assign(reinterpret_cast<char const*>(v6 + 12), 4);
+    } else {
+      key.assign(reinterpret_cast<char const*>(v6), 16);
+    }
+    return true;
+  }
+  return false;
+}
+
+inline
+VertexInterner::IdType VertexInterner::intern(std::string const& vertex)
+{
+  std::string key;
+  if (addressKey(vertex.data(), vertex.size(), key)) {
+    return addresses.intern(key) | ADDRESS_FLAG;
+  }
+  return names.intern(vertex);
+}
+
+inline
+VertexInterner::IdType VertexInterner::intern(char const* data,
+                                              size_t length)
+{
+  std::string key;
+  if (addressKey(data, length, key)) {
+    return addresses.intern(key) | ADDRESS_FLAG;
+  }
+  return names.intern(std::string(data, length));
+}
+
+inline
+VertexInterner::IdType VertexInterner::find(std::string const& vertex) const
+{
+  std::string key;
+  if (addressKey(vertex.data(), vertex.size(), key)) {
+    IdType id = addresses.find(key);
+    return id == NO_ID ? id : id | ADDRESS_FLAG;
+  }
+  return names.find(vertex);
+}
+
+inline
+std::string VertexInterner::lookup(IdType id) const
+{
+  if (!isAddress(id)) {
+    return names.lookup(id);
+  }
+  std::string const& key = addresses.lookup(id & ~ADDRESS_FLAG);
+  char buffer[INET6_ADDRSTRLEN];
+  inet_ntop(key.size() == 4 ? AF_INET : AF_INET6, key.data(), buffer,
+            sizeof(buffer));
+  return buffer;
+}
+
+/**
+ * Hash function for vertex ids, for the HF parameters of CompressedSparse
+ * and SubgraphQueryResultMap when the vertex fields hold VertexInterner
+ * ids.  Ids are local to a node, so it must not be used to pick the node a
+ * vertex belongs to (which GraphStore does with its SourceHF/TargetHF).
+ */
+class VertexIdHashFunction
+{
+public:
+  inline
+  uint64_t operator()(VertexInterner::IdType id) const {
+    return hashFunction(static_cast<uint64_t>(id));
+  }
+};
+
+/**
+ * Equality function for vertex ids.  Equal ids are equal vertices.
+ */
+class VertexIdEqualityFunction
+{
+public:
+  inline
+  bool operator()(VertexInterner::IdType id1, VertexInterner::IdType id2)
+    const
+  {
+    return id1 == id2;
+  }
+};
+
+} // end namespace sam
+
+#endif
@@ -13,13 +13,17 @@
 #include <atomic>
 #include <thread>
 #include <set>
+#include <memory>
 #include <sys/socket.h>
 #include <zmq.hpp>
 
 #include <sam/AbstractConsumer.hpp>
 #include <sam/BaseProducer.hpp>
+#include <sam/IngestQueue.hpp>
+#include <sam/RoutingTable.hpp>
 #include <sam/Util.hpp>
 #include <sam/ZeroMQUtil.hpp>
+#include <sam/EdgeCodec.hpp>
 #include <sam/tuples/Edge.hpp>
 
 
@@ -51,7 +55,7 @@ class ZeroMQPushPull : public AbstractConsumer<EdgeType>,
                        public BaseProducer<EdgeType>
 {
 public:
-  typedef typename PushPull::FunctionType FunctionType;
+  typedef typename PushPull::RawFunctionType FunctionType;
 
 private:
   Tuplizer tuplizer; ///> Converts from string to tuple
@@ -68,6 +72,13 @@ private:
 
   // Generates unique id for each tuple
   SimpleIdGenerator* idGenerator = idGenerator->getInstance(); 
+
+  /// If not null, the pull threads push received edges here and its drain
+  /// thread feeds them to the consumers.
+  std::unique_ptr<IngestQueue<EdgeType>> ingestQueue;
+
+  /// Says which nodes get the edges of a vertex.
+  std::shared_ptr<RoutingTable> routingTable;
     
 
 public:
@@ -86,6 +97,16 @@ public:
    *                 trying to send a message to a socket.
    * \param local Specifies that we aren't actually talking to any other nodes.
    * \param hwm The high water mark.
+   * \param ingestCapacity If greater than zero, edges received from other
+   *   nodes wait in an IngestQueue of this capacity and are fed to the
+   *   consumers from its thread, so the pull threads go straight back to 
+   *   polling.  If zero, the pull threads feed the consumers themselves.
+   * \param ingestPolicy What happens to received edges when the 
+   *   IngestQueue is full.
+   * \param routingTable Says which nodes get the edges of a vertex.  The
+   *   edges of replicated vertices are sent to every node.  If null,
+   *   vertices are owned by a HashRing of all the nodes.  Hubs are only
+   *   detected if every node is given the same table (see RoutingTable).
    */
   ZeroMQPushPull(size_t queueLength,
                  size_t numNodes, 
@@ -94,12 +115,27 @@ public:
                  size_t startingPort,
                  size_t timeout,
                  bool local,
-                 std::size_t hwm);
+                 std::size_t hwm,
+                 size_t ingestCapacity = 0,
+                 IngestPolicy ingestPolicy = IngestPolicy::Block,
+                 std::shared_ptr<RoutingTable> routingTable = nullptr);
 
   virtual ~ZeroMQPushPull()
   {
-    terminate();
+    try {
+      terminate();
+    } catch (std::exception const& e) {
+      printf("Node %lu ~ZeroMQPushPull consumer exception: %s\n", nodeId,
+        e.what());
+    }
     delete communicator;
+    if (ingestQueue) {
+      ingestQueue->stop();
+      if (ingestQueue->getNumDropped() > 0) {
+        printf("Node %lu ZeroMQPushPull ingest queue dropped %lu edges\n",
+          nodeId, ingestQueue->getNumDropped());
+      }
+    }
     DEBUG_PRINT("Node %lu end of ~ZeroMQPushPull\n", nodeId);
   }
   
@@ -117,18 +153,49 @@ public:
 
   size_t getConsumeCount() const { return consumeCount; }
 
+  /**
+   * The IngestQueue of received edges, or null if there isn't one.
+   */
+  IngestQueue<EdgeType> const* getIngestQueue() const { 
+    return ingestQueue.get(); 
+  }
+
+  /**
+   * The RoutingTable that says which nodes get the edges of a vertex.
+   */
+  std::shared_ptr<RoutingTable> getRoutingTable() const {
+    return routingTable;
+  }
+
+  /**
+   * Recreates the sockets to and from the node after it has been added to
+   * the cluster (see PushPull::reopen).  The RoutingTable must be updated
+   * separately, e.g. by GraphStore::addNode() if they share it.
+   */
+  void reopen(size_t node) {
+    communicator->reopen(node);
+  }
+
 private:
   bool acceptingData = false;
   PushPull* communicator;
 
+  /**
+   * Sends the edge to the node, or feeds it to this node's consumers if the
+   * node is this one, unless the node is already in seenNodes.
+   */
+  void sendTo(size_t node,
+              EdgeType const& edge,
+              std::string const& s,
+              std::set<int>& seenNodes);
+
   /**
    * Compile-time base function of recursion for sending tuples along all
    * partition dimensions.  There is a tuple version to send locally and a
    * string version to send via zeromq.
    *
    * \param edge The edge to send.
-   * \param s The tuple, label in string form (inside TupleLabelCombined
-   *          object).
+   * \param s The tuple, label in wire form (see EdgeCodec).
    * \param seenNodes Keeps track of which nodes have seen the tuple already.
    *
    * \tparam PlaceHolder - Just helps us determine that we are calling the base
@@ -146,7 +213,7 @@ private:
    * nature of this compile-time function allows each to be called.  
    *
    * \param tuple The tuple to send.
-   * \param s The tuple in string form.
+   * \param s The tuple in wire form (see EdgeCodec).
    * \param seenNodes Keeps track of which nodes have seen the tuple already.
    * 
    * \tparam PlaceHolder - Just helps us disambiguate base instance from recurssive call.
@@ -169,10 +236,18 @@ ZeroMQPushPull<EdgeType, Tuplizer, HF...>::ZeroMQPushPull(
                  size_t startingPort,
                  size_t timeout,
                  bool local,
-                 size_t hwm)
+                 size_t hwm,
+                 size_t ingestCapacity,
+                 IngestPolicy ingestPolicy,
+                 std::shared_ptr<RoutingTable> routingTable)
   : 
-  BaseProducer<EdgeType>(nodeId, queueLength)
+  BaseProducer<EdgeType>(nodeId, queueLength), routingTable(routingTable)
 {
+  if (!this->routingTable) {
+    this->routingTable = std::make_shared<RoutingTable>(numNodes);
+  }
+  this->routingTable->attach(nodeId);
+
   this->numNodes  = numNodes;
   this->nodeId    = nodeId;
   this->hostnames = hostnames;
@@ -181,17 +256,29 @@ ZeroMQPushPull<EdgeType, Tuplizer, HF...>::ZeroMQPushPull(
   this->hwm       = hwm;
   terminated.store(false);
 
-  auto callbackFunction = [this](std::string str)
-  {
+  if (ingestCapacity > 0) {
+    ingestQueue.reset(new IngestQueue<EdgeType>(ingestCapacity,
+      [this](EdgeType const* edges, size_t count) {
+        this->parallelFeed(edges, count);
+      }, ingestPolicy));
+  }
 
-    DEBUG_PRINT("Node %lu ZeroMQPushPull pullThread received tuple "
-      "%s\n", this->nodeId, str.c_str());
-   
+  auto callbackFunction = [this](char const* data, size_t size)
+  {
     // Since we are receiving this from another node, we need to assign an
     // id to the edge. 
     size_t id = idGenerator->generate(); 
-    EdgeType edge = tuplizer(id, str);
-    this->parallelFeed(edge);
+    EdgeType edge = EdgeCodec<EdgeType>::fromMessage(id, data, size, 
+                                                     tuplizer);
+
+    DEBUG_PRINT("Node %lu ZeroMQPushPull pullThread received tuple "
+      "%s\n", this->nodeId, edge.toString().c_str());
+   
+    if (ingestQueue) {
+      ingestQueue->push(edge);
+    } else {
+      this->parallelFeed(edge);
+    }
   };
 
   // TODO make parameters of constructor
@@ -213,10 +300,12 @@ void ZeroMQPushPull<EdgeType, Tuplizer, HF...>::terminate()
   if (!terminated) {
 
     terminated = true;
-    
-    for (auto consumer : this->consumers) {
-      consumer->terminate();
+
+    // The consumers finish what they have before they are terminated.
+    if (ingestQueue) {
+      ingestQueue->flush();
     }
+    this->terminateConsumers();
 
   }
 
@@ -240,44 +329,54 @@ void ZeroMQPushPull<EdgeType, Tuplizer, HF...>::sendTuple(
   std::set<int> seenNodes)
 {
   First first;
-  size_t node1 = first(edge.tuple) % numNodes;
-
-  if (node1 != this->nodeId) { // Don't send data to ourselves.
-           
-    if (seenNodes.count(node1) == 0) {
-      
-      DEBUG_PRINT("Node %lu ZeroMQPushPull::consume because of source "
-             "sending to %lu %s\n", nodeId, node1, s.c_str());
-
-      seenNodes.insert(node1);
-      communicator->send(s, node1);
+  size_t hash = first(edge.tuple);
+  routingTable->observe(hash);
 
+  if (routingTable->isReplicated(hash)) {
+    // A hub; every member gets its edges.
+    for (size_t node : routingTable->getMembers()) {
+      sendTo(node, edge, s, seenNodes);
     }
   } else {
+    sendTo(routingTable->owner(hash), edge, s, seenNodes);
+  }
 
-    if (seenNodes.count(this->nodeId) == 0) {
+  sendTuple<PlaceHolderClass, Rest...>(edge, s, seenNodes);
+}
 
-      DEBUG_PRINT("Node %lu ZeroMQPushPull::consume sending to parallel "
-        "feed %s\n", nodeId, s.c_str());
 
-      seenNodes.insert(this->nodeId);
-      this->parallelFeed(edge);
-    }
+template <typename EdgeType, typename Tuplizer, typename ...HF>
+void ZeroMQPushPull<EdgeType, Tuplizer, HF...>::sendTo(
+  size_t node,
+  EdgeType const& edge,
+  std::string const& s,
+  std::set<int>& seenNodes)
+{
+  if (seenNodes.count(node) > 0) {
+    return;
   }
+  seenNodes.insert(node);
 
-  sendTuple<PlaceHolderClass, Rest...>(edge, s, seenNodes);
+  if (node != this->nodeId) { // Don't send data to ourselves.
+    DEBUG_PRINT("Node %lu ZeroMQPushPull::sendTo sending to %lu %s\n", 
+      nodeId, node, edge.toString().c_str());
+    communicator->send(s, node);
+  } else {
+    DEBUG_PRINT("Node %lu ZeroMQPushPull::sendTo sending to parallel "
+      "feed %s\n", nodeId, edge.toString().c_str());
+    this->parallelFeed(edge);
+  }
 }
 
-
 template <typename EdgeType, typename Tuplizer, typename ...HF>
 bool ZeroMQPushPull<EdgeType, Tuplizer, HF...>::
 consume(EdgeType const& edge)
 {
 
-  std::string s = edge.toStringNoId();
+  std::string s = EdgeCodec<EdgeType>::toMessage(edge);
 
-  DEBUG_PRINT("Node %lu ZeroMQPushPull::consume string %s\n",
-   nodeId, s.c_str());
+  DEBUG_PRINT("Node %lu ZeroMQPushPull::consume edge %s\n",
+   nodeId, edge.toString().c_str());
 
   // Keep track how many netflows have come through this method.
   consumeCount++;
@@ -3,6 +3,9 @@
 
 #include <sam/Util.hpp>
 #include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 namespace sam {
 
@@ -150,6 +153,113 @@ size_t getPortForPull(size_t i,
 }
 
 
+#define BATCH_FRAME_MARKER '\x03'
+
+/**
+ * Controls how PushPull batches outgoing messages.  Messages to the same
+ * push socket are appended to a frame, which is sent when any of the 
+ * limits is reached.  The default has maxRecords = 1, i.e. no batching.
+ * A maxRecords of 0 or 1 means no record limit, so a policy with only a
+ * byte or time limit fills frames up to that limit.
+ */
+struct BatchPolicy
+{
+  size_t maxRecords = 1; ///> Send the frame when it has this many records
+                         ///> (0 or 1 = no record limit)
+  size_t maxBytes = 0; ///> Send the frame when it reaches this size (0 = none)
+  size_t maxMicros = 0; ///> Send the frame once its oldest record is this
+                        ///> old in microseconds (0 = no deadline)
+
+  BatchPolicy() {}
+
+  BatchPolicy(size_t maxRecords, size_t maxBytes, size_t maxMicros) :
+    maxRecords(maxRecords), maxBytes(maxBytes), maxMicros(maxMicros) {}
+
+  /// True if any limit is set, i.e. records are framed rather than sent
+  /// one per message.
+  bool enabled() const { 
+    return maxRecords > 1 || maxBytes > 0 || maxMicros > 0; 
+  }
+
+  /**
+   * True if a frame with the given number of records and bytes, whose
+   * oldest record was added age ago, has reached one of the limits.
+   */
+  bool isFull(size_t numRecords, size_t numBytes,
+              std::chrono::steady_clock::duration age) const
+  {
+    return (maxRecords > 1 && numRecords >= maxRecords) ||
+      (maxBytes > 0 && numBytes >= maxBytes) ||
+      (maxMicros > 0 && age >= std::chrono::microseconds(maxMicros));
+  }
+};
+
+/**
+ * Returns true if the frame is well formed, i.e. its records' lengths 
+ * add up to the size of the frame.
+ */
+inline
+bool isValidFrame(char const* data, size_t size)
+{
+  char const* p = data + 1;
+  char const* end = data + size;
+  while (p < end) {
+    uint32_t length;
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(length))) {
+      return false;
+    }
+    std::memcpy(&length, p, sizeof(length));
+    p += sizeof(length);
+    if (static_cast<size_t>(end - p) < length) {
+      return false;
+    }
+    p += length;
+  }
+  return true;
+}
+
+/**
+ * Calls the callback on each record in a frame made by PushPull when
+ * batching.  A frame is BATCH_FRAME_MARKER followed by records, each a 
+ * uint32_t length and the bytes of the record.
+ * 
+ * \return Returns the number of records in the frame.
+ */
+template <typename Callback>
+size_t forEachRecordInFrame(char const* data, size_t size, Callback&& callback)
+{
+  char const* p = data + 1;
+  char const* end = data + size;
+  size_t numRecords = 0;
+  while (p < end) {
+    uint32_t length;
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(length))) {
+      throw ZeroMQUtilException("forEachRecordInFrame truncated frame");
+    }
+    std::memcpy(&length, p, sizeof(length));
+    p += sizeof(length);
+    if (static_cast<size_t>(end - p) < length) {
+      throw ZeroMQUtilException("forEachRecordInFrame truncated record");
+    }
+    callback(p, static_cast<size_t>(length));
+    p += length;
+    numRecords++;
+  }
+  return numRecords;
+}
+
+/**
+ * True if the message starts like a batch frame.  The pull threads decide
+ * with this alone, whatever their own BatchPolicy, so the payloads sent
+ * through PushPull must not start with BATCH_FRAME_MARKER (csv tuples and
+ * serialized protobuf messages don't).
+ */
+inline
+bool isBatchFrame(char const* data, size_t size)
+{
+  return size > 0 && data[0] == BATCH_FRAME_MARKER;
+}
+
 /**
  * Class that implements the push/pull communication paradigm amongst a 
  * set of nodes within a cluster.
@@ -162,13 +272,22 @@ size_t getPortForPull(size_t i,
  *
  * No information is necessary about the type of data being sent.  The only
  * requirement is that it can be serialized as an std::string.  send()
- * accepts strings as input, and the pull threads creates strings from 
- * the data it gets and sends those strings to the callback functions.
+ * accepts strings as input.  The pull threads hand the callback functions
+ * a pointer to the data in the zmq message and its size (RawFunctionType),
+ * or, for callbacks of FunctionType, a string copied from the message.
+ *
+ * If a BatchPolicy is given, send() appends to a per-socket frame instead
+ * of sending right away.  The pull threads recognize frames by
+ * BATCH_FRAME_MARKER, so nodes with different policies can talk to each
+ * other, and call the callbacks once per record, reading them in place
+ * from the message.  A malformed frame is logged and dropped.  The message
+ * counts are always in records; the frame counts are in zmq messages.
  */
 class PushPull
 {
 public:
   typedef std::function<void(std::string const&)> FunctionType;
+  typedef std::function<void(char const*, size_t)> RawFunctionType;
 
 private:
   size_t numNodes; ///> How many nodes in the cluster
@@ -180,6 +299,8 @@ private:
   std::atomic<size_t> totalMessagesReceived; ///> Total messages pulled.
   std::atomic<size_t> totalMessagesSent; ///> Total messages pushed.
   std::atomic<size_t> totalMessagesFailed; ///> Total messages failed to send.
+  std::atomic<size_t> totalFramesSent; ///> Total batch frames pushed.
+  std::atomic<size_t> totalFramesDropped; ///> Malformed frames pulled.
   std::vector<std::thread> pullThreads; ///> All the pull threads.
   uint32_t hwm; ///> The high-water mark
   size_t startingPort; ///> The starting port
@@ -209,13 +330,30 @@ private:
 
   /// These callback functions are called any time we receive data in the 
   /// pull threads.
-  std::vector<FunctionType> callbacks;
+  std::vector<RawFunctionType> callbacks;
 
   std::mt19937 myRand;
   std::uniform_int_distribution<size_t> dist;
 
   bool local = false;
 
+  BatchPolicy batchPolicy; ///> When to send batch frames
+
+  /// One frame being built per push socket.  Protected by pushMutexes.
+  std::vector<std::string> frames;
+  std::vector<size_t> frameRecords; ///> Number of records in each frame
+  
+  /// When the oldest record in each frame was added.
+  std::vector<std::chrono::steady_clock::time_point> frameStarts;
+
+  /// Sends frames that have passed the deadline when send() isn't called.
+  std::thread flushThread;
+  std::atomic<bool> stopFlushThread;
+
+  /// Bumped by reopen(node).  The pull threads recreate their sockets from
+  /// a node when its generation changes.
+  std::unique_ptr<std::atomic<size_t>[]> nodeGenerations;
+
 public:
   /**
    * Constructor.
@@ -243,6 +381,25 @@ public:
    * \param timeout The amount of time in ms that a send() call waits before
    *  timing out.  If -1, blocks until completed.
    * \param local Flag indicating that all the nodes are local
+   * \param batchPolicy When to send batches of messages.  By default each
+   *  message is sent on its own.
+   */
+  PushPull(   
+    size_t numNodes,
+    size_t nodeId,
+    size_t numPushSockets,
+    size_t numPullThreads,
+    std::vector<std::string> hostnames,
+    uint32_t hwm,
+    std::vector<RawFunctionType> callbacks,
+    size_t startingPort,
+    int timeout,
+    bool local = false,
+    BatchPolicy batchPolicy = BatchPolicy());
+
+  /**
+   * Same as above except the callbacks receive the data as a string
+   * copied out of the zmq message.
    */
   PushPull(   
     size_t numNodes,
@@ -254,15 +411,31 @@ public:
     std::vector<FunctionType> callbacks,
     size_t startingPort,
     int timeout,
-    bool local = false);
+    bool local = false,
+    BatchPolicy batchPolicy = BatchPolicy());
 
   ~PushPull();
 
   /**
-   * Sends the data to the specified node.
-   * \return Returns true if the data was sent, false otherwise.
+   * Sends the data to the specified node.  When batching, the data is
+   * added to a frame that is sent later.
+   * \return Returns true if the data was sent (or added to a frame), false
+   *   otherwise.
    */
-  bool send(std::string data, size_t node);
+  bool send(std::string const& data, size_t node);
+
+  /**
+   * Sends all partially filled frames.  Does nothing if not batching.
+   */
+  void flush();
+
+  /**
+   * Recreates the sockets to and from the node, e.g. when it has been
+   * restarted or added back to the cluster.  Messages still queued for the
+   * node, including a partial frame, are dropped.  A pull thread that has
+   * already exited (see pullThreadTimeout) is not restarted.
+   */
+  void reopen(size_t node);
 
   /**
    * Terminates accepting data and prevents more data from being sent.
@@ -284,6 +457,16 @@ public:
     return totalMessagesFailed;
   }
 
+  size_t getTotalFramesSent() const 
+  {
+    return totalFramesSent;
+  }
+
+  size_t getTotalFramesDropped() const 
+  {
+    return totalFramesDropped;
+  }
+
   size_t getLastPort() const
   {
     return startingPort + (numNodes - 1) * numPushSockets - 1;
@@ -294,11 +477,37 @@ public:
 
 private:
 
+  /**
+   * Wraps string callbacks so that they can be called with the raw data.
+   */
+  static std::vector<RawFunctionType> 
+  wrapCallbacks(std::vector<FunctionType> const& callbacks);
+
+  /**
+   * Sends the frame of the given push socket.  The caller must hold 
+   * pushMutexes[index].
+   */
+  void sendFrame(size_t index);
+
   /**
    * Creates the push sockets.
    */
   void createPushSockets();
 
+  /**
+   * Creates and binds the ith push socket.  Retries the bind for a while
+   * since a closed socket may not have released the port yet.
+   */
+  std::shared_ptr<zmq::socket_t> createPushSocket(size_t i, size_t retries);
+
+  /**
+   * The node that the ith push (or pull) socket talks to.
+   */
+  size_t nodeForSocket(size_t i) const {
+    size_t node = i / numPushSockets;
+    return node >= nodeId ? node + 1 : node;
+  }
+
   /**
    * Starts the pull threads. 
    */
@@ -313,10 +522,11 @@ PushPull::PushPull(
   size_t numPullThreads,
   std::vector<std::string> hostnames,
   uint32_t hwm,
-  std::vector<FunctionType> callbacks,
+  std::vector<RawFunctionType> callbacks,
   size_t startingPort,
   int timeout,
-  bool local)
+  bool local,
+  BatchPolicy batchPolicy)
 {
   DEBUG_PRINT("Node %lu Entering PushPull Constructor", nodeId)
   this->numNodes       = numNodes;
@@ -329,13 +539,20 @@ PushPull::PushPull(
   this->startingPort   = startingPort;
   this->timeout        = timeout;
   this->local          = local;
+  this->batchPolicy    = batchPolicy;
   totalNumPushSockets = (numNodes - 1) * numPushSockets; 
 
   totalMessagesReceived = 0;
   totalMessagesSent     = 0;
   totalMessagesFailed   = 0;
+  totalFramesSent       = 0;
+  totalFramesDropped    = 0;
   
   pushMutexes = new std::mutex[totalNumPushSockets];
+  nodeGenerations.reset(new std::atomic<size_t>[numNodes]);
+  for (size_t i = 0; i < numNodes; i++) {
+    nodeGenerations[i] = 0;
+  }
 
   createPushSockets();
 
@@ -344,6 +561,59 @@ PushPull::PushPull(
   dist = std::uniform_int_distribution<size_t>(0, numPushSockets-1);
 
   initializePullThreads();
+
+  frames.resize(totalNumPushSockets);
+  frameRecords.resize(totalNumPushSockets, 0);
+  frameStarts.resize(totalNumPushSockets);
+  stopFlushThread = false;
+  if (batchPolicy.enabled() && batchPolicy.maxMicros > 0) {
+    flushThread = std::thread([this]() {
+      // Check twice per deadline so a frame waits at most 1.5 deadlines.
+      auto period = std::chrono::microseconds(
+        std::max<size_t>(this->batchPolicy.maxMicros / 2, 1));
+      auto deadline = std::chrono::microseconds(this->batchPolicy.maxMicros);
+      while (!stopFlushThread) {
+        std::this_thread::sleep_for(period);
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < totalNumPushSockets; i++) {
+          std::lock_guard<std::mutex> lock(pushMutexes[i]);
+          if (frameRecords[i] > 0 && now - frameStarts[i] >= deadline) {
+            sendFrame(i);
+          }
+        }
+      }
+    });
+  }
+}
+
+PushPull::PushPull(
+  size_t numNodes,
+  size_t nodeId,
+  size_t numPushSockets,
+  size_t numPullThreads,
+  std::vector<std::string> hostnames,
+  uint32_t hwm,
+  std::vector<FunctionType> callbacks,
+  size_t startingPort,
+  int timeout,
+  bool local,
+  BatchPolicy batchPolicy) : 
+  PushPull(numNodes, nodeId, numPushSockets, numPullThreads, hostnames, hwm,
+           wrapCallbacks(callbacks), startingPort, timeout, local, 
+           batchPolicy)
+{
+}
+
+std::vector<PushPull::RawFunctionType> 
+PushPull::wrapCallbacks(std::vector<FunctionType> const& callbacks)
+{
+  std::vector<RawFunctionType> rawCallbacks;
+  for (auto callback : callbacks) {
+    rawCallbacks.push_back([callback](char const* data, size_t size) {
+      callback(std::string(data, size));
+    });
+  }
+  return rawCallbacks;
 }
 
 PushPull::~PushPull()
@@ -358,6 +628,13 @@ void PushPull::terminate()
   {
     terminated = true;
 
+    // Get whatever is left in the frames out before the terminate message.
+    stopFlushThread = true;
+    if (flushThread.joinable()) {
+      flushThread.join();
+    }
+    flush();
+
     for (size_t i = 0; i < totalNumPushSockets; i++) 
     {
       bool sent = false;
@@ -383,42 +660,77 @@ void PushPull::terminate()
 void PushPull::createPushSockets()
 {
   pushers.resize(totalNumPushSockets);
+  DEBUG_PRINT("totalNumPushSockets %lu \n", totalNumPushSockets);
+  for (size_t i = 0; i < totalNumPushSockets; i++) 
+  {
+    pushers[i] = createPushSocket(i, 0);
+  }
+}
+
+std::shared_ptr<zmq::socket_t> 
+PushPull::createPushSocket(size_t i, size_t retries)
+{
   std::string hostname = hostnames[nodeId];
   std::string ip = getIpString(hostname);
   size_t actualStartingPort = startingPort;
   if (local) {
     actualStartingPort += nodeId * totalNumPushSockets;
   }
-  DEBUG_PRINT("totalNumPushSockets %lu \n", totalNumPushSockets);
-  for (size_t i = 0; i < totalNumPushSockets; i++) 
-  {
-    zmqLock.lock();
-    auto pusher = std::shared_ptr<zmq::socket_t>(
-      new zmq::socket_t(context, ZMQ_PUSH));
-    std::string url = "tcp://" + ip + ":";
-      url = url + boost::lexical_cast<std::string>(actualStartingPort + i);
-    DEBUG_PRINT("Node %lu binding to %s\n", nodeId, url.c_str());
 
-    // The function complains if you use std::size_t, so be sure to use the
-    // uint32_t class member for hwm.
-    pusher->setsockopt(ZMQ_SNDHWM, &hwm, sizeof(hwm));
+  std::lock_guard<std::mutex> lock(zmqLock);
+  auto pusher = std::shared_ptr<zmq::socket_t>(
+    new zmq::socket_t(context, ZMQ_PUSH));
+  std::string url = "tcp://" + ip + ":";
+    url = url + boost::lexical_cast<std::string>(actualStartingPort + i);
+  DEBUG_PRINT("Node %lu binding to %s\n", nodeId, url.c_str());
+
+  // The function complains if you use std::size_t, so be sure to use the
+  // uint32_t class member for hwm.
+  pusher->setsockopt(ZMQ_SNDHWM, &hwm, sizeof(hwm));
 
-    // Setting the timeout for the socket
-    DEBUG_PRINT("Node %lu setting timeout %d\n", nodeId, timeout);
-    pusher->setsockopt(ZMQ_SNDTIMEO, &timeout, sizeof(timeout));
+  // Setting the timeout for the socket
+  DEBUG_PRINT("Node %lu setting timeout %d\n", nodeId, timeout);
+  pusher->setsockopt(ZMQ_SNDTIMEO, &timeout, sizeof(timeout));
 
+  for (size_t attempt = 0; ; attempt++) {
     try {
       pusher->bind(url);
-    } catch (std::exception e) {
-      std::string message = "PushPull: Node " +
-        boost::lexical_cast<std::string>(nodeId) +
-        " couldn't bind to url " + url + ": " + e.what();
-      throw std::runtime_error(message);
+      break;
+    } catch (std::exception const& e) {
+      if (attempt >= retries) {
+        std::string message = "PushPull: Node " +
+          boost::lexical_cast<std::string>(nodeId) +
+          " couldn't bind to url " + url + ": " + e.what();
+        throw std::runtime_error(message);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-    zmqLock.unlock();
+  }
+  return pusher;
+}
 
-    pushers[i] = pusher;
+void PushPull::reopen(size_t node)
+{
+  if (node >= numNodes || node == nodeId) {
+    throw ZeroMQUtilException("PushPull::reopen node " +
+      boost::lexical_cast<std::string>(node) + " is not another node of "
+      "the cluster");
+  }
+
+  size_t beg = (node < nodeId ? node : node - 1) * numPushSockets;
+  for (size_t i = beg; i < beg + numPushSockets; i++) {
+    std::lock_guard<std::mutex> lock(pushMutexes[i]);
+    frames[i].clear();
+    frameRecords[i] = 0;
+
+    // Drop whatever is queued for the old peer rather than waiting on it.
+    int linger = 0;
+    pushers[i]->setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+    pushers[i].reset();
+    pushers[i] = createPushSocket(i, 100);
   }
+
+  nodeGenerations[node].fetch_add(1);
 }
 
 void PushPull::initializePullThreads()
@@ -442,6 +754,9 @@ void PushPull::initializePullThreads()
     zmq::pollitem_t pollItems[numVisiblePushSockets];
     std::vector<zmq::socket_t*> sockets;
 
+    // The generation of each socket's node when the socket was created.
+    std::vector<size_t> generations;
+
     // When a node sends a terminate flag, the corresponding entry is
     // turned to true.  When all flags are true, the thread terminates.
     bool terminate[numVisiblePushSockets];
@@ -450,21 +765,15 @@ void PushPull::initializePullThreads()
     // thread calling zmq_poll().  Below we create the poll items and the
     // pull sockets.
 
-    size_t numAdded = 0;
-    for( size_t i = beg; i < end; i++) {
+    auto connectPullSocket = [&](size_t i)
+    {
       std::string hostname = getHostnameForPull(i, nodeId, numPushSockets,
                                                 numNodes, hostnames);
       size_t port = getPortForPull(i, nodeId, numPushSockets,
                                    numNodes, startingPort);
 
       if (local) {
-        // Find which node we are wanting to talk to.
-        size_t targetNode = i / numPushSockets;
-        if ((i / numPushSockets) >= nodeId) {
-          targetNode++;
-        } 
-
-        port += targetNode * totalNumPushSockets;
+        port += nodeForSocket(i) * totalNumPushSockets;
       }
 
       zmq::socket_t* socket = new zmq::socket_t(context, ZMQ_PULL);
@@ -486,7 +795,14 @@ void PushPull::initializePullThreads()
           " couldn't connect to url " + url + ": " + e.what();
         throw std::runtime_error(message);
       }
+      return socket;
+    };
+
+    size_t numAdded = 0;
+    for( size_t i = beg; i < end; i++) {
+      zmq::socket_t* socket = connectPullSocket(i);
       sockets.push_back(socket);
+      generations.push_back(nodeGenerations[nodeForSocket(i)]);
 
       pollItems[numAdded].socket = *socket;
       pollItems[numAdded].events = ZMQ_POLLIN;
@@ -500,6 +816,19 @@ void PushPull::initializePullThreads()
     auto timeDataArrived = std::chrono::high_resolution_clock::now();
 
     while (!stop) {
+      // Reconnect to nodes that have been reopened.
+      for (size_t i = 0; i < numVisiblePushSockets; i++) {
+        size_t generation = nodeGenerations[nodeForSocket(beg + i)];
+        if (generation != generations[i]) {
+          std::lock_guard<std::mutex> lock(this->zmqLock);
+          delete sockets[i];
+          sockets[i] = connectPullSocket(beg + i);
+          generations[i] = generation;
+          pollItems[i].socket = *sockets[i];
+          terminate[i] = false;
+        }
+      }
+
       zmq::message_t message;
       // Third parameter is the timeout in milliseconds to wait for input.
       size_t numStop = 0;
@@ -518,15 +847,30 @@ void PushPull::initializePullThreads()
 
           } else if (message.size() > 0) {
             
-            std::string str = getStringFromZmqMessage(message);
-            receivedMessages++;
+            // The callbacks read straight out of the message buffer.
+            char const* data = static_cast<char const*>(message.data());
 
             DEBUG_PRINT("Node %lu PushPull pullThread received message of"
-              " size %lu from %lu %s\n", nodeId, message.size(), i, 
-               str.c_str());
-
-            for (auto callback : callbacks) {
-              callback(str);              
+              " size %lu from %lu\n", nodeId, message.size(), i);
+
+            if (isBatchFrame(data, message.size())) {
+              if (!isValidFrame(data, message.size())) {
+                printf("Node %lu PushPull pullThread dropped a malformed "
+                  "frame of size %lu from %lu\n", nodeId, message.size(), i);
+                totalFramesDropped.fetch_add(1);
+              } else {
+                receivedMessages += forEachRecordInFrame(data, 
+                  message.size(), [this](char const* record, size_t size) {
+                    for (auto& callback : callbacks) {
+                      callback(record, size);
+                    }
+                  });
+              }
+            } else {
+              receivedMessages++;
+              for (auto& callback : callbacks) {
+                callback(data, message.size());
+              }
             }
 
             timeDataArrived = std::chrono::high_resolution_clock::now();
@@ -578,22 +922,42 @@ void PushPull::initializePullThreads()
   }
 }
 
-bool PushPull::send(std::string str, size_t otherNode)
+bool PushPull::send(std::string const& str, size_t otherNode)
 {
-  DEBUG_PRINT("Node %lu->%lu PushPull::send sending %s\n", nodeId, 
-    otherNode, str.c_str());
+  DEBUG_PRINT("Node %lu->%lu PushPull::send sending message of size %lu\n",
+    nodeId, otherNode, str.size());
 
   size_t pushSocket = dist(myRand);
   size_t offset = otherNode < nodeId ? otherNode : otherNode - 1;
   size_t index = offset * numPushSockets + pushSocket;
+
+  if (batchPolicy.enabled()) {
+    std::lock_guard<std::mutex> lock(pushMutexes[index]);
+    std::string& frame = frames[index];
+    if (frameRecords[index] == 0) {
+      frame.push_back(BATCH_FRAME_MARKER);
+      frameStarts[index] = std::chrono::steady_clock::now();
+    }
+    uint32_t length = static_cast<uint32_t>(str.size());
+    frame.append(reinterpret_cast<char const*>(&length), sizeof(length));
+    frame.append(str);
+    frameRecords[index]++;
+
+    if (batchPolicy.isFull(frameRecords[index], frame.size(),
+          std::chrono::steady_clock::now() - frameStarts[index])) {
+      sendFrame(index);
+    }
+    return true;
+  }
+
   zmq::message_t message = fillZmqMessage(str);
   
   pushMutexes[index].lock();
   bool sent = pushers[index]->send(message);
   pushMutexes[index].unlock();
   
-  DEBUG_PRINT("Node %lu->%lu sent %s rvalue %d\n", nodeId, otherNode, 
-    str.c_str(), sent);
+  DEBUG_PRINT("Node %lu->%lu sent message of size %lu rvalue %d\n", nodeId,
+    otherNode, str.size(), sent);
   
   if (!sent) {
     size_t failedNodeId = index / numPushSockets;
@@ -608,7 +972,38 @@ bool PushPull::send(std::string str, size_t otherNode)
 
 }
 
+void PushPull::flush()
+{
+  if (!batchPolicy.enabled()) return;
+  for (size_t i = 0; i < totalNumPushSockets; i++) {
+    std::lock_guard<std::mutex> lock(pushMutexes[i]);
+    if (frameRecords[i] > 0) {
+      sendFrame(i);
+    }
+  }
+}
+
+void PushPull::sendFrame(size_t index)
+{
+  zmq::message_t message = fillZmqMessage(frames[index]);
+  bool sent = pushers[index]->send(message);
+  size_t numRecords = frameRecords[index];
+
+  DEBUG_PRINT("Node %lu PushPull::sendFrame sent frame of %lu records and "
+    "%lu bytes to socket %lu rvalue %d\n", nodeId, numRecords, 
+    frames[index].size(), index, sent);
 
+  if (!sent) {
+    printf("Node %lu PushPull::sendFrame couldn't send frame of %lu records "
+      "to %luth socket\n", nodeId, numRecords, index);
+    totalMessagesFailed.fetch_add(numRecords);
+  } else {
+    totalMessagesSent.fetch_add(numRecords);
+    totalFramesSent.fetch_add(1);
+  }
+  frames[index].clear();
+  frameRecords[index] = 0;
+}
 
 }
 
@@ -12,6 +12,7 @@
 
 #include <sam/AbstractSubgraphPrinter.hpp>
 #include <sam/CollapsedConsumer.hpp>
+#include <sam/CountDistinct.hpp>
 #include <sam/Expression.hpp>
 #include <sam/ExponentialHistogramSum.hpp>
 #include <sam/ExponentialHistogramVariance.hpp>
@@ -20,14 +21,18 @@
 #include <sam/Identity.hpp>
 #include <sam/LabelProducer.hpp>
 #include <sam/Project.hpp>
+#include <sam/Quantile.hpp>
 #include <sam/ReadSocket.hpp>
 #include <sam/ReadCSV.hpp>
 #include <sam/SimpleSum.hpp>
 #include <sam/SubgraphQuery.hpp>
 #include <sam/SubgraphDiskPrinter.hpp>
+#include <sam/TimeExponentialHistogramSum.hpp>
+#include <sam/TimeExponentialHistogramVariance.hpp>
 #include <sam/TopK.hpp>
 #include <sam/TransformProducer.hpp>
 #include <sam/TupleExpression.hpp>
+#include <sam/VertexInterner.hpp>
 #include <sam/ZeroMQPushPull.hpp>
 
 #include <sam/tuples/VastNetflow.hpp>
@@ -17,6 +17,7 @@
 #include <zmq.hpp>
 
 #include <sam/Util.hpp>
+#include <sam/VertexInterner.hpp>
 #include <sam/tuples/Edge.hpp>
 
 namespace sam {
@@ -166,6 +167,80 @@ public:
   }
 };
 
+/**
+ * A VastNetflow whose SourceIp and DestIp are VertexInterner ids instead
+ * of strings.  The field indices are the same as VastNetflow's, so the
+ * graph can be keyed by the ids with VertexIdHashFunction and 
+ * VertexIdEqualityFunction.  Ids are local to a node, so these tuples
+ * are for pipelines that stay on one node (e.g. ReadCSV into local
+ * operators); they must not go through ZeroMQPushPull or GraphStore,
+ * which partition by vertex.
+ */
+typedef std::tuple<double,       //TimeSeconds
+                   std::string,  //PARSE_DATE_FIELD
+                   std::string,  //DATE_TIME_STR_FIELD
+                   std::string,  //IP_LAYER_PROTOCOL_FIELD
+                   std::string,  //IP_LAYER_PROTOCOL_CODE_FIELD
+                   VertexInterner::IdType,  //SourceIp
+                   VertexInterner::IdType,  //DestIp
+                   int,          //SourcePort
+                   int,          //DestPort
+                   std::string,  //MORE_FRAGMENTS
+                   int,          //COUNT_FRAGMENTS
+                   double,          //DURATION_SECONDS
+                   long,          //SRC_PAYLOAD_BYTES
+                   long,          //DEST_PAYLOAD_BYTES
+                   long,          //SOURCE_TOTAL_BYTES
+                   long,          //DEST_TOTAL_BYTES
+                   long,          //FIRST_SEEN_SRC_PACKET_COUNT
+                   long,          //FIRST_SEEN_DEST_PACKET_COUNT
+                   int          //RECORD_FORCE_OUT
+                   >
+                   VastNetflowInterned;
+
+/**
+ * Converts a string that is in csv vast format into a tuple, interning 
+ * the source and destination ips.
+ */
+inline
+VastNetflowInterned makeVastNetflowInterned(std::string const& s,
+                                            VertexInterner& interner)
+{
+  VastNetflow n = makeVastNetflow(s);
+  return VastNetflowInterned(std::get<TimeSeconds>(n),
+                             std::get<ParseDate>(n),
+                             std::get<DateTime>(n),
+                             std::get<IpLayerProtocol>(n),
+                             std::get<IpLayerProtocolCode>(n),
+                             interner.intern(std::get<SourceIp>(n)),
+                             interner.intern(std::get<DestIp>(n)),
+                             std::get<SourcePort>(n),
+                             std::get<DestPort>(n),
+                             std::get<MoreFragments>(n),
+                             std::get<CountFragments>(n),
+                             std::get<DurationSeconds>(n),
+                             std::get<SrcPayloadBytes>(n),
+                             std::get<DestPayloadBytes>(n),
+                             std::get<SrcTotalBytes>(n),
+                             std::get<DestTotalBytes>(n),
+                             std::get<FirstSeenSrcPacketCount>(n),
+                             std::get<FirstSeenDestPacketCount>(n),
+                             std::get<RecordForceOut>(n));
+}
+
+/**
+ * Tuple maker for TuplizerFunction that interns the ips with the node's 
+ * VertexInterner (VertexInterner::local()).
+ */
+class MakeVastNetflowInterned
+{
+public:
+  VastNetflowInterned operator()(std::string const& s)
+  {
+    return makeVastNetflowInterned(s, VertexInterner::local()); 
+  }
+};
+
 
 } // end namespace vast_netflow
 
@@ -0,0 +1,229 @@
+#define BOOST_TEST_MAIN TestBaseProducer
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <sam/BaseProducer.hpp>
+#include <sam/Expression.hpp>
+#include <sam/FeatureMap.hpp>
+#include <sam/Features.hpp>
+#include <sam/Filter.hpp>
+#include <sam/Tokens.hpp>
+#include <sam/tuples/Edge.hpp>
+
+using namespace sam;
+
+typedef std::tuple<size_t> TupleType;
+typedef Edge<size_t, std::tuple<>, TupleType> EdgeType;
+
+namespace {
+
+/**
+ * Feeds 0 to n - 1.
+ */
+class CountingProducer : public BaseProducer<EdgeType>
+{
+public:
+  CountingProducer(size_t queueLength) : BaseProducer(0, queueLength) {}
+
+  void run(size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      parallelFeed(EdgeType(i, std::tuple<>(), TupleType(i)));
+    }
+    waitForConsumers();
+  }
+};
+
+/**
+ * Sums the edges it sees and records the threads it was called on.
+ */
+class SummingConsumer : public AbstractConsumer<EdgeType>
+{
+public:
+  std::atomic<size_t> sum;
+  std::atomic<size_t> count;
+  std::mutex mu;
+  std::set<std::thread::id> threadIds;
+  size_t sleepMillis;
+
+  SummingConsumer(size_t sleepMillis = 0) :
+    sum(0), count(0), sleepMillis(sleepMillis) {}
+
+  bool consume(EdgeType const& edge) {
+    sum += std::get<0>(edge.tuple);
+    count++;
+    return true;
+  }
+
+  bool consumeBatch(EdgeType const* edges, size_t n) {
+    {
+      std::lock_guard<std::mutex> guard(mu);
+      threadIds.insert(std::this_thread::get_id());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(sleepMillis));
+    return AbstractConsumer<EdgeType>::consumeBatch(edges, n);
+  }
+
+  void terminate() {}
+};
+
+/**
+ * Writes a feature for each edge's key after a pause, like a slow windowed
+ * operator.
+ */
+class WritingConsumer : public AbstractConsumer<EdgeType>
+{
+public:
+  std::shared_ptr<FeatureMap> featureMap;
+
+  WritingConsumer(std::shared_ptr<FeatureMap> featureMap) :
+    featureMap(featureMap) {}
+
+  bool consume(EdgeType const& edge) {
+    featureMap->updateInsert(generateKey<0>(edge.tuple), "writer",
+      SingleFeature(std::get<0>(edge.tuple)));
+    return true;
+  }
+
+  bool consumeBatch(EdgeType const* edges, size_t n) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    return AbstractConsumer<EdgeType>::consumeBatch(edges, n);
+  }
+
+  void terminate() {}
+};
+
+/**
+ * Throws on every batch.
+ */
+class ThrowingConsumer : public AbstractConsumer<EdgeType>
+{
+public:
+  bool consume(EdgeType const&) {
+    throw std::runtime_error("ThrowingConsumer");
+  }
+
+  void terminate() {}
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( base_producer_test_workers )
+{
+  /**
+   * Every full buffer reaches every consumer, each on its own worker.
+   */
+  CountingProducer producer(10);
+  auto consumer1 = std::make_shared<SummingConsumer>();
+  auto consumer2 = std::make_shared<SummingConsumer>();
+  producer.registerConsumer(consumer1);
+  producer.registerConsumer(consumer2);
+
+  // The last 5 items don't fill a buffer, so they aren't handed off.
+  producer.run(1005);
+  BOOST_CHECK_EQUAL(consumer1->count, 1000);
+  BOOST_CHECK_EQUAL(consumer2->count, 1000);
+  BOOST_CHECK_EQUAL(consumer1->sum, 999 * 1000 / 2);
+  BOOST_CHECK_EQUAL(consumer2->sum, 999 * 1000 / 2);
+  BOOST_CHECK_EQUAL(producer.getNumReadItems(), 1005);
+
+  BOOST_CHECK_EQUAL(consumer1->threadIds.size(), 1);
+  BOOST_CHECK_EQUAL(consumer2->threadIds.size(), 1);
+  BOOST_CHECK(consumer1->threadIds != consumer2->threadIds);
+  BOOST_CHECK(consumer1->threadIds.count(std::this_thread::get_id()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE( base_producer_test_backpressure )
+{
+  /**
+   * A slow consumer makes the producer wait, and the waits are counted.
+   */
+  CountingProducer producer(4);
+  auto consumer = std::make_shared<SummingConsumer>(5);
+  producer.registerConsumer(consumer);
+
+  producer.run(40);
+  BOOST_CHECK_EQUAL(consumer->count, 40);
+  BOOST_CHECK(producer.getNumBackpressureWaits() > 0);
+  BOOST_CHECK(producer.getBackpressureSeconds() > 0);
+}
+
+BOOST_AUTO_TEST_CASE( base_producer_test_ordered_consumers )
+{
+  /**
+   * A Filter registered after the operator whose feature it reads sees
+   * the feature of every edge in the batch, even though the operator is
+   * slow.
+   */
+  auto featureMap = std::make_shared<FeatureMap>();
+  CountingProducer producer(10);
+  auto writer = std::make_shared<WritingConsumer>(featureMap);
+
+  auto function = [](Feature const* feature)->double {
+    return feature->getValue();
+  };
+  std::list<std::shared_ptr<ExpressionToken<TupleType>>> infixList;
+  infixList.push_back(std::make_shared<FuncToken<TupleType>>(featureMap,
+    function, "writer"));
+  infixList.push_back(std::make_shared<GreaterThanOperator<TupleType>>(
+    featureMap));
+  infixList.push_back(std::make_shared<NumberToken<TupleType>>(featureMap,
+    -1));
+  auto expression = std::make_shared<Expression<TupleType>>(infixList);
+  auto filter = std::make_shared<Filter<EdgeType, 0>>(expression, 0,
+    featureMap, "filter", 10);
+
+  producer.registerConsumer(writer);
+  producer.registerConsumer(filter);
+  producer.run(200);
+
+  for (size_t i = 0; i < 200; i++) {
+    std::string key = boost::lexical_cast<std::string>(i);
+    BOOST_CHECK(featureMap->exists(key, "writer"));
+    BOOST_CHECK(featureMap->exists(key, "filter"));
+  }
+}
+
+BOOST_AUTO_TEST_CASE( base_producer_test_concurrent_consumers )
+{
+  /**
+   * Consumers registered as concurrent share a stage; all of them still
+   * see every batch.
+   */
+  CountingProducer producer(10);
+  auto consumer1 = std::make_shared<SummingConsumer>(1);
+  auto consumer2 = std::make_shared<SummingConsumer>(1);
+  auto consumer3 = std::make_shared<SummingConsumer>();
+  producer.registerConsumer(consumer1);
+  producer.registerConsumer(consumer2, true);
+  producer.registerConsumer(consumer3);
+
+  producer.run(100);
+  BOOST_CHECK_EQUAL(consumer1->count, 100);
+  BOOST_CHECK_EQUAL(consumer2->count, 100);
+  BOOST_CHECK_EQUAL(consumer3->count, 100);
+  BOOST_CHECK(consumer1->threadIds != consumer2->threadIds);
+}
+
+BOOST_AUTO_TEST_CASE( base_producer_test_consumer_exception )
+{
+  /**
+   * An exception thrown by a consumer on a worker reaches the producer's
+   * caller, and the other consumers still get the batch.
+   */
+  CountingProducer producer(10);
+  auto thrower = std::make_shared<ThrowingConsumer>();
+  auto consumer = std::make_shared<SummingConsumer>();
+  producer.registerConsumer(thrower);
+  producer.registerConsumer(consumer);
+
+  BOOST_CHECK_THROW(producer.run(10), std::runtime_error);
+  BOOST_CHECK_EQUAL(consumer->count, 10);
+
+  // Reported once
+  producer.run(0);
+}
@@ -220,3 +220,119 @@ BOOST_AUTO_TEST_CASE( test_cleanup )
   //BOOST_CHECK(work->load() > 2 * numExamples * numThreads * 10 - numThreads);
 }
 
+
+BOOST_AUTO_TEST_CASE( test_find_edges )
+{
+  /**
+   * Makes sure findEdges respects the target and the time ranges, and 
+   * that it works when many vertices end up in the same bin.
+   */
+  size_t capacity = 1;
+  double window = 1000;
+  GraphType graph(capacity, window);
+  Tuplizer tuplizer;
+
+  // The graph is keyed on DestIp.  Every dest ip has 10 edges from
+  // two different source ips.
+  size_t id = 0;
+  for (size_t i = 0; i < 20; i++) {
+    std::string dest = "192.168.0." + boost::lexical_cast<std::string>(i);
+    for (size_t j = 0; j < 10; j++) {
+      std::string src = j % 2 == 0 ? "10.0.0.1" : "10.0.0.2";
+      std::string str = boost::lexical_cast<std::string>(j) + 
+        ",parseDate,dateTimeStr,17,UDP," + src + "," + dest +
+        ",29986,1900,0,0,1.0,133,0,1,0,1,0,0";
+      graph.addEdge(tuplizer(id++, str));
+    }
+  }
+  BOOST_CHECK_EQUAL(graph.countEdges(), 200);
+
+  std::list<EdgeType> foundEdges;
+  double lowest = std::numeric_limits<double>::lowest();
+  double highest = std::numeric_limits<double>::max();
+  graph.findEdges("192.168.0.3", "", lowest, highest, lowest, highest,
+                  foundEdges);
+  BOOST_CHECK_EQUAL(foundEdges.size(), 10);
+
+  foundEdges.clear();
+  graph.findEdges("192.168.0.3", "10.0.0.2", lowest, highest, lowest, 
+                  highest, foundEdges);
+  BOOST_CHECK_EQUAL(foundEdges.size(), 5);
+  for (auto edge : foundEdges) {
+    BOOST_CHECK_EQUAL(std::get<SourceIp>(edge.tuple), "10.0.0.2");
+    BOOST_CHECK_EQUAL(std::get<DestIp>(edge.tuple), "192.168.0.3");
+  }
+
+  // Start times 2 through 5, end times are one second later.
+  foundEdges.clear();
+  graph.findEdges("192.168.0.3", "", 2, 5, 3, 6, foundEdges);
+  BOOST_CHECK_EQUAL(foundEdges.size(), 4);
+
+  foundEdges.clear();
+  graph.findEdges("192.168.0.30", "", lowest, highest, lowest, highest,
+                  foundEdges);
+  BOOST_CHECK_EQUAL(foundEdges.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_expire_slice )
+{
+  /**
+   * expireSlice removes expired edges from vertices that don't get new
+   * edges, frees the empty vertices, and keeps the gauges in step.
+   */
+  size_t capacity = 16;
+  double window = 10;
+  GraphType graph(capacity, window);
+  Tuplizer tuplizer;
+
+  auto makeEdge = [&tuplizer](size_t id, size_t time, std::string dest) {
+    std::string str = boost::lexical_cast<std::string>(time) +
+      ",parseDate,dateTimeStr,17,UDP,10.0.0.1," + dest +
+      ",29986,1900,0,0,1.0,133,0,1,0,1,0,0";
+    return tuplizer(id, str);
+  };
+
+  // One edge per destination, so addEdge never expires anything.
+  for (size_t i = 0; i < 100; i++) {
+    graph.addEdge(makeEdge(i, i, "192.168.0." + std::to_string(i)));
+  }
+  BOOST_CHECK_EQUAL(graph.countEdges(), 100);
+  BOOST_CHECK_EQUAL(graph.getNumVertices(), 100);
+  BOOST_CHECK_EQUAL(graph.getLowWaterMark(), 89);
+  size_t fullBytes = graph.getNumBytes();
+
+  // Start times 0 through 88 are older than the low-water mark.
+  BOOST_CHECK_EQUAL(graph.expireSlice(capacity), 89);
+  BOOST_CHECK_EQUAL(graph.countEdges(), 11);
+  BOOST_CHECK_EQUAL(graph.getNumVertices(), 11);
+  BOOST_CHECK(graph.getNumBytes() < fullBytes);
+
+  // Sweep a few bins at a time until everything older has gone.
+  graph.addEdge(makeEdge(100, 1000, "192.168.0.0"));
+  for (size_t i = 0; i < capacity / 4; i++) {
+    graph.expireSlice(4);
+  }
+  BOOST_CHECK_EQUAL(graph.countEdges(), 1);
+  BOOST_CHECK_EQUAL(graph.getNumVertices(), 1);
+
+  size_t counted = 0;
+  graph.forEachEdge([&counted](EdgeType const&) { counted++; });
+  BOOST_CHECK_EQUAL(counted, 1);
+
+  std::list<EdgeType> foundEdges;
+  graph.findEdges("192.168.0.0", "", 1000, 1000, 1000, 1001, foundEdges);
+  BOOST_CHECK_EQUAL(foundEdges.size(), 1);
+
+  // The gauge agrees with a graph that only ever had the one edge.
+  GraphType fresh(capacity, window);
+  fresh.addEdge(makeEdge(100, 1000, "192.168.0.0"));
+  BOOST_CHECK_EQUAL(graph.getNumBytes(), fresh.getNumBytes());
+
+  // Past the window, the last vertex goes too.
+  graph.addEdge(makeEdge(101, 2000, "192.168.0.0"));
+  BOOST_CHECK_EQUAL(graph.countEdges(), 1);
+  graph.addEdge(makeEdge(102, 3000, "192.168.0.1"));
+  graph.expireSlice(capacity);
+  BOOST_CHECK_EQUAL(graph.countEdges(), 1);
+  BOOST_CHECK_EQUAL(graph.getNumVertices(), 1);
+}
@@ -0,0 +1,51 @@
+#define BOOST_TEST_MAIN TestCountDistinct
+#include <boost/test/unit_test.hpp>
+#include <sam/CountDistinct.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+
+BOOST_AUTO_TEST_CASE( test_count_distinct_ports )
+{
+  /**
+   * A scanner touches many ports of one destination; a normal source talks
+   * to one port.  Both keep the same amount of state.
+   */
+  Tuplizer tuplizer;
+  auto featureMap = std::make_shared<FeatureMap>();
+  CountDistinct<EdgeType, DestPort, SourceIp>
+    distinct(0, 0, 10, 0, featureMap, "distinctPorts");
+  CountDistinct<EdgeType, DestPort, SourceIp>
+    recent(1000, 100, 10, 0, featureMap, "recentPorts");
+
+  for (size_t i = 0; i < 20000; i++) {
+    std::string source = i % 2 == 0 ? "scanner" : "normal";
+    std::string port = i % 2 == 0 ? boost::lexical_cast<std::string>(i / 2)
+                                  : "80";
+    std::string str = boost::lexical_cast<std::string>(i) +
+      ",2013-04-10 08:32:36,20130410083236.384094,17,UDP," + source +
+      ",target,29986," + port + ",0,0,1.0,133,0,1,0,1,0,0";
+    EdgeType edge = tuplizer(i, str);
+    distinct.consume(edge);
+    recent.consume(edge);
+  }
+
+  BOOST_CHECK_CLOSE(featureMap->at("scanner", "distinctPorts")->getValue(),
+                    10000, 10);
+  BOOST_CHECK_CLOSE(featureMap->at("normal", "distinctPorts")->getValue(),
+                    1, 5);
+
+  // The scanner's last 1000 to 1100 items have as many distinct ports.
+  double recentPorts = featureMap->at("scanner", "recentPorts")->getValue();
+  BOOST_CHECK(recentPorts > 900);
+  BOOST_CHECK(recentPorts < 1250);
+
+  BOOST_CHECK_THROW((CountDistinct<EdgeType, DestPort, SourceIp>(
+    0, 0, 20, 0, featureMap, "bad")), HyperLogLogException);
+}
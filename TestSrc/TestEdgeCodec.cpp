@@ -0,0 +1,108 @@
+#define BOOST_TEST_MAIN TestEdgeCodec
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/VastNetflowGenerators.hpp>
+#include <sam/EdgeCodec.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+typedef EdgeCodec<EdgeType> CodecType;
+
+typedef Edge<size_t, SingleIntLabel, VastNetflow> LabeledEdgeType;
+typedef TuplizerFunction<LabeledEdgeType, MakeVastNetflow> LabeledTuplizer;
+typedef EdgeCodec<LabeledEdgeType> LabeledCodecType;
+
+BOOST_AUTO_TEST_CASE( test_edge_codec_round_trip )
+{
+  /**
+   * Encodes edges and decodes them again.  The text form of the decoded
+   * edge should be the same as the original.
+   */
+  Tuplizer tuplizer;
+  UniformDestPort generator("192.168.0.1", 1);
+  for (size_t i = 0; i < 100; i++) {
+    EdgeType edge = tuplizer(i, generator.generate(i * 0.1));
+    std::string message = CodecType::encode(edge);
+    BOOST_CHECK(isBinaryMessage(message.data(), message.size()));
+
+    EdgeType decoded = CodecType::decode(i + 1, message.data(),
+                                         message.size());
+    BOOST_CHECK_EQUAL(decoded.id, i + 1);
+    BOOST_CHECK_EQUAL(decoded.toStringNoId(), edge.toStringNoId());
+    BOOST_CHECK_EQUAL(std::get<TimeSeconds>(decoded.tuple),
+                      std::get<TimeSeconds>(edge.tuple));
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_edge_codec_label )
+{
+  /**
+   * The label goes along with edge messages but not with tuple messages.
+   */
+  LabeledTuplizer tuplizer;
+  std::string str = "1,166.0,2013-04-10 08:32:36,20130410083236.384094,17,"
+    "UDP,target,controller,29986,1900,0,0,1.0,133,0,1,0,1,0,0";
+  LabeledEdgeType edge = tuplizer(0, str);
+  BOOST_CHECK_EQUAL(std::get<0>(edge.label), 1);
+
+  std::string message = LabeledCodecType::encode(edge);
+  LabeledEdgeType decoded = LabeledCodecType::decode(0, message.data(),
+                                                     message.size());
+  BOOST_CHECK_EQUAL(std::get<0>(decoded.label), 1);
+  BOOST_CHECK_EQUAL(decoded.toStringNoId(), edge.toStringNoId());
+
+  message = encodeTuple(edge.tuple);
+  decoded = LabeledCodecType::decode(0, message.data(), message.size());
+  BOOST_CHECK_EQUAL(std::get<0>(decoded.label), 0);
+  BOOST_CHECK_EQUAL(toString(decoded.tuple), toString(edge.tuple));
+}
+
+BOOST_AUTO_TEST_CASE( test_edge_codec_from_message )
+{
+  /**
+   * fromMessage decodes binary messages and parses anything else as text.
+   */
+  Tuplizer tuplizer;
+  std::string str = "166.0,2013-04-10 08:32:36,20130410083236.384094,17,"
+    "UDP,target,controller,29986,1900,0,0,1.0,133,0,1,0,1,0,0";
+  EdgeType edge = tuplizer(0, str);
+
+  EdgeType fromText = CodecType::fromMessage(0, str.data(), str.size(),
+                                             tuplizer);
+  BOOST_CHECK_EQUAL(fromText.toStringNoId(), edge.toStringNoId());
+
+  std::string message = CodecType::encode(edge);
+  EdgeType fromBinary = CodecType::fromMessage(0, message.data(),
+                                               message.size(), tuplizer);
+  BOOST_CHECK_EQUAL(fromBinary.toStringNoId(), edge.toStringNoId());
+}
+
+BOOST_AUTO_TEST_CASE( test_edge_codec_malformed )
+{
+  /**
+   * Truncated messages, extra bytes, and messages without a marker throw.
+   */
+  Tuplizer tuplizer;
+  UniformDestPort generator("192.168.0.1", 1);
+  EdgeType edge = tuplizer(0, generator.generate());
+  std::string message = CodecType::encode(edge);
+
+  for (size_t size = 1; size < message.size(); size++) {
+    BOOST_CHECK_THROW(CodecType::decode(0, message.data(), size),
+                      EdgeCodecException);
+  }
+
+  std::string extra = message + "x";
+  BOOST_CHECK_THROW(CodecType::decode(0, extra.data(), extra.size()),
+                    EdgeCodecException);
+
+  std::string text = edge.toStringNoId();
+  BOOST_CHECK_THROW(CodecType::decode(0, text.data(), text.size()),
+                    EdgeCodecException);
+}
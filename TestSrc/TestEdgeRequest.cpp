@@ -96,3 +96,20 @@ BOOST_FIXTURE_TEST_CASE( test_zmq, F)
                     edgeRequest2.getEndTimeSecond());
 
 }
+
+BOOST_FIXTURE_TEST_CASE( test_widen, F )
+{
+  EdgeRequestType other;
+  other.setStartTimeFirst(0.5);
+  other.setStartTimeSecond(1.5);
+  other.setEndTimeFirst(1.5);
+  other.setEndTimeSecond(3.0);
+
+  edgeRequest.widen(other);
+  BOOST_CHECK_EQUAL(edgeRequest.getStartTimeFirst(), 0.5);
+  BOOST_CHECK_EQUAL(edgeRequest.getStartTimeSecond(), startTimeSecond);
+  BOOST_CHECK_EQUAL(edgeRequest.getEndTimeFirst(), endTimeFirst);
+  BOOST_CHECK_EQUAL(edgeRequest.getEndTimeSecond(), 3.0);
+  BOOST_CHECK_EQUAL(edgeRequest.getSource(), source);
+  BOOST_CHECK_EQUAL(edgeRequest.getTarget(), target);
+}
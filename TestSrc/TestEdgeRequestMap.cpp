@@ -2,10 +2,12 @@
 
 #define DEBUG
 #define METRICS
+#define DETAIL_TIMING
 
 #include <boost/test/unit_test.hpp>
 #include <sam/EdgeRequestMap.hpp>
 #include <sam/tuples/VastNetflowGenerators.hpp>
+#include <numeric>
 #include <thread>
 
 using namespace sam;
@@ -172,3 +174,80 @@ BOOST_AUTO_TEST_CASE( test_edge_request_map )
   delete edgeCommunicator1;
 
 }
+
+BOOST_AUTO_TEST_CASE( test_edge_request_map_coalesce )
+{
+  /**
+   * Requests for the same target and return node become one entry that
+   * lives as long as the latest of them.
+   */
+  size_t numNodes = 2;
+  std::vector<std::string> hostnames;
+  hostnames.push_back("localhost");
+  hostnames.push_back("localhost");
+  size_t startingPort = 10300;
+  uint32_t hwm = 1000;
+  size_t tableCapacity = 1000;
+  int timeout = -1;
+
+  auto noopFunction = [](std::string const&) {};
+  std::vector<PushPull::FunctionType> functions;
+  functions.push_back(noopFunction);
+
+  PushPull* edgeCommunicator0 = new PushPull(numNodes, 0, 1, 1, hostnames,
+                                             hwm, functions, startingPort,
+                                             timeout, true);
+  PushPull* edgeCommunicator1 = new PushPull(numNodes, 1, 1, 1, hostnames,
+                                             hwm, functions, startingPort,
+                                             timeout, true);
+
+  MapType map0(numNodes, 0, tableCapacity, edgeCommunicator0);
+
+  double endTimes[] = {10, 20, 15};
+  for (double endTime : endTimes) {
+    EdgeRequestType edgeRequest;
+    edgeRequest.setTarget("192.168.0.0");
+    edgeRequest.setStartTimeFirst(0);
+    edgeRequest.setStartTimeSecond(endTime);
+    edgeRequest.setEndTimeFirst(0);
+    edgeRequest.setEndTimeSecond(endTime);
+    edgeRequest.setReturn(1);
+    map0.addRequest(edgeRequest);
+  }
+
+  // A different target is a different entry.
+  EdgeRequestType other;
+  other.setTarget("192.168.0.2");
+  other.setReturn(1);
+  BOOST_CHECK(!map0.addRequest(other));
+
+  BOOST_CHECK_EQUAL(map0.getTotalEdgeRequestsAdded(), 4);
+  BOOST_CHECK_EQUAL(map0.getTotalEdgeRequestsCoalesced(), 2);
+
+  // The source hashes to node 0, so node 1 wants the edge.
+  std::string netflowString = "18,parseDate,dateTimeStr,ipLayerProtocol,"
+    "ipLayerProtocolCode,192.168.0.2,192.168.0.0,51482,40020,"
+    "1,1,1,1,1,1,1,1,1,1";
+  map0.process(makeVastNetflow(netflowString));
+  BOOST_CHECK_EQUAL(map0.getTotalEdgePushes(), 1);
+
+  // Past the latest end time the entry is gone.
+  netflowString = "25,parseDate,dateTimeStr,ipLayerProtocol,"
+    "ipLayerProtocolCode,192.168.0.2,192.168.0.0,51482,40020,"
+    "1,1,1,1,1,1,1,1,1,1";
+  map0.process(makeVastNetflow(netflowString));
+  BOOST_CHECK_EQUAL(map0.getTotalEdgePushes(), 1);
+
+  // Each process call looks in three entries (by source, by target, and by
+  // both), so six lock holds were timed.
+  std::vector<size_t> histogram = map0.getLockHoldHistogram();
+  BOOST_CHECK_EQUAL(std::accumulate(histogram.begin(), histogram.end(), 0),
+                    6);
+  BOOST_CHECK(map0.getTotalTimeLockHeld() > 0);
+
+  map0.terminate();
+  edgeCommunicator1->terminate();
+
+  delete edgeCommunicator0;
+  delete edgeCommunicator1;
+}
@@ -0,0 +1,219 @@
+#define BOOST_TEST_MAIN TestEdgeRing
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/VastNetflowGenerators.hpp>
+#include <sam/EdgeRing.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+typedef EdgeRing<EdgeType, TimeSeconds, DurationSeconds> RingType;
+
+BOOST_AUTO_TEST_CASE( test_edge_ring_grow )
+{
+  /**
+   * Adds more edges than the initial capacity and makes sure they are
+   * still in time order with the records matching the edges.
+   */
+  RingType ring(2);
+  BOOST_CHECK_EQUAL(ring.capacity(), 2);
+
+  UniformDestPort generator("192.168.0.1", 1);
+  Tuplizer tuplizer;
+  for (size_t i = 0; i < 10; i++) {
+    EdgeType edge = tuplizer(i, generator.generate(i));
+    ring.push_back(edge, i);
+  }
+
+  BOOST_CHECK_EQUAL(ring.size(), 10);
+  BOOST_CHECK_EQUAL(ring.capacity(), 16);
+  for (size_t i = 0; i < 10; i++) {
+    BOOST_CHECK_EQUAL(ring.edge(i).id, i);
+    BOOST_CHECK_EQUAL(ring.record(i).other, i);
+    BOOST_CHECK_EQUAL(ring.record(i).startTime, 
+                      std::get<TimeSeconds>(ring.edge(i).tuple));
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_edge_ring_expire )
+{
+  /**
+   * Expiring edges removes them from the head, and the ring can keep
+   * wrapping around without growing.
+   */
+  RingType ring(4);
+  UniformDestPort generator("192.168.0.1", 1);
+  Tuplizer tuplizer;
+
+  double window = 2;
+  size_t totalRemoved = 0;
+  for (size_t i = 0; i < 100; i++) {
+    EdgeType edge = tuplizer(i, generator.generate(i));
+    ring.push_back(edge, 0);
+    totalRemoved += ring.expire(i, window);
+  }
+
+  // Edges with times 97, 98, and 99 are within the window.
+  BOOST_CHECK_EQUAL(ring.size(), 3);
+  BOOST_CHECK_EQUAL(totalRemoved, 97);
+  BOOST_CHECK_EQUAL(ring.capacity(), 4);
+  BOOST_CHECK_EQUAL(ring.edge(0).id, 97);
+
+  BOOST_CHECK_EQUAL(ring.expire(1000, window), 3);
+  BOOST_CHECK(ring.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_edge_ring_filter_kernels )
+{
+  /**
+   * The scalar and vectorized kernels agree with a straightforward check,
+   * including for lengths that aren't a multiple of the vector width.
+   */
+  size_t n = 103;
+  std::vector<double> startTimes(n), endTimes(n);
+  std::vector<uint64_t> others(n);
+  for (size_t i = 0; i < n; i++) {
+    startTimes[i] = i;
+    endTimes[i] = i + (i % 7);
+    others[i] = i % 3;
+  }
+
+  EdgeFilter filter;
+  filter.startTimeFirst = 10;
+  filter.startTimeSecond = 90;
+  filter.endTimeFirst = 15;
+  filter.endTimeSecond = 80;
+  filter.now = 100;
+  filter.window = 95;
+  filter.checkOther = true;
+  filter.other = 1;
+
+  std::vector<uint32_t> expected;
+  for (size_t i = 0; i < n; i++) {
+    if (startTimes[i] >= 10 && startTimes[i] <= 90 && endTimes[i] >= 15 &&
+        endTimes[i] <= 80 && 100 - startTimes[i] < 95 && others[i] == 1) 
+    {
+      expected.push_back(i);
+    }
+  }
+  BOOST_CHECK(!expected.empty());
+
+  std::vector<uint32_t> scalar(n), dispatched(n);
+  size_t numScalar = ring_detail::filterScalar(filter, startTimes.data(),
+    endTimes.data(), others.data(), n, scalar.data());
+  size_t numDispatched = ring_detail::filter(filter, startTimes.data(),
+    endTimes.data(), others.data(), n, dispatched.data());
+  scalar.resize(numScalar);
+  dispatched.resize(numDispatched);
+  BOOST_CHECK(scalar == expected);
+  BOOST_CHECK(dispatched == expected);
+
+  filter.checkOther = false;
+  numScalar = ring_detail::filterScalar(filter, startTimes.data(),
+    endTimes.data(), others.data(), n, scalar.data());
+  numDispatched = ring_detail::filter(filter, startTimes.data(),
+    endTimes.data(), others.data(), n, dispatched.data());
+  BOOST_CHECK_EQUAL(numScalar, numDispatched);
+  BOOST_CHECK(numScalar > expected.size());
+}
+
+BOOST_AUTO_TEST_CASE( test_edge_ring_find_matches )
+{
+  /**
+   * findMatches covers edges on both sides of the wrap-around, oldest 
+   * first, and only touches the edges that pass.
+   */
+  RingType ring(128);
+  UniformDestPort generator("192.168.0.1", 1);
+  Tuplizer tuplizer;
+  for (size_t i = 0; i < 228; i++) {
+    EdgeType edge = tuplizer(i, generator.generate(i));
+    ring.push_back(edge, i % 2);
+    ring.expire(i, 100);
+  }
+  BOOST_CHECK_EQUAL(ring.capacity(), 128);
+
+  EdgeFilter filter;
+  filter.startTimeFirst = 150;
+  filter.startTimeSecond = 200;
+  filter.endTimeFirst = 150;
+  filter.endTimeSecond = 1000;
+  filter.now = 227;
+  filter.window = 100;
+  filter.checkOther = true;
+  filter.other = 0;
+
+  std::vector<size_t> ids;
+  size_t numMatches = ring.findMatches(filter, [&](EdgeType const& edge) {
+    ids.push_back(edge.id);
+  });
+  BOOST_CHECK_EQUAL(numMatches, 26);
+  BOOST_REQUIRE_EQUAL(ids.size(), 26);
+  for (size_t i = 0; i < ids.size(); i++) {
+    BOOST_CHECK_EQUAL(ids[i], 150 + 2 * i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_edge_ring_late_arrivals )
+{
+  /**
+   * Edges that arrive out of order wait in the late buffer, are found by
+   * findMatches, expire, and once the buffer fills up are merged so that
+   * the ring stays sorted by start time.
+   */
+  RingType ring(4);
+  UniformDestPort generator("192.168.0.1", 1);
+  Tuplizer tuplizer;
+
+  // Times 0, 10, 20, ..., 190, then 5 and 1005 (late and in order).
+  for (size_t i = 0; i < 20; i++) {
+    ring.push_back(tuplizer(i, generator.generate(10 * i)), 0);
+  }
+  ring.push_back(tuplizer(20, generator.generate(5)), 0);
+  BOOST_CHECK_EQUAL(ring.numLate(), 1);
+  BOOST_CHECK_EQUAL(ring.size(), 21);
+  BOOST_CHECK_EQUAL(ring.edge(20).id, 20);
+
+  EdgeFilter filter;
+  filter.startTimeFirst = 0;
+  filter.startTimeSecond = 10;
+  filter.endTimeFirst = 0;
+  filter.endTimeSecond = 1000;
+  filter.now = 190;
+  filter.window = 1000;
+
+  std::vector<size_t> ids;
+  auto collect = [&](EdgeType const& edge) { ids.push_back(edge.id); };
+  BOOST_CHECK_EQUAL(ring.findMatches(filter, collect), 3);
+  BOOST_CHECK(ids == std::vector<size_t>({0, 1, 20}));
+
+  // The late edge is the oldest, so it expires along with edge 0.
+  BOOST_CHECK_EQUAL(ring.expire(16, 10), 2);
+  BOOST_CHECK_EQUAL(ring.numLate(), 0);
+  BOOST_CHECK_EQUAL(ring.size(), 19);
+
+  // Fill the late buffer with edges between the ones in the ring.
+  for (size_t i = 0; i < RingType::LATE_CAPACITY; i++) {
+    ring.push_back(tuplizer(100 + i, generator.generate(10 * i + 15)), 0);
+  }
+  BOOST_CHECK_EQUAL(ring.numLate(), 0);
+  BOOST_CHECK_EQUAL(ring.size(), 19 + RingType::LATE_CAPACITY);
+  for (size_t i = 1; i < ring.size(); i++) {
+    BOOST_CHECK_LE(ring.record(i - 1).startTime, ring.record(i).startTime);
+    BOOST_CHECK_EQUAL(ring.record(i).startTime,
+                      std::get<TimeSeconds>(ring.edge(i).tuple));
+  }
+
+  // Lookups skip straight to the range.
+  filter.startTimeFirst = 40;
+  filter.startTimeSecond = 60;
+  ids.clear();
+  BOOST_CHECK_EQUAL(ring.findMatches(filter, collect), 5);
+  BOOST_CHECK(ids == std::vector<size_t>({4, 103, 5, 104, 6}));
+}
@@ -0,0 +1,78 @@
+#define BOOST_TEST_MAIN TestExpiryService
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/CompressedSparse.hpp>
+#include <sam/ExpiryService.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef CompressedSparse<EdgeType, 
+   SourceIp, DestIp, TimeSeconds, DurationSeconds, 
+   StringHashFunction, StringEqualityFunction> GraphType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+
+BOOST_AUTO_TEST_CASE( test_expiry_service_sweeps )
+{
+  std::atomic<size_t> bins(0);
+  BOOST_CHECK_THROW(ExpiryService({}, 0), ExpiryServiceException);
+
+  ExpiryService service({
+    [&bins](size_t maxBins) { bins.fetch_add(maxBins); return size_t(1); }},
+    8, 100);
+  while (service.getNumSlices() < 3) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  service.stop();
+
+  size_t numSlices = service.getNumSlices();
+  BOOST_CHECK_EQUAL(bins.load(), 8 * numSlices);
+  BOOST_CHECK_EQUAL(service.getNumRemoved(), numSlices);
+
+  // Stopping again is fine.
+  service.stop();
+  BOOST_CHECK_EQUAL(service.getNumSlices(), numSlices);
+}
+
+BOOST_AUTO_TEST_CASE( test_expiry_service_graph )
+{
+  /**
+   * The sources stop getting edges, and the service expires their edges
+   * in the background while a new source keeps getting them.
+   */
+  GraphType graph(64, 10);
+  Tuplizer tuplizer;
+  auto makeEdge = [&tuplizer](size_t id, size_t time, std::string src) {
+    std::string str = boost::lexical_cast<std::string>(time) +
+      ",parseDate,dateTimeStr,17,UDP," + src + 
+      ",192.168.0.1,29986,1900,0,0,1.0,133,0,1,0,1,0,0";
+    return tuplizer(id, str);
+  };
+
+  for (size_t i = 0; i < 200; i++) {
+    graph.addEdge(makeEdge(i, 0, "10.0.0." + std::to_string(i)));
+  }
+  BOOST_CHECK_EQUAL(graph.getNumVertices(), 200);
+
+  ExpiryService service({
+    [&graph](size_t maxBins) { return graph.expireSlice(maxBins); }}, 
+    4, 100);
+
+  for (size_t i = 0; i < 1000; i++) {
+    graph.addEdge(makeEdge(200 + i, 20 + i / 100, "10.0.1.1"));
+  }
+  while (graph.getNumVertices() > 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  service.stop();
+
+  BOOST_CHECK_EQUAL(service.getNumRemoved(), 200);
+  BOOST_CHECK_EQUAL(graph.countEdges(), 1000);
+}
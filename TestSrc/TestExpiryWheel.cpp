@@ -0,0 +1,121 @@
+#define BOOST_TEST_MAIN TestExpiryWheel
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <vector>
+#include <sam/ExpiryWheel.hpp>
+
+using namespace sam;
+
+namespace {
+
+std::vector<int> items(ExpiryWheel<int> const& wheel)
+{
+  std::vector<int> v;
+  wheel.forEach([&v](int i) { v.push_back(i); });
+  std::sort(v.begin(), v.end());
+  return v;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( expiry_wheel_test_expire )
+{
+  /**
+   * Slots are dropped once their whole time range is over.
+   */
+  ExpiryWheel<int> wheel(1.0, 8);
+  wheel.insert(1, 10.5);
+  wheel.insert(2, 11.2);
+  wheel.insert(3, 11.9);
+  wheel.insert(4, 14.0);
+  BOOST_CHECK_EQUAL(wheel.size(), 4);
+
+  // 10.9 is still in the slot of item 1.
+  BOOST_CHECK_EQUAL(wheel.expire(10.9), 0);
+  BOOST_CHECK_EQUAL(wheel.expire(11.0), 1);
+  BOOST_CHECK_EQUAL(wheel.size(), 3);
+  BOOST_CHECK_EQUAL(wheel.expire(12.5), 2);
+  BOOST_CHECK(items(wheel) == std::vector<int>({4}));
+
+  // Already past, so it waits in the current slot for the next expire.
+  wheel.insert(5, 11.5);
+  BOOST_CHECK_EQUAL(wheel.size(), 2);
+  BOOST_CHECK_EQUAL(wheel.expire(12.9), 0);
+  BOOST_CHECK_EQUAL(wheel.expire(13.0), 1);
+  BOOST_CHECK(items(wheel) == std::vector<int>({4}));
+
+  BOOST_CHECK_EQUAL(wheel.expire(100), 1);
+  BOOST_CHECK(wheel.empty());
+
+  // An empty wheel stays at the stream time.
+  wheel.insert(6, 3.0);
+  BOOST_CHECK_EQUAL(wheel.size(), 1);
+  BOOST_CHECK_EQUAL(wheel.expire(100.5), 0);
+  BOOST_CHECK_EQUAL(wheel.expire(101), 1);
+
+  BOOST_CHECK_THROW(ExpiryWheel<int>(0), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( expiry_wheel_test_overflow )
+{
+  /**
+   * Items past the end of the wheel wait in the overflow and are dropped
+   * at the right time once the wheel turns.
+   */
+  ExpiryWheel<int> wheel(1.0, 4);
+  for (int i = 0; i < 40; i++) {
+    wheel.insert(i, i + 0.5);
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 40);
+  BOOST_CHECK(items(wheel).size() == 40);
+
+  size_t dropped = 0;
+  for (int t = 1; t <= 40; t++) {
+    dropped += wheel.expire(t);
+    BOOST_CHECK_EQUAL(dropped, t);
+    BOOST_CHECK_EQUAL(wheel.size(), 40 - t);
+  }
+
+  // Jumping far ahead drops everything, including the overflow.
+  for (int i = 0; i < 40; i++) wheel.insert(i, 100 + i);
+  BOOST_CHECK_EQUAL(wheel.expire(120), 20);
+  BOOST_CHECK_EQUAL(items(wheel).front(), 20);
+  BOOST_CHECK_EQUAL(wheel.expire(1000), 20);
+  BOOST_CHECK(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE( expiry_wheel_test_out_of_order )
+{
+  /**
+   * Items inserted in descending expire-time order, as happens when 
+   * several threads add to a bin, are all kept, and each is dropped only
+   * once the stream is past its expire time.
+   */
+  ExpiryWheel<int> wheel(1.0, 8);
+  wheel.expire(5);
+  for (int i = 20; i > 0; i--) {
+    wheel.insert(i, 5 + i + 0.5);
+  }
+  BOOST_CHECK_EQUAL(wheel.size(), 20);
+  BOOST_CHECK_EQUAL(items(wheel).size(), 20);
+
+  for (int t = 6; t <= 26; t++) {
+    wheel.expire(t);
+    std::vector<int> left = items(wheel);
+    // Items with 5 + i + 0.5 >= t are still there.
+    int expected = std::max(0, 26 - t);
+    BOOST_CHECK_EQUAL(left.size(), expected);
+    if (!left.empty()) {
+      BOOST_CHECK_EQUAL(left.front(), 21 - expected);
+    }
+  }
+
+  // Inserted after the wheel has moved past the first item's slot.
+  ExpiryWheel<int> late(1.0, 8);
+  late.insert(1, 10.5);
+  late.insert(2, 4.5);
+  late.insert(3, 2.5);
+  BOOST_CHECK_EQUAL(late.size(), 3);
+  BOOST_CHECK_EQUAL(late.expire(10), 0);
+  BOOST_CHECK_EQUAL(late.expire(11), 3);
+}
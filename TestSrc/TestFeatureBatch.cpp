@@ -0,0 +1,76 @@
+#define BOOST_TEST_MAIN TestFeatureBatch
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include <sam/FeatureBatch.hpp>
+#include <sam/ExponentialHistogramSum.hpp>
+#include <sam/tuples/Edge.hpp>
+
+using namespace sam;
+
+namespace {
+
+double value(FeatureMap const& featureMap, std::string const& key,
+             std::string const& featureName)
+{
+  auto feature = featureMap.at(key, featureName);
+  return feature->evaluate<double>(valueFunc);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( feature_batch_test_flush )
+{
+  /**
+   * Only the last feature of each key reaches the map.
+   */
+  FeatureMap featureMap;
+  FeatureBatch<SingleFeature> batch;
+  batch.set("a", SingleFeature(1));
+  batch.set("b", SingleFeature(2));
+  batch.set("a", SingleFeature(3));
+  BOOST_CHECK_EQUAL(batch.size(), 2);
+  BOOST_CHECK(!featureMap.exists("a", "sum"));
+
+  batch.flush(featureMap, "sum");
+  BOOST_CHECK_EQUAL(batch.size(), 0);
+  BOOST_CHECK_EQUAL(value(featureMap, "a", "sum"), 3);
+  BOOST_CHECK_EQUAL(value(featureMap, "b", "sum"), 2);
+
+  // An empty batch leaves the map alone.
+  batch.flush(featureMap, "sum");
+  BOOST_CHECK_EQUAL(value(featureMap, "a", "sum"), 3);
+}
+
+BOOST_AUTO_TEST_CASE( feature_batch_test_consume_batch )
+{
+  /**
+   * consumeBatch leaves the same features as consuming edge by edge.
+   */
+  typedef std::tuple<std::string, double> TupleType;
+  typedef Edge<size_t, std::tuple<>, TupleType> EdgeType;
+  typedef ExponentialHistogramSum<double, EdgeType, 1, 0> SumType;
+
+  auto featureMap1 = std::make_shared<FeatureMap>();
+  auto featureMap2 = std::make_shared<FeatureMap>();
+  SumType sum1(10, 2, 0, featureMap1, "sum");
+  SumType sum2(10, 2, 0, featureMap2, "sum");
+
+  std::vector<EdgeType> edges;
+  for (size_t i = 0; i < 100; i++) {
+    edges.push_back(EdgeType(i, std::tuple<>(),
+      TupleType("key" + std::to_string(i % 7), i)));
+  }
+
+  for (auto const& edge : edges) {
+    sum1.consume(edge);
+  }
+  BOOST_CHECK(sum2.consumeBatch(edges.data(), 60));
+  BOOST_CHECK(sum2.consumeBatch(edges.data() + 60, 40));
+
+  for (size_t i = 0; i < 7; i++) {
+    std::string key = "key" + std::to_string(i);
+    BOOST_CHECK_EQUAL(value(*featureMap1, key, "sum"),
+                      value(*featureMap2, key, "sum"));
+  }
+}
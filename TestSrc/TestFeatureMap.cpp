@@ -79,3 +79,111 @@ BOOST_AUTO_TEST_CASE( map_test_multi_threads )
     }
   }
 }
+
+BOOST_AUTO_TEST_CASE( map_test_find )
+{
+  /**
+   * find() returns an empty pointer for missing combos, and the handle it
+   * returns keeps its value after the feature is updated.
+   */
+  FeatureMap featureMap;
+  BOOST_CHECK(!featureMap.find("192.168.0.1", "feature"));
+  BOOST_CHECK(!featureMap.exists("192.168.0.1", "feature"));
+  BOOST_CHECK_THROW(featureMap.at("192.168.0.1", "feature"),
+                    std::out_of_range);
+
+  featureMap.updateInsert("192.168.0.1", "feature", SingleFeature(1.0));
+  auto handle = featureMap.find("192.168.0.1", "feature");
+  BOOST_CHECK(handle);
+  BOOST_CHECK(!featureMap.find("192.168.0.1", "other"));
+  BOOST_CHECK(!featureMap.find("192.168.0.2", "feature"));
+
+  featureMap.updateInsert("192.168.0.1", "feature", SingleFeature(2.0));
+  BOOST_CHECK_EQUAL(handle->getValue(), 1.0);
+  BOOST_CHECK_EQUAL(featureMap.at("192.168.0.1", "feature")->getValue(), 2.0);
+
+  auto keyId = featureMap.getKeyId("192.168.0.1");
+  auto featureId = featureMap.getFeatureId("feature");
+  BOOST_CHECK_EQUAL(featureMap.find(keyId, featureId)->getValue(), 2.0);
+  featureMap.updateInsert(keyId, featureId, SingleFeature(3.0));
+  BOOST_CHECK_EQUAL(featureMap.at("192.168.0.1", "feature")->getValue(), 3.0);
+}
+
+BOOST_AUTO_TEST_CASE( map_test_grow )
+{
+  /**
+   * The map grows past its initial capacity while threads insert and
+   * update, and no updates are lost.
+   */
+  FeatureMap featureMap(16);
+  int numThreads = 4;
+  int numKeys = 5000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < numThreads; i++)
+  {
+    threads.push_back(std::thread([i, numKeys, &featureMap]() {
+      for (int j = 0; j < numKeys; j++) {
+        std::string key = boost::lexical_cast<std::string>(j);
+        std::string featureName = "feature" +
+          boost::lexical_cast<std::string>(i);
+        featureMap.updateInsert(key, featureName, SingleFeature(j));
+        featureMap.updateInsert(key, featureName, SingleFeature(j + 1));
+
+        // Every thread also updates a shared feature of the key.  Check
+        // that an earlier value is readable while the table grows.
+        featureMap.updateInsert(key, "shared", SingleFeature(j));
+        BOOST_CHECK(featureMap.find(key, "shared"));
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < numThreads; i++) {
+    std::string featureName = "feature" + boost::lexical_cast<std::string>(i);
+    for (int j = 0; j < numKeys; j++) {
+      std::string key = boost::lexical_cast<std::string>(j);
+      auto feature = featureMap.find(key, featureName);
+      BOOST_REQUIRE(feature);
+      BOOST_CHECK_EQUAL(feature->getValue(), j + 1);
+      BOOST_CHECK_EQUAL(featureMap.at(key, "shared")->getValue(), j);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( map_test_grow_distinct_keys )
+{
+  /**
+   * Threads insert distinct keys into a tiny map, so the table grows many
+   * times while slots are being claimed.  A slot the migration seals 
+   * before its value is stored must not hold up the writer that claimed it.
+   */
+  FeatureMap featureMap(16);
+  int numThreads = 8;
+  int numKeys = 20000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < numThreads; i++)
+  {
+    threads.push_back(std::thread([i, numKeys, &featureMap]() {
+      std::string prefix = boost::lexical_cast<std::string>(i) + ":";
+      for (int j = 0; j < numKeys; j++) {
+        std::string key = prefix + boost::lexical_cast<std::string>(j);
+        featureMap.updateInsert(key, "feature", SingleFeature(j));
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < numThreads; i++) {
+    std::string prefix = boost::lexical_cast<std::string>(i) + ":";
+    for (int j = 0; j < numKeys; j++) {
+      auto feature = featureMap.find(prefix + 
+        boost::lexical_cast<std::string>(j), "feature");
+      BOOST_REQUIRE(feature);
+      BOOST_CHECK_EQUAL(feature->getValue(), j);
+    }
+  }
+}
@@ -137,6 +137,199 @@ BOOST_AUTO_TEST_CASE( test_graph_store )
   //delete graphStore1;
 }
 
+///
+/// Runs a two edge query (x->y then x->z) on a single node with and without
+/// consume threads.  All the edges of a source land on the same consume
+/// thread in order, so the number of results should be exact either way.
+///
+BOOST_AUTO_TEST_CASE( test_consume_threads )
+{
+  size_t numNodes = 1;
+  size_t nodeId0 = 0;
+  size_t hwm = 1000;
+  size_t graphCapacity = 1000;
+  size_t tableCapacity = 1000;
+  size_t resultsCapacity = 1000;
+  double timeWindow = 100;
+  size_t startingPort = 10100;
+  size_t numPushSockets = 1;
+  size_t numPullThreads = 1;
+  size_t timeout = 1000;
+  bool local = true;
+
+  std::vector<std::string> hostnames;
+  hostnames.push_back("localhost");
+
+  size_t numSources = 8;
+  size_t numEdgesPerSource = 50;
+
+  auto featureMap = std::make_shared<FeatureMap>(1000);
+
+  EdgeExpression x2y("nodex", "e0", "nodey");
+  EdgeExpression x2z("nodex", "e1", "nodez");
+  TimeEdgeExpression startE0(EdgeFunction::StartTime, "e0",
+                             EdgeOperator::Assignment, 0);
+  TimeEdgeExpression startE1(EdgeFunction::StartTime, "e1",
+                             EdgeOperator::GreaterThan, 0);
+
+  auto query = std::make_shared<QueryType>(featureMap);
+  query->addExpression(x2y);
+  query->addExpression(x2z);
+  query->addExpression(startE0);
+  query->addExpression(startE1);
+  query->finalize();
+
+  for (size_t numConsumeThreads : {0, 1, 4})
+  {
+    GraphStoreType graphStore(numNodes, nodeId0,
+                              hostnames, startingPort,
+                              hwm, graphCapacity,
+                              tableCapacity, resultsCapacity,
+                              numPushSockets, numPullThreads, timeout,
+                              timeWindow, featureMap, MAX_NUM_FUTURES, local,
+                              numConsumeThreads);
+    graphStore.registerQuery(query);
+
+    Tuplizer tuplizer;
+    double time = 0;
+    size_t id = 0;
+    for (size_t i = 0; i < numEdgesPerSource; i++) {
+      for (size_t j = 0; j < numSources; j++) {
+        std::string str = boost::lexical_cast<std::string>(time) +
+          ",parseDate,dateTimeStr,ipLayerProtocol,ipLayerProtocolCode,"
+          "source" + boost::lexical_cast<std::string>(j) +
+          ",target" + boost::lexical_cast<std::string>(i) +
+          ",51482,40020,1,1,1,1,1,1,1,1,1,1";
+        graphStore.consume(tuplizer(id++, str));
+        time += 0.01;
+      }
+    }
+    graphStore.terminate();
+
+    size_t expected =
+      numSources * numEdgesPerSource * (numEdgesPerSource - 1) / 2;
+    BOOST_CHECK_EQUAL(graphStore.getNumResults(), expected);
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE( test_ingest_queues )
+{
+  /**
+   * With ingest queues the graph store gives the same results, and the
+   * queues are there to report on.
+   */
+  size_t numNodes = 1;
+  std::vector<std::string> hostnames = {"localhost"};
+  auto featureMap = std::make_shared<FeatureMap>(1000);
+
+  EdgeExpression x2y("nodex", "e0", "nodey");
+  EdgeExpression x2z("nodex", "e1", "nodez");
+  TimeEdgeExpression startE0(EdgeFunction::StartTime, "e0",
+                             EdgeOperator::Assignment, 0);
+  TimeEdgeExpression startE1(EdgeFunction::StartTime, "e1",
+                             EdgeOperator::GreaterThan, 0);
+
+  auto query = std::make_shared<QueryType>(featureMap);
+  query->addExpression(x2y);
+  query->addExpression(x2z);
+  query->addExpression(startE0);
+  query->addExpression(startE1);
+  query->finalize();
+
+  GraphStoreType graphStore(numNodes, 0, hostnames, 10200, 1000, 1000, 1000,
+                            1000, 1, 1, 1000, 100, featureMap,
+                            MAX_NUM_FUTURES, true, 0, 256,
+                            IngestPolicy::Drop);
+  graphStore.registerQuery(query);
+  BOOST_CHECK(graphStore.getEdgeIngestQueue() != nullptr);
+  BOOST_CHECK(graphStore.getRequestIngestQueue() != nullptr);
+
+  Tuplizer tuplizer;
+  size_t n = 50;
+  for (size_t i = 0; i < n; i++) {
+    std::string str = boost::lexical_cast<std::string>(i * 0.01) +
+      ",parseDate,dateTimeStr,ipLayerProtocol,ipLayerProtocolCode,"
+      "source,target" + boost::lexical_cast<std::string>(i) +
+      ",51482,40020,1,1,1,1,1,1,1,1,1,1";
+    graphStore.consume(tuplizer(i, str));
+  }
+  graphStore.terminate();
+
+  BOOST_CHECK_EQUAL(graphStore.getNumResults(), n * (n - 1) / 2);
+  BOOST_CHECK_EQUAL(graphStore.getEdgeIngestQueue()->getNumDropped(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_add_node )
+{
+  /**
+   * Node 1 starts out drained, so node 0 owns every vertex.  When node 1
+   * is added, node 0 sends it the edges of the vertices it now owns.
+   */
+  size_t numNodes = 2;
+  std::vector<std::string> hostnames = {"localhost", "localhost"};
+  auto featureMap = std::make_shared<FeatureMap>(1000);
+
+  auto routingTable = std::make_shared<RoutingTable>(numNodes);
+  routingTable->drainNode(1);
+
+  GraphStoreType graphStore0(numNodes, 0, hostnames, 10300, 1000, 1000, 1000,
+                             1000, 1, 1, 1000, 100, featureMap,
+                             MAX_NUM_FUTURES, true, 0, 0, 
+                             IngestPolicy::Block, routingTable);
+  GraphStoreType graphStore1(numNodes, 1, hostnames, 10300, 1000, 1000, 1000,
+                             1000, 1, 1, 1000, 100, featureMap,
+                             MAX_NUM_FUTURES, true, 0, 0, 
+                             IngestPolicy::Block, routingTable);
+
+  Tuplizer tuplizer;
+  StringHashFunction hash;
+  size_t n = 100;
+  for (size_t i = 0; i < n; i++) {
+    std::string str = boost::lexical_cast<std::string>(i * 0.01) +
+      ",parseDate,dateTimeStr,ipLayerProtocol,ipLayerProtocolCode,"
+      "source" + boost::lexical_cast<std::string>(i % 10) + 
+      ",target" + boost::lexical_cast<std::string>(i) +
+      ",51482,40020,1,1,1,1,1,1,1,1,1,1";
+    graphStore0.consume(tuplizer(i, str));
+  }
+  BOOST_CHECK_EQUAL(graphStore0.countEdges(), n);
+
+  // 10 sources with 10 edges each, 100 targets with one each
+  QueryStatistics statistics = graphStore0.getQueryStatistics();
+  BOOST_CHECK_EQUAL(statistics.numVertices, 100);
+  BOOST_CHECK_EQUAL(statistics.meanOutDegree, 10);
+  BOOST_CHECK_EQUAL(statistics.excessOutDegree(), 10);
+  BOOST_CHECK_EQUAL(statistics.excessInDegree(), 1);
+
+  routingTable->addNode(1);
+  size_t expected = 0;
+  for (size_t i = 0; i < n; i++) {
+    std::string src = "source" + boost::lexical_cast<std::string>(i % 10);
+    std::string trg = "target" + boost::lexical_cast<std::string>(i);
+    if (routingTable->owner(hash(src)) == 1 || 
+        routingTable->owner(hash(trg)) == 1) 
+    {
+      expected++;
+    }
+  }
+  BOOST_CHECK(expected > 0);
+
+  // The table is shared, so adding the node again only rebalances.
+  BOOST_CHECK_EQUAL(graphStore0.addNode(1), expected);
+  BOOST_CHECK_EQUAL(graphStore1.addNode(1), 0);
+
+  for (size_t i = 0; i < 100 && graphStore1.countEdges() < expected; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  BOOST_CHECK_EQUAL(graphStore1.countEdges(), expected);
+
+  // Edges stay on the old owner until they expire.
+  BOOST_CHECK_EQUAL(graphStore0.countEdges(), n);
+
+  graphStore0.terminate();
+  graphStore1.terminate();
+}
 
 /*
 struct SingleNodeFixture  {
@@ -455,3 +648,40 @@ BOOST_FIXTURE_TEST_CASE( test_triangle_same_time, SingleNodeFixture )
 }
 */
 
+
+BOOST_AUTO_TEST_CASE( test_background_expiry )
+{
+  /**
+   * Sources that stop getting edges have their edges expired in the
+   * background.
+   */
+  std::vector<std::string> hostnames = {"localhost"};
+  auto featureMap = std::make_shared<FeatureMap>(1000);
+
+  double timeWindow = 1;
+  GraphStoreType graphStore(1, 0, hostnames, 10400, 1000, 1000, 1000,
+                            1000, 1, 1, 1000, timeWindow, featureMap,
+                            MAX_NUM_FUTURES, true);
+  graphStore.startExpiry(16, 100);
+  BOOST_CHECK_THROW(graphStore.startExpiry(16), GraphStoreException);
+
+  Tuplizer tuplizer;
+  size_t n = 50;
+  for (size_t i = 0; i < n; i++) {
+    std::string str = "0,parseDate,dateTimeStr,ipLayerProtocol,"
+      "ipLayerProtocolCode,source" + boost::lexical_cast<std::string>(i) +
+      ",target,51482,40020,1,1,1,1,1,1,1,1,1,1";
+    graphStore.consume(tuplizer(i, str));
+  }
+  size_t fullBytes = graphStore.getNumGraphBytes();
+  graphStore.consume(tuplizer(n, "10,parseDate,dateTimeStr,ipLayerProtocol,"
+    "ipLayerProtocolCode,source,target,51482,40020,1,1,1,1,1,1,1,1,1,1"));
+
+  for (size_t i = 0; i < 1000 && graphStore.countEdges() > 1; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_CHECK_EQUAL(graphStore.countEdges(), 1);
+  BOOST_CHECK(graphStore.getNumGraphBytes() < fullBytes);
+  graphStore.terminate();
+  BOOST_CHECK(graphStore.getExpiryService()->getNumRemoved() >= n);
+}
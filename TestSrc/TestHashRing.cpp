@@ -0,0 +1,57 @@
+#define BOOST_TEST_MAIN TestHashRing
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <sam/HashRing.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( hash_ring_test_balance )
+{
+  BOOST_CHECK_THROW(HashRing(std::vector<size_t>()), HashRingException);
+
+  HashRing ring({0, 1, 2, 3});
+  BOOST_CHECK_EQUAL(ring.size(), 4);
+  BOOST_CHECK(ring.contains(3));
+  BOOST_CHECK(!ring.contains(4));
+
+  size_t n = 100000;
+  std::vector<size_t> counts(4, 0);
+  for (size_t hash = 0; hash < n; hash++) {
+    counts[ring.owner(hash)]++;
+  }
+  for (size_t count : counts) {
+    BOOST_CHECK_GT(count, n / 8);
+    BOOST_CHECK_LT(count, n / 2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( hash_ring_test_membership_changes )
+{
+  HashRing ring({0, 1, 2});
+  HashRing bigger = ring.with(3);
+  HashRing smaller = ring.without(1);
+  BOOST_CHECK_EQUAL(bigger.size(), 4);
+  BOOST_CHECK_EQUAL(smaller.size(), 2);
+  BOOST_CHECK_EQUAL(ring.with(2).size(), 3);
+
+  // Adding a node only moves hashes to it, and removing a node only moves
+  // its hashes.
+  size_t n = 100000;
+  size_t movedToNew = 0;
+  for (size_t hash = 0; hash < n; hash++) {
+    size_t owner = ring.owner(hash);
+    if (bigger.owner(hash) != owner) {
+      BOOST_CHECK_EQUAL(bigger.owner(hash), 3);
+      movedToNew++;
+    }
+    if (owner != 1) {
+      BOOST_CHECK_EQUAL(smaller.owner(hash), owner);
+    } else {
+      BOOST_CHECK(smaller.owner(hash) != 1);
+    }
+  }
+  BOOST_CHECK_GT(movedToNew, n / 8);
+  BOOST_CHECK_LT(movedToNew, n / 2);
+
+  BOOST_CHECK_THROW(HashRing({0}).without(0), HashRingException);
+}
@@ -0,0 +1,111 @@
+#define BOOST_TEST_MAIN TestHyperLogLog
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include <sam/HyperLogLog.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( hll_test_estimate )
+{
+  BOOST_CHECK_THROW(HyperLogLog(3), HyperLogLogException);
+  BOOST_CHECK_THROW(HyperLogLog(17), HyperLogLogException);
+
+  HyperLogLog hll(12);
+  BOOST_CHECK_EQUAL(hll.estimate(), 0);
+
+  // Small counts use linear counting and are close to exact.
+  for (size_t i = 0; i < 100; i++) hll.add(HyperLogLog::hash(i));
+  BOOST_CHECK_CLOSE(hll.estimate(), 100, 2);
+
+  // Adding the same values again changes nothing.
+  for (size_t i = 0; i < 100; i++) {
+    BOOST_CHECK(!hll.add(HyperLogLog::hash(i)));
+  }
+
+  for (size_t i = 100; i < 1000000; i++) hll.add(HyperLogLog::hash(i));
+  // The standard error with 4096 registers is 1.6%.
+  BOOST_CHECK_CLOSE(hll.estimate(), 1000000, 5);
+
+  // The incrementally kept sum agrees with a recount.
+  double before = hll.estimate();
+  hll.recount();
+  BOOST_CHECK_CLOSE(hll.estimate(), before, 1e-6);
+
+  HyperLogLog strings(10);
+  for (size_t i = 0; i < 500; i++) {
+    strings.add(HyperLogLog::hash("192.168.0." +
+                                  boost::lexical_cast<std::string>(i % 250)));
+  }
+  BOOST_CHECK_CLOSE(strings.estimate(), 250, 5);
+}
+
+BOOST_AUTO_TEST_CASE( hll_test_merge )
+{
+  HyperLogLog a(10), b(10), both(10);
+  for (size_t i = 0; i < 20000; i++) {
+    a.add(HyperLogLog::hash(i));
+    b.add(HyperLogLog::hash(i + 10000));
+    both.add(HyperLogLog::hash(i));
+    both.add(HyperLogLog::hash(i + 10000));
+  }
+  a.merge(b);
+  BOOST_CHECK(a.getRegisters() == both.getRegisters());
+  BOOST_CHECK_CLOSE(a.estimate(), both.estimate(), 1e-6);
+
+  HyperLogLog other(11);
+  BOOST_CHECK_THROW(a.merge(other), HyperLogLogException);
+}
+
+BOOST_AUTO_TEST_CASE( hll_test_kernels )
+{
+  /**
+   * The AVX2 kernels give the same answers as the scalar ones, including
+   * on lengths that aren't a multiple of 32.
+   */
+  if (!cpuHasAvx2()) return;
+#if SAM_HAS_AVX2_KERNELS
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> dist(0, 40);
+  for (size_t m : {16, 64, 100, 1024}) {
+    std::vector<uint8_t> x(m), y(m);
+    for (size_t i = 0; i < m; i++) {
+      x[i] = dist(gen) < 10 ? 0 : dist(gen);
+      y[i] = dist(gen);
+    }
+    std::vector<uint8_t> scalar = x, avx = x;
+    hll_detail::mergeScalar(scalar.data(), y.data(), m);
+    hll_detail::mergeAvx2(avx.data(), y.data(), m);
+    BOOST_CHECK(scalar == avx);
+
+    double sumScalar, sumAvx;
+    size_t zerosScalar, zerosAvx;
+    hll_detail::sumScalar(x.data(), m, sumScalar, zerosScalar);
+    hll_detail::sumAvx2(x.data(), m, sumAvx, zerosAvx);
+    BOOST_CHECK_CLOSE(sumScalar, sumAvx, 1e-4);
+    BOOST_CHECK_EQUAL(zerosScalar, zerosAvx);
+  }
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( hll_test_sliding )
+{
+  /**
+   * The window covers the last N to N + b items.
+   */
+  SlidingHyperLogLog window(1000, 100, 10);
+  for (size_t i = 0; i < 10000; i++) window.add(HyperLogLog::hash(i));
+  BOOST_CHECK(window.estimate() > 900);
+  BOOST_CHECK(window.estimate() < 1200);
+
+  // Values from long ago are gone; repeated recent ones count once.
+  SlidingHyperLogLog repeats(1000, 100, 10);
+  for (size_t i = 0; i < 10000; i++) repeats.add(HyperLogLog::hash(i % 10));
+  BOOST_CHECK_CLOSE(repeats.estimate(), 10, 5);
+
+  BOOST_CHECK_THROW(SlidingHyperLogLog(100, 1000, 10), HyperLogLogException);
+
+  // N of 0 counts over everything.
+  SlidingHyperLogLog all(0, 0, 10);
+  for (size_t i = 0; i < 10000; i++) all.add(HyperLogLog::hash(i));
+  BOOST_CHECK_CLOSE(all.estimate(), 10000, 10);
+}
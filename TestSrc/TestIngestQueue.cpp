@@ -0,0 +1,133 @@
+#define BOOST_TEST_MAIN TestIngestQueue
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sam/IngestQueue.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( ingest_queue_test_block )
+{
+  /**
+   * Under the block policy every item reaches the handler, from however
+   * many threads they are pushed.
+   */
+  std::atomic<size_t> sum(0);
+  std::atomic<size_t> calls(0);
+  IngestQueue<size_t> queue(16, [&](size_t const* items, size_t count) {
+    for (size_t i = 0; i < count; i++) sum += items[i];
+    calls++;
+  }, IngestPolicy::Block, 8);
+
+  size_t numThreads = 4;
+  size_t n = 10000;
+  std::atomic<size_t> failedPushes(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; t++) {
+    threads.push_back(std::thread([&queue, &failedPushes, n]() {
+      for (size_t i = 1; i <= n; i++) {
+        if (!queue.push(i)) failedPushes++;
+      }
+    }));
+  }
+  for (auto& thread : threads) thread.join();
+  queue.flush();
+
+  BOOST_CHECK_EQUAL(failedPushes, 0);
+  BOOST_CHECK_EQUAL(sum, numThreads * n * (n + 1) / 2);
+  BOOST_CHECK_EQUAL(queue.getNumPushed(), numThreads * n);
+  BOOST_CHECK_EQUAL(queue.getNumHandled(), numThreads * n);
+  BOOST_CHECK_EQUAL(queue.getNumDropped(), 0);
+  BOOST_CHECK(queue.getMaxOccupancy() <= queue.capacity());
+  BOOST_CHECK(calls > 0);
+
+  queue.stop();
+  BOOST_CHECK(!queue.push(1));
+  BOOST_CHECK_EQUAL(queue.getNumDropped(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( ingest_queue_test_drop )
+{
+  /**
+   * Under the drop policy a stalled handler makes pushes fail and they
+   * are counted.
+   */
+  std::atomic<bool> release(false);
+  std::atomic<size_t> handled(0);
+  IngestQueue<int> queue(4, [&](int const*, size_t count) {
+    while (!release) std::this_thread::yield();
+    handled += count;
+  }, IngestPolicy::Drop, 1);
+
+  // The first item may be taken by the handler right away, so at most
+  // capacity + 1 items fit while the handler is stalled.
+  size_t pushed = 0;
+  for (int i = 0; i < 20; i++) {
+    pushed += queue.push(i);
+  }
+  BOOST_CHECK(pushed >= queue.capacity());
+  BOOST_CHECK(pushed <= queue.capacity() + 1);
+  BOOST_CHECK_EQUAL(queue.getNumDropped(), 20 - pushed);
+  BOOST_CHECK_EQUAL(queue.getNumFull(), 20 - pushed);
+  BOOST_CHECK_EQUAL(queue.getMaxOccupancy(), queue.capacity());
+
+  release = true;
+  queue.flush();
+  BOOST_CHECK_EQUAL(handled, pushed);
+  BOOST_CHECK_EQUAL(queue.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( ingest_queue_test_stop_drains )
+{
+  /**
+   * stop() hands the waiting items to the handler before it returns.
+   */
+  std::atomic<size_t> handled(0);
+  IngestQueue<int> queue(1024, [&](int const*, size_t count) {
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+    handled += count;
+  });
+  for (int i = 0; i < 1000; i++) {
+    queue.push(i);
+  }
+  queue.stop();
+  BOOST_CHECK_EQUAL(handled, 1000);
+
+  BOOST_CHECK_THROW(IngestQueue<int>(4, [](int const*, size_t) {},
+                      IngestPolicy::Block, 0), IngestQueueException);
+}
+
+BOOST_AUTO_TEST_CASE( ingest_queue_test_stop_while_pushing )
+{
+  /**
+   * Every item counted as pushed is handled, even when stop() races with
+   * the pushing threads.
+   */
+  for (size_t round = 0; round < 20; round++) {
+    std::atomic<size_t> handled(0);
+    IngestQueue<int> queue(64, [&](int const*, size_t count) {
+      handled += count;
+    });
+
+    std::vector<std::thread> threads;
+    std::atomic<size_t> accepted(0);
+    for (size_t t = 0; t < 4; t++) {
+      threads.push_back(std::thread([&queue, &accepted]() {
+        for (int i = 0; i < 10000; i++) {
+          accepted += queue.push(i);
+        }
+      }));
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100 * round));
+    queue.stop();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    BOOST_CHECK_EQUAL(queue.getNumPushed(), accepted);
+    BOOST_CHECK_EQUAL(handled, accepted);
+    BOOST_CHECK_EQUAL(queue.getNumPushed() + queue.getNumDropped(), 40000);
+  }
+}
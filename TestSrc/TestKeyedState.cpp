@@ -0,0 +1,151 @@
+#define BOOST_TEST_MAIN TestKeyedState
+#include <boost/test/unit_test.hpp>
+#include <sam/KeyedState.hpp>
+#include <sam/SimpleSum.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+
+BOOST_AUTO_TEST_CASE( test_keyed_state_get )
+{
+  /**
+   * Without a ttl or a budget nothing is evicted.
+   */
+  KeyedState<int> state;
+  for (int i = 0; i < 100; i++) {
+    state.get(boost::lexical_cast<std::string>(i), i, []() { return 0; })++;
+  }
+  state.get("5", 100, []() { return 0; })++;
+  BOOST_CHECK_EQUAL(state.size(), 100);
+  BOOST_CHECK_EQUAL(state.getKeysEvicted(), 0);
+  BOOST_CHECK_EQUAL(*state.find("5"), 2);
+  BOOST_CHECK_EQUAL(*state.find("6"), 1);
+  BOOST_CHECK(state.find("100") == nullptr);
+
+  size_t count = 0;
+  state.forEach([&count](std::string const&, int value) { count += value; });
+  BOOST_CHECK_EQUAL(count, 101);
+
+  BOOST_CHECK_THROW(KeyedState<int>(-1), KeyedStateException);
+}
+
+BOOST_AUTO_TEST_CASE( test_keyed_state_ttl )
+{
+  /**
+   * Keys that haven't been seen for more than the ttl are evicted, but
+   * keys that keep getting accessed stay.
+   */
+  KeyedState<int> state(10);
+  auto factory = []() { return 0; };
+  for (int t = 0; t < 100; t++) {
+    state.get("hot", t, factory)++;
+    state.get(boost::lexical_cast<std::string>(t), t, factory);
+  }
+
+  // Keys 0 through 88 are older than the ttl.
+  BOOST_CHECK_EQUAL(state.getKeysEvicted(), 89);
+  BOOST_CHECK_EQUAL(state.size(), 12);
+  BOOST_CHECK_EQUAL(*state.find("hot"), 100);
+  BOOST_CHECK(state.find("88") == nullptr);
+  BOOST_CHECK(state.find("89") != nullptr);
+
+  // A key accessed after a long gap is never evicted by its own access.
+  state.get("late", 1000, factory);
+  BOOST_CHECK_EQUAL(state.size(), 1);
+  BOOST_CHECK(state.find("late") != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE( test_keyed_state_budget )
+{
+  /**
+   * The least recently used keys are evicted to stay under the budget.
+   */
+  KeyedState<int> probe;
+  probe.get("10", 0, []() { return 0; });
+  size_t entryBytes = probe.getBytesHeld();
+
+  // The keys all have two characters, so they all cost entryBytes.
+  KeyedState<int> state(0, 10 * entryBytes);
+  auto factory = []() { return 0; };
+  for (int i = 10; i < 20; i++) {
+    state.get(boost::lexical_cast<std::string>(i), 0, factory);
+  }
+  BOOST_CHECK_EQUAL(state.size(), 10);
+  BOOST_CHECK_EQUAL(state.getBytesHeld(), 10 * entryBytes);
+
+  // Touch 10 so that 11 is the least recently used.
+  state.get("10", 0, factory);
+  state.get("20", 0, factory);
+  BOOST_CHECK_EQUAL(state.size(), 10);
+  BOOST_CHECK_EQUAL(state.getKeysEvicted(), 1);
+  BOOST_CHECK(state.find("10") != nullptr);
+  BOOST_CHECK(state.find("11") == nullptr);
+  BOOST_CHECK(state.getBytesHeld() <= 10 * entryBytes);
+
+  // A budget smaller than one entry keeps only the key being accessed.
+  KeyedState<int> tiny(0, 1);
+  tiny.get("a", 0, factory);
+  tiny.get("b", 0, factory);
+  BOOST_CHECK_EQUAL(tiny.size(), 1);
+  BOOST_CHECK(tiny.find("b") != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE( test_keyed_state_churn_bytes )
+{
+  /**
+   * Keys built by concatenation (as generateKey does) are longer than the
+   * small string buffer, so their capacity can differ from the table's 
+   * copy.  Evicting them must give back exactly what adding them took.
+   */
+  std::string prefix = "192.168.100.200,";
+  KeyedState<int> probe;
+  probe.get(prefix + boost::lexical_cast<std::string>(999), 0, 
+            []() { return 0; });
+  size_t oneKey = probe.getBytesHeld();
+
+  KeyedState<int> state(1, 100 * oneKey);
+  auto factory = []() { return 0; };
+  for (int i = 100; i < 1000; i++) {
+    std::string key = prefix;
+    key += boost::lexical_cast<std::string>(i);
+    key.reserve(64);
+    state.get(key, 2 * i, factory);
+  }
+  BOOST_CHECK_EQUAL(state.size(), 1);
+  BOOST_CHECK_EQUAL(state.getKeysEvicted(), 899);
+  BOOST_CHECK_EQUAL(state.getBytesHeld(), oneKey);
+}
+
+BOOST_AUTO_TEST_CASE( test_simple_sum_key_ttl )
+{
+  /**
+   * SimpleSum evicts the windows of idle destinations.
+   */
+  Tuplizer tuplizer;
+  auto featureMap = std::make_shared<FeatureMap>();
+  SimpleSum<size_t, EdgeType, SrcTotalBytes, DestIp>
+    sum(10, 0, featureMap, "sum0", 60, 0, TimeFieldFunction<TimeSeconds>());
+
+  for (size_t i = 0; i < 100; i++) {
+    std::string str = boost::lexical_cast<std::string>(i * 10) +
+      ",2013-04-10 08:32:36,20130410083236.384094,17,UDP,target," +
+      "dest" + boost::lexical_cast<std::string>(i) +
+      ",29986,1900,0,0,1.0,133,0,1,0,1,0,0";
+    sum.consume(tuplizer(i, str));
+  }
+
+  // Destinations seen more than 60 seconds before the last one are gone.
+  BOOST_CHECK_EQUAL(sum.keys().size(), 7);
+  BOOST_CHECK_EQUAL(sum.getKeysEvicted(), 93);
+  BOOST_CHECK_EQUAL(sum.getSum("dest99"), 1);
+  BOOST_CHECK_THROW(sum.getSum("dest0"), KeyedStateException);
+
+  BOOST_CHECK_THROW((SimpleSum<size_t, EdgeType, SrcTotalBytes, DestIp>(
+    10, 0, featureMap, "sum1", 60)), KeyedStateException);
+}
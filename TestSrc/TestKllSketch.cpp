@@ -0,0 +1,71 @@
+#define BOOST_TEST_MAIN TestKllSketch
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <random>
+#include <sam/KllSketch.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( kll_test_small )
+{
+  /**
+   * Until the first compaction the sketch is exact.
+   */
+  KllSketch<double> sketch(200);
+  BOOST_CHECK_THROW(sketch.getQuantile(0.5), KllSketchException);
+  for (int i = 1; i <= 99; i++) sketch.update(i);
+  BOOST_CHECK_EQUAL(sketch.getN(), 99);
+  BOOST_CHECK_EQUAL(sketch.getNumRetained(), 99);
+  BOOST_CHECK_EQUAL(sketch.getQuantile(0), 1);
+  BOOST_CHECK_EQUAL(sketch.getQuantile(0.5), 50);
+  BOOST_CHECK_EQUAL(sketch.getQuantile(1), 99);
+
+  BOOST_CHECK_THROW(KllSketch<double>(1), KllSketchException);
+}
+
+BOOST_AUTO_TEST_CASE( kll_test_bounded )
+{
+  /**
+   * The number of items held stays around 3k while the rank error stays
+   * within a few percent.
+   */
+  size_t k = 200;
+  KllSketch<double> sketch(k);
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> dist(0, 1);
+  size_t n = 1000000;
+  for (size_t i = 0; i < n; i++) {
+    sketch.update(dist(gen));
+    BOOST_REQUIRE(sketch.getNumRetained() <= 4 * k);
+  }
+  BOOST_CHECK_EQUAL(sketch.getN(), n);
+  BOOST_CHECK(sketch.memoryUsage() < 10 * k * sizeof(double) + 4096);
+
+  for (double q : {0.01, 0.1, 0.5, 0.9, 0.99}) {
+    BOOST_CHECK_SMALL(sketch.getQuantile(q) - q, 0.02);
+  }
+
+  uint64_t total = 0;
+  for (auto const& p : sketch.getSortedView()) total += p.second;
+  BOOST_CHECK_EQUAL(total, n);
+}
+
+BOOST_AUTO_TEST_CASE( kll_test_merge )
+{
+  /**
+   * Merging the sketches of two halves gives the quantiles of the whole.
+   */
+  KllSketch<double> low(200), high(200);
+  for (int i = 0; i < 100000; i++) {
+    low.update(i);
+    high.update(100000 + i);
+  }
+  low.merge(high);
+  BOOST_CHECK_EQUAL(low.getN(), 200000);
+  BOOST_CHECK_SMALL(low.getQuantile(0.5) - 100000, 4000.0);
+  BOOST_CHECK_SMALL(low.getQuantile(0.25) - 50000, 4000.0);
+  BOOST_CHECK(low.getNumRetained() <= 800);
+
+  KllSketch<double> other(100);
+  BOOST_CHECK_THROW(low.merge(other), KllSketchException);
+}
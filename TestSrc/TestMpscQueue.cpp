@@ -0,0 +1,76 @@
+#define BOOST_TEST_MAIN TestMpscQueue
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <vector>
+#include <sam/MpscQueue.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( mpsc_queue_test_single_thread )
+{
+  MpscQueue<int> queue(5);
+  BOOST_CHECK_EQUAL(queue.capacity(), 8);
+
+  for (int i = 0; i < 8; i++) {
+    BOOST_CHECK(queue.push(i));
+  }
+  BOOST_CHECK(!queue.push(8));
+  BOOST_CHECK_EQUAL(queue.size(), 8);
+
+  int item;
+  BOOST_CHECK(queue.pop(item));
+  BOOST_CHECK_EQUAL(item, 0);
+
+  // Wraps around the ring.
+  BOOST_CHECK(queue.push(8));
+  int items[10];
+  BOOST_CHECK_EQUAL(queue.popBatch(items, 10), 8);
+  for (int i = 0; i < 8; i++) {
+    BOOST_CHECK_EQUAL(items[i], i + 1);
+  }
+  BOOST_CHECK(!queue.pop(item));
+  BOOST_CHECK_EQUAL(queue.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( mpsc_queue_test_producers )
+{
+  /**
+   * Several producers push at once.  Every item comes out exactly once
+   * and each producer's items come out in the order pushed.
+   */
+  size_t numProducers = 4;
+  size_t numItems = 100000;
+  MpscQueue<size_t> queue(64);
+
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < numProducers; p++) {
+    producers.push_back(std::thread([&queue, p, numItems]() {
+      for (size_t i = 0; i < numItems; i++) {
+        while (!queue.push(p * numItems + i)) {
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+
+  std::vector<size_t> next(numProducers, 0);
+  size_t received = 0;
+  bool inOrder = true;
+  size_t items[16];
+  while (received < numProducers * numItems) {
+    size_t n = queue.popBatch(items, 16);
+    for (size_t i = 0; i < n; i++) {
+      size_t p = items[i] / numItems;
+      inOrder = inOrder && items[i] % numItems == next[p];
+      next[p]++;
+    }
+    received += n;
+  }
+  for (auto& producer : producers) producer.join();
+
+  BOOST_CHECK(inOrder);
+  for (size_t p = 0; p < numProducers; p++) {
+    BOOST_CHECK_EQUAL(next[p], numItems);
+  }
+  BOOST_CHECK_EQUAL(queue.size(), 0);
+}
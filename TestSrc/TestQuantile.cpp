@@ -0,0 +1,67 @@
+#define BOOST_TEST_MAIN TestQuantile
+#include <boost/test/unit_test.hpp>
+#include <sam/Quantile.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+
+namespace {
+
+EdgeType makeEdge(Tuplizer& tuplizer, size_t id, std::string dest,
+                  size_t bytes)
+{
+  std::string str = boost::lexical_cast<std::string>(id) +
+    ",2013-04-10 08:32:36,20130410083236.384094,17,UDP,target," +
+    dest + ",29986,1900,0,0,1.0,133,0," +
+    boost::lexical_cast<std::string>(bytes) + ",0,1,0,0";
+  return tuplizer(id, str);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_quantile_window )
+{
+  /**
+   * The median of SrcTotalBytes per destination over the last 1000 items,
+   * published each time a basic window of 100 items fills up.
+   */
+  Tuplizer tuplizer;
+  auto featureMap = std::make_shared<FeatureMap>();
+  Quantile<double, EdgeType, SrcTotalBytes, DestIp>
+    median(1000, 100, 200, 0.5, 0, featureMap, "median");
+
+  // Nothing is published until the first basic window is full.
+  for (size_t i = 0; i < 99; i++) {
+    median.consume(makeEdge(tuplizer, i, "dest0", i));
+  }
+  BOOST_CHECK(!featureMap->exists("dest0", "median"));
+  median.consume(makeEdge(tuplizer, 99, "dest0", 99));
+  BOOST_CHECK(featureMap->exists("dest0", "median"));
+  BOOST_CHECK_CLOSE(featureMap->at("dest0", "median")->getValue(), 49, 5);
+
+  // After 5000 items the window holds 4000 through 4999.
+  for (size_t i = 100; i < 5000; i++) {
+    median.consume(makeEdge(tuplizer, i, "dest0", i));
+  }
+  auto feature = featureMap->at("dest0", "median");
+  BOOST_CHECK_CLOSE(feature->getValue(), 4500, 1);
+
+  // Other quantiles can be read from the feature.
+  double p90 = feature->evaluate<double>([](Feature const* f) {
+    return static_cast<QuantileFeature const*>(f)->getQuantile(0.9);
+  });
+  BOOST_CHECK_CLOSE(p90, 4900, 1);
+  BOOST_CHECK_CLOSE(static_cast<QuantileFeature const*>(feature.get())->
+    getQuantile(0), 4000, 1);
+
+  BOOST_CHECK_THROW((Quantile<double, EdgeType, SrcTotalBytes, DestIp>(
+    100, 1000, 200, 0.5, 0, featureMap, "bad")), QuantileException);
+  BOOST_CHECK_THROW((Quantile<double, EdgeType, SrcTotalBytes, DestIp>(
+    1000, 100, 200, 1.5, 0, featureMap, "bad")), QuantileException);
+}
@@ -0,0 +1,127 @@
+#define BOOST_TEST_MAIN TestQueryTrie
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include <sam/QueryTrie.hpp>
+#include <sam/SubgraphQuery.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/FeatureMap.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef SubgraphQuery<VastNetflow, SourceIp, DestIp, TimeSeconds, 
+     DurationSeconds> QueryType;
+typedef QueryTrie<QueryType> TrieType;
+
+struct F {
+  std::shared_ptr<FeatureMap> featureMap;
+
+  F() {
+    featureMap = std::make_shared<FeatureMap>();
+  }
+
+  /**
+   * x e1 y, y e2 z, z e3 x, with e1 at 0 and the others after it, e3 
+   * starting no later than lastStart.
+   */
+  std::shared_ptr<QueryType> triangle(double lastStart, 
+                                      std::string constraint = "") 
+  {
+    auto query = std::make_shared<QueryType>(featureMap);
+    query->addExpression(EdgeExpression("x", "e1", "y"));
+    query->addExpression(EdgeExpression("y", "e2", "z"));
+    query->addExpression(EdgeExpression("z", "e3", "x"));
+    query->addExpression(TimeEdgeExpression(EdgeFunction::StartTime, "e1",
+                         EdgeOperator::Assignment, 0));
+    query->addExpression(TimeEdgeExpression(EdgeFunction::StartTime, "e2",
+                         EdgeOperator::GreaterThan, 0));
+    query->addExpression(TimeEdgeExpression(EdgeFunction::StartTime, "e3",
+                         EdgeOperator::GreaterThan, 0));
+    query->addExpression(TimeEdgeExpression(EdgeFunction::StartTime, "e3",
+                         EdgeOperator::LessThan, lastStart));
+    if (constraint != "") {
+      query->addExpression(VertexConstraintExpression("x", VertexOperator::In,
+                           constraint));
+    }
+    query->finalize();
+    return query;
+  }
+
+  /**
+   * a e1 b, b e2 c: the first two edges of triangle() with other names.
+   */
+  std::shared_ptr<QueryType> path()
+  {
+    auto query = std::make_shared<QueryType>(featureMap);
+    query->addExpression(EdgeExpression("a", "e1", "b"));
+    query->addExpression(EdgeExpression("b", "e2", "c"));
+    query->addExpression(TimeEdgeExpression(EdgeFunction::StartTime, "e1",
+                         EdgeOperator::Assignment, 0));
+    query->addExpression(TimeEdgeExpression(EdgeFunction::StartTime, "e2",
+                         EdgeOperator::GreaterThan, 0));
+    query->finalize();
+    return query;
+  }
+};
+
+BOOST_FIXTURE_TEST_CASE( test_matches_edge, F )
+{
+  auto t1 = triangle(10);
+  auto t2 = triangle(20);
+  BOOST_CHECK(t1->matchesEdge(0, *t2));
+  BOOST_CHECK(t1->matchesEdge(1, *t2));
+  BOOST_CHECK(!t1->matchesEdge(2, *t2));
+  BOOST_CHECK(!t1->matchesEdge(3, *t2));
+
+  // Variable names don't matter, constraints do.
+  BOOST_CHECK(t1->matchesEdge(1, *path()));
+  BOOST_CHECK(!t1->matchesEdge(0, *triangle(10, "top")));
+}
+
+BOOST_FIXTURE_TEST_CASE( test_shared_prefix, F )
+{
+  TrieType trie;
+  trie.add(triangle(10));
+  trie.add(triangle(20));
+  trie.add(path());
+  trie.add(triangle(10, "top"));
+
+  BOOST_CHECK_EQUAL(trie.numQueries(), 4);
+  BOOST_REQUIRE_EQUAL(trie.getRoots().size(), 2);
+
+  // The two triangles and the path share two edges, then the path is 
+  // complete and the triangles diverge.
+  auto root = trie.getRoots()[0];
+  BOOST_CHECK(root->isShared());
+  BOOST_CHECK_EQUAL(root->depth, 2);
+  BOOST_CHECK_EQUAL(root->queries.size(), 3);
+  BOOST_CHECK_EQUAL(root->completes.size(), 1);
+  BOOST_REQUIRE_EQUAL(root->children.size(), 2);
+  for (auto const& child : root->children) {
+    BOOST_CHECK(!child->isShared());
+    BOOST_CHECK_EQUAL(child->depth, 3);
+  }
+  BOOST_CHECK_EQUAL(root->maxTimeExtent, 
+                    root->children[1]->representative()->getMaxTimeExtent());
+
+  // The constrained triangle shares nothing.
+  auto other = trie.getRoots()[1];
+  BOOST_CHECK(!other->isShared());
+  BOOST_CHECK_EQUAL(other->depth, 3);
+  BOOST_CHECK_EQUAL(other->completes.size(), 1);
+
+  BOOST_CHECK_EQUAL(trie.numNodes(), 4);
+}
+
+BOOST_FIXTURE_TEST_CASE( test_identical_queries, F )
+{
+  TrieType trie;
+  trie.add(triangle(10));
+  trie.add(triangle(10));
+
+  BOOST_REQUIRE_EQUAL(trie.getRoots().size(), 1);
+  BOOST_CHECK_EQUAL(trie.getRoots()[0]->depth, 3);
+  BOOST_CHECK_EQUAL(trie.getRoots()[0]->completes.size(), 2);
+  BOOST_CHECK(trie.getRoots()[0]->children.empty());
+}
@@ -0,0 +1,190 @@
+#define BOOST_TEST_MAIN TestRoutingTable
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sam/HeavyHitters.hpp>
+#include <sam/RoutingTable.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( heavy_hitters_test )
+{
+  HeavyHitters<std::string> hitters(4);
+  BOOST_CHECK_THROW(HeavyHitters<std::string>(0), HeavyHittersException);
+
+  // "dns" is seen every other time, everything else once.
+  for (size_t i = 0; i < 100; i++) {
+    hitters.add("dns");
+    hitters.add("host" + std::to_string(i));
+  }
+
+  BOOST_CHECK_EQUAL(hitters.getTotal(), 200);
+  BOOST_CHECK_GE(hitters.getCount("dns"), 100);
+  BOOST_CHECK_EQUAL(hitters.getCount("neverSeen"), 0);
+
+  auto heavy = hitters.getHeavyHitters(0.4);
+  BOOST_CHECK_EQUAL(heavy.size(), 1);
+  BOOST_CHECK_EQUAL(heavy[0].first, "dns");
+}
+
+BOOST_AUTO_TEST_CASE( heavy_hitters_replacement_test )
+{
+  HeavyHitters<size_t> hitters(3);
+  hitters.add(1);
+  hitters.add(1);
+  hitters.add(2);
+  hitters.add(3);
+  hitters.add(3);
+  hitters.add(3);
+
+  // 2 has the smallest count, so 4 replaces it and takes over its count
+  BOOST_CHECK_EQUAL(hitters.add(4), 2);
+  BOOST_CHECK_EQUAL(hitters.getCount(2), 0);
+  BOOST_CHECK_EQUAL(hitters.getCount(1), 2);
+  BOOST_CHECK_EQUAL(hitters.getCount(3), 3);
+
+  // Ties at the smallest count; one of 1 and 4 is replaced
+  BOOST_CHECK_EQUAL(hitters.add(5), 3);
+  BOOST_CHECK_EQUAL(hitters.getCount(1) + hitters.getCount(4), 2);
+  BOOST_CHECK_EQUAL(hitters.getCount(5), 3);
+
+  auto heavy = hitters.getHeavyHitters(0.3);
+  BOOST_CHECK_EQUAL(heavy.size(), 2);
+  for (auto const& p : heavy) {
+    BOOST_CHECK_EQUAL(p.second, 3);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( routing_table_ownership_test )
+{
+  RoutingTable table(4);
+  BOOST_CHECK_THROW(RoutingTable(0), RoutingTableException);
+
+  size_t hub = 6;
+  size_t owner = table.owner(hub);
+  BOOST_CHECK(owner < 4);
+  BOOST_CHECK(table.receives(hub, owner));
+  BOOST_CHECK(!table.receives(hub, (owner + 1) % 4));
+  BOOST_CHECK_EQUAL(table.resultOwner(hub, 7), owner);
+
+  // No hub detection unless asked for
+  BOOST_CHECK(!table.detectsHubs());
+  BOOST_CHECK(!table.observe(hub));
+
+  table.replicate(hub);
+  BOOST_CHECK(table.isReplicated(hub));
+  BOOST_CHECK_EQUAL(table.getNumReplicated(), 1);
+  for (size_t node = 0; node < 4; node++) {
+    BOOST_CHECK(table.receives(hub, node));
+  }
+  // Owner stays the same, but results out of a hub go to the target's owner
+  BOOST_CHECK_EQUAL(table.owner(hub), owner);
+  BOOST_CHECK_EQUAL(table.resultOwner(hub, 7), table.owner(7));
+  BOOST_CHECK_EQUAL(table.resultOwner(7, hub), table.owner(7));
+
+  table.replicate(hub);
+  BOOST_CHECK_EQUAL(table.getNumReplicated(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( routing_table_membership_test )
+{
+  RoutingTable table(4);
+  BOOST_CHECK_EQUAL(table.getMembers().size(), 4);
+  BOOST_CHECK_EQUAL(table.getEpoch(), 0);
+
+  table.drainNode(2);
+  BOOST_CHECK(!table.isMember(2));
+  BOOST_CHECK_EQUAL(table.getEpoch(), 1);
+
+  size_t moved = 0;
+  for (size_t hash = 0; hash < 1000; hash++) {
+    BOOST_CHECK(table.owner(hash) != 2);
+    if (table.previousOwner(hash) == 2) {
+      moved++;
+      BOOST_CHECK(table.previouslyReceived(hash, 2));
+      BOOST_CHECK(!table.receives(hash, 2));
+    } else {
+      // Only the drained node's vertices move.
+      BOOST_CHECK_EQUAL(table.owner(hash), table.previousOwner(hash));
+    }
+  }
+  BOOST_CHECK(moved > 0);
+
+  // Draining again changes nothing
+  table.drainNode(2);
+  BOOST_CHECK_EQUAL(table.getEpoch(), 1);
+
+  table.addNode(2);
+  BOOST_CHECK(table.isMember(2));
+  BOOST_CHECK_EQUAL(table.getEpoch(), 2);
+  for (size_t hash = 0; hash < 1000; hash++) {
+    if (table.owner(hash) != 2) {
+      BOOST_CHECK_EQUAL(table.owner(hash), table.previousOwner(hash));
+    }
+  }
+
+  BOOST_CHECK_THROW(table.addNode(4), RoutingTableException);
+  table.drainNode(0);
+  table.drainNode(1);
+  table.drainNode(2);
+  BOOST_CHECK_THROW(table.drainNode(3), RoutingTableException);
+  BOOST_CHECK_EQUAL(table.owner(12345), 3);
+}
+
+BOOST_AUTO_TEST_CASE( routing_table_hub_detection_test )
+{
+  RoutingTable table(4, 0.25, 50, 16);
+  BOOST_CHECK(table.detectsHubs());
+  BOOST_CHECK_THROW(table.attach(4), RoutingTableException);
+
+  // Nothing is promoted until every node shares the table
+  for (size_t node = 0; node < 3; node++) {
+    table.attach(node);
+  }
+  BOOST_CHECK(!table.isShared());
+  for (size_t i = 0; i < 1000; i++) {
+    BOOST_CHECK(!table.observe(1));
+  }
+  BOOST_CHECK(!table.isReplicated(1));
+  table.attach(3);
+  table.attach(3);
+  BOOST_CHECK(table.isShared());
+
+  size_t promoted = 0;
+  for (size_t i = 0; i < 1000; i++) {
+    if (table.observe(1)) { promoted++; }
+    table.observe(100 + i);
+    table.observe(2000 + i);
+  }
+
+  BOOST_CHECK_EQUAL(promoted, 1);
+  BOOST_CHECK(table.isReplicated(1));
+  BOOST_CHECK_EQUAL(table.getNumReplicated(), 1);
+}
+
+BOOST_AUTO_TEST_CASE( routing_table_load_test )
+{
+  RoutingTable table(3);
+  BOOST_CHECK_EQUAL(table.leastLoaded(0, 1), 0);
+
+  table.addLoad(0, 5);
+  table.addLoad(1);
+  BOOST_CHECK_EQUAL(table.getLoad(0), 5);
+  BOOST_CHECK_EQUAL(table.leastLoaded(0, 1), 1);
+  BOOST_CHECK_EQUAL(table.leastLoaded(1, 2), 2);
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 4; t++) {
+    threads.push_back(std::thread([&table]() {
+      for (size_t i = 0; i < 1000; i++) {
+        table.addLoad(2);
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  BOOST_CHECK_EQUAL(table.getLoad(2), 4000);
+  BOOST_CHECK_EQUAL(table.leastLoaded(1, 2), 1);
+}
@@ -155,3 +155,47 @@ BOOST_AUTO_TEST_CASE( test_add_dormant )
   BOOST_CHECK_EQUAL(2, sw.getIthElement(3).second);
   BOOST_CHECK_THROW(sw.getIthElement(4), std::out_of_range);
 }
+
+BOOST_AUTO_TEST_CASE( test_top_k_changes )
+{
+  /**
+   * add() reports a change only when the top k keys or their frequencies
+   * change, which can only happen when a window becomes dormant.
+   */
+  SlidingWindow<size_t> sw(30, 10, 2);
+  BOOST_CHECK_EQUAL(0, sw.getTopKeys().size());
+
+  // First active window: 1 x6, 2 x4
+  for (int i = 0; i < 6; i++) BOOST_CHECK(!sw.add(1));
+  for (int i = 0; i < 4; i++) BOOST_CHECK(!sw.add(2));
+
+  // Becomes dormant
+  BOOST_CHECK(sw.add(1));
+  BOOST_REQUIRE_EQUAL(2, sw.getTopKeys().size());
+  BOOST_CHECK_EQUAL("1", sw.getTopKeys()[0]);
+  BOOST_CHECK_EQUAL("2", sw.getTopKeys()[1]);
+  BOOST_CHECK_CLOSE(0.6, sw.getTopFrequencies()[0], 0.001);
+  BOOST_CHECK_CLOSE(0.4, sw.getTopFrequencies()[1], 0.001);
+
+  // Second window: 1 x6, 2 x4 gives the same frequencies.
+  for (int i = 0; i < 5; i++) BOOST_CHECK(!sw.add(1));
+  for (int i = 0; i < 4; i++) BOOST_CHECK(!sw.add(2));
+  BOOST_CHECK(!sw.add(3));
+  BOOST_CHECK_EQUAL("1", sw.getTopKeys()[0]);
+  BOOST_CHECK_CLOSE(0.6, sw.getTopFrequencies()[0], 0.001);
+
+  // Third window: 3 x10.  Pushes out the first window.
+  for (int i = 0; i < 9; i++) BOOST_CHECK(!sw.add(3));
+  BOOST_CHECK(sw.add(3));
+  BOOST_CHECK_EQUAL("3", sw.getTopKeys()[0]);
+  BOOST_CHECK_EQUAL("1", sw.getTopKeys()[1]);
+
+  auto top = sw.getTopK(5);
+  BOOST_REQUIRE_EQUAL(3, top.size());
+  BOOST_CHECK_EQUAL(3, top[0].first);
+  BOOST_CHECK_EQUAL(10, top[0].second);
+  BOOST_CHECK_EQUAL(1, top[1].first);
+  BOOST_CHECK_EQUAL(6, top[1].second);
+  BOOST_CHECK_EQUAL(2, top[2].first);
+  BOOST_CHECK_EQUAL(4, top[2].second);
+}
@@ -0,0 +1,49 @@
+#define BOOST_TEST_MAIN TestSmallHashSet
+#include <boost/test/unit_test.hpp>
+#include <sam/SmallHashSet.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( small_hash_set_test_inline )
+{
+  SmallHashSet set;
+  BOOST_CHECK(set.empty());
+  BOOST_CHECK(set.insert(0));
+  BOOST_CHECK(!set.insert(0));
+  for (uint64_t i = 1; i <= SmallHashSet::INLINE_CAPACITY; i++) {
+    BOOST_CHECK(set.insert(i));
+  }
+  BOOST_CHECK(!set.insert(2));
+  BOOST_CHECK_EQUAL(set.size(), SmallHashSet::INLINE_CAPACITY + 1);
+  BOOST_CHECK_EQUAL(set.heapBytes(), 0);
+  BOOST_CHECK(set.contains(0));
+  BOOST_CHECK(!set.contains(100));
+}
+
+BOOST_AUTO_TEST_CASE( small_hash_set_test_table )
+{
+  SmallHashSet set;
+  for (uint64_t i = 0; i < 1000; i++) {
+    BOOST_CHECK(set.insert(i << 40));
+  }
+  BOOST_CHECK_EQUAL(set.size(), 1000);
+  BOOST_CHECK(set.heapBytes() > 0);
+  for (uint64_t i = 0; i < 1000; i++) {
+    BOOST_CHECK(set.contains(i << 40));
+    BOOST_CHECK(!set.contains((i << 40) + 1));
+  }
+
+  // Copies are independent
+  SmallHashSet copy(set);
+  BOOST_CHECK(copy.insert(7));
+  BOOST_CHECK(!set.contains(7));
+  BOOST_CHECK(copy.contains(999ull << 40));
+
+  SmallHashSet moved(std::move(copy));
+  BOOST_CHECK(moved.contains(7));
+  BOOST_CHECK(copy.empty());
+  BOOST_CHECK(!copy.contains(7));
+
+  set = moved;
+  BOOST_CHECK(set.contains(7));
+}
@@ -0,0 +1,66 @@
+#define BOOST_TEST_MAIN TestStringInterner
+#include <boost/test/unit_test.hpp>
+#include <boost/lexical_cast.hpp>
+#include <thread>
+#include <vector>
+#include <sam/StringInterner.hpp>
+
+using namespace sam;
+
+BOOST_AUTO_TEST_CASE( test_intern )
+{
+  /**
+   * Ids are dense, start at 1, and map back to their strings.
+   */
+  StringInterner interner;
+  BOOST_CHECK(interner.find("192.168.0.1") == StringInterner::NO_ID);
+
+  auto id1 = interner.intern("192.168.0.1");
+  auto id2 = interner.intern("192.168.0.2");
+  BOOST_CHECK_EQUAL(id1, 1);
+  BOOST_CHECK_EQUAL(id2, 2);
+  BOOST_CHECK_EQUAL(interner.intern("192.168.0.1"), id1);
+  BOOST_CHECK_EQUAL(interner.find("192.168.0.2"), id2);
+  BOOST_CHECK_EQUAL(interner.lookup(id1), "192.168.0.1");
+  BOOST_CHECK_EQUAL(interner.size(), 2);
+
+  BOOST_CHECK_THROW(interner.lookup(StringInterner::NO_ID),
+                    StringInternerException);
+  BOOST_CHECK_THROW(interner.lookup(3), StringInternerException);
+}
+
+BOOST_AUTO_TEST_CASE( test_intern_grow )
+{
+  /**
+   * Threads intern overlapping strings while the table grows from its
+   * smallest size.  Every thread has to see the same id for a string.
+   */
+  StringInterner interner(16);
+  size_t numThreads = 4;
+  size_t numStrings = 20000;
+  std::vector<std::vector<StringInterner::IdType>> ids(numThreads);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < numThreads; i++) {
+    threads.push_back(std::thread([i, numStrings, &ids, &interner]() {
+      for (size_t j = 0; j < numStrings; j++) {
+        // Each thread goes through the strings in a different order.
+        size_t k = (j * (2 * i + 1)) % numStrings;
+        ids[i].push_back(
+          interner.intern(boost::lexical_cast<std::string>(k)));
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (size_t i = 0; i < numThreads; i++) {
+    for (size_t j = 0; j < numStrings; j++) {
+      size_t k = (j * (2 * i + 1)) % numStrings;
+      std::string str = boost::lexical_cast<std::string>(k);
+      BOOST_CHECK_EQUAL(ids[i][j], interner.find(str));
+      BOOST_CHECK_EQUAL(interner.lookup(ids[i][j]), str);
+    }
+  }
+  BOOST_CHECK(interner.size() >= numStrings);
+}
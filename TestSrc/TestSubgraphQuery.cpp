@@ -250,3 +250,80 @@ BOOST_FIXTURE_TEST_CASE( test_defined_start_undefined_end, F )
   BOOST_CHECK_EQUAL(edgeDesc.endTimeRange.second, maxOffset);
 
 }
+
+/**
+ * Adds x e1 y, y e2 z, and w e3 x, all starting between 0 and 10, so the
+ * planner is free to choose the order.
+ */
+void addTiedPath(QueryType& query)
+{
+  std::vector<std::vector<std::string>> path = 
+    {{"x", "e1", "y"}, {"y", "e2", "z"}, {"w", "e3", "x"}};
+  for (auto const& edge : path) {
+    query.addExpression(EdgeExpression(edge[0], edge[1], edge[2]));
+    query.addExpression(TimeEdgeExpression(EdgeFunction::StartTime, edge[1],
+                        EdgeOperator::GreaterThanEqual, 0));
+    query.addExpression(TimeEdgeExpression(EdgeFunction::StartTime, edge[1],
+                        EdgeOperator::LessThanEqual, 10));
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE( test_plan_keeps_order_on_ties, F )
+{
+  QueryType query(featureMap);
+  addTiedPath(query);
+  query.finalize();
+
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(0).getEdgeId(), "e1");
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(1).getEdgeId(), "e2");
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(2).getEdgeId(), "e3");
+  BOOST_CHECK_EQUAL(query.getPlan().size(), 3);
+  BOOST_CHECK(query.getPlan()[1].sourceBound);
+  BOOST_CHECK(!query.getPlan()[1].targetBound);
+  BOOST_CHECK_THROW(query.finalize(), SubgraphQueryException);
+}
+
+BOOST_FIXTURE_TEST_CASE( test_plan_anchors_on_constrained_vertex, F )
+{
+  // w in top, where top has one of the 1000 vertices
+  QueryType query(featureMap);
+  addTiedPath(query);
+  query.addExpression(VertexConstraintExpression("w", VertexOperator::In, 
+                                                 "top"));
+  std::vector<std::string> keys = {"192.168.0.1"};
+  std::vector<double> frequencies = {0.5};
+  featureMap->updateInsert("", "top", TopKFeature(keys, frequencies));
+  query.finalize();
+
+  // The anchor is e3, then e1 (connected to x) before e2.
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(0).getEdgeId(), "e3");
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(1).getEdgeId(), "e1");
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(2).getEdgeId(), "e2");
+  BOOST_CHECK_CLOSE(query.getPlan()[0].fanOut, 0.001, 0.0001);
+
+  // The slots follow the plan
+  BOOST_CHECK_EQUAL(query.getVariable(query.getSourceSlot(0)), "w");
+  BOOST_CHECK_EQUAL(query.getVariable(query.getTargetSlot(1)), "y");
+
+  std::string plan = query.explain();
+  BOOST_CHECK(plan.find("0: e3 (w -> x) anchor") != std::string::npos);
+  BOOST_CHECK(plan.find("1: e1 (x* -> y)") != std::string::npos);
+}
+
+BOOST_FIXTURE_TEST_CASE( test_plan_avoids_hubs, F )
+{
+  // Out-degrees are skewed, so following an edge out of a vertex fans out
+  // far more than following one in.
+  QueryStatistics statistics;
+  statistics.outDegreeSecondMoment = 100;
+
+  QueryType query(featureMap);
+  addTiedPath(query);
+  query.finalize(statistics);
+
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(0).getEdgeId(), "e1");
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(1).getEdgeId(), "e3");
+  BOOST_CHECK_EQUAL(query.getEdgeDescription(2).getEdgeId(), "e2");
+  BOOST_CHECK(query.getPlan()[1].targetBound);
+  BOOST_CHECK_CLOSE(query.getPlan()[2].fanOut, 100, 0.0001);
+}
@@ -226,3 +226,43 @@ BOOST_FIXTURE_TEST_CASE( test_watering_hole, F )
   BOOST_CHECK_EQUAL(pair.second.getExpireTime(), expireTime); 
   
 }
+
+BOOST_FIXTURE_TEST_CASE( test_shared_prefix, F )
+{
+  // Results made from the same result share its edges, and an edge that
+  // has been seen before (even with a new id) is not added again.
+  auto query = std::make_shared<QueryType>(featureMap);
+  query->addExpression(*startTimeExpressionE1);
+  query->addExpression(*targetE1Bait);
+  query->addExpression(*startTimeExpressionE2_begin);
+  query->addExpression(*startTimeExpressionE2_end);
+  query->addExpression(*targetE2Controller);
+  query->finalize();
+
+  BOOST_CHECK_EQUAL(query->numVariables(), 3);
+  BOOST_CHECK_EQUAL(query->getVariable(query->getSourceSlot(1)), "target1");
+  BOOST_CHECK_EQUAL(query->getSourceSlot(0), query->getSourceSlot(1));
+
+  ResultType result(query, netflow1);
+  BOOST_CHECK_EQUAL(result.getCurrentSource(), "target");
+  BOOST_CHECK(!result.boundTarget());
+
+  auto pair = result.addEdge(netflow2);
+  BOOST_CHECK(pair.first);
+  BOOST_CHECK(pair.second.complete());
+  BOOST_CHECK_EQUAL(pair.second.getResultTuple(0).id, 1);
+  BOOST_CHECK_EQUAL(pair.second.getResultTuple(1).id, 2);
+  BOOST_CHECK_THROW(pair.second.getResultTuple(2), 
+                    SubgraphQueryResultException);
+
+  // The original result is unchanged
+  BOOST_CHECK(!result.complete());
+  BOOST_CHECK_EQUAL(result.getResultTuple(0).id, 1);
+  BOOST_CHECK(!result.noSamId(1));
+  BOOST_CHECK(result.noSamId(2));
+
+  // Same edge, different id
+  EdgeType repeated = tuplizer(4, netflowString2);
+  BOOST_CHECK(!result.addEdge(repeated).first);
+  BOOST_CHECK(!result.addEdge(netflow2).first);
+}
@@ -5,6 +5,7 @@
 #include <sam/SubgraphQuery.hpp>
 #include <sam/SubgraphQueryResult.hpp>
 #include <sam/SubgraphQueryResultMap.hpp>
+#include <sam/QueryTrie.hpp>
 #include <sam/tuples/Edge.hpp>
 #include <sam/tuples/Tuplizer.hpp>
 #include <sam/tuples/VastNetflow.hpp>
@@ -286,3 +287,83 @@ BOOST_FIXTURE_TEST_CASE( test_process_against_graph, F )
 
 }
 
+
+///
+/// Two queries, a->b, b->c and a->b, b->c, c->d, share one partial result
+/// until the first is complete.
+///
+BOOST_FIXTURE_TEST_CASE( test_shared_prefix, F )
+{
+  std::string str1 = generator->generate(0.0);
+  std::string str2 = generator->generate(0.1);
+  std::string str3 = generator->generate(0.2);
+
+  Tuplizer tuplizer;
+  EdgeType netflow1 = tuplizer(1, str1);
+  EdgeType netflow2 = tuplizer(2, str2);
+  EdgeType netflow3 = tuplizer(3, str3);
+
+  std::get<SourceIp>(netflow1.tuple) = "A"; 
+  std::get<DestIp>(netflow1.tuple) = "B"; 
+  std::get<SourceIp>(netflow2.tuple) = "B"; 
+  std::get<DestIp>(netflow2.tuple) = "C"; 
+  std::get<SourceIp>(netflow3.tuple) = "C"; 
+  std::get<DestIp>(netflow3.tuple) = "D"; 
+
+  EdgeExpression A2B("nodea", "e0", "nodeb");
+  EdgeExpression B2C("nodeb", "e1", "nodec");
+  EdgeExpression C2D("nodec", "e2", "noded");
+  TimeEdgeExpression startTimeExpressionA2B(starttimeFunction, "e0",
+                                           equal_edge_operator, 0);
+  TimeEdgeExpression startTimeExpressionB2C(starttimeFunction, "e1",
+                                           greater_edge_operator, 0);
+  TimeEdgeExpression startTimeExpressionC2D(starttimeFunction, "e2",
+                                           greater_edge_operator, 0);
+
+  auto path = std::make_shared<QueryType>(featureMap);
+  path->addExpression(A2B);
+  path->addExpression(B2C);
+  path->addExpression(startTimeExpressionA2B);
+  path->addExpression(startTimeExpressionB2C);
+  path->finalize();
+
+  auto longPath = std::make_shared<QueryType>(featureMap);
+  longPath->addExpression(A2B);
+  longPath->addExpression(B2C);
+  longPath->addExpression(C2D);
+  longPath->addExpression(startTimeExpressionA2B);
+  longPath->addExpression(startTimeExpressionB2C);
+  longPath->addExpression(startTimeExpressionC2D);
+  longPath->finalize();
+
+  QueryTrie<QueryType> trie;
+  trie.add(path);
+  trie.add(longPath);
+  BOOST_REQUIRE_EQUAL(trie.getRoots().size(), 1);
+
+  size_t tableCapacity = 1000;
+  size_t resultCapacity = 1000;
+  size_t numNodes = 1;
+  size_t nodeId = 0;
+  MapType map(numNodes, nodeId, tableCapacity, resultCapacity, *csr, *csc); 
+
+  std::list<EdgeRequestType> edgeRequests;
+  QueryResultType result(trie.getRoots()[0], netflow1);
+  BOOST_CHECK_EQUAL(result.numQueries(), 2);
+  map.add(result, edgeRequests);
+
+  // One result stands in for both queries.
+  BOOST_CHECK_EQUAL(map.getNumIntermediateResults(), 1);
+  BOOST_CHECK_EQUAL(map.getNumPartialResults(), 1);
+  BOOST_CHECK_EQUAL(map.getNumIndependentPartialResults(), 2);
+
+  // c->d is found in the graph once b->c forks the result.
+  csr->addEdge(netflow3);
+  csc->addEdge(netflow3);
+  map.process(netflow2, edgeRequests);
+
+  BOOST_CHECK_EQUAL(map.getNumResults(), 2);
+  BOOST_CHECK_EQUAL(map.getResult(0).complete(), true);
+  BOOST_CHECK_EQUAL(map.getResult(1).complete(), true);
+  BOOST_CHECK_EQUAL(edgeRequests.size(), 0);
+}
@@ -0,0 +1,119 @@
+#define BOOST_TEST_MAIN TestTimeExponentialHistogram
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+#include <cmath>
+#include <sam/TimeExponentialHistogram.hpp>
+#include <sam/TimeExponentialHistogramSum.hpp>
+#include <sam/TimeExponentialHistogramVariance.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef Edge<size_t, EmptyLabel, VastNetflow> EdgeType;
+typedef TuplizerFunction<EdgeType, MakeVastNetflow> Tuplizer;
+
+BOOST_AUTO_TEST_CASE( time_eh_test_expire )
+{
+  BOOST_CHECK_THROW(TimeExponentialHistogram<size_t>(0, 2), std::out_of_range);
+
+  /**
+   * With only a few items nothing is merged, so the totals are exact.
+   */
+  TimeExponentialHistogram<size_t> eh(10, 2);
+  BOOST_CHECK_EQUAL(eh.getTotal(0), 0);
+  eh.add(1, 0);
+  eh.add(2, 5);
+  eh.add(4, 9);
+  BOOST_CHECK_EQUAL(eh.getTotal(9), 7);
+  BOOST_CHECK_EQUAL(eh.getNumItems(9), 3);
+
+  // The item at 0 is out of the window at 10.
+  BOOST_CHECK_EQUAL(eh.getTotal(10), 6);
+  BOOST_CHECK_EQUAL(eh.getNumItems(), 2);
+
+  // Expiry only happens when asked.
+  BOOST_CHECK_EQUAL(eh.getTotal(), 6);
+  BOOST_CHECK_EQUAL(eh.getTotal(100), 0);
+  BOOST_CHECK_EQUAL(eh.getNumBuckets(), 0);
+
+  // An item that arrives late counts as arriving at the newest time.
+  eh.add(1, 200);
+  eh.add(1, 150);
+  BOOST_CHECK_EQUAL(eh.getTotal(209), 2);
+  BOOST_CHECK_EQUAL(eh.getTotal(210), 0);
+}
+
+BOOST_AUTO_TEST_CASE( time_eh_test_buckets )
+{
+  /**
+   * A fast key and a slow key get the same time horizon, and the buckets
+   * grow with the log of the number of items in the window.
+   */
+  size_t k = 2;
+  TimeExponentialHistogram<size_t> fast(60, k);
+  TimeExponentialHistogram<size_t> slow(60, k);
+  for (size_t i = 0; i < 1000000; i++) {
+    double time = i / 1000.0;
+    fast.add(1, time);
+    if (i % 100000 == 0) slow.add(1, time);
+  }
+
+  // 60,000 items in the fast window at 999.999.  The oldest bucket can
+  // straddle the edge of the window.
+  double time = 999.999;
+  size_t total = fast.getTotal(time);
+  BOOST_CHECK(total >= 60000);
+  BOOST_CHECK_CLOSE(static_cast<double>(total), 60000.0, 100.0 / k);
+  BOOST_CHECK(fast.getNumBuckets() <= (k + 2) + 16 * (k/2 + 2));
+  BOOST_CHECK(fast.memoryUsage() <=
+              TimeExponentialHistogram<size_t>::memoryUsage(k, 1 << 20) +
+              fast.getNumBuckets() *
+                sizeof(TimeExponentialHistogram<size_t>::Bucket));
+
+  // The last item of the slow key, at 900, is in its window until 960.
+  BOOST_CHECK_EQUAL(slow.getTotal(959), 1);
+  BOOST_CHECK_EQUAL(slow.getTotal(960), 0);
+}
+
+BOOST_AUTO_TEST_CASE( time_eh_test_sum_operator )
+{
+  /**
+   * The sum, average and variance of SrcTotalBytes per destination over
+   * the last 60 seconds.  k is large enough that nothing is merged, so the
+   * values are exact.
+   */
+  Tuplizer tuplizer;
+  auto featureMap = std::make_shared<FeatureMap>();
+  TimeExponentialHistogramSum<size_t, EdgeType, SrcTotalBytes, TimeSeconds,
+                              DestIp> sum(60, 10, 0, featureMap, "sum0");
+  TimeExponentialHistogramAve<double, EdgeType, SrcTotalBytes, TimeSeconds,
+                              DestIp> ave(60, 10, 0, featureMap, "ave0");
+  TimeExponentialHistogramVariance<double, EdgeType, SrcTotalBytes,
+                                   TimeSeconds, DestIp>
+    var(60, 10, 0, featureMap, "var0");
+
+  for (size_t i = 0; i < 100; i++) {
+    // dest0 gets one flow every 10 seconds with 1 or 3 bytes.
+    std::string dest = "dest0";
+    std::string bytes = i % 2 == 0 ? "1" : "3";
+    std::string str = boost::lexical_cast<std::string>(i * 10) +
+      ",2013-04-10 08:32:36,20130410083236.384094,17,UDP,target," +
+      dest + ",29986,1900,0,0,1.0,133,0," + bytes + ",0,1,0,0";
+    EdgeType edge = tuplizer(i, str);
+    sum.consume(edge);
+    ave.consume(edge);
+    var.consume(edge);
+  }
+
+  // dest0 has the flows at 940 through 990 in its window.
+  BOOST_CHECK_EQUAL(featureMap->at("dest0", "sum0")->getValue(), 12);
+  BOOST_CHECK_EQUAL(featureMap->at("dest0", "ave0")->getValue(), 2);
+  BOOST_CHECK_EQUAL(featureMap->at("dest0", "var0")->getValue(), 1);
+
+  BOOST_CHECK_THROW((TimeExponentialHistogramSum<size_t, EdgeType,
+    SrcTotalBytes, TimeSeconds, DestIp>(0, 2, 0, featureMap, "sum1")),
+    std::out_of_range);
+}
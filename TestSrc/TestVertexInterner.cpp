@@ -0,0 +1,197 @@
+#define BOOST_TEST_MAIN TestVertexInterner
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <fstream>
+#include <list>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <sam/CompressedSparse.hpp>
+#include <sam/ReadCSV.hpp>
+#include <sam/VertexInterner.hpp>
+#include <sam/tuples/Edge.hpp>
+#include <sam/tuples/Tuplizer.hpp>
+#include <sam/tuples/VastNetflow.hpp>
+#include <sam/tuples/VastNetflowGenerators.hpp>
+
+using namespace sam;
+using namespace sam::vast_netflow;
+
+typedef VertexInterner::IdType IdType;
+
+BOOST_AUTO_TEST_CASE( vertex_interner_test_ipv4 )
+{
+  VertexInterner interner;
+  IdType a = interner.intern("192.168.0.1");
+  std::string line = "x,192.168.0.1,y";
+  BOOST_CHECK_EQUAL(interner.intern(line.data() + 2, 11), a);
+  BOOST_CHECK(VertexInterner::isAddress(a));
+  BOOST_CHECK_EQUAL(interner.lookup(a), "192.168.0.1");
+  BOOST_CHECK_EQUAL(interner.find("192.168.0.1"), a);
+  BOOST_CHECK_EQUAL(interner.find("192.168.0.2"),
+                    IdType(VertexInterner::NO_ID));
+  BOOST_CHECK(interner.intern("192.168.0.2") != a);
+
+  uint32_t address;
+  BOOST_CHECK(VertexInterner::parseIpv4("10.0.0.255", 10, address));
+  BOOST_CHECK_EQUAL(address, htonl(0x0a0000ff));
+  BOOST_CHECK(!VertexInterner::parseIpv4("10.0.0.256", 10, address));
+  BOOST_CHECK(!VertexInterner::parseIpv4("10.0.0", 6, address));
+  BOOST_CHECK(!VertexInterner::parseIpv4("10.0.0.1.", 9, address));
+  BOOST_CHECK(!VertexInterner::parseIpv4("10.0.0.0001", 11, address));
+
+  // Leading zeros are kept as text
+  IdType octal = interner.intern("010.0.0.1");
+  BOOST_CHECK(!VertexInterner::isAddress(octal));
+  BOOST_CHECK_EQUAL(interner.lookup(octal), "010.0.0.1");
+}
+
+BOOST_AUTO_TEST_CASE( vertex_interner_test_ipv6 )
+{
+  VertexInterner interner;
+  IdType a = interner.intern("2001:db8::1");
+  BOOST_CHECK(VertexInterner::isAddress(a));
+  BOOST_CHECK_EQUAL(interner.intern("2001:0db8:0:0:0:0:0:0001"), a);
+  BOOST_CHECK_EQUAL(interner.lookup(a), "2001:db8::1");
+
+  // IPv4-mapped addresses are the IPv4 address
+  IdType v4 = interner.intern("10.1.2.3");
+  BOOST_CHECK_EQUAL(interner.intern("::ffff:10.1.2.3"), v4);
+  BOOST_CHECK_EQUAL(interner.lookup(v4), "10.1.2.3");
+
+  BOOST_CHECK(!VertexInterner::isAddress(interner.intern("bad::address::")));
+  BOOST_CHECK(!VertexInterner::isAddress(interner.intern("host:80")));
+}
+
+BOOST_AUTO_TEST_CASE( vertex_interner_test_names )
+{
+  VertexInterner interner;
+  IdType bait = interner.intern("bait");
+  BOOST_CHECK(!VertexInterner::isAddress(bait));
+  BOOST_CHECK_EQUAL(interner.intern(std::string("bait")), bait);
+  BOOST_CHECK_EQUAL(interner.lookup(bait), "bait");
+  BOOST_CHECK_EQUAL(interner.size(), 1);
+  BOOST_CHECK_EQUAL(&VertexInterner::local(), &VertexInterner::local());
+}
+
+BOOST_AUTO_TEST_CASE( vertex_interner_test_threads )
+{
+  /**
+   * Threads interning overlapping addresses agree on the ids.
+   */
+  VertexInterner interner(16);
+  size_t numThreads = 8;
+  size_t numAddresses = 5000;
+  std::vector<std::vector<IdType>> ids(numThreads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      for (size_t i = 0; i < numAddresses; i++) {
+        std::string ip = "10.0." + std::to_string(i / 256) + "." +
+                         std::to_string(i % 256);
+        ids[t].push_back(interner.intern(ip));
+      }
+    }));
+  }
+  for (auto& thread : threads) thread.join();
+  for (size_t t = 1; t < numThreads; t++) {
+    BOOST_CHECK(ids[t] == ids[0]);
+  }
+  BOOST_CHECK_EQUAL(interner.lookup(ids[0][300]), "10.0.1.44");
+}
+
+BOOST_AUTO_TEST_CASE( vertex_interner_test_compressed_sparse )
+{
+  /**
+   * The id functors work as the hash and equality functions of the graph.
+   */
+  typedef std::tuple<double, IdType, IdType, double> TupleType;
+  typedef Edge<size_t, std::tuple<>, TupleType> EdgeType;
+  typedef CompressedSparse<EdgeType, 1, 2, 0, 3,
+    VertexIdHashFunction, VertexIdEqualityFunction> GraphType;
+
+  VertexInterner interner;
+  GraphType graph(100, 1000);
+  for (size_t i = 0; i < 100; i++) {
+    IdType src = interner.intern("192.168.0." + std::to_string(i % 10));
+    IdType trg = interner.intern("10.0.0." + std::to_string(i));
+    graph.addEdge(EdgeType(i, std::tuple<>(), TupleType(i, src, trg, 0.1)));
+  }
+  BOOST_CHECK_EQUAL(graph.countEdges(), 100);
+  BOOST_CHECK_EQUAL(interner.size(), 110);
+}
+
+namespace {
+
+typedef Edge<size_t, SingleBoolLabel, VastNetflowInterned> InternedEdge;
+typedef CompressedSparse<InternedEdge, SourceIp, DestIp, TimeSeconds,
+  DurationSeconds, VertexIdHashFunction, VertexIdEqualityFunction>
+  InternedGraph;
+
+/**
+ * Adds the edges it is fed to a graph keyed by vertex id.
+ */
+class InternedGraphConsumer : public AbstractConsumer<InternedEdge>
+{
+public:
+  InternedGraph graph;
+
+  InternedGraphConsumer() : graph(100, 1000000) {}
+
+  bool consume(InternedEdge const& edge) {
+    graph.addEdge(edge);
+    return true;
+  }
+
+  void terminate() {}
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( vertex_interner_test_ingest )
+{
+  /**
+   * ReadCSV with the interning tuplizer gives the graph vertex ids that
+   * map back to the ips in the input.
+   */
+  UniformDestPort generator("192.168.0.1", 4);
+  std::string filename = "testvertexinterner.csv";
+  std::vector<std::string> lines;
+  std::ofstream file(filename);
+  for (size_t i = 0; i < 50; i++) {
+    lines.push_back("0," + generator.generate()); // Label first
+    file << lines.back() << std::endl;
+  }
+  file.close();
+
+  ReadCSV<InternedEdge, TuplizerFunction<InternedEdge, 
+    MakeVastNetflowInterned>> receiver(0, filename);
+  auto consumer = std::make_shared<InternedGraphConsumer>();
+  receiver.registerConsumer(consumer);
+  receiver.connect();
+  receiver.receive();
+  std::remove(filename.c_str());
+
+  BOOST_CHECK_EQUAL(consumer->graph.countEdges(), lines.size());
+
+  VertexInterner& interner = VertexInterner::local();
+  IdType dest = interner.find("192.168.0.1");
+  BOOST_REQUIRE(dest != VertexInterner::NO_ID);
+  BOOST_CHECK(VertexInterner::isAddress(dest));
+
+  typedef Edge<size_t, SingleBoolLabel, VastNetflow> PlainEdge;
+  TuplizerFunction<PlainEdge, MakeVastNetflow> plain;
+  for (auto const& line : lines) {
+    PlainEdge edge = plain(0, line);
+    IdType source = interner.find(std::get<SourceIp>(edge.tuple));
+    BOOST_REQUIRE(source != VertexInterner::NO_ID);
+    BOOST_CHECK_EQUAL(interner.lookup(source), std::get<SourceIp>(edge.tuple));
+
+    std::list<InternedEdge> found;
+    double time = std::get<TimeSeconds>(edge.tuple);
+    consumer->graph.findEdges(source, dest, time - 1, time + 1, 
+                              time - 1, time + 10, found);
+    BOOST_CHECK(!found.empty());
+  }
+}
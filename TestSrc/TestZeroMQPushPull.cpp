@@ -115,3 +115,67 @@ BOOST_AUTO_TEST_CASE( test_zeromqpushpull )
   delete generator1;
 }
 
+
+BOOST_AUTO_TEST_CASE( test_zeromqpushpull_ingest )
+{
+  /**
+   * Same as above, but the received edges go through an IngestQueue.
+   */
+  size_t queueLength = 1;
+  size_t numNodes = 2;
+  std::vector<std::string> hostnames = {"localhost", "localhost"};
+  size_t hwm = 1000;
+  size_t timeout = 1000;
+  size_t startingPort = 10100;
+  size_t ingestCapacity = 1024;
+  size_t n = 10000;
+
+  AbstractVastNetflowGenerator* generator0 = 
+    new UniformDestPort("192.168.0.1", 1);
+  AbstractVastNetflowGenerator* generator1 = 
+    new UniformDestPort("192.168.0.2", 1);
+   
+  PartitionType* pushPull0 = new PartitionType(queueLength, numNodes, 0,
+    hostnames, startingPort, timeout, true, hwm, ingestCapacity);
+  PartitionType* pushPull1 = new PartitionType(queueLength, numNodes, 1,
+    hostnames, startingPort, timeout, true, hwm, ingestCapacity);
+
+  BOOST_CHECK(pushPull0->getIngestQueue() != nullptr);
+
+  auto function = [n](AbstractVastNetflowGenerator *generator,
+                      PartitionType* pushPull)
+  {
+    Tuplizer tuplizer;
+    for(size_t i = 0; i < n; i++) {
+      EdgeType edge = tuplizer(i, generator->generate());
+      pushPull->consume(edge);
+    }
+    pushPull->terminate();
+  };
+
+  std::thread thread0(function, generator0, pushPull0);
+  std::thread thread1(function, generator1, pushPull1);
+  thread0.join();
+  thread1.join();
+
+  BOOST_CHECK_EQUAL(n, pushPull0->getConsumeCount());
+  BOOST_CHECK_EQUAL(n, pushPull1->getConsumeCount());
+
+  size_t read = pushPull0->getNumReadItems() + pushPull1->getNumReadItems();
+  BOOST_CHECK(2 * n <= read);
+  BOOST_CHECK(4 * n >= read);
+
+  // The other node may still be sending after terminate, so only the
+  // edges received so far have necessarily been fed on.
+  for (auto pushPull : {pushPull0, pushPull1}) {
+    auto queue = pushPull->getIngestQueue();
+    BOOST_CHECK_EQUAL(queue->getNumDropped(), 0);
+    BOOST_CHECK(queue->getNumHandled() > 0);
+    BOOST_CHECK(queue->getNumHandled() <= queue->getNumPushed());
+  }
+
+  delete pushPull0;
+  delete pushPull1;
+  delete generator0;
+  delete generator1;
+}
@@ -1,6 +1,7 @@
 #define BOOST_TEST_MAIN TestUtil
 #include <boost/test/unit_test.hpp>
 #include <boost/tokenizer.hpp>
+#include <atomic>
 #include <stdexcept>
 #include <tuple>
 #include <string>
@@ -314,3 +315,173 @@ BOOST_AUTO_TEST_CASE( test_getHostnameForPull )
 
 
 }
+
+BOOST_AUTO_TEST_CASE( test_for_each_record_in_frame )
+{
+  std::string frame(1, BATCH_FRAME_MARKER);
+  std::vector<std::string> records = {"a", "", "hello"};
+  for (auto record : records) {
+    uint32_t length = record.size();
+    frame.append(reinterpret_cast<char const*>(&length), sizeof(length));
+    frame.append(record);
+  }
+  BOOST_CHECK(isBatchFrame(frame.data(), frame.size()));
+  BOOST_CHECK(!isBatchFrame("a,b", 3));
+
+  std::vector<std::string> found;
+  size_t n = forEachRecordInFrame(frame.data(), frame.size(),
+    [&found](char const* data, size_t size) {
+      found.push_back(std::string(data, size));
+    });
+  BOOST_CHECK_EQUAL(n, 3);
+  BOOST_CHECK(found == records);
+
+  // Cut off the last character of the last record.
+  BOOST_CHECK(isValidFrame(frame.data(), frame.size()));
+  BOOST_CHECK(!isValidFrame(frame.data(), frame.size() - 1));
+  BOOST_CHECK(!isValidFrame(frame.data(), 3));
+  BOOST_CHECK_THROW(forEachRecordInFrame(frame.data(), frame.size() - 1,
+    [](char const*, size_t) {}), ZeroMQUtilException);
+}
+
+BOOST_AUTO_TEST_CASE( test_batch_policy_enabled )
+{
+  /// Any one limit turns batching on.
+  BOOST_CHECK(!BatchPolicy().enabled());
+  BOOST_CHECK(BatchPolicy(10, 0, 0).enabled());
+  BOOST_CHECK(BatchPolicy(1, 4096, 0).enabled());
+  BOOST_CHECK(BatchPolicy(1, 0, 1000).enabled());
+  BOOST_CHECK(!BatchPolicy(0, 0, 0).enabled());
+}
+
+BOOST_AUTO_TEST_CASE( test_batch_policy_frame_records )
+{
+  /// Fills frames the way PushPull::send does and checks how many records
+  /// each one carries.  A maxRecords of 0 or 1 is no record limit.
+  auto recordsPerFrame = [](BatchPolicy const& policy, size_t numRecords,
+                            size_t recordSize) {
+    std::vector<size_t> frames;
+    size_t records = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < numRecords; i++) {
+      if (records == 0) { bytes = 1; } // BATCH_FRAME_MARKER
+      bytes += sizeof(uint32_t) + recordSize;
+      records++;
+      if (policy.isFull(records, bytes, std::chrono::microseconds(0))) {
+        frames.push_back(records);
+        records = 0;
+      }
+    }
+    if (records > 0) { frames.push_back(records); } // flush()
+    return frames;
+  };
+
+  // Each record takes 4 + 12 bytes, so 256 fit in 4096 bytes.
+  for (size_t maxRecords : {0, 1}) {
+    auto frames = recordsPerFrame(BatchPolicy(maxRecords, 4096, 0), 1000, 12);
+    BOOST_REQUIRE_EQUAL(frames.size(), 4);
+    BOOST_CHECK_EQUAL(frames[0], 256);
+    BOOST_CHECK_EQUAL(frames[2], 256);
+    BOOST_CHECK_EQUAL(frames[3], 1000 - 3 * 256);
+  }
+
+  // Deadline only: nothing is sent until the deadline or a flush.
+  auto frames = recordsPerFrame(BatchPolicy(1, 0, 1000), 1000, 12);
+  BOOST_REQUIRE_EQUAL(frames.size(), 1);
+  BOOST_CHECK_EQUAL(frames[0], 1000);
+  BOOST_CHECK(BatchPolicy(1, 0, 1000).isFull(1, 17, 
+    std::chrono::microseconds(1000)));
+
+  // Whichever limit comes first
+  frames = recordsPerFrame(BatchPolicy(100, 4096, 0), 1000, 12);
+  BOOST_REQUIRE_EQUAL(frames.size(), 10);
+  BOOST_CHECK_EQUAL(frames[0], 100);
+}
+
+BOOST_AUTO_TEST_CASE( test_push_pull_byte_batching )
+{
+  /// A byte-only policy puts as many records in a frame as fit, and a
+  /// node that doesn't batch still unpacks the frames.
+  size_t numNodes = 2;
+  std::vector<std::string> hostnames;
+  hostnames.push_back("localhost");
+  hostnames.push_back("localhost");
+  size_t startingPort = 10220;
+  uint32_t hwm = 1000;
+  int timeout = -1;
+
+  std::atomic<size_t> received(0);
+  std::vector<PushPull::RawFunctionType> functions;
+  functions.push_back([&received](char const*, size_t) { received++; });
+
+  PushPull pushPull0(numNodes, 0, 1, 1, hostnames, hwm, functions,
+                     startingPort, timeout, true, BatchPolicy(1, 4096, 0));
+  PushPull pushPull1(numNodes, 1, 1, 1, hostnames, hwm, functions,
+                     startingPort, timeout, true);
+
+  // Each record takes 4 + 12 bytes, so 256 fit in a frame.
+  size_t n = 1000;
+  for (size_t i = 0; i < n; i++) {
+    BOOST_CHECK(pushPull0.send(std::string(12, 'a'), 1));
+  }
+
+  std::thread thread0([&pushPull0]() { pushPull0.terminate(); });
+  std::thread thread1([&pushPull1]() { pushPull1.terminate(); });
+  thread0.join();
+  thread1.join();
+
+  BOOST_CHECK_EQUAL(pushPull0.getTotalMessagesSent(), n);
+  BOOST_CHECK_EQUAL(pushPull0.getTotalFramesSent(), 4);
+  BOOST_CHECK_EQUAL(pushPull1.getTotalMessagesReceived(), n);
+  BOOST_CHECK_EQUAL(pushPull1.getTotalFramesDropped(), 0);
+  BOOST_CHECK_EQUAL(received, n);
+}
+
+BOOST_AUTO_TEST_CASE( test_push_pull_batching )
+{
+  /// Node 0 sends messages to node 1 in batches of up to 10.  The last
+  /// partial batch goes out either because of the deadline or terminate.
+  size_t numNodes = 2;
+  std::vector<std::string> hostnames;
+  hostnames.push_back("localhost");
+  hostnames.push_back("localhost");
+  size_t startingPort = 10200;
+  uint32_t hwm = 1000;
+  int timeout = -1;
+  size_t numPushSockets = 1;
+  size_t numPullThreads = 1;
+  BatchPolicy batchPolicy(10, 0, 1000);
+
+  std::mutex receivedLock;
+  std::vector<std::string> received;
+  auto receive = [&received, &receivedLock](char const* data, size_t size) {
+    std::lock_guard<std::mutex> lock(receivedLock);
+    received.push_back(std::string(data, size));
+  };
+  std::vector<PushPull::RawFunctionType> functions;
+  functions.push_back(receive);
+
+  PushPull pushPull0(numNodes, 0, numPushSockets, numPullThreads, hostnames,
+                     hwm, functions, startingPort, timeout, true, 
+                     batchPolicy);
+  PushPull pushPull1(numNodes, 1, numPushSockets, numPullThreads, hostnames,
+                     hwm, functions, startingPort, timeout, true,
+                     batchPolicy);
+
+  size_t n = 95;
+  for (size_t i = 0; i < n; i++) {
+    BOOST_CHECK(pushPull0.send(boost::lexical_cast<std::string>(i), 1));
+  }
+
+  std::thread thread0([&pushPull0]() { pushPull0.terminate(); });
+  std::thread thread1([&pushPull1]() { pushPull1.terminate(); });
+  thread0.join();
+  thread1.join();
+
+  BOOST_CHECK_EQUAL(pushPull0.getTotalMessagesSent(), n);
+  BOOST_CHECK_EQUAL(pushPull1.getTotalMessagesReceived(), n);
+  BOOST_REQUIRE_EQUAL(received.size(), n);
+  for (size_t i = 0; i < n; i++) {
+    BOOST_CHECK_EQUAL(received[i], boost::lexical_cast<std::string>(i));
+  }
+}